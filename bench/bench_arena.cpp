@@ -0,0 +1,126 @@
+/*
+ * @Descripttion: Frame arena benchmarks: pixel conversion over frames on huge pages against regular pages
+ * @version:
+ * @Date: 2026-10-20 02:41:19
+ * @LastEditTime: 2026-10-20 02:41:19
+ */
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "frame_arena.h"
+#include "pixel_pipeline.h"
+
+using namespace std;
+
+// Frames in flight at once, as between the grab path and the workers; each
+// iteration converts the next one, so the working set exceeds what the TLB
+// covers with 4 KB pages
+const unsigned int k_arenaFramesInFlight = 6;
+
+// Conversions the recorder runs on every frame of these formats (see
+// bench_pipeline), from input frames copied into an arena into outputs
+// carved from the same arena, as EVENT frames are. "regular" maps the arena
+// with 4 KB pages and transparent huge pages turned off, "huge" asks for
+// 2 MB pages; backing says which it got and huge_page_bytes how much of the
+// arena the kernel actually backs with them. The huge cases report their
+// speedup over the regular case just before them.
+static void BenchFrameArena(const BenchOptions& options)
+{
+    struct ArenaCase
+    {
+        const char* name;
+        pipelineFormat input;
+    };
+    const ArenaCase cases[] = {
+        {"mono16_to_mono8", PIPELINE_MONO16},
+        {"bayerrg8_to_mono8", PIPELINE_BAYERRG8},
+    };
+    const arenaPages pages[] = {ARENA_PAGES_REGULAR, ARENA_PAGES_HUGE};
+    const char* pageNames[] = {"regular", "huge"};
+
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const size_t count = (size_t)resolution.width * resolution.height;
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        {
+            const ArenaCase& arenaCase = cases[c];
+            const unsigned int bytesPerPixel = GetPipelineBytesPerPixel(arenaCase.input);
+            const size_t stride = (size_t)resolution.width * bytesPerPixel;
+            PipelineConfig config;
+            config.inputBits = 12;
+            PixelPipeline pipeline;
+            if (pipeline.Select(arenaCase.input, config) < 0)
+            {
+                fprintf(stderr, "Pipeline %s is not instantiated\n", arenaCase.name);
+                continue;
+            }
+            vector<uint8_t> source;
+            double regularNs = 0.0;
+            for (int p = 0; p < 2; p++)
+            {
+                const string name = string(arenaCase.name) + "_" + pageNames[p] + "/" + resolution.name;
+                if (!BenchSelected(options, "arena", name))
+                {
+                    continue;
+                }
+                if (source.empty())
+                {
+                    if (bytesPerPixel == 2)
+                    {
+                        const vector<uint16_t> frame16 = MakeSyntheticFrame16(resolution.width, resolution.height);
+                        source.resize(count * 2);
+                        for (size_t i = 0; i < count; i++)
+                        {
+                            const uint16_t sample = (uint16_t)(frame16[i] & 0x0FFF);
+                            memcpy(&source[i * 2], &sample, 2);
+                        }
+                    }
+                    else
+                    {
+                        source = MakeSyntheticFrame8(resolution.width, resolution.height);
+                    }
+                }
+
+                FrameArena arena(k_arenaFramesInFlight * (source.size() + count) + (16 << 20), pages[p]);
+                vector<ArenaBytes> frames;
+                vector<PipelineOutput> outputs;
+                for (unsigned int i = 0; i < k_arenaFramesInFlight; i++)
+                {
+                    frames.push_back(ArenaBytes(source.begin(), source.end(), ArenaAllocator<uint8_t>(&arena)));
+                    outputs.push_back(PipelineOutput(&arena));
+                    pipeline.Process(&frames[i][0], resolution.width, resolution.height, stride, outputs[i]);
+                }
+
+                unsigned int next = 0;
+                BenchResult result;
+                result.bench = "arena";
+                result.name = name;
+                result.bytesPerOp = (double)source.size();
+                MeasureLoop(options, result, [&]() {
+                    pipeline.Process(&frames[next][0], resolution.width, resolution.height, stride, outputs[next]);
+                    KeepAlive(outputs[next].data[count / 2]);
+                    next = (next + 1) % k_arenaFramesInFlight;
+                });
+                result.Add("mpixels_per_s", count / (result.nsMedian / 1e3));
+                result.Add("backing", GetArenaBackingName(arena.GetBacking()));
+                result.Add("huge_page_bytes", (double)arena.GetHugePageBytes());
+                result.Add("arena_bytes_in_use", (double)arena.GetBytesInUse());
+                result.Add("heap_blocks", (double)arena.GetHeapBlocks());
+                if (p == 0)
+                {
+                    regularNs = result.nsMedian;
+                }
+                else if (regularNs > 0.0)
+                {
+                    result.Add("speedup_vs_regular", regularNs / result.nsMedian);
+                }
+                result.Print();
+            }
+        }
+    }
+}
+
+BENCH_REGISTER("arena", BenchFrameArena);
@@ -0,0 +1,99 @@
+/*
+ * @Descripttion: Clock sync model benchmarks against simulated camera clocks
+ * @version:
+ * @Date: 2026-10-19 18:41:27
+ * @LastEditTime: 2026-10-19 18:41:27
+ */
+
+#include <stdio.h>
+#include <string>
+#include "bench_common.h"
+#include "clock_simulation.h"
+
+using namespace std;
+
+// Accuracy of the drift/offset model on simulated one-hour sessions at 30 fps
+// with one latch per second, and the cost of feeding and querying it. The
+// accuracy cases report the error of mapped frame timestamps against the true
+// host time, how often that error stays within the reported bound, and for
+// comparison the worst error of an offset taken from the first latch alone.
+static void BenchClockSync(const BenchOptions& options)
+{
+    const SimulatedCameraClock* clocks = k_simulatedClocks;
+    for (size_t c = 0; c < k_numSimulatedClocks; c++)
+    {
+        const string name = string("simulated/") + clocks[c].name;
+        if (!BenchSelected(options, "clock_sync", name))
+        {
+            continue;
+        }
+        SimulationReport report = SimulationReport();
+        BenchResult result;
+        result.bench = "clock_sync";
+        result.name = name;
+        MeasureLoop(options, result, [&]() { report = Simulate(clocks[c], 3600.0, 30.0); });
+        result.Add("frames", (double)report.frames);
+        result.Add("unmapped", (double)report.unmapped);
+        result.Add("error_p50_us", report.errorP50Ns / 1e3);
+        result.Add("error_p99_us", report.errorP99Ns / 1e3);
+        result.Add("error_max_us", report.errorMaxNs / 1e3);
+        result.Add("bound_mean_us", report.boundMeanNs / 1e3);
+        result.Add("within_bound", (double)report.withinBound / (double)(report.frames - report.unmapped));
+        if (clocks[c].resetAtS == 0.0)
+        {
+            result.Add("first_latch_error_max_us", report.firstLatchMaxErrorNs / 1e3);
+        }
+        result.Add("latches_slow", (double)report.counts[CLOCK_SAMPLE_SLOW_LATCH]);
+        result.Add("latches_outlier", (double)report.counts[CLOCK_SAMPLE_OUTLIER]);
+        result.Add("resets", (double)report.counts[CLOCK_SAMPLE_RESET]);
+        result.Print();
+    }
+
+    // Feeding one latch: the window refit done on the latch thread
+    if (BenchSelected(options, "clock_sync", "add_sample"))
+    {
+        ClockModel model((ClockSyncConfig()));
+        SimulationRandom random(3);
+        double t = 0.0;
+        BenchResult result;
+        result.bench = "clock_sync";
+        result.name = "add_sample";
+        MeasureLoop(options, result, [&]() {
+            KeepAlive(model.AddSample(SimulateLatch(clocks[0], random, t)));
+            t += 1e9;
+        });
+        result.Print();
+    }
+
+    // Mapping one frame timestamp through the service, done on the grab path
+    if (BenchSelected(options, "clock_sync", "to_host"))
+    {
+        SimulationRandom random(5);
+        double t = 0.0;
+        ClockSyncService service((ClockSyncConfig()), 1000);
+        service.AddClock("simulated", [&](ClockSample& sample) {
+            sample = SimulateLatch(clocks[0], random, t);
+            t += 1e9;
+            return 0;
+        });
+        service.Activate(0);
+        service.Start();
+        uint64_t device = (uint64_t)clocks[0].DeviceAt(4e9);
+        BenchResult result;
+        result.bench = "clock_sync";
+        result.name = "to_host";
+        MeasureLoop(options, result, [&]() {
+            for (int i = 0; i < 1000; i++)
+            {
+                KeepAlive(service.ToHost(0, device));
+                device += 33333333;
+            }
+        });
+        service.Stop();
+        result.nsMedian /= 1000.0;
+        result.nsMin /= 1000.0;
+        result.Print();
+    }
+}
+
+BENCH_REGISTER("clock_sync", BenchClockSync);
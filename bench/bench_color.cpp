@@ -0,0 +1,122 @@
+/*
+ * @Descripttion: Color pipeline benchmarks: synthetic Bayer test charts demosaiced to BGR8 and YUV420
+ * @version:
+ * @Date: 2026-10-20 03:48:30
+ * @LastEditTime: 2026-10-20 03:48:30
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "color_chart.h"
+#include "jpeg_encoder.h"
+
+using namespace std;
+
+// Frame rate each camera delivers; a conversion must fit in its period
+const double k_colorFrameRate = 60.0;
+
+// Color checker charts captured through a color cast and turned back into
+// white-balanced color by every demosaic method, into both outputs, with
+// the scalar and SSE2 kernels on the calling thread and SSE2 on a
+// TaskScheduler over 64-row bands. Each case reports its PSNR against the
+// chart; bilinear BGR8 cases also the largest difference from a floating
+// point reference. Frames per second are compared with what
+// k_colorFrameRate cameras need; YUV420 cases also report the size of the
+// color JPEG the encoder makes of them. That every kernel matches the
+// scalar one byte for byte is checked by the tests target.
+static void BenchColorPipeline(const BenchOptions& options)
+{
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    unique_ptr<TaskScheduler> scheduler;
+    const char* kinds[] = {"scalar", "simd", "simd_threaded"};
+    const char* outputNames[] = {"bgr8", "yuv420"};
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const size_t count = (size_t)resolution.width * resolution.height;
+        vector<uint8_t> chart;
+        vector<uint8_t> bayer;
+        vector<uint8_t> reference;
+        for (int method = 0; method < NUM_DEMOSAIC_METHODS; method++)
+        {
+            for (int output = 0; output < NUM_COLOR_OUTPUTS; output++)
+            {
+                ColorConfig config;
+                config.demosaic = (demosaicMethod)method;
+                config.output = (colorOutput)output;
+                for (int c = 0; c < 3; c++)
+                {
+                    config.whiteBalance[c] = k_chartWhiteBalance[c];
+                }
+                ColorPipeline pipeline;
+                pipeline.Configure(config);
+                for (int k = 0; k < 3; k++)
+                {
+                    char name[64];
+                    snprintf(name, sizeof(name), "%s_%s_%s/%s", GetDemosaicMethodName((demosaicMethod)method),
+                             outputNames[output], kinds[k], resolution.name);
+                    if (!BenchSelected(options, "color", name))
+                    {
+                        continue;
+                    }
+                    if (chart.empty())
+                    {
+                        chart = MakeColorChart(resolution.width, resolution.height);
+                        bayer = MakeBayerChart(chart, resolution.width, resolution.height);
+                    }
+                    if (k == 2 && !scheduler)
+                    {
+                        scheduler.reset(new TaskScheduler());
+                    }
+                    pipeline.SetKernel(k == 0 ? COLOR_KERNEL_SCALAR : COLOR_KERNEL_SSE2);
+
+                    ColorFrame frame;
+                    BenchResult result;
+                    result.bench = "color";
+                    result.name = name;
+                    result.bytesPerOp = (double)count;
+                    MeasureLoop(options, result, [&]() {
+                        pipeline.Process(&bayer[0], resolution.width, resolution.width, resolution.height, frame,
+                                         k == 2 ? scheduler.get() : nullptr);
+                        KeepAlive(frame.data[count / 2]);
+                    });
+                    const double framesPerSecond = 1e9 / result.nsMedian;
+                    result.Add("mpixels_per_s", count / (result.nsMedian / 1e3));
+                    result.Add("cameras_at_rate", framesPerSecond / k_colorFrameRate);
+                    result.Add("psnr_db", GetPsnr(chart, frame));
+                    if (method == DEMOSAIC_BILINEAR && output == COLOR_OUTPUT_BGR8)
+                    {
+                        if (reference.empty())
+                        {
+                            reference = DemosaicReference(bayer, resolution.width, resolution.height);
+                        }
+                        result.Add("max_error_vs_reference",
+                                   (double)GetMaxDifference(&frame.data[0], &reference[0], resolution.width,
+                                                            resolution.height));
+                    }
+                    if (output == COLOR_OUTPUT_YUV420 && k == 1)
+                    {
+                        JpegBuffer jpeg;
+                        JpegEncoder encoder;
+                        const int encodedOk = encoder.Encode(&frame.data[0], frame.width, frame.height, frame.stride,
+                                                             JPEG_INPUT_YUV420, JpegOptions(), jpeg);
+                        result.Add("jpeg_bytes", encodedOk == 0 ? (double)jpeg.Size() : -1.0);
+                    }
+                    result.Add("kernel", GetColorKernelName(pipeline.GetKernel()));
+                    if (k == 2)
+                    {
+                        result.Add("cores", (double)cores);
+                    }
+                    result.Print();
+                }
+            }
+        }
+    }
+}
+
+BENCH_REGISTER("color", BenchColorPipeline);
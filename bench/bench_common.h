@@ -0,0 +1,189 @@
+/*
+ * @Descripttion: Registry, timing loop and JSON reporting shared by the bench target
+ * @version:
+ * @Date: 2026-10-19 11:30:17
+ * @LastEditTime: 2026-10-19 11:30:17
+ */
+
+#ifndef DUAL_CAM_RECORDER_BENCH_COMMON_H
+#define DUAL_CAM_RECORDER_BENCH_COMMON_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include "time_utils.h"
+
+#ifndef BENCH_GIT_REVISION
+#define BENCH_GIT_REVISION "unknown"
+#endif
+
+// Sensor resolutions of the cameras we run; every per-frame case is measured at each
+struct SensorResolution
+{
+    const char* name;
+    unsigned int width;
+    unsigned int height;
+};
+
+const SensorResolution k_sensorResolutions[] = {
+    {"1.6MP", 1440, 1080},
+    {"3.2MP", 2048, 1536},
+    {"5.0MP", 2448, 2048},
+};
+const size_t k_numSensorResolutions = sizeof(k_sensorResolutions) / sizeof(k_sensorResolutions[0]);
+
+// Options shared by every case, set from the command line
+struct BenchOptions
+{
+    std::string filter;    // run only cases whose "bench/case" name contains this
+    double minSeconds;     // minimum measured time per case
+    unsigned int minIters; // minimum measured iterations per case
+    std::string outputDir; // scratch directory for file output cases
+
+    BenchOptions() : minSeconds(0.5), minIters(5), outputDir("/tmp")
+    {
+    }
+};
+
+// One measured case, printed as a single JSON line so that runs of different
+// commits can be diffed or loaded directly
+struct BenchResult
+{
+    std::string bench;
+    std::string name;
+    uint64_t iterations;
+    double nsMedian;
+    double nsMin;
+    double bytesPerOp; // input bytes processed per iteration, 0 if not meaningful
+    std::vector<std::pair<std::string, std::string> > extra;
+
+    BenchResult() : iterations(0), nsMedian(0.0), nsMin(0.0), bytesPerOp(0.0)
+    {
+    }
+
+    void Add(const std::string& key, double value)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.6g", value);
+        extra.push_back(std::make_pair(key, std::string(buffer)));
+    }
+
+    void Add(const std::string& key, const std::string& value)
+    {
+        extra.push_back(std::make_pair(key, "\"" + value + "\""));
+    }
+
+    void Print() const
+    {
+        printf("{\"revision\":\"%s\",\"bench\":\"%s\",\"case\":\"%s\",\"iterations\":%llu,"
+               "\"ns_median\":%.0f,\"ns_min\":%.0f",
+               BENCH_GIT_REVISION, bench.c_str(), name.c_str(), (unsigned long long)iterations, nsMedian, nsMin);
+        if (bytesPerOp > 0.0 && nsMedian > 0.0)
+        {
+            printf(",\"mb_per_s\":%.1f", bytesPerOp / nsMedian * 1e3);
+        }
+        for (size_t i = 0; i < extra.size(); i++)
+        {
+            printf(",\"%s\":%s", extra[i].first.c_str(), extra[i].second.c_str());
+        }
+        printf("}\n");
+        fflush(stdout);
+    }
+};
+
+// Runs fn once to warm up, then repeatedly until both the minimum time and
+// the minimum iteration count are reached. Fills in timing fields of result.
+template <class Function>
+void MeasureLoop(const BenchOptions& options, BenchResult& result, Function fn)
+{
+    fn();
+    std::vector<uint64_t> samples;
+    const uint64_t start = GetMonotonicNs();
+    const uint64_t minNs = (uint64_t)(options.minSeconds * 1e9);
+    while (samples.size() < options.minIters || GetMonotonicNs() - start < minNs)
+    {
+        const uint64_t t0 = GetMonotonicNs();
+        fn();
+        samples.push_back(GetMonotonicNs() - t0);
+    }
+    std::sort(samples.begin(), samples.end());
+    result.iterations = samples.size();
+    result.nsMedian = (double)samples[samples.size() / 2];
+    result.nsMin = (double)samples[0];
+}
+
+// Keeps a computed value observable so a measured loop is not optimized away
+template <class T>
+inline void KeepAlive(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Deterministic 8-bit test frame: smooth gradients with texture and noise, so
+// that conversion and JPEG encode see realistic content rather than a flat field
+inline std::vector<uint8_t> MakeSyntheticFrame8(unsigned int width, unsigned int height, uint32_t seed = 1)
+{
+    std::vector<uint8_t> frame((size_t)width * height);
+    uint32_t state = seed * 2654435761u + 1;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            state = state * 1664525u + 1013904223u;
+            const int gradient = (int)((x * 160) / width + (y * 64) / height);
+            const int texture = ((x / 16 + y / 16) & 1) ? 24 : 0;
+            const int noise = (int)(state >> 29) - 4;
+            frame[(size_t)y * width + x] = (uint8_t)std::max(0, std::min(255, gradient + texture + noise));
+        }
+    }
+    return frame;
+}
+
+// 12-bit variant stored in 16-bit words, the same scene as MakeSyntheticFrame8
+inline std::vector<uint16_t> MakeSyntheticFrame16(unsigned int width, unsigned int height, uint32_t seed = 1)
+{
+    std::vector<uint8_t> frame8 = MakeSyntheticFrame8(width, height, seed);
+    std::vector<uint16_t> frame((size_t)width * height);
+    for (size_t i = 0; i < frame.size(); i++)
+    {
+        frame[i] = (uint16_t)((frame8[i] << 4) | (i & 0x0F));
+    }
+    return frame;
+}
+
+typedef void (*BenchFunction)(const BenchOptions& options);
+
+struct BenchEntry
+{
+    const char* name;
+    BenchFunction function;
+};
+
+inline std::vector<BenchEntry>& GetBenchRegistry()
+{
+    static std::vector<BenchEntry> registry;
+    return registry;
+}
+
+// Returns true if the case "bench/name" is selected by the --filter option
+inline bool BenchSelected(const BenchOptions& options, const std::string& bench, const std::string& name)
+{
+    return options.filter.empty() || (bench + "/" + name).find(options.filter) != std::string::npos;
+}
+
+struct BenchRegistrar
+{
+    BenchRegistrar(const char* name, BenchFunction function)
+    {
+        BenchEntry entry = {name, function};
+        GetBenchRegistry().push_back(entry);
+    }
+};
+
+// Registers a benchmark group; each source file in bench/ registers its own
+#define BENCH_REGISTER(name, function) static BenchRegistrar s_benchRegistrar_##function(name, function)
+
+#endif // DUAL_CAM_RECORDER_BENCH_COMMON_H
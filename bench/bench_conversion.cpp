@@ -0,0 +1,72 @@
+/*
+ * @Descripttion: Pixel format conversion benchmarks
+ * @version:
+ * @Date: 2026-10-19 11:41:26
+ * @LastEditTime: 2026-10-19 11:41:26
+ */
+
+#include <string>
+#include <vector>
+#include "Spinnaker.h"
+#include "bench_common.h"
+
+using namespace Spinnaker;
+using namespace std;
+
+// Conversions the recorders run per frame: Image::Convert (recorder.cpp,
+// recorder_trigger.cpp) and ImageProcessor::Convert (trigger.cpp), from the
+// formats our cameras can deliver to Mono8
+static void BenchConversion(const BenchOptions& options)
+{
+    struct SourceFormat
+    {
+        const char* name;
+        PixelFormatEnums format;
+        unsigned int bytesPerPixel;
+    };
+    const SourceFormat sources[] = {
+        {"BayerRG8", PixelFormat_BayerRG8, 1},
+        {"Mono16", PixelFormat_Mono16, 2},
+        {"Mono8", PixelFormat_Mono8, 1},
+    };
+
+    ImageProcessor processor;
+    processor.SetColorProcessing(HQ_LINEAR);
+
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        vector<uint8_t> frame8 = MakeSyntheticFrame8(resolution.width, resolution.height);
+        vector<uint16_t> frame16 = MakeSyntheticFrame16(resolution.width, resolution.height);
+
+        for (size_t s = 0; s < sizeof(sources) / sizeof(sources[0]); s++)
+        {
+            void* data = sources[s].bytesPerPixel == 2 ? (void*)&frame16[0] : (void*)&frame8[0];
+            ImagePtr source =
+                Image::Create(resolution.width, resolution.height, 0, 0, sources[s].format, data);
+            const double bytes = (double)resolution.width * resolution.height * sources[s].bytesPerPixel;
+
+            const string suffix = string(sources[s].name) + "_to_Mono8/" + resolution.name;
+            if (BenchSelected(options, "conversion", "image_convert_" + suffix))
+            {
+                BenchResult result;
+                result.bench = "conversion";
+                result.name = "image_convert_" + suffix;
+                result.bytesPerOp = bytes;
+                MeasureLoop(options, result, [&]() { KeepAlive(source->Convert(PixelFormat_Mono8, HQ_LINEAR)); });
+                result.Print();
+            }
+            if (BenchSelected(options, "conversion", "image_processor_" + suffix))
+            {
+                BenchResult result;
+                result.bench = "conversion";
+                result.name = "image_processor_" + suffix;
+                result.bytesPerOp = bytes;
+                MeasureLoop(options, result, [&]() { KeepAlive(processor.Convert(source, PixelFormat_Mono8)); });
+                result.Print();
+            }
+        }
+    }
+}
+
+BENCH_REGISTER("conversion", BenchConversion);
@@ -0,0 +1,137 @@
+/*
+ * @Descripttion: Capture daemon benchmarks: command round trips and command-to-frame latency on synthetic cameras
+ * @version:
+ * @Date: 2026-10-19 23:52:09
+ * @LastEditTime: 2026-10-19 23:52:09
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bench_common.h"
+#include "capture_daemon.h"
+#include "capture_protocol.h"
+
+using namespace std;
+
+// Synthetic cameras of the daemon cases; a high frame rate keeps the wait for
+// the next frame from hiding the command path
+const unsigned int k_daemonCameras = 2;
+const double k_daemonFrameRate = 200.0;
+
+// Removes a session directory written by the daemon
+static void RemoveSession(const string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        const string name = entry->d_name;
+        if (name != "." && name != "..")
+        {
+            remove((directory + "/" + name).c_str());
+        }
+    }
+    closedir(dir);
+    rmdir(directory.c_str());
+}
+
+// Commands against a daemon serving synthetic 1.6 MP cameras over its Unix
+// socket: a STATUS round trip, a SNAPSHOT (command to the next frame back at
+// the client, so about half a frame period is waiting) and START of a
+// one-frame recording through to that frame on disk and STOP. The protocol
+// itself is checked by the tests target.
+static void BenchCaptureDaemon(const BenchOptions& options)
+{
+    const char* names[] = {"status_round_trip", "snapshot", "start_to_recorded_frame"};
+    bool any = false;
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++)
+    {
+        any = any || BenchSelected(options, "daemon", names[n]);
+    }
+    if (!any)
+    {
+        return;
+    }
+    vector<unique_ptr<CaptureCamera> > cameras;
+    for (unsigned int i = 0; i < k_daemonCameras; i++)
+    {
+        cameras.push_back(unique_ptr<CaptureCamera>(
+            new SyntheticCamera("synthetic" + to_string(i), 1440, 1080, k_daemonFrameRate, 0)));
+    }
+    CaptureDaemonConfig config;
+    config.socketPath = options.outputDir + "/bench_daemon.sock";
+    config.storage.directory = options.outputDir;
+    config.storage.segmentMaxBytes = 64ULL << 20;
+    CaptureDaemon daemon(config, cameras);
+    if (daemon.Start() < 0)
+    {
+        fprintf(stderr, "Unable to start the daemon on %s\n", config.socketPath.c_str());
+        return;
+    }
+    CaptureClient client;
+    if (client.Connect(config.socketPath) < 0)
+    {
+        return;
+    }
+
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++)
+    {
+        if (!BenchSelected(options, "daemon", names[n]))
+        {
+            continue;
+        }
+        BenchResult result;
+        result.bench = "daemon";
+        result.name = names[n];
+        vector<CaptureCameraStatus> statuses;
+        CaptureSnapshot snapshot;
+        vector<double> latenciesMs;
+        bool ok = true;
+        MeasureLoop(options, result, [&]() {
+            if (n == 0)
+            {
+                ok = client.Status(statuses) == CAPTURE_OK && ok;
+            }
+            else if (n == 1)
+            {
+                ok = client.Snapshot(0, 1000, snapshot) == CAPTURE_OK && ok;
+                latenciesMs.push_back(snapshot.latencyNs / 1e6);
+            }
+            else
+            {
+                ok = client.Start(1, 1, statuses) == CAPTURE_OK && ok;
+                while (client.Status(statuses) == CAPTURE_OK && statuses[0].recording)
+                {
+                    usleep(200);
+                }
+                ok = client.Stop(k_captureAllCameras, statuses) == CAPTURE_OK && statuses[0].framesRecorded == 1 && ok;
+                latenciesMs.push_back(statuses[0].firstFrameLatencyNs / 1e6);
+                RemoveSession(daemon.GetSessionDirectory());
+            }
+        });
+        if (!latenciesMs.empty())
+        {
+            std::sort(latenciesMs.begin(), latenciesMs.end());
+            result.Add("frame_latency_ms_median", latenciesMs[latenciesMs.size() / 2]);
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "daemon/%s: a command failed, the timings are not meaningful\n", names[n]);
+        }
+        result.Add("frame_period_ms", 1e3 / k_daemonFrameRate);
+        result.Print();
+    }
+    client.Close();
+    daemon.Stop();
+}
+
+BENCH_REGISTER("daemon", BenchCaptureDaemon);
@@ -0,0 +1,64 @@
+/*
+ * @Descripttion: Per-frame filename formatting benchmarks
+ * @version:
+ * @Date: 2026-10-19 12:13:55
+ * @LastEditTime: 2026-10-19 12:13:55
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <sstream>
+#include <string>
+#include "bench_common.h"
+
+using namespace std;
+
+// Filenames formatted per iteration; per-call cost is ns_median / k_namesPerIteration
+const unsigned int k_namesPerIteration = 1000;
+
+// "<time>-<serial>-<n>.jpg" built the way recorder.cpp does (ostringstream)
+// and with snprintf into a stack buffer
+static void BenchFilename(const BenchOptions& options)
+{
+    const time_t wallTime = 1668058165;
+    const string serialNumber = "22080512";
+
+    if (BenchSelected(options, "filename", "ostringstream"))
+    {
+        BenchResult result;
+        result.bench = "filename";
+        result.name = "ostringstream";
+        MeasureLoop(options, result, [&]() {
+            for (unsigned int i = 0; i < k_namesPerIteration; i++)
+            {
+                ostringstream filename;
+                filename << wallTime;
+                filename << "-";
+                filename << serialNumber.c_str();
+                filename << "-" << i << ".jpg";
+                KeepAlive(filename.str());
+            }
+        });
+        result.Add("ns_per_name", result.nsMedian / k_namesPerIteration);
+        result.Print();
+    }
+
+    if (BenchSelected(options, "filename", "snprintf"))
+    {
+        BenchResult result;
+        result.bench = "filename";
+        result.name = "snprintf";
+        MeasureLoop(options, result, [&]() {
+            for (unsigned int i = 0; i < k_namesPerIteration; i++)
+            {
+                char filename[128];
+                snprintf(filename, sizeof(filename), "%lld-%s-%u.jpg", (long long)wallTime, serialNumber.c_str(), i);
+                KeepAlive(filename);
+            }
+        });
+        result.Add("ns_per_name", result.nsMedian / k_namesPerIteration);
+        result.Print();
+    }
+}
+
+BENCH_REGISTER("filename", BenchFilename);
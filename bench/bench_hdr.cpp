@@ -0,0 +1,107 @@
+/*
+ * @Descripttion: HDR fusion benchmarks: synthetic exposure brackets merged by the scalar and SIMD kernels
+ * @version:
+ * @Date: 2026-10-20 01:07:44
+ * @LastEditTime: 2026-10-20 01:07:44
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "hdr_scene.h"
+
+using namespace std;
+
+// Bracketed frame rate the recorder runs the sequencer at; fused brackets per
+// second must reach this divided by the bracket size
+const double k_bracketFrameRate = 60.0;
+
+// Brackets of 2 to 4 synthetic exposures merged into one radiance frame plus
+// its tone-mapped Mono8 rendition, with each kernel on the calling thread and
+// the best one on a TaskScheduler over 64-row bands. Each case reports the
+// median error against the synthetic scene and brackets per second next to
+// the rate the recorder needs (k_bracketFrameRate / exposures). That every
+// kernel matches the scalar one bit for bit is checked by the tests target.
+static void BenchHdrFusion(const BenchOptions& options)
+{
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    unique_ptr<TaskScheduler> scheduler;
+    const char* kinds[] = {"scalar", "simd", "simd_threaded"};
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const size_t count = (size_t)resolution.width * resolution.height;
+        vector<float> radiance;
+        for (unsigned int exposures = 2; exposures <= k_hdrMaxExposures; exposures++)
+        {
+            vector<vector<uint8_t> > frames;
+            vector<const uint8_t*> pixels;
+            const vector<size_t> strides(exposures, resolution.width);
+            HdrFusion fusion;
+            for (int k = 0; k < 3; k++)
+            {
+                char name[64];
+                snprintf(name, sizeof(name), "fuse_%u_%s/%s", exposures, kinds[k], resolution.name);
+                if (!BenchSelected(options, "hdr", name))
+                {
+                    continue;
+                }
+                if (frames.empty())
+                {
+                    if (radiance.empty())
+                    {
+                        radiance = MakeSyntheticRadiance(resolution.width, resolution.height);
+                    }
+                    for (unsigned int i = 0; i < exposures; i++)
+                    {
+                        frames.push_back(MakeExposure(radiance, k_bracketExposuresUs[i] / k_bracketExposuresUs[0], i));
+                    }
+                    fusion.Configure(k_bracketExposuresUs, exposures);
+                    for (unsigned int i = 0; i < exposures; i++)
+                    {
+                        pixels.push_back(&frames[i][0]);
+                    }
+                }
+                if (k == 2 && !scheduler)
+                {
+                    scheduler.reset(new TaskScheduler());
+                }
+                fusion.SetKernel(k == 0 ? HDR_KERNEL_SCALAR : HDR_KERNEL_AVX2);
+                if (k != 0 && fusion.GetKernel() == HDR_KERNEL_SCALAR)
+                {
+                    fusion.SetKernel(HDR_KERNEL_SSE2);
+                }
+
+                HdrFrame fused;
+                BenchResult result;
+                result.bench = "hdr";
+                result.name = name;
+                result.bytesPerOp = (double)count * exposures;
+                MeasureLoop(options, result, [&]() {
+                    fusion.Fuse(&pixels[0], &strides[0], resolution.width, resolution.height, fused,
+                                k == 2 ? scheduler.get() : nullptr);
+                    KeepAlive(fused.radiance[count / 2]);
+                });
+                const double bracketsPerSecond = 1e9 / result.nsMedian;
+                result.Add("mpixels_per_s", count / (result.nsMedian / 1e3));
+                result.Add("brackets_per_s", bracketsPerSecond);
+                result.Add("required_brackets_per_s", k_bracketFrameRate / exposures);
+                result.Add("keeps_up", bracketsPerSecond >= k_bracketFrameRate / exposures ? 1.0 : 0.0);
+                const double maxGain = k_bracketExposuresUs[0] / k_bracketExposuresUs[exposures - 1];
+                result.Add("median_error", GetMedianError(radiance, fused, maxGain));
+                result.Add("kernel", GetHdrKernelName(fusion.GetKernel()));
+                if (k == 2)
+                {
+                    result.Add("cores", (double)cores);
+                }
+                result.Print();
+            }
+        }
+    }
+}
+
+BENCH_REGISTER("hdr", BenchHdrFusion);
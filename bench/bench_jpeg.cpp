@@ -0,0 +1,177 @@
+/*
+ * @Descripttion: JPEG encode benchmarks
+ * @version:
+ * @Date: 2026-10-19 11:52:03
+ * @LastEditTime: 2026-10-19 16:48:12
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "Spinnaker.h"
+#include "bench_common.h"
+#include "jpeg_encoder.h"
+
+using namespace Spinnaker;
+using namespace std;
+
+// Decodes a grayscale JPEG and returns its PSNR against the source frame, in
+// dB, or 0 if it cannot be decoded. Used to check that two encoders are
+// compared at the same visual quality.
+static double GrayJpegPsnr(const vector<uint8_t>& encoded, const vector<uint8_t>& source)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr error;
+    cinfo.err = jpeg_std_error(&error);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(&encoded[0]), (unsigned long)encoded.size());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+    vector<uint8_t> decoded((size_t)cinfo.output_width * cinfo.output_height);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row = &decoded[(size_t)cinfo.output_scanline * cinfo.output_width];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    if (decoded.size() != source.size())
+    {
+        return 0.0;
+    }
+    double squaredError = 0.0;
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        const double diff = (double)decoded[i] - (double)source[i];
+        squaredError += diff * diff;
+    }
+    if (squaredError == 0.0)
+    {
+        return 99.0;
+    }
+    return 10.0 * log10(255.0 * 255.0 * source.size() / squaredError);
+}
+
+static vector<uint8_t> ReadFile(const string& path)
+{
+    vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return data;
+    }
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return data;
+}
+
+// Image::Save to .jpg, the encode path of every recorder, against the direct
+// libjpeg encoder (JpegEncoder) at the same quality settings. Image::Save
+// includes writing the file, so the libjpeg case writes its buffer to a file
+// as well; a separate case measures the encode alone. Encoded size and PSNR
+// are reported for every case so the speedup is read at equal quality.
+static void BenchJpegEncode(const BenchOptions& options)
+{
+    const unsigned int qualities[] = {50, 75, 90, 95};
+    const string path = options.outputDir + "/bench_jpeg.jpg";
+
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        vector<uint8_t> frame = MakeSyntheticFrame8(resolution.width, resolution.height);
+        ImagePtr image = Image::Create(resolution.width, resolution.height, 0, 0, PixelFormat_Mono8, &frame[0]);
+
+        for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++)
+        {
+            char name[64];
+            double saveNs = 0.0;
+            snprintf(name, sizeof(name), "image_save_q%u/%s", qualities[q], resolution.name);
+            if (BenchSelected(options, "jpeg", name))
+            {
+                JPEGOption option;
+                option.quality = qualities[q];
+                BenchResult result;
+                result.bench = "jpeg";
+                result.name = name;
+                result.bytesPerOp = (double)frame.size();
+                MeasureLoop(options, result, [&]() { image->Save(path.c_str(), option); });
+                vector<uint8_t> encoded = ReadFile(path);
+                if (!encoded.empty())
+                {
+                    result.Add("encoded_bytes", (double)encoded.size());
+                    result.Add("psnr_db", GrayJpegPsnr(encoded, frame));
+                }
+                result.Print();
+                saveNs = result.nsMedian;
+            }
+
+            const jpegDct methods[] = {JPEG_DCT_ACCURATE, JPEG_DCT_FAST};
+            const char* methodNames[] = {"accurate", "fast"};
+            for (size_t m = 0; m < 2; m++)
+            {
+                JpegOptions jpegOptions;
+                jpegOptions.quality = (int)qualities[q];
+                jpegOptions.dct = methods[m];
+                JpegEncoder& encoder = JpegEncoder::ForCurrentThread();
+                JpegBuffer buffer;
+
+                // Encode and write a file, comparable with Image::Save
+                snprintf(name, sizeof(name), "libjpeg_%s_q%u/%s", methodNames[m], qualities[q], resolution.name);
+                if (BenchSelected(options, "jpeg", name))
+                {
+                    BenchResult result;
+                    result.bench = "jpeg";
+                    result.name = name;
+                    result.bytesPerOp = (double)frame.size();
+                    MeasureLoop(options, result, [&]() {
+                        encoder.Encode(&frame[0], resolution.width, resolution.height, resolution.width,
+                                       JPEG_INPUT_GRAY, jpegOptions, buffer);
+                        FILE* file = fopen(path.c_str(), "wb");
+                        if (file != nullptr)
+                        {
+                            fwrite(buffer.Data(), 1, buffer.Size(), file);
+                            fclose(file);
+                        }
+                    });
+                    vector<uint8_t> encoded(buffer.Data(), buffer.Data() + buffer.Size());
+                    result.Add("encoded_bytes", (double)encoded.size());
+                    result.Add("psnr_db", GrayJpegPsnr(encoded, frame));
+                    if (saveNs > 0.0)
+                    {
+                        result.Add("speedup_vs_image_save", saveNs / result.nsMedian);
+                    }
+                    result.Print();
+                }
+
+                // Encode only, into the reused buffer
+                snprintf(name, sizeof(name), "libjpeg_%s_encode_only_q%u/%s", methodNames[m], qualities[q],
+                         resolution.name);
+                if (BenchSelected(options, "jpeg", name))
+                {
+                    BenchResult result;
+                    result.bench = "jpeg";
+                    result.name = name;
+                    result.bytesPerOp = (double)frame.size();
+                    MeasureLoop(options, result, [&]() {
+                        encoder.Encode(&frame[0], resolution.width, resolution.height, resolution.width,
+                                       JPEG_INPUT_GRAY, jpegOptions, buffer);
+                        KeepAlive(buffer.Size());
+                    });
+                    result.Add("encoded_bytes", (double)buffer.Size());
+                    result.Print();
+                }
+            }
+        }
+    }
+    remove(path.c_str());
+}
+
+BENCH_REGISTER("jpeg", BenchJpegEncode);
@@ -0,0 +1,205 @@
+/*
+ * @Descripttion: Frame lease benchmarks: Mono8 frames written in place against copied, and the use-after-release guard
+ * @version:
+ * @Date: 2026-10-20 01:58:03
+ * @LastEditTime: 2026-10-20 01:58:03
+ */
+
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "frame_lease.h"
+
+using namespace std;
+
+// Acquisition buffers of the simulated driver, like the stream buffers
+// Spinnaker allocates per camera, and the recorder's lease limit
+const unsigned int k_leaseDriverBuffers = 10;
+const unsigned int k_leaseMaxLeases = 4;
+// Writes queued ahead of the writer; with the one being written this stays
+// within the lease limit, as it does while the recorder keeps up
+const size_t k_leaseWriterBacklog = 3;
+
+// Driver side of the simulation: a ring of filled acquisition buffers. A
+// buffer is handed out again only once it was returned; handing out one that
+// is still held would be the use-after-release the leases prevent.
+struct SimulatedDriver
+{
+    vector<vector<uint8_t> > buffers;
+    vector<bool> held;
+    unsigned int next;
+    uint64_t starved;  // no free buffer when a frame arrived
+    uint64_t reissued; // a buffer handed out while still held
+
+    SimulatedDriver(unsigned int width, unsigned int height) : held(k_leaseDriverBuffers, false), next(0), starved(0),
+                                                               reissued(0)
+    {
+        for (unsigned int i = 0; i < k_leaseDriverBuffers; i++)
+        {
+            buffers.push_back(MakeSyntheticFrame8(width, height, i + 1));
+        }
+    }
+
+    // Index of the buffer the next frame lands in, or -1 if all are held
+    int Grab()
+    {
+        for (unsigned int tries = 0; tries < k_leaseDriverBuffers; tries++)
+        {
+            const unsigned int index = next;
+            next = (next + 1) % k_leaseDriverBuffers;
+            if (!held[index])
+            {
+                held[index] = true;
+                return (int)index;
+            }
+        }
+        starved++;
+        return -1;
+    }
+
+    void Return(unsigned int index)
+    {
+        if (!held[index])
+        {
+            reissued++;
+        }
+        held[index] = false;
+    }
+};
+
+// What the writer does with a frame's pixels: read all of them once
+static uint64_t ConsumePixels(const uint8_t* pixels, size_t size)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, pixels + i, 8);
+        sum ^= word;
+    }
+    return sum;
+}
+
+// A Mono8 POLLING frame from grab to writer; EVENT frames are copied by the
+// image event handler either way. "copy" is what Convert(PixelFormat_Mono8)
+// did for frames already in Mono8: a new image per frame and a full copy,
+// after which the buffer goes back at once. "lease" writes from the buffer in
+// place and returns it when the write is done. The writer runs on its own
+// thread behind a backlog of k_leaseWriterBacklog frames, so leases are held
+// while frames queue; the driver must never starve or get a held buffer
+// back. The lease guarantees themselves are checked by the tests target.
+static void BenchFrameLease(const BenchOptions& options)
+{
+    const char* modes[] = {"copy", "lease"};
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const size_t size = (size_t)resolution.width * resolution.height;
+        for (int m = 0; m < 2; m++)
+        {
+            const string name = string("mono8_") + modes[m] + "/" + resolution.name;
+            if (!BenchSelected(options, "lease", name))
+            {
+                continue;
+            }
+            SimulatedDriver driver(resolution.width, resolution.height);
+            FrameLeaseTracker tracker(k_leaseMaxLeases, "synthetic");
+            std::mutex mutex;
+            std::condition_variable changed;
+            // A queued write: the leased buffer, or a copy owning its pixels
+            struct Write
+            {
+                FrameLeasePtr lease;
+                const uint8_t* pixels;
+                std::shared_ptr<vector<uint8_t> > copy;
+            };
+            deque<Write> queue;
+            bool stop = false;
+            uint64_t frames = 0;
+            uint64_t allocations = 0;
+            uint64_t bytesCopied = 0;
+            std::thread writer([&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    changed.wait(lock, [&]() { return stop || !queue.empty(); });
+                    if (queue.empty())
+                    {
+                        return;
+                    }
+                    Write write = queue.front();
+                    queue.pop_front();
+                    lock.unlock();
+                    if (!write.lease || write.lease->Check("Bench writer"))
+                    {
+                        KeepAlive(ConsumePixels(write.pixels, size));
+                    }
+                    write.copy.reset();
+                    // The driver's state is guarded by the lock
+                    lock.lock();
+                    write.lease.reset();
+                    changed.notify_all();
+                }
+            });
+
+            BenchResult result;
+            result.bench = "lease";
+            result.name = name;
+            result.bytesPerOp = (double)size;
+            MeasureLoop(options, result, [&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return queue.size() < k_leaseWriterBacklog; });
+                const int index = driver.Grab();
+                if (index < 0)
+                {
+                    return;
+                }
+                frames++;
+                Write write;
+                write.pixels = &driver.buffers[index][0];
+                if (m == 1)
+                {
+                    SimulatedDriver* pDriver = &driver;
+                    write.lease = tracker.Acquire([pDriver, index]() { pDriver->Return((unsigned int)index); });
+                }
+                if (!write.lease)
+                {
+                    lock.unlock();
+                    write.copy.reset(new vector<uint8_t>(write.pixels, write.pixels + size));
+                    lock.lock();
+                    write.pixels = &(*write.copy)[0];
+                    allocations++;
+                    bytesCopied += size;
+                    driver.Return((unsigned int)index);
+                }
+                queue.push_back(write);
+                changed.notify_all();
+            });
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+                changed.notify_all();
+            }
+            writer.join();
+
+            result.Add("mpixels_per_s", size / (result.nsMedian / 1e3));
+            result.Add("allocations_per_frame", frames > 0 ? (double)allocations / frames : 0.0);
+            result.Add("bytes_copied_per_frame", frames > 0 ? (double)bytesCopied / frames : 0.0);
+            result.Add("max_leased_buffers", (double)tracker.GetMaxOutstanding());
+            result.Add("driver_starved", (double)driver.starved);
+            result.Add("buffer_reissued_while_held", (double)driver.reissued);
+            if (m == 1)
+            {
+                result.Add("copied_at_limit", (double)tracker.GetRefusedCount());
+            }
+            result.Print();
+        }
+    }
+}
+
+BENCH_REGISTER("lease", BenchFrameLease);
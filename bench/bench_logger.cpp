@@ -0,0 +1,120 @@
+/*
+ * @Descripttion: Per-call cost of hot-path logging on the calling thread
+ * @version:
+ * @Date: 2026-10-19 13:40:21
+ * @LastEditTime: 2026-10-19 13:40:21
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "async_logger.h"
+#include "bench_common.h"
+
+using namespace std;
+
+// Messages per timed batch; the async ring is drained between batches so the
+// measurement never hits the full-buffer drop path
+const unsigned int k_messagesPerBatch = 256;
+const unsigned int k_numBatches = 200;
+
+// Times k_numBatches batches of fn, calling between() untimed after each.
+// Reports the median per-message cost in ns_median/ns_min.
+template <class Function, class Between>
+static void MeasurePerMessage(BenchResult& result, Function fn, Between between)
+{
+    vector<uint64_t> samples;
+    for (unsigned int batch = 0; batch < k_numBatches; batch++)
+    {
+        const uint64_t t0 = GetMonotonicNs();
+        for (unsigned int i = 0; i < k_messagesPerBatch; i++)
+        {
+            fn(batch * k_messagesPerBatch + i);
+        }
+        samples.push_back((GetMonotonicNs() - t0) / k_messagesPerBatch);
+        between();
+    }
+    sort(samples.begin(), samples.end());
+    result.iterations = (uint64_t)k_numBatches * k_messagesPerBatch;
+    result.nsMedian = (double)samples[samples.size() / 2];
+    result.nsMin = (double)samples[0];
+}
+
+// The "Grabbed image ..." line of the recorder, written with cout-style
+// streaming plus endl (the old path) and through the async logger. Both go to
+// /dev/null so only the cost seen by the grab thread is measured.
+static void BenchLogger(const BenchOptions& options)
+{
+    const string serialNumber = "22080512";
+    const string filename = "1668058165-22080512-17.jpg";
+
+    if (BenchSelected(options, "logger", "ostream_endl"))
+    {
+        ofstream devNull("/dev/null");
+        BenchResult result;
+        result.bench = "logger";
+        result.name = "ostream_endl";
+        MeasurePerMessage(result,
+                          [&](unsigned int i) {
+                              devNull << "[" << serialNumber << "] "
+                                      << "Grabbed image " << i << ", width = " << 2048 << ", height = " << 1536
+                                      << ". Image saved at " << filename << endl;
+                          },
+                          []() {});
+        result.Print();
+    }
+
+    FILE* devNull = fopen("/dev/null", "w");
+    AsyncLogger::Instance().SetOutput(devNull);
+
+    if (BenchSelected(options, "logger", "async_log"))
+    {
+        BenchResult result;
+        result.bench = "logger";
+        result.name = "async_log";
+        MeasurePerMessage(result,
+                          [&](unsigned int i) {
+                              ASYNC_LOG(SEVERITY_INFO, "[{}] Grabbed image {}, width = {}, height = {}. Image saved at {}",
+                                        serialNumber, i, 2048, 1536, filename);
+                          },
+                          []() { AsyncLogger::Instance().Flush(); });
+        result.Print();
+    }
+
+    if (BenchSelected(options, "logger", "async_log_filtered"))
+    {
+        AsyncLogger::SetMinSeverity(SEVERITY_WARNING);
+        BenchResult result;
+        result.bench = "logger";
+        result.name = "async_log_filtered";
+        MeasurePerMessage(result,
+                          [&](unsigned int i) {
+                              ASYNC_LOG(SEVERITY_DEBUG, "[{}] Grabbed image {}", serialNumber, i);
+                          },
+                          []() {});
+        AsyncLogger::SetMinSeverity(SEVERITY_INFO);
+        result.Print();
+    }
+
+    if (BenchSelected(options, "logger", "async_log_rate_limited"))
+    {
+        BenchResult result;
+        result.bench = "logger";
+        result.name = "async_log_rate_limited";
+        MeasurePerMessage(result,
+                          [&](unsigned int i) {
+                              ASYNC_LOG_RATE_LIMITED(SEVERITY_WARNING, 1000, "[{}] Image incomplete with image status {}...",
+                                                     serialNumber, i);
+                          },
+                          []() { AsyncLogger::Instance().Flush(); });
+        result.Print();
+    }
+
+    AsyncLogger::Instance().Flush();
+    AsyncLogger::Instance().SetOutput(stderr);
+    fclose(devNull);
+}
+
+BENCH_REGISTER("logger", BenchLogger);
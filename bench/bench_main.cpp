@@ -0,0 +1,71 @@
+/*
+ * @Descripttion: Entry point of the bench target
+ * @version:
+ * @Date: 2026-10-19 11:34:50
+ * @LastEditTime: 2026-10-19 11:34:50
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include "bench_common.h"
+
+using namespace std;
+
+// Usage: bench [--filter=<substring>] [--min-time=<seconds>] [--min-iters=<n>] [--output-dir=<dir>] [--list]
+//
+// Every measured case prints one JSON line on stdout; progress and errors go
+// to stderr, so "bench > results.jsonl" gives a file that can be compared
+// across commits.
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    bool listOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0)
+        {
+            options.filter = arg.substr(9);
+        }
+        else if (arg.compare(0, 11, "--min-time=") == 0)
+        {
+            options.minSeconds = atof(arg.c_str() + 11);
+        }
+        else if (arg.compare(0, 12, "--min-iters=") == 0)
+        {
+            options.minIters = (unsigned int)atoi(arg.c_str() + 12);
+        }
+        else if (arg.compare(0, 13, "--output-dir=") == 0)
+        {
+            options.outputDir = arg.substr(13);
+        }
+        else if (arg == "--list")
+        {
+            listOnly = true;
+        }
+        else
+        {
+            cerr << "Unknown argument " << arg << endl;
+            return -1;
+        }
+    }
+    if (options.minIters == 0)
+    {
+        options.minIters = 1;
+    }
+
+    const vector<BenchEntry>& registry = GetBenchRegistry();
+    for (size_t i = 0; i < registry.size(); i++)
+    {
+        if (listOnly)
+        {
+            cout << registry[i].name << endl;
+            continue;
+        }
+        cerr << "Running " << registry[i].name << "..." << endl;
+        registry[i].function(options);
+    }
+    return 0;
+}
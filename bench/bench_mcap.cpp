@@ -0,0 +1,118 @@
+/*
+ * @Descripttion: MCAP output benchmarks: chunk compression and CRCs against plain appends
+ * @version:
+ * @Date: 2026-10-19 20:31:52
+ * @LastEditTime: 2026-10-19 20:31:52
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "jpeg_encoder.h"
+#include "mcap_writer.h"
+
+using namespace std;
+
+// Frames of each of the two channels written per iteration
+const unsigned int k_mcapFramesPerChannel = 30;
+
+// One second of two cameras at 30 fps streamed through McapWriter into a new
+// file, from the first Submit() to the footer of Stop(), so chunking,
+// compression, indexing and the write are all counted. Raw Mono8 channels
+// are measured without compression, with zstd and lz4 (when built with them)
+// and without CRCs; JPEG channels without compression. The data lands in the
+// page cache like the other output cases.
+static void BenchMcapOutput(const BenchOptions& options)
+{
+    struct McapCase
+    {
+        const char* name;
+        mcapImageType type;
+        mcapCompression compression;
+        bool crc;
+    };
+    const McapCase cases[] = {
+        {"raw", MCAP_IMAGE_RAW, MCAP_COMPRESSION_NONE, true},
+        {"raw_no_crc", MCAP_IMAGE_RAW, MCAP_COMPRESSION_NONE, false},
+#if defined(RECORDER_HAVE_ZSTD)
+        {"raw_zstd", MCAP_IMAGE_RAW, MCAP_COMPRESSION_ZSTD, true},
+#endif
+#if defined(RECORDER_HAVE_LZ4)
+        {"raw_lz4", MCAP_IMAGE_RAW, MCAP_COMPRESSION_LZ4, true},
+#endif
+        {"jpeg", MCAP_IMAGE_JPEG, MCAP_COMPRESSION_NONE, true},
+    };
+    const string path = options.outputDir + "/bench_mcap.mcap";
+
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        std::shared_ptr<vector<uint8_t> > frame(
+            new vector<uint8_t>(MakeSyntheticFrame8(resolution.width, resolution.height)));
+        std::shared_ptr<JpegBuffer> encoded(new JpegBuffer());
+        JpegEncoder::ForCurrentThread().Encode(&(*frame)[0], resolution.width, resolution.height, resolution.width,
+                                               JPEG_INPUT_GRAY, JpegOptions(), *encoded);
+
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        {
+            const string name = string(cases[c].name) + "/" + resolution.name;
+            if (!BenchSelected(options, "mcap", name))
+            {
+                continue;
+            }
+            const bool raw = cases[c].type == MCAP_IMAGE_RAW;
+            const void* payload = raw ? (const void*)&(*frame)[0] : (const void*)encoded->Data();
+            const uint32_t payloadSize = raw ? (uint32_t)frame->size() : (uint32_t)encoded->Size();
+            std::shared_ptr<const void> keepAlive =
+                raw ? std::shared_ptr<const void>(frame) : std::shared_ptr<const void>(encoded);
+            McapConfig config;
+            config.compression = cases[c].compression;
+            config.crc = cases[c].crc;
+            double compressionRatio = 1.0;
+            uint64_t fileBytes = 0;
+            BenchResult result;
+            result.bench = "mcap";
+            result.name = name;
+            result.bytesPerOp = 2.0 * k_mcapFramesPerChannel * payloadSize;
+            MeasureLoop(options, result, [&]() {
+                McapWriter writer(path, config);
+                const unsigned int channels[] = {writer.AddChannel("11111111", cases[c].type),
+                                                 writer.AddChannel("22222222", cases[c].type)};
+                if (writer.Start() < 0)
+                {
+                    return;
+                }
+                const uint64_t start = GetRealtimeNs();
+                for (unsigned int i = 0; i < k_mcapFramesPerChannel; i++)
+                {
+                    for (unsigned int channel = 0; channel < 2; channel++)
+                    {
+                        McapFrame mcapFrame;
+                        mcapFrame.channel = channels[channel];
+                        mcapFrame.sequence = i;
+                        mcapFrame.logTime = start + i * 33333333ULL;
+                        mcapFrame.publishTime = mcapFrame.logTime;
+                        mcapFrame.width = resolution.width;
+                        mcapFrame.height = resolution.height;
+                        mcapFrame.payload = payload;
+                        mcapFrame.payloadSize = payloadSize;
+                        mcapFrame.keepAlive = keepAlive;
+                        writer.Submit(mcapFrame);
+                    }
+                }
+                writer.Stop();
+                struct stat fileStat;
+                fileBytes = stat(path.c_str(), &fileStat) == 0 ? (uint64_t)fileStat.st_size : 0;
+                compressionRatio = fileBytes > 0 ? result.bytesPerOp / fileBytes : 0.0;
+            });
+            result.Add("file_mb", fileBytes / 1e6);
+            result.Add("compression_ratio", compressionRatio);
+            result.Print();
+            remove(path.c_str());
+        }
+    }
+}
+
+BENCH_REGISTER("mcap", BenchMcapOutput);
@@ -0,0 +1,124 @@
+/*
+ * @Descripttion: Motion gate benchmarks
+ * @version:
+ * @Date: 2026-10-19 17:46:10
+ * @LastEditTime: 2026-10-19 17:46:10
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "motion_gate.h"
+
+using namespace std;
+
+// Draws a bright 128x128 square at (x, y) into frame
+static void DrawSquare(vector<uint8_t>& frame, unsigned int width, unsigned int x, unsigned int y)
+{
+    for (unsigned int row = y; row < y + 128; row++)
+    {
+        memset(&frame[(size_t)row * width + x], 250, 128);
+    }
+}
+
+// Cost of the gating stage per frame: the grid computed on a worker and the
+// decision made on the writer strand. Both must stay far below a frame period.
+//
+// The "sequence" case replays a synthetic session: 200 static frames with
+// sensor noise, 40 frames with a moving object, then 200 static frames again.
+// It reports how many frames were recorded, so a change of the gate's
+// behaviour shows up next to its cost.
+static void BenchMotionGate(const BenchOptions& options)
+{
+    MotionGateConfig config;
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        vector<uint8_t> frame = MakeSyntheticFrame8(resolution.width, resolution.height, 1);
+        vector<uint8_t> other = MakeSyntheticFrame8(resolution.width, resolution.height, 2);
+        char name[64];
+
+        snprintf(name, sizeof(name), "grid/%s", resolution.name);
+        if (BenchSelected(options, "motion_gate", name))
+        {
+            MotionGrid grid;
+            BenchResult result;
+            result.bench = "motion_gate";
+            result.name = name;
+            result.bytesPerOp = (double)frame.size();
+            MeasureLoop(options, result, [&]() {
+                grid.Compute(&frame[0], resolution.width, resolution.height, resolution.width, config);
+                KeepAlive(grid);
+            });
+            result.Print();
+        }
+
+        snprintf(name, sizeof(name), "changed_fraction/%s", resolution.name);
+        if (BenchSelected(options, "motion_gate", name))
+        {
+            MotionGrid grid;
+            MotionGrid reference;
+            grid.Compute(&frame[0], resolution.width, resolution.height, resolution.width, config);
+            reference.Compute(&other[0], resolution.width, resolution.height, resolution.width, config);
+            double fraction = 0.0;
+            BenchResult result;
+            result.bench = "motion_gate";
+            result.name = name;
+            MeasureLoop(options, result, [&]() {
+                fraction = grid.ChangedFraction(reference, config.cellThreshold);
+                KeepAlive(fraction);
+            });
+            result.Add("changed_fraction", fraction);
+            result.Print();
+        }
+
+        snprintf(name, sizeof(name), "sequence/%s", resolution.name);
+        if (BenchSelected(options, "motion_gate", name))
+        {
+            // frames[0..3]: the static scene with different noise; frames[4..43]:
+            // the same scene with an object moving across it
+            vector<vector<uint8_t> > frames;
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                frames.push_back(MakeSyntheticFrame8(resolution.width, resolution.height, 100 + i));
+            }
+            for (unsigned int i = 0; i < 40; i++)
+            {
+                frames.push_back(frames[i % 4]);
+                DrawSquare(frames.back(), resolution.width, 100 + i * 16, 200);
+            }
+            const string metadata = options.outputDir + "/bench_motion_gate.csv";
+            uint64_t recorded = 0;
+            uint64_t skipped = 0;
+            BenchResult result;
+            result.bench = "motion_gate";
+            result.name = name;
+            MeasureLoop(options, result, [&]() {
+                MotionGate gate(config, metadata);
+                MotionGrid grid;
+                unsigned int writes = 0;
+                for (unsigned int i = 0; i < 440; i++)
+                {
+                    const vector<uint8_t>& pixels =
+                        (i >= 200 && i < 240) ? frames[4 + (i - 200)] : frames[i % 4];
+                    grid.Compute(&pixels[0], resolution.width, resolution.height, resolution.width, config);
+                    gate.Process(i, 0, 0, grid, [&writes]() { writes++; });
+                }
+                gate.Finish();
+                recorded = gate.GetRecordedCount();
+                skipped = gate.GetSkippedCount();
+                KeepAlive(writes);
+            });
+            result.Add("frames", 440.0);
+            result.Add("recorded", (double)recorded);
+            result.Add("skipped", (double)skipped);
+            result.Add("ns_per_frame", result.nsMedian / 440.0);
+            result.Print();
+            remove(metadata.c_str());
+        }
+    }
+}
+
+BENCH_REGISTER("motion_gate", BenchMotionGate);
@@ -0,0 +1,107 @@
+/*
+ * @Descripttion: File output benchmarks: one file per frame versus batched writes
+ * @version:
+ * @Date: 2026-10-19 12:04:38
+ * @LastEditTime: 2026-10-19 12:04:38
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Spinnaker.h"
+#include "bench_common.h"
+
+using namespace Spinnaker;
+using namespace std;
+
+// Size of the stdio buffer used by the batched writer
+const size_t k_batchBufferSize = 8 << 20;
+
+// The same raw Mono8 frame written three ways:
+//  - image_save_per_file: Image::Save to a new .pgm per frame, as the recorders do
+//  - fwrite_per_file: fopen/fwrite/fclose per frame, the syscall cost without Spinnaker
+//  - batched_append: frames appended to one open file through an 8 MB buffer
+// The data lands in the page cache; the final fsync of the batched file is
+// reported separately so device bandwidth is visible too.
+static void BenchFileOutput(const BenchOptions& options)
+{
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        vector<uint8_t> frame = MakeSyntheticFrame8(resolution.width, resolution.height);
+        ImagePtr image = Image::Create(resolution.width, resolution.height, 0, 0, PixelFormat_Mono8, &frame[0]);
+        unsigned int fileIndex = 0;
+        vector<string> written;
+
+        const string saveName = string("image_save_per_file/") + resolution.name;
+        if (BenchSelected(options, "output", saveName))
+        {
+            BenchResult result;
+            result.bench = "output";
+            result.name = saveName;
+            result.bytesPerOp = (double)frame.size();
+            MeasureLoop(options, result, [&]() {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/bench_save_%u.pgm", options.outputDir.c_str(), fileIndex++);
+                image->Save(path);
+                written.push_back(path);
+            });
+            result.Print();
+        }
+
+        const string fwriteName = string("fwrite_per_file/") + resolution.name;
+        if (BenchSelected(options, "output", fwriteName))
+        {
+            BenchResult result;
+            result.bench = "output";
+            result.name = fwriteName;
+            result.bytesPerOp = (double)frame.size();
+            MeasureLoop(options, result, [&]() {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/bench_fwrite_%u.raw", options.outputDir.c_str(), fileIndex++);
+                FILE* file = fopen(path, "wb");
+                if (file != nullptr)
+                {
+                    fwrite(&frame[0], 1, frame.size(), file);
+                    fclose(file);
+                    written.push_back(path);
+                }
+            });
+            result.Print();
+        }
+
+        const string batchName = string("batched_append/") + resolution.name;
+        if (BenchSelected(options, "output", batchName))
+        {
+            const string path = options.outputDir + "/bench_batched.raw";
+            FILE* file = fopen(path.c_str(), "wb");
+            if (file == nullptr)
+            {
+                fprintf(stderr, "Unable to open %s\n", path.c_str());
+                continue;
+            }
+            vector<char> buffer(k_batchBufferSize);
+            setvbuf(file, &buffer[0], _IOFBF, buffer.size());
+            BenchResult result;
+            result.bench = "output";
+            result.name = batchName;
+            result.bytesPerOp = (double)frame.size();
+            MeasureLoop(options, result, [&]() { fwrite(&frame[0], 1, frame.size(), file); });
+            const uint64_t t0 = GetMonotonicNs();
+            fflush(file);
+            fsync(fileno(file));
+            result.Add("final_fsync_ms", (GetMonotonicNs() - t0) / 1e6);
+            fclose(file);
+            result.Print();
+            remove(path.c_str());
+        }
+
+        for (size_t i = 0; i < written.size(); i++)
+        {
+            remove(written[i].c_str());
+        }
+    }
+}
+
+BENCH_REGISTER("output", BenchFileOutput);
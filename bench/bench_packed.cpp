@@ -0,0 +1,95 @@
+/*
+ * @Descripttion: Packed 10/12-bit unpacking benchmarks: SSSE3 kernels against the scalar versions
+ * @version:
+ * @Date: 2026-10-19 21:26:05
+ * @LastEditTime: 2026-10-19 21:26:05
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "packed_pixels.h"
+
+using namespace std;
+
+// Synthetic frame of the packing's depth, packed
+static vector<uint8_t> MakePackedFrame(pixelPacking packing, unsigned int width, unsigned int height)
+{
+    vector<uint16_t> samples = MakeSyntheticFrame16(width, height);
+    const unsigned int shift = 12 - GetPackingBitDepth(packing);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = (uint16_t)(samples[i] >> shift);
+    }
+    vector<uint8_t> packed(GetPackedSize(packing, samples.size()));
+    PackPixels16(packing, &samples[0], samples.size(), &packed[0]);
+    return packed;
+}
+
+// Unpacking a whole packed frame to 16-bit samples (the full-depth view)
+// and to 8 bits (the view the JPEG, MCAP and motion paths take), with the
+// SSSE3 kernels and with the scalar versions. simd cases fall back to
+// scalar on CPUs without SSSE3, see "ssse3". That every unpacker gives back
+// what was packed is checked by the tests target.
+static void BenchPackedPixels(const BenchOptions& options)
+{
+    const pixelPacking packings[] = {PACKING_10P, PACKING_12P, PACKING_12PACKED};
+    const char* packingNames[] = {"10p", "12p", "12packed"};
+    bool ssse3 = false;
+#if defined(PACKED_PIXELS_SSSE3)
+    ssse3 = CpuHasSsse3();
+#endif
+
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const size_t count = (size_t)resolution.width * resolution.height;
+        vector<uint16_t> output16(count);
+        vector<uint8_t> output8(count);
+        for (size_t p = 0; p < sizeof(packings) / sizeof(packings[0]); p++)
+        {
+            const pixelPacking packing = packings[p];
+            const vector<uint8_t> packed = MakePackedFrame(packing, resolution.width, resolution.height);
+            const char* kinds[] = {"scalar_16", "simd_16", "scalar_8", "simd_8"};
+            for (int k = 0; k < 4; k++)
+            {
+                const string name = string("unpack_") + packingNames[p] + "_" + kinds[k] + "/" + resolution.name;
+                if (!BenchSelected(options, "packed", name))
+                {
+                    continue;
+                }
+                BenchResult result;
+                result.bench = "packed";
+                result.name = name;
+                result.bytesPerOp = (double)packed.size();
+                MeasureLoop(options, result, [&]() {
+                    if (k == 0)
+                    {
+                        UnpackPixels16Scalar(packing, &packed[0], count, &output16[0]);
+                    }
+                    else if (k == 1)
+                    {
+                        UnpackPixels16(packing, &packed[0], count, &output16[0]);
+                    }
+                    else if (k == 2)
+                    {
+                        UnpackPixels8Scalar(packing, &packed[0], count, &output8[0]);
+                    }
+                    else
+                    {
+                        UnpackPixels8(packing, &packed[0], count, &output8[0]);
+                    }
+                    KeepAlive(output16[count / 2]);
+                    KeepAlive(output8[count / 2]);
+                });
+                result.Add("mpixels_per_s", count / (result.nsMedian / 1e3));
+                result.Add("packed_bytes_per_pixel", (double)packed.size() / count);
+                result.Add("ssse3", ssse3 ? 1.0 : 0.0);
+                result.Print();
+            }
+        }
+    }
+}
+
+BENCH_REGISTER("packed", BenchPackedPixels);
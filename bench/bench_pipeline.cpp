@@ -0,0 +1,122 @@
+/*
+ * @Descripttion: Pixel pipeline benchmarks: fused single-pass kernels against one pass per stage
+ * @version:
+ * @Date: 2026-10-19 22:07:36
+ * @LastEditTime: 2026-10-19 22:07:36
+ */
+
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "pixel_pipeline.h"
+
+using namespace std;
+
+// Combinations the recorder runs ahead of JPEG encoding, with the operations
+// each one enables. Crops keep the centered 3/4 of the frame; Mono16 holds
+// 12-bit samples like the unpacked 12-bit formats. That the fused kernels
+// give the chained output is checked by the tests target.
+static void BenchPixelPipeline(const BenchOptions& options)
+{
+    struct PipelineCase
+    {
+        const char* name;
+        pipelineFormat input;
+        pipelineFormat output;
+        bool crop;
+        unsigned int bin;
+        bool lut;
+    };
+    const PipelineCase cases[] = {
+        {"mono8_lut", PIPELINE_MONO8, PIPELINE_MONO8, false, 1, true},
+        {"mono8_crop_bin2_lut", PIPELINE_MONO8, PIPELINE_MONO8, true, 2, true},
+        {"mono16_to_mono8", PIPELINE_MONO16, PIPELINE_MONO8, false, 1, false},
+        {"mono16_to_mono8_crop_bin2_lut", PIPELINE_MONO16, PIPELINE_MONO8, true, 2, true},
+        {"mono16_bin2", PIPELINE_MONO16, PIPELINE_MONO16, false, 2, false},
+        {"bayerrg8_to_mono8", PIPELINE_BAYERRG8, PIPELINE_MONO8, false, 1, false},
+        {"bayerrg8_to_mono8_bin2_lut", PIPELINE_BAYERRG8, PIPELINE_MONO8, false, 2, true},
+    };
+
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const vector<uint8_t> frame8 = MakeSyntheticFrame8(resolution.width, resolution.height);
+        vector<uint16_t> frame16 = MakeSyntheticFrame16(resolution.width, resolution.height);
+        for (size_t i = 0; i < frame16.size(); i++)
+        {
+            frame16[i] = (uint16_t)(frame16[i] & 0x0FFF);
+        }
+
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        {
+            const PipelineCase& pipelineCase = cases[c];
+            const string fusedName = string("fused_") + pipelineCase.name + "/" + resolution.name;
+            const string chainedName = string("chained_") + pipelineCase.name + "/" + resolution.name;
+            const bool runFused = BenchSelected(options, "pipeline", fusedName);
+            const bool runChained = BenchSelected(options, "pipeline", chainedName);
+            if (!runFused && !runChained)
+            {
+                continue;
+            }
+            PipelineConfig config;
+            if (pipelineCase.crop)
+            {
+                config.cropX = resolution.width / 8;
+                config.cropY = resolution.height / 8;
+                config.cropWidth = resolution.width * 3 / 4;
+                config.cropHeight = resolution.height * 3 / 4;
+            }
+            config.bin = pipelineCase.bin;
+            config.inputBits = 12;
+            config.output = pipelineCase.output;
+            config.SetGamma(pipelineCase.lut ? 2.2 : 1.0);
+
+            const unsigned int bytesPerPixel = GetPipelineBytesPerPixel(pipelineCase.input);
+            const uint8_t* src = bytesPerPixel == 2 ? (const uint8_t*)&frame16[0] : &frame8[0];
+            const size_t stride = (size_t)resolution.width * bytesPerPixel;
+            PixelPipeline pipeline;
+            if (pipeline.Select(pipelineCase.input, config) < 0)
+            {
+                fprintf(stderr, "Pipeline %s is not instantiated\n", pipelineCase.name);
+                continue;
+            }
+            PipelineOutput fused;
+            PipelineOutput chained;
+            PipelineStages stages;
+            const double inputBytes = (double)resolution.width * resolution.height * bytesPerPixel;
+
+            for (int chainedCase = 0; chainedCase < 2; chainedCase++)
+            {
+                if (!(chainedCase ? runChained : runFused))
+                {
+                    continue;
+                }
+                BenchResult result;
+                result.bench = "pipeline";
+                result.name = chainedCase ? chainedName : fusedName;
+                result.bytesPerOp = inputBytes;
+                MeasureLoop(options, result, [&]() {
+                    if (chainedCase)
+                    {
+                        RunChainedPipeline(pipelineCase.input, config, src, resolution.width, resolution.height,
+                                           stride, stages, chained);
+                        KeepAlive(chained.data[chained.data.size() / 2]);
+                    }
+                    else
+                    {
+                        pipeline.Process(src, resolution.width, resolution.height, stride, fused);
+                        KeepAlive(fused.data[fused.data.size() / 2]);
+                    }
+                });
+                result.Add("mpixels_per_s", resolution.width * resolution.height / (result.nsMedian / 1e3));
+                const PipelineOutput& output = chainedCase ? chained : fused;
+                result.Add("output_width", (double)output.width);
+                result.Add("output_height", (double)output.height);
+                result.Add("pipeline", pipeline.Describe());
+                result.Print();
+            }
+        }
+    }
+}
+
+BENCH_REGISTER("pipeline", BenchPixelPipeline);
@@ -0,0 +1,108 @@
+/*
+ * @Descripttion: Hot-plug recovery benchmarks: a simulated camera unplugged and replugged while another records on
+ * @version:
+ * @Date: 2026-10-20 03:21:52
+ * @LastEditTime: 2026-10-20 03:21:52
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "recovery_simulation.h"
+
+using namespace std;
+
+static double GetMedian(vector<double> values)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Two simulated cameras record; camera 1 is unplugged for the outage and
+// plugged back in, or in the "gone" case never comes back. Per outage:
+// recovery_ms from quarantine to acquiring again, detection_ms from the
+// unplug to the first failed grab, resume_after_plug_ms from the replug to
+// the first new frame (bounded by the rescan interval plus enumeration and
+// initialization), and the lines in the gap file. Camera 0 records on:
+// other_camera_errors and its frame rate. That the camera comes back with
+// its configuration and camera 0 sees no errors is checked by the tests
+// target.
+static void BenchDeviceRecovery(const BenchOptions& options)
+{
+    const unsigned int outagesMs[] = {100, 400, 0};
+    for (size_t o = 0; o < sizeof(outagesMs) / sizeof(outagesMs[0]); o++)
+    {
+        const bool gone = outagesMs[o] == 0;
+        char name[64];
+        if (gone)
+        {
+            snprintf(name, sizeof(name), "gone_%ums_timeout", k_simulatedGoneTimeoutMs);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "unplug_%ums", outagesMs[o]);
+        }
+        if (!BenchSelected(options, "recovery", name))
+        {
+            continue;
+        }
+        const string gapPath = options.outputDir + "/bench-recovery-gaps.csv";
+        DeviceRecoveryConfig config;
+        config.rescanIntervalMs = k_simulatedRescanMs;
+        config.reacquireTimeoutMs = gone ? k_simulatedGoneTimeoutMs : k_simulatedRecoveryTimeoutMs;
+
+        vector<double> recoveryMs;
+        vector<double> detectionMs;
+        vector<double> resumeMs;
+        vector<double> otherFps;
+        uint64_t otherErrors = 0;
+        unsigned int gapLines = 0;
+        unsigned int givenUp = 0;
+        unsigned int runs = 0;
+        BenchResult result;
+        result.bench = "recovery";
+        result.name = name;
+        MeasureLoop(options, result, [&]() {
+            const RecoveryRun run = SimulateOutage(config, outagesMs[o], gapPath);
+            runs++;
+            otherErrors += run.otherErrors;
+            otherFps.push_back(run.otherFps);
+            detectionMs.push_back(run.detectionMs);
+            recoveryMs.push_back(run.recoveryMs);
+            if (run.givenUp)
+            {
+                givenUp++;
+            }
+            else
+            {
+                resumeMs.push_back(run.resumeMs);
+            }
+            gapLines += run.gapLines;
+        });
+        AsyncLogger::Instance().Flush();
+
+        result.Add(gone ? "time_to_give_up_ms" : "recovery_ms", GetMedian(recoveryMs));
+        result.Add("detection_ms", GetMedian(detectionMs));
+        if (!gone)
+        {
+            result.Add("resume_after_plug_ms", GetMedian(resumeMs));
+            result.Add("max_resume_after_plug_ms", resumeMs.empty() ? 0.0 : *std::max_element(resumeMs.begin(),
+                                                                                              resumeMs.end()));
+            result.Add("bound_ms", (double)GetSimulatedResumeBoundMs());
+        }
+        result.Add("given_up", runs > 0 ? (double)givenUp / runs : 0.0);
+        result.Add("gap_lines_per_outage", runs > 0 ? (double)gapLines / runs : 0.0);
+        result.Add("other_camera_errors", (double)otherErrors);
+        result.Add("other_camera_fps", GetMedian(otherFps));
+        result.Add("nominal_fps", 1e6 / k_simulatedFrameUs);
+        result.Print();
+    }
+}
+
+BENCH_REGISTER("recovery", BenchDeviceRecovery);
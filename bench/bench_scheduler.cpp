@@ -0,0 +1,218 @@
+/*
+ * @Descripttion: Scaling benchmark of the shared task scheduler with synthetic cameras
+ * @version:
+ * @Date: 2026-10-19 10:48:05
+ * @LastEditTime: 2026-10-19 10:48:05
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <string>
+#include <vector>
+#include "bench_common.h"
+#include "task_scheduler.h"
+#include "time_utils.h"
+
+// Frames each synthetic camera delivers per run
+const unsigned int k_framesPerCamera = 50;
+
+using namespace std;
+
+// Sensor resolutions of the cameras we run; synthetic camera i uses entry i % 3
+// so that cameras produce different per-frame loads
+const unsigned int k_resolutions[3][2] = {{1440, 1080}, {2048, 1536}, {2448, 2048}};
+
+// One synthetic camera: a 12-bit Mono16 source frame and an output "file"
+struct SyntheticCamera
+{
+    unsigned int width;
+    unsigned int height;
+    std::vector<uint16_t> source;
+    std::vector<uint8_t> sink;
+    uint64_t nextExpected;
+    uint64_t orderErrors;
+    std::unique_ptr<OrderedStrand> writer;
+};
+
+// Conversion stage: 12-bit to 8-bit, the same work as Convert(PixelFormat_Mono8)
+static void ConvertFrame(const SyntheticCamera& camera, std::vector<uint8_t>& out)
+{
+    const size_t numPixels = (size_t)camera.width * camera.height;
+    out.resize(numPixels);
+    const uint16_t* src = &camera.source[0];
+    uint8_t* dst = &out[0];
+    for (size_t i = 0; i < numPixels; i++)
+    {
+        dst[i] = (uint8_t)(src[i] >> 4);
+    }
+}
+
+// Write stage: copy into the camera's sink and check per-camera ordering
+static void WriteFrame(SyntheticCamera& camera, uint64_t sequence, const std::vector<uint8_t>& frame)
+{
+    if (sequence != camera.nextExpected)
+    {
+        camera.orderErrors++;
+    }
+    camera.nextExpected = sequence + 1;
+    memcpy(&camera.sink[0], &frame[0], frame.size());
+}
+
+static void InitCameras(std::vector<SyntheticCamera>& cameras, TaskScheduler* scheduler)
+{
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        SyntheticCamera& camera = cameras[i];
+        camera.width = k_resolutions[i % 3][0];
+        camera.height = k_resolutions[i % 3][1];
+        camera.source.resize((size_t)camera.width * camera.height);
+        for (size_t p = 0; p < camera.source.size(); p++)
+        {
+            camera.source[p] = (uint16_t)((p * 2654435761u + i) & 0x0FFF);
+        }
+        camera.sink.resize(camera.source.size());
+        camera.nextExpected = 0;
+        camera.orderErrors = 0;
+        if (scheduler != nullptr)
+        {
+            camera.writer.reset(new OrderedStrand(*scheduler));
+        }
+    }
+}
+
+static uint64_t TotalPixels(const std::vector<SyntheticCamera>& cameras, unsigned int framesPerCamera)
+{
+    uint64_t pixels = 0;
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        pixels += (uint64_t)cameras[i].width * cameras[i].height * framesPerCamera;
+    }
+    return pixels;
+}
+
+// Prints one scaling run; "cores" is the number of hardware threads the run
+// could actually use, so fps_per_core is comparable across modes
+static void PrintResult(const string& name, unsigned int numCameras, unsigned int numThreads,
+                        unsigned int framesPerCamera, uint64_t elapsedNs, uint64_t pixels, uint64_t steals,
+                        uint64_t orderErrors)
+{
+    const double seconds = elapsedNs / 1e9;
+    const double fps = numCameras * framesPerCamera / seconds;
+    const unsigned int cores = std::min(numThreads, std::max(1u, std::thread::hardware_concurrency()));
+    BenchResult result;
+    result.bench = "scheduler_scaling";
+    result.name = name;
+    result.iterations = 1;
+    result.nsMedian = (double)elapsedNs;
+    result.nsMin = (double)elapsedNs;
+    result.Add("cameras", numCameras);
+    result.Add("threads", numThreads);
+    result.Add("cores", cores);
+    result.Add("frames", numCameras * framesPerCamera);
+    result.Add("fps", fps);
+    result.Add("fps_per_core", fps / cores);
+    result.Add("mpix_per_s", pixels / seconds / 1e6);
+    result.Add("steals", (double)steals);
+    result.Add("order_errors", (double)orderErrors);
+    result.Print();
+}
+
+// All cameras share one scheduler; frames of all cameras are submitted
+// interleaved, the way image events arrive
+static void RunPool(const string& name, unsigned int numCameras, unsigned int framesPerCamera)
+{
+    std::vector<SyntheticCamera> cameras(numCameras);
+    std::unique_ptr<TaskScheduler> scheduler(new TaskScheduler());
+    InitCameras(cameras, scheduler.get());
+
+    const uint64_t start = GetMonotonicNs();
+    for (unsigned int frame = 0; frame < framesPerCamera; frame++)
+    {
+        for (unsigned int c = 0; c < numCameras; c++)
+        {
+            SyntheticCamera* camera = &cameras[c];
+            const uint64_t sequence = frame;
+            scheduler->Submit([camera, sequence]() {
+                std::shared_ptr<std::vector<uint8_t> > converted(new std::vector<uint8_t>());
+                ConvertFrame(*camera, *converted);
+                camera->writer->Post(sequence, [camera, sequence, converted]() {
+                    WriteFrame(*camera, sequence, *converted);
+                });
+            });
+        }
+    }
+    scheduler->WaitIdle();
+    const uint64_t elapsed = GetMonotonicNs() - start;
+
+    uint64_t orderErrors = 0;
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        orderErrors += cameras[i].orderErrors;
+    }
+    PrintResult(name, numCameras, scheduler->GetNumWorkers(), framesPerCamera, elapsed,
+                TotalPixels(cameras, framesPerCamera), scheduler->GetStealCount(), orderErrors);
+    // Strands reference the scheduler; drop them first
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        cameras[i].writer.reset();
+    }
+}
+
+// Baseline: one thread per camera doing all of its own per-frame work
+static void RunThreadPerCamera(const string& name, unsigned int numCameras, unsigned int framesPerCamera)
+{
+    std::vector<SyntheticCamera> cameras(numCameras);
+    InitCameras(cameras, nullptr);
+
+    const uint64_t start = GetMonotonicNs();
+    std::vector<std::thread> threads;
+    for (unsigned int c = 0; c < numCameras; c++)
+    {
+        SyntheticCamera* camera = &cameras[c];
+        threads.push_back(std::thread([camera, framesPerCamera]() {
+            for (unsigned int frame = 0; frame < framesPerCamera; frame++)
+            {
+                // Fresh output per frame, as Convert() allocates a new image
+                std::vector<uint8_t> converted;
+                ConvertFrame(*camera, converted);
+                WriteFrame(*camera, frame, converted);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    const uint64_t elapsed = GetMonotonicNs() - start;
+    PrintResult(name, numCameras, numCameras, framesPerCamera, elapsed,
+                TotalPixels(cameras, framesPerCamera), 0, 0);
+}
+
+// 1 to 16 synthetic cameras through the shared pool (one worker per hardware
+// thread) and through one thread per camera
+static void BenchSchedulerScaling(const BenchOptions& options)
+{
+    const unsigned int cameraCounts[] = {1, 2, 4, 8, 12, 16};
+    for (size_t i = 0; i < sizeof(cameraCounts) / sizeof(cameraCounts[0]); i++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "thread_per_camera/%u", cameraCounts[i]);
+        if (BenchSelected(options, "scheduler_scaling", name))
+        {
+            RunThreadPerCamera(name, cameraCounts[i], k_framesPerCamera);
+        }
+        snprintf(name, sizeof(name), "pool/%u", cameraCounts[i]);
+        if (BenchSelected(options, "scheduler_scaling", name))
+        {
+            RunPool(name, cameraCounts[i], k_framesPerCamera);
+        }
+    }
+}
+
+BENCH_REGISTER("scheduler_scaling", BenchSchedulerScaling);
@@ -0,0 +1,62 @@
+/*
+ * @Descripttion: Load shedder benchmarks: a synthetic slow writer falling behind and recovering
+ * @version:
+ * @Date: 2026-10-20 00:21:07
+ * @LastEditTime: 2026-10-20 00:21:07
+ */
+
+#include <string>
+#include "bench_common.h"
+#include "shedding_simulation.h"
+
+using namespace std;
+
+// The writer falls behind for 4 s and catches up again. "adaptive" runs the
+// default LoadShedderConfig; "none" disables every level, so only a full
+// queue drops frames. Each case reports how many frames were shed or lost to
+// the full queue, the worst write latency, how long the shedder took to react
+// and to step back to none, and the level changes with their session times.
+// The measured time is one replay of the 12 s session (2400 frames).
+static void BenchLoadShedding(const BenchOptions& options)
+{
+    const char* names[] = {"slow_writer/adaptive", "slow_writer/none"};
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++)
+    {
+        if (!BenchSelected(options, "shedding", names[n]))
+        {
+            continue;
+        }
+        LoadShedderConfig config;
+        if (n == 1)
+        {
+            for (unsigned int level = 0; level < NUM_SHEDDING_LEVELS; level++)
+            {
+                config.enabled[level] = false;
+            }
+        }
+        // The first replay logs each level change; the measured ones are quiet
+        const ShedSimulation simulation = SimulateSlowWriter(config);
+        AsyncLogger::Instance().Flush();
+        AsyncLogger::SetMinSeverity(SEVERITY_ERROR);
+        BenchResult result;
+        result.bench = "shedding";
+        result.name = names[n];
+        MeasureLoop(options, result, [&]() { KeepAlive(SimulateSlowWriter(config).written); });
+        AsyncLogger::SetMinSeverity(SEVERITY_INFO);
+        result.Add("frames", (double)simulation.frames);
+        result.Add("written", (double)simulation.written);
+        result.Add("shed", (double)simulation.shed);
+        result.Add("queue_full_drops", (double)simulation.queueFull);
+        result.Add("max_latency_ms", simulation.maxLatencyNs / 1e6);
+        result.Add("max_level", GetSheddingLevelName(simulation.maxLevel));
+        if (simulation.maxLevel != SHEDDING_NONE)
+        {
+            result.Add("reaction_ms", simulation.firstShedNs / 1e6);
+            result.Add("recovery_ms", simulation.recoveredNs / 1e6);
+        }
+        result.Add("levels", simulation.levels);
+        result.Print();
+    }
+}
+
+BENCH_REGISTER("shedding", BenchLoadShedding);
@@ -0,0 +1,261 @@
+/*
+ * @Descripttion: Staging tier benchmarks: segment appends direct to disk against RAM staging with a flusher
+ * @version:
+ * @Date: 2026-10-20 04:17:09
+ * @LastEditTime: 2026-10-20 04:17:09
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "storage_manager.h"
+
+using namespace std;
+
+// Cameras appending at once, each on its own thread like the writer strands
+const unsigned int k_stagingCameras = 2;
+// Recorded per camera and session
+const uint64_t k_stagingSessionBytes = 128ULL << 20;
+// Small segments, so sessions roll over and finish several files
+const uint64_t k_stagingSegmentBytes = 32ULL << 20;
+// RAM-backed directory the staged cases use
+const char* const k_stagingBenchDirectory = "/dev/shm/bench_staging";
+
+// Removes a directory of session files
+static void RemoveStagingFiles(const string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        const string name = entry->d_name;
+        if (name != "." && name != "..")
+        {
+            remove((directory + "/" + name).c_str());
+        }
+    }
+    closedir(dir);
+    rmdir(directory.c_str());
+}
+
+// Walks every segment in directory and counts complete records, the way a
+// reader of the recording would. Returns -1 if a segment is damaged.
+static int64_t CountSegmentRecords(const string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+    {
+        return -1;
+    }
+    int64_t records = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        const string name = entry->d_name;
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".seg") != 0)
+        {
+            continue;
+        }
+        const string path = directory + "/" + name;
+        struct stat info;
+        FILE* file = fopen(path.c_str(), "rb");
+        SegmentFileHeader fileHeader;
+        if (file == nullptr || stat(path.c_str(), &info) != 0 || fread(&fileHeader, sizeof(fileHeader), 1, file) != 1 ||
+            memcmp(fileHeader.magic, k_segmentFileMagic, sizeof(fileHeader.magic)) != 0)
+        {
+            records = -1;
+        }
+        // The file must end exactly after its last record
+        uint64_t offset = sizeof(fileHeader);
+        SegmentRecordHeader header;
+        while (records >= 0 && offset < (uint64_t)info.st_size)
+        {
+            if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != k_segmentRecordMagic ||
+                offset + sizeof(header) + header.payloadSize > (uint64_t)info.st_size ||
+                fseek(file, header.payloadSize, SEEK_CUR) != 0)
+            {
+                records = -1;
+                break;
+            }
+            offset += sizeof(header) + header.payloadSize;
+            records++;
+        }
+        if (file != nullptr)
+        {
+            fclose(file);
+        }
+        if (records < 0)
+        {
+            break;
+        }
+    }
+    closedir(dir);
+    return records;
+}
+
+// Sessions of k_stagingCameras threads appending Mono8 frames to segments
+// as fast as they can, ended by StorageManager::Stop():
+//  - direct: segments written straight to the output directory
+//  - staged: written to tmpfs and flushed to the output directory in 16 MB
+//    batches; the session time includes draining the staging tier and
+//    syncing every segment, which direct sessions leave to the page cache
+//  - staged_backpressure: a high-water mark of 4 frames and a capacity of 6,
+//    so writers outrun the flusher and wait, or have records refused
+// Each case reports the append latency the writer strands see, the staging
+// occupancy peak, flush throughput, backpressure waits and refused records,
+// and whether the last session's segments hold every record that was
+// accepted, with no staged file left behind.
+static void BenchStaging(const BenchOptions& options)
+{
+    const char* caseNames[] = {"direct", "staged", "staged_backpressure"};
+    mkdir("/dev/shm", 0755);
+    for (size_t r = 0; r < k_numSensorResolutions; r++)
+    {
+        const SensorResolution& resolution = k_sensorResolutions[r];
+        const vector<uint8_t> frame = MakeSyntheticFrame8(resolution.width, resolution.height);
+        const uint64_t recordBytes = sizeof(SegmentRecordHeader) + frame.size();
+        const unsigned int recordsPerCamera = (unsigned int)std::max<uint64_t>(1, k_stagingSessionBytes / recordBytes);
+        for (int c = 0; c < 3; c++)
+        {
+            const string name = string(caseNames[c]) + "/" + resolution.name;
+            if (!BenchSelected(options, "staging", name))
+            {
+                continue;
+            }
+            const string directory = options.outputDir + "/bench_staging";
+            StorageConfig config;
+            config.directory = directory;
+            config.segmentMaxBytes = k_stagingSegmentBytes;
+            config.warnFreeBytes = 0;
+            config.warnSeconds = 0;
+            config.reserveFreeBytes = 0;
+            if (c > 0)
+            {
+                config.staging.directory = k_stagingBenchDirectory;
+                config.staging.flushBatchBytes = 16ULL << 20;
+                config.staging.reportIntervalMs = 100;
+            }
+            if (c == 2)
+            {
+                config.staging.highWaterBytes = 4 * recordBytes;
+                config.staging.capacityBytes = 6 * recordBytes;
+                config.staging.backpressureTimeoutMs = 20;
+                config.staging.flushBatchBytes = recordBytes;
+            }
+
+            vector<uint64_t> latencies;
+            std::mutex latencyMutex;
+            uint64_t accepted = 0;
+            double peakStaged = 0.0;
+            double flushBusy = 0.0;
+            uint64_t waits = 0;
+            uint64_t rejected = 0;
+            uint64_t integrityFailures = 0;
+            BenchResult result;
+            result.bench = "staging";
+            result.name = name;
+            result.bytesPerOp = (double)recordBytes * recordsPerCamera * k_stagingCameras;
+            MeasureLoop(options, result, [&]() {
+                RemoveStagingFiles(directory);
+                mkdir(directory.c_str(), 0755);
+                if (c > 0)
+                {
+                    mkdir(k_stagingBenchDirectory, 0755);
+                }
+                StorageManager storage(config);
+                if (storage.Start() < 0)
+                {
+                    return;
+                }
+                vector<SegmentWriter*> writers;
+                for (unsigned int i = 0; i < k_stagingCameras; i++)
+                {
+                    writers.push_back(storage.OpenWriter("cam" + to_string(i)));
+                }
+                accepted = 0;
+                vector<thread> threads;
+                for (unsigned int i = 0; i < k_stagingCameras; i++)
+                {
+                    SegmentWriter* writer = writers[i];
+                    threads.push_back(thread([&, writer]() {
+                        vector<uint64_t> local;
+                        uint64_t written = 0;
+                        for (unsigned int n = 0; n < recordsPerCamera; n++)
+                        {
+                            SegmentRecordHeader header;
+                            memset(&header, 0, sizeof(header));
+                            header.frameIndex = n;
+                            header.width = resolution.width;
+                            header.height = resolution.height;
+                            const uint64_t start = GetMonotonicNs();
+                            if (writer->Append(header, &frame[0], (uint32_t)frame.size()))
+                            {
+                                written++;
+                            }
+                            local.push_back(GetMonotonicNs() - start);
+                        }
+                        std::lock_guard<std::mutex> lock(latencyMutex);
+                        latencies.insert(latencies.end(), local.begin(), local.end());
+                        accepted += written;
+                    }));
+                }
+                for (size_t i = 0; i < threads.size(); i++)
+                {
+                    threads[i].join();
+                }
+                storage.Stop();
+                if (storage.GetStaging() != nullptr)
+                {
+                    peakStaged = (double)storage.GetStaging()->GetPeakStagedBytes();
+                    flushBusy = storage.GetStaging()->GetFlushBusyBytesPerSecond();
+                    waits = storage.GetStaging()->GetBackpressureWaits();
+                    rejected = storage.GetStaging()->GetRejectedCount();
+                    integrityFailures = storage.GetStaging()->GetIntegrityFailures();
+                }
+            });
+
+            std::sort(latencies.begin(), latencies.end());
+            const int64_t records = CountSegmentRecords(directory);
+            unsigned int stagedLeft = 0;
+            DIR* stagingDir = opendir(k_stagingBenchDirectory);
+            if (stagingDir != nullptr)
+            {
+                struct dirent* entry;
+                while ((entry = readdir(stagingDir)) != nullptr)
+                {
+                    stagedLeft += entry->d_name[0] != '.';
+                }
+                closedir(stagingDir);
+            }
+            result.Add("append_p50_us", latencies.empty() ? 0.0 : latencies[latencies.size() / 2] / 1e3);
+            result.Add("append_p99_us", latencies.empty() ? 0.0 : latencies[latencies.size() * 99 / 100] / 1e3);
+            result.Add("append_max_us", latencies.empty() ? 0.0 : latencies.back() / 1e3);
+            if (c > 0)
+            {
+                result.Add("peak_staged_mb", peakStaged / 1e6);
+                result.Add("flush_busy_mb_per_s", flushBusy / 1e6);
+                result.Add("backpressure_waits", (double)waits);
+                result.Add("rejected_records", (double)rejected);
+            }
+            result.Add("records_accepted", (double)accepted);
+            result.Add("records_on_disk", (double)records);
+            result.Add("intact", records == (int64_t)accepted && stagedLeft == 0 && integrityFailures == 0 ? 1.0
+                                                                                                             : 0.0);
+            result.Print();
+            RemoveStagingFiles(directory);
+            RemoveStagingFiles(k_stagingBenchDirectory);
+        }
+    }
+}
+
+BENCH_REGISTER("staging", BenchStaging);
@@ -0,0 +1,121 @@
+/*
+ * @Descripttion: Stream diagnostics benchmarks: cause attribution on simulated links and the frame path cost
+ * @version:
+ * @Date: 2026-10-20 04:46:21
+ * @LastEditTime: 2026-10-20 04:46:21
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "bench_common.h"
+#include "stream_simulation.h"
+
+using namespace std;
+
+// A simulated hour of readings per transport layer: one interval in ten
+// goes through an episode of incomplete frames. Reports the share of those
+// intervals attributed to the right cause, overall and per cause, and the
+// time one reading takes to analyse on the sampler thread. Without resend
+// counters late resends show as unknown, which is what the transport layer
+// lets us tell.
+static void BenchStreamAttribution(const BenchOptions& options)
+{
+    const char* caseNames[] = {"attribution/gige", "attribution/usb3"};
+    for (int c = 0; c < 2; c++)
+    {
+        if (!BenchSelected(options, "stream_diag", caseNames[c]))
+        {
+            continue;
+        }
+        AttributionRun run;
+        BenchResult result;
+        result.bench = "stream_diag";
+        result.name = caseNames[c];
+        MeasureLoop(options, result, [&]() { run = SimulateAttribution(c == 0); });
+        result.nsMedian /= k_simulatedIntervals;
+        result.nsMin /= k_simulatedIntervals;
+        result.Add("episodes", (double)run.episodes);
+        result.Add("attributed_correctly", run.episodes > 0 ? (double)run.correct / run.episodes : 0.0);
+        for (int e = 1; e < NUM_LINK_EPISODES; e++)
+        {
+            uint64_t episodes = 0;
+            for (int cause = 0; cause < NUM_STREAM_CAUSES; cause++)
+            {
+                episodes += run.causes[e][cause];
+            }
+            result.Add(GetStreamCauseName(k_episodeCauses[e]),
+                       episodes > 0 ? (double)run.causes[e][k_episodeCauses[e]] / episodes : 0.0);
+        }
+        result.Print();
+    }
+}
+
+// Reporting incomplete frames on the frame path: this thread reports for
+// one camera while another thread reports for a second, and the service
+// reads both every millisecond, a thousand times the recorder's rate.
+// Reports the cost per call and the intervals that had incomplete frames
+// attributed. That every reading runs on the one sampler thread is checked
+// by the tests target.
+static void BenchStreamFramePath(const BenchOptions& options)
+{
+    if (!BenchSelected(options, "stream_diag", "on_incomplete_frame"))
+    {
+        return;
+    }
+    const unsigned int k_callsPerOp = 1000;
+    StreamDiagnosticsConfig config;
+    config.intervalMs = 1;
+    StreamDiagnostics diagnostics(config);
+    std::atomic<uint64_t> readings(0);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        diagnostics.AddCamera("cam" + to_string(i), [&](StreamSample& sample) {
+            sample.counters[STREAM_LOST_PACKETS] = (int64_t)readings++;
+            return 0;
+        });
+        diagnostics.Activate(i);
+    }
+    diagnostics.Start();
+    std::atomic<bool> stop(false);
+    std::thread otherCamera([&]() {
+        while (!stop)
+        {
+            diagnostics.OnIncompleteFrame(1, GetMonotonicNs());
+            std::this_thread::yield();
+        }
+    });
+    BenchResult result;
+    result.bench = "stream_diag";
+    result.name = "on_incomplete_frame";
+    MeasureLoop(options, result, [&]() {
+        for (unsigned int n = 0; n < k_callsPerOp; n++)
+        {
+            diagnostics.OnIncompleteFrame(0, GetMonotonicNs());
+        }
+    });
+    stop = true;
+    otherCamera.join();
+    // Let a last reading of both cameras take in the final frames
+    const uint64_t readingsAtEnd = readings;
+    while (readings < readingsAtEnd + 4)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    diagnostics.Stop();
+    result.nsMedian /= k_callsPerOp;
+    result.nsMin /= k_callsPerOp;
+    result.Add("readings", (double)readings);
+    result.Add("intervals_with_incomplete", (double)(diagnostics.GetIntervalCount(0, STREAM_CAUSE_PACKET_LOSS) +
+                                                     diagnostics.GetIntervalCount(1, STREAM_CAUSE_PACKET_LOSS)));
+    result.Print();
+}
+
+static void BenchStreamDiagnostics(const BenchOptions& options)
+{
+    BenchStreamAttribution(options);
+    BenchStreamFramePath(options);
+}
+
+BENCH_REGISTER("stream_diag", BenchStreamDiagnostics);
@@ -0,0 +1,185 @@
+/*
+ * @Descripttion: Simulated camera clocks with drift and latch jitter, shared by the bench and tests targets
+ * @version:
+ * @Date: 2026-10-20 07:38:16
+ * @LastEditTime: 2026-10-20 07:38:16
+ */
+
+#ifndef DUAL_CAM_RECORDER_CLOCK_SIMULATION_H
+#define DUAL_CAM_RECORDER_CLOCK_SIMULATION_H
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "clock_sync.h"
+
+// A camera clock and latch path simulated against a virtual host clock. The
+// camera clock runs at a rate off by driftPpm plus a slow sinusoidal wander
+// (temperature), and can be reset to zero mid-run. A latch takes baseLatchNs
+// plus an exponentially distributed jitter, occasionally much longer (the
+// latching thread was preempted), and occasionally returns a bad value.
+struct SimulatedCameraClock
+{
+    const char* name;
+    double startNs;      // device time at host time 0
+    double driftPpm;
+    double wanderPpm;    // amplitude of the rate wander
+    double wanderPeriodS;
+    double baseLatchNs;
+    double latchJitterNs; // mean of the exponential part of a latch round trip
+    double slowLatchRate; // fraction of latches delayed by 1..5 ms
+    double badValueRate;  // fraction of latches whose value is off by up to 1 ms
+    double resetAtS;      // host time of a counter reset, 0 for none
+
+    // Device time at host time t, both in ns
+    double DeviceAt(double t) const
+    {
+        double device = startNs + t * (1.0 + driftPpm * 1e-6);
+        if (wanderPpm != 0.0)
+        {
+            const double period = wanderPeriodS * 1e9;
+            device += wanderPpm * 1e-6 * period / (2.0 * M_PI) * (1.0 - cos(2.0 * M_PI * t / period));
+        }
+        if (resetAtS > 0.0 && t >= resetAtS * 1e9)
+        {
+            device -= DeviceAtNoReset(resetAtS * 1e9);
+        }
+        return device;
+    }
+
+    double DeviceAtNoReset(double t) const
+    {
+        SimulatedCameraClock clock = *this;
+        clock.resetAtS = 0.0;
+        return clock.DeviceAt(t);
+    }
+};
+
+// Small deterministic generator, so every run sees the same latches
+struct SimulationRandom
+{
+    uint64_t state;
+
+    explicit SimulationRandom(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1)
+    {
+    }
+
+    double Uniform()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (double)(state >> 11) / 9007199254740992.0;
+    }
+
+    double Exponential(double mean)
+    {
+        return -mean * log(1.0 - Uniform());
+    }
+};
+
+// Host time of the simulation starts well above zero like a real uptime
+const double k_simulationHostStartNs = 3600e9;
+
+inline ClockSample SimulateLatch(const SimulatedCameraClock& clock, SimulationRandom& random, double t)
+{
+    double roundTrip = clock.baseLatchNs + random.Exponential(clock.latchJitterNs);
+    if (random.Uniform() < clock.slowLatchRate)
+    {
+        roundTrip += 1e6 + random.Uniform() * 4e6;
+    }
+    double device = clock.DeviceAt(t + random.Uniform() * roundTrip);
+    if (random.Uniform() < clock.badValueRate)
+    {
+        device += (random.Uniform() * 2.0 - 1.0) * 1e6;
+    }
+    ClockSample sample;
+    sample.deviceTimestamp = (uint64_t)device;
+    sample.hostBefore = (uint64_t)(k_simulationHostStartNs + t);
+    sample.hostAfter = (uint64_t)(k_simulationHostStartNs + t + roundTrip);
+    return sample;
+}
+
+// Statistics of one simulated session
+struct SimulationReport
+{
+    uint64_t frames;
+    uint64_t unmapped;
+    uint64_t withinBound;
+    double errorP50Ns;
+    double errorP99Ns;
+    double errorMaxNs;
+    double boundMeanNs;
+    double firstLatchMaxErrorNs; // offset from the first latch only, no drift model
+    uint64_t counts[NUM_CLOCK_SAMPLE_RESULTS];
+};
+
+// Runs a session of durationS seconds with one latch per second and frames at
+// frameRate. Every frame is mapped with the fit as of the latest latch and
+// compared with its true host time.
+inline SimulationReport Simulate(const SimulatedCameraClock& clock, double durationS, double frameRate)
+{
+    SimulationReport report = SimulationReport();
+    ClockSyncConfig config;
+    ClockModel model(config);
+    SimulationRandom random(7);
+    std::vector<double> errors;
+    double boundSum = 0.0;
+    bool haveFirst = false;
+    double firstOffset = 0.0;
+    double nextLatch = 0.0;
+    const double framePeriod = 1e9 / frameRate;
+    for (double t = 0.0; t < durationS * 1e9; t += framePeriod)
+    {
+        while (nextLatch <= t)
+        {
+            const ClockSample sample = SimulateLatch(clock, random, nextLatch);
+            report.counts[model.AddSample(sample)]++;
+            if (!haveFirst)
+            {
+                firstOffset = (double)sample.hostBefore - (double)sample.deviceTimestamp;
+                haveFirst = true;
+            }
+            nextLatch += 1e9;
+        }
+        report.frames++;
+        const double device = floor(clock.DeviceAt(t));
+        const double truth = k_simulationHostStartNs + t;
+        const SyncedTimestamp synced = model.GetFit().Map((uint64_t)device, config);
+        if (!synced.valid)
+        {
+            report.unmapped++;
+            continue;
+        }
+        const double error = fabs((double)synced.monotonic - truth);
+        errors.push_back(error);
+        boundSum += (double)synced.errorNs;
+        if (error <= (double)synced.errorNs)
+        {
+            report.withinBound++;
+        }
+        if (clock.resetAtS == 0.0)
+        {
+            report.firstLatchMaxErrorNs = std::max(report.firstLatchMaxErrorNs, fabs(device + firstOffset - truth));
+        }
+    }
+    if (!errors.empty())
+    {
+        std::sort(errors.begin(), errors.end());
+        report.errorP50Ns = errors[errors.size() / 2];
+        report.errorP99Ns = errors[errors.size() * 99 / 100];
+        report.errorMaxNs = errors.back();
+        report.boundMeanNs = boundSum / errors.size();
+    }
+    return report;
+}
+
+// The simulated clocks of the bench: a steady one, a noisy one with wander,
+// slow latches and bad values, and one whose counter is reset halfway
+const SimulatedCameraClock k_simulatedClocks[] = {
+    {"steady", 5e9, 30.0, 0.0, 0.0, 40e3, 20e3, 0.0, 0.0, 0.0},
+    {"noisy", 120e9, -80.0, 1.0, 1200.0, 100e3, 150e3, 0.05, 0.01, 0.0},
+    {"reset", 5e9, 30.0, 0.0, 0.0, 40e3, 20e3, 0.0, 0.0, 1800.0},
+};
+const size_t k_numSimulatedClocks = sizeof(k_simulatedClocks) / sizeof(k_simulatedClocks[0]);
+
+#endif // DUAL_CAM_RECORDER_CLOCK_SIMULATION_H
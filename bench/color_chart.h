@@ -0,0 +1,182 @@
+/*
+ * @Descripttion: Synthetic color checker charts and their error measures, shared by the bench and tests targets
+ * @version:
+ * @Date: 2026-10-20 06:34:07
+ * @LastEditTime: 2026-10-20 06:34:07
+ */
+
+#ifndef DUAL_CAM_RECORDER_COLOR_CHART_H
+#define DUAL_CAM_RECORDER_COLOR_CHART_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "color_pipeline.h"
+
+// The 24 patches of a color checker in sRGB, row by row
+const uint8_t k_chartPatches[24][3] = {
+    {115, 82, 68},   {194, 150, 130}, {98, 122, 157},  {87, 108, 67},   {133, 128, 177}, {103, 189, 170},
+    {214, 126, 44},  {80, 91, 166},   {193, 90, 99},   {94, 60, 108},   {157, 188, 64},  {224, 163, 46},
+    {56, 61, 150},   {70, 148, 73},   {175, 54, 60},   {231, 199, 31},  {187, 86, 149},  {8, 133, 161},
+    {243, 243, 242}, {200, 200, 200}, {160, 160, 160}, {122, 122, 121}, {85, 85, 85},    {52, 52, 50}};
+
+// Gains that undo the cast the charts are captured with: the synthetic
+// sensor sees red and blue this much weaker than green
+const double k_chartWhiteBalance[3] = {1.8, 1.0, 1.5};
+
+// Pixels this close to the border are left out of the error measures, as
+// demosaicing has to mirror the pattern there
+const unsigned int k_chartMargin = 2;
+
+// The scene as packed RGB8: the color checker over the top two thirds, then
+// a hue ramp darkening towards the top on the left and gray rings, whose
+// edges in every direction are the hard case of demosaicing, on the right
+inline std::vector<uint8_t> MakeColorChart(unsigned int width, unsigned int height)
+{
+    std::vector<uint8_t> chart((size_t)width * height * 3);
+    const unsigned int patchRows = height * 2 / 3;
+    const double pi = 3.14159265358979;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            uint8_t* pixel = &chart[((size_t)y * width + x) * 3];
+            if (y < patchRows)
+            {
+                const unsigned int patch = (y * 4 / patchRows) * 6 + x * 6 / width;
+                for (int c = 0; c < 3; c++)
+                {
+                    pixel[c] = k_chartPatches[patch][c];
+                }
+            }
+            else if (x < width / 2)
+            {
+                const double hue = 2.0 * pi * x / (width / 2);
+                const double level = 0.3 + 0.7 * (y - patchRows) / (height - patchRows);
+                for (int c = 0; c < 3; c++)
+                {
+                    pixel[c] = (uint8_t)floor(level * (128.0 + 100.0 * sin(hue + c * 2.0 * pi / 3.0)) + 0.5);
+                }
+            }
+            else
+            {
+                const double dx = x - width * 3.0 / 4.0;
+                const double dy = y - (patchRows + height) / 2.0;
+                const uint8_t level = (uint8_t)floor(128.0 + 100.0 * cos(2.0 * pi * sqrt(dx * dx + dy * dy) / 16.0));
+                pixel[0] = pixel[1] = pixel[2] = level;
+            }
+        }
+    }
+    return chart;
+}
+
+// The chart as a BayerRG8 sensor with the color cast of k_chartWhiteBalance
+// captures it
+inline std::vector<uint8_t> MakeBayerChart(const std::vector<uint8_t>& chart, unsigned int width,
+                                           unsigned int height)
+{
+    std::vector<uint8_t> bayer((size_t)width * height);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            const int c = (x + y) & 1 ? 1 : (y & 1 ? 2 : 0);
+            const double sample = chart[((size_t)y * width + x) * 3 + c] / k_chartWhiteBalance[c];
+            bayer[(size_t)y * width + x] = (uint8_t)floor(sample + 0.5);
+        }
+    }
+    return bayer;
+}
+
+// Plain floating point bilinear demosaic and white balance into BGR8: the
+// site's own color is its sample, the others the mean of their samples among
+// the 8 neighbours. What the bilinear pipeline computes in fixed point,
+// written the obvious way.
+inline std::vector<uint8_t> DemosaicReference(const std::vector<uint8_t>& bayer, unsigned int width,
+                                              unsigned int height)
+{
+    std::vector<uint8_t> bgr((size_t)width * height * 3);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            const int own = (x + y) & 1 ? 1 : (y & 1 ? 2 : 0);
+            double sums[3] = {0.0, 0.0, 0.0};
+            int counts[3] = {0, 0, 0};
+            sums[own] = bayer[(size_t)y * width + x];
+            counts[own] = 1;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const int sy = ReflectBayer((int)y + dy, (int)height);
+                    const int sx = ReflectBayer((int)x + dx, (int)width);
+                    const int c = (sx + sy) & 1 ? 1 : (sy & 1 ? 2 : 0);
+                    if (c != own)
+                    {
+                        sums[c] += bayer[(size_t)sy * width + sx];
+                        counts[c]++;
+                    }
+                }
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                const double value = sums[c] / counts[c] * k_chartWhiteBalance[c];
+                bgr[((size_t)y * width + x) * 3 + 2 - c] = (uint8_t)std::min(255.0, floor(value + 0.5));
+            }
+        }
+    }
+    return bgr;
+}
+
+// Largest difference between two BGR8 frames away from the border
+inline int GetMaxDifference(const uint8_t* a, const uint8_t* b, unsigned int width, unsigned int height)
+{
+    int maxDifference = 0;
+    for (unsigned int y = k_chartMargin; y + k_chartMargin < height; y++)
+    {
+        for (size_t i = (size_t)k_chartMargin * 3; i < ((size_t)width - k_chartMargin) * 3; i++)
+        {
+            const size_t offset = (size_t)y * width * 3 + i;
+            maxDifference = std::max(maxDifference, abs((int)a[offset] - (int)b[offset]));
+        }
+    }
+    return maxDifference;
+}
+
+// PSNR of the converted frame against the chart away from the border: over
+// B, G and R for BGR8, over luma for YUV420
+inline double GetPsnr(const std::vector<uint8_t>& chart, ColorFrame& frame)
+{
+    double squares = 0.0;
+    size_t count = 0;
+    for (unsigned int y = k_chartMargin; y + k_chartMargin < frame.height; y++)
+    {
+        for (unsigned int x = k_chartMargin; x + k_chartMargin < frame.width; x++)
+        {
+            const uint8_t* truth = &chart[((size_t)y * frame.width + x) * 3];
+            if (frame.output == COLOR_OUTPUT_BGR8)
+            {
+                const uint8_t* bgr = &frame.data[(size_t)y * frame.stride + x * 3];
+                for (int c = 0; c < 3; c++)
+                {
+                    const double error = (double)bgr[2 - c] - truth[c];
+                    squares += error * error;
+                }
+                count += 3;
+            }
+            else
+            {
+                const double luma = 0.299 * truth[0] + 0.587 * truth[1] + 0.114 * truth[2];
+                const double error = frame.GetPlane(0)[(size_t)y * frame.stride + x] - luma;
+                squares += error * error;
+                count++;
+            }
+        }
+    }
+    return squares == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / (squares / count));
+}
+
+#endif // DUAL_CAM_RECORDER_COLOR_CHART_H
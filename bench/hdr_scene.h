@@ -0,0 +1,84 @@
+/*
+ * @Descripttion: Synthetic high dynamic range scene and its exposure brackets, shared by the bench and tests targets
+ * @version:
+ * @Date: 2026-10-20 07:02:11
+ * @LastEditTime: 2026-10-20 07:02:11
+ */
+
+#ifndef DUAL_CAM_RECORDER_HDR_SCENE_H
+#define DUAL_CAM_RECORDER_HDR_SCENE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "bench_common.h"
+#include "hdr_fusion.h"
+
+// Exposure times of the bracket cases in microseconds, longest first; the
+// cases use the first 2, 3 or 4 of them
+const double k_bracketExposuresUs[] = {16000.0, 4000.0, 1000.0, 250.0};
+
+// Scene radiance in gray levels of the longest exposure: the usual gradient
+// frame, with a sunlit region 40 times brighter on the right third and a
+// shadow 4 times darker at the bottom
+inline std::vector<float> MakeSyntheticRadiance(unsigned int width, unsigned int height)
+{
+    const std::vector<uint8_t> base = MakeSyntheticFrame8(width, height, 7);
+    std::vector<float> radiance(base.size());
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            float scale = 1.0f;
+            if (x > width * 2 / 3)
+            {
+                scale = 40.0f;
+            }
+            else if (y > height * 3 / 4)
+            {
+                scale = 0.25f;
+            }
+            radiance[(size_t)y * width + x] = (base[(size_t)y * width + x] + 8.0f) * scale;
+        }
+    }
+    return radiance;
+}
+
+// One exposure of the scene as the camera would deliver it: scaled by the
+// exposure ratio, with a little sensor noise, clipped to 8 bits
+inline std::vector<uint8_t> MakeExposure(const std::vector<float>& radiance, double ratio, uint32_t seed)
+{
+    std::vector<uint8_t> frame(radiance.size());
+    uint32_t state = seed * 2654435761u + 1;
+    for (size_t i = 0; i < radiance.size(); i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        const double noise = (int)(state >> 30) - 1.5;
+        frame[i] = (uint8_t)std::max(0.0, std::min(255.0, floor(radiance[i] * ratio + noise + 0.5)));
+    }
+    return frame;
+}
+
+// Median relative error of the fused radiance against the scene, over pixels
+// the bracket covers (not clipped in the shortest exposure)
+inline double GetMedianError(const std::vector<float>& radiance, const HdrFrame& frame, double maxGain)
+{
+    std::vector<double> errors;
+    for (size_t i = 0; i < radiance.size(); i += 7)
+    {
+        if (radiance[i] < 1.0f || radiance[i] / maxGain > 250.0)
+        {
+            continue;
+        }
+        errors.push_back(fabs(frame.radiance[i] / frame.radianceScale - radiance[i]) / radiance[i]);
+    }
+    if (errors.empty())
+    {
+        return 0.0;
+    }
+    std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+    return errors[errors.size() / 2];
+}
+
+#endif // DUAL_CAM_RECORDER_HDR_SCENE_H
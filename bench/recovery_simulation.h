@@ -0,0 +1,317 @@
+/*
+ * @Descripttion: Simulated bus of hot-pluggable cameras, shared by the bench and tests targets
+ * @version:
+ * @Date: 2026-10-20 06:21:18
+ * @LastEditTime: 2026-10-20 06:21:18
+ */
+
+#ifndef DUAL_CAM_RECORDER_RECOVERY_SIMULATION_H
+#define DUAL_CAM_RECORDER_RECOVERY_SIMULATION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "device_recovery.h"
+#include "time_utils.h"
+
+// Frame interval of the simulated cameras (200 fps)
+const unsigned int k_simulatedFrameUs = 5000;
+// What enumerating the bus and initializing a camera cost
+const unsigned int k_simulatedEnumerateUs = 5000;
+const unsigned int k_simulatedInitUs = 30000;
+// Recovery settings of the cases: the bus is searched every 20 ms, and a
+// camera that stays away is given up after the timeout
+const unsigned int k_simulatedRescanMs = 20;
+const unsigned int k_simulatedRecoveryTimeoutMs = 2000;
+const unsigned int k_simulatedGoneTimeoutMs = 300;
+
+// Longest a replugged camera may take to deliver a frame: the next rescan,
+// enumeration, initialization and one frame interval
+inline unsigned int GetSimulatedResumeBoundMs()
+{
+    return k_simulatedRescanMs + (k_simulatedEnumerateUs + k_simulatedInitUs + k_simulatedFrameUs) / 1000;
+}
+
+typedef std::map<std::string, std::string> NodeValues;
+
+// Node values of a camera that was just powered up, and the configuration
+// the recorder gave it
+inline NodeValues GetDefaultNodes()
+{
+    NodeValues nodes;
+    nodes["PixelFormat"] = "Mono8";
+    nodes["ExposureTime"] = "10000";
+    nodes["Gain"] = "0";
+    return nodes;
+}
+
+inline NodeValues GetConfiguredNodes()
+{
+    NodeValues nodes;
+    nodes["PixelFormat"] = "Mono12p";
+    nodes["ExposureTime"] = "2500";
+    nodes["Gain"] = "6";
+    return nodes;
+}
+
+// Cameras on a simulated bus, standing in for the Spinnaker calls of the
+// recorder's grab threads: GetNextImage fails once a camera is unplugged,
+// and a replugged camera must be found again, initialized and configured
+// before it streams. Its device timestamps restart from zero.
+class SimulatedBus
+{
+  public:
+    explicit SimulatedBus(unsigned int cameras) : m_cameras(cameras)
+    {
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            m_cameras[i].nodes = GetConfiguredNodes();
+        }
+    }
+
+    void Unplug(unsigned int camera)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cameras[camera].present = false;
+        m_cameras[camera].streaming = false;
+    }
+
+    void Plug(unsigned int camera)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cameras[camera] = Camera();
+        m_cameras[camera].streaming = false;
+        m_cameras[camera].nodes = GetDefaultNodes();
+    }
+
+    // Waits for the next frame. Returns -1 if there is none; removed then
+    // tells whether the camera is gone from the bus.
+    int Grab(unsigned int camera, uint64_t& deviceTimestamp, bool& removed)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(k_simulatedFrameUs));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Camera& state = m_cameras[camera];
+        if (!state.streaming)
+        {
+            removed = !state.present;
+            return -1;
+        }
+        state.timestamp += k_simulatedFrameUs * 1000ULL;
+        deviceTimestamp = state.timestamp;
+        return 0;
+    }
+
+    // ReacquireCamera() of the recorder
+    int Reacquire(unsigned int camera, const NodeValues& cachedConfig)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(k_simulatedEnumerateUs));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_cameras[camera].present)
+            {
+                return -1;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(k_simulatedInitUs));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cameras[camera].nodes = cachedConfig;
+        m_cameras[camera].streaming = true;
+        return 0;
+    }
+
+    NodeValues GetNodes(unsigned int camera)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_cameras[camera].nodes;
+    }
+
+  private:
+    struct Camera
+    {
+        bool present;
+        bool streaming;
+        uint64_t timestamp;
+        NodeValues nodes;
+
+        Camera() : present(true), streaming(true), timestamp(0)
+        {
+        }
+    };
+
+    std::mutex m_mutex;
+    std::vector<Camera> m_cameras;
+};
+
+// One camera's grab loop as in AcquireImages() with HOTPLUG_RECOVERY
+struct SimulatedGrabThread
+{
+    SimulatedBus* bus;
+    unsigned int camera;
+    DeviceRecovery* recovery;
+    NodeValues cachedConfig;
+    std::atomic<bool>* stop;
+    uint64_t frames;
+    uint64_t errors;
+    uint64_t lostNs;                         // when the first grab failed
+    std::atomic<uint64_t> firstFrameAfterNs; // when the first frame after recovery arrived
+    std::atomic<bool> givenUp;
+    uint64_t givenUpNs;
+
+    void Run()
+    {
+        uint64_t frameIndex = 0;
+        while (!stop->load())
+        {
+            uint64_t deviceTimestamp = 0;
+            bool removed = false;
+            if (bus->Grab(camera, deviceTimestamp, removed) == 0)
+            {
+                if (recovery->GetRecoveryCount() > 0 && firstFrameAfterNs == 0)
+                {
+                    firstFrameAfterNs = GetMonotonicNs();
+                }
+                recovery->OnFrame(frameIndex++, deviceTimestamp);
+                frames++;
+                continue;
+            }
+            errors++;
+            if (lostNs == 0)
+            {
+                lostNs = GetMonotonicNs();
+            }
+            if (recovery->OnGrabError(removed))
+            {
+                SimulatedGrabThread* self = this;
+                if (recovery->Recover([self]() { return self->bus->Reacquire(self->camera, self->cachedConfig); }) <
+                    0)
+                {
+                    givenUpNs = GetMonotonicNs();
+                    givenUp = true;
+                    return;
+                }
+            }
+        }
+    }
+};
+
+inline unsigned int CountGapLines(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return 0;
+    }
+    unsigned int lines = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        lines++;
+    }
+    fclose(file);
+    return lines > 0 ? lines - 1 : 0;
+}
+
+// What one outage of camera 1 did to both cameras
+struct RecoveryRun
+{
+    bool givenUp;
+    double recoveryMs;   // quarantine to acquiring again, or to giving up
+    double detectionMs;  // unplug to the first failed grab
+    double resumeMs;     // replug to the first new frame
+    bool configRestored; // camera 1 came back with its cached configuration
+    unsigned int gapLines;
+    uint64_t otherErrors; // grab errors of camera 0
+    double otherFps;
+
+    RecoveryRun()
+        : givenUp(false), recoveryMs(0.0), detectionMs(0.0), resumeMs(0.0), configRestored(false), gapLines(0),
+          otherErrors(0), otherFps(0.0)
+    {
+    }
+};
+
+// Two simulated cameras record; camera 1 is unplugged for outageMs and
+// plugged back in, or with outageMs 0 never comes back. Its gaps are written
+// to gapPath, which is removed afterwards.
+inline RecoveryRun SimulateOutage(const DeviceRecoveryConfig& config, unsigned int outageMs,
+                                  const std::string& gapPath)
+{
+    const bool gone = outageMs == 0;
+    SimulatedBus bus(2);
+    std::atomic<bool> stop(false);
+    std::unique_ptr<DeviceRecovery> recoveries[2];
+    SimulatedGrabThread grabs[2];
+    std::thread threads[2];
+    const uint64_t start = GetMonotonicNs();
+    for (unsigned int c = 0; c < 2; c++)
+    {
+        recoveries[c].reset(new DeviceRecovery(config, c == 0 ? "sim0" : "sim1", c == 1 ? gapPath : ""));
+        SimulatedGrabThread& grab = grabs[c];
+        grab.bus = &bus;
+        grab.camera = c;
+        grab.recovery = recoveries[c].get();
+        grab.cachedConfig = GetConfiguredNodes();
+        grab.stop = &stop;
+        grab.frames = 0;
+        grab.errors = 0;
+        grab.lostNs = 0;
+        grab.firstFrameAfterNs = 0;
+        grab.givenUp = false;
+        grab.givenUpNs = 0;
+        threads[c] = std::thread(&SimulatedGrabThread::Run, &grab);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t unplugNs = GetMonotonicNs();
+    bus.Unplug(1);
+    uint64_t plugNs = 0;
+    if (gone)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(config.reacquireTimeoutMs + 100));
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(outageMs));
+        plugNs = GetMonotonicNs();
+        bus.Plug(1);
+        // Until camera 1 records again, bounded by the timeout
+        while (grabs[1].firstFrameAfterNs == 0 && !grabs[1].givenUp &&
+               GetMonotonicNs() - plugNs < config.reacquireTimeoutMs * 1000000ULL)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    stop = true;
+    threads[0].join();
+    threads[1].join();
+    const uint64_t end = GetMonotonicNs();
+    recoveries[1]->Finish();
+
+    RecoveryRun run;
+    run.otherErrors = grabs[0].errors;
+    run.otherFps = grabs[0].frames / ((end - start) / 1e9);
+    run.detectionMs = grabs[1].lostNs > unplugNs ? (grabs[1].lostNs - unplugNs) / 1e6 : 0.0;
+    run.givenUp = grabs[1].givenUp;
+    if (run.givenUp)
+    {
+        run.recoveryMs = (grabs[1].givenUpNs - grabs[1].lostNs) / 1e6;
+    }
+    else
+    {
+        run.recoveryMs = recoveries[1]->GetLastRecoveryNs() / 1e6;
+        run.resumeMs = grabs[1].firstFrameAfterNs > plugNs ? (grabs[1].firstFrameAfterNs - plugNs) / 1e6 : 0.0;
+        run.configRestored = bus.GetNodes(1) == GetConfiguredNodes();
+    }
+    run.gapLines = CountGapLines(gapPath);
+    remove(gapPath.c_str());
+    return run;
+}
+
+#endif // DUAL_CAM_RECORDER_RECOVERY_SIMULATION_H
@@ -0,0 +1,135 @@
+/*
+ * @Descripttion: Simulated slow writer behind a load shedder, shared by the bench and tests targets
+ * @version:
+ * @Date: 2026-10-20 05:58:40
+ * @LastEditTime: 2026-10-20 05:58:40
+ */
+
+#ifndef DUAL_CAM_RECORDER_SHEDDING_SIMULATION_H
+#define DUAL_CAM_RECORDER_SHEDDING_SIMULATION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include "load_shedder.h"
+
+// Synthetic session: 200 fps into a queue of 64 frames, a writer needing
+// 3 ms per frame (60 % load), 10 ms (200 %) during the slow phase
+const uint64_t k_shedPeriodNs = 5000000ULL;
+const size_t k_shedQueueCapacity = 64;
+const uint64_t k_shedFastCostNs = 3000000ULL;
+const uint64_t k_shedSlowCostNs = 10000000ULL;
+const uint64_t k_shedSlowStartNs = 2000000000ULL;
+const uint64_t k_shedSlowEndNs = 6000000000ULL;
+const uint64_t k_shedSessionNs = 12000000000ULL;
+
+// Writer cost of a frame at a shedding level: a lower JPEG quality saves
+// about a fifth of the encode, binning leaves a quarter of the pixels
+inline uint64_t GetShedWriteCost(uint64_t cost, const LoadShedder& shedder)
+{
+    if (shedder.UseBinning())
+    {
+        return cost * 3 / 10;
+    }
+    if (shedder.GetJpegQuality(75) < 75)
+    {
+        return cost * 8 / 10;
+    }
+    return cost;
+}
+
+struct ShedSimulation
+{
+    uint64_t frames;
+    uint64_t written;
+    uint64_t shed;
+    uint64_t shedBeforeSlow; // of them, before the slow phase began
+    uint64_t queueFull;
+    uint64_t maxLatencyNs;
+    sheddingLevel maxLevel;
+    uint64_t firstShedNs;   // first escalation after the slow phase began
+    uint64_t recoveredNs;   // back to SHEDDING_NONE after the slow phase ended
+    std::string levels;
+
+    ShedSimulation()
+        : frames(0), written(0), shed(0), shedBeforeSlow(0), queueFull(0), maxLatencyNs(0), maxLevel(SHEDDING_NONE),
+          firstShedNs(0), recoveredNs(0)
+    {
+    }
+};
+
+// Replays the session in simulated time, so the result does not depend on
+// the machine: the writer completes frames in order, each one reporting its
+// latency, and the grab side observes the queue and admits every new frame.
+inline ShedSimulation SimulateSlowWriter(const LoadShedderConfig& config)
+{
+    struct QueuedFrame
+    {
+        uint64_t arrivalNs;
+        uint64_t costNs;
+    };
+    ShedSimulation simulation;
+    LoadShedder shedder(config, "synthetic");
+    std::deque<QueuedFrame> queue;
+    uint64_t writerFreeNs = 0;
+    sheddingLevel level = SHEDDING_NONE;
+    // Simulated time starts at 1 s; zero marks an unset time in the shedder
+    const uint64_t origin = 1000000000ULL;
+    for (uint64_t t = 0; t < k_shedSessionNs; t += k_shedPeriodNs)
+    {
+        const uint64_t now = origin + t;
+        while (!queue.empty())
+        {
+            const uint64_t done = std::max(writerFreeNs, queue.front().arrivalNs) + queue.front().costNs;
+            if (done > now)
+            {
+                break;
+            }
+            const uint64_t latencyNs = done - queue.front().arrivalNs;
+            shedder.ReportLatency(latencyNs, done);
+            simulation.maxLatencyNs = std::max(simulation.maxLatencyNs, latencyNs);
+            simulation.written++;
+            writerFreeNs = done;
+            queue.pop_front();
+        }
+
+        simulation.frames++;
+        shedder.Observe((double)queue.size() / k_shedQueueCapacity, now);
+        if (shedder.GetLevel() != level)
+        {
+            char change[64];
+            snprintf(change, sizeof(change), "%s%s@%.2fs", simulation.levels.empty() ? "" : " ",
+                     GetSheddingLevelName(shedder.GetLevel()), t / 1e9);
+            simulation.levels += change;
+            if (level == SHEDDING_NONE && simulation.firstShedNs == 0 && t >= k_shedSlowStartNs)
+            {
+                simulation.firstShedNs = t - k_shedSlowStartNs;
+            }
+            level = shedder.GetLevel();
+            simulation.maxLevel = std::max(simulation.maxLevel, level);
+            if (level == SHEDDING_NONE && t >= k_shedSlowEndNs)
+            {
+                simulation.recoveredNs = t - k_shedSlowEndNs;
+            }
+        }
+        if (!shedder.Admit(simulation.frames - 1))
+        {
+            simulation.shed++;
+            simulation.shedBeforeSlow += t < k_shedSlowStartNs;
+            continue;
+        }
+        if (queue.size() >= k_shedQueueCapacity)
+        {
+            simulation.queueFull++;
+            continue;
+        }
+        const bool slow = t >= k_shedSlowStartNs && t < k_shedSlowEndNs;
+        QueuedFrame frame = {now, GetShedWriteCost(slow ? k_shedSlowCostNs : k_shedFastCostNs, shedder)};
+        queue.push_back(frame);
+    }
+    return simulation;
+}
+
+#endif // DUAL_CAM_RECORDER_SHEDDING_SIMULATION_H
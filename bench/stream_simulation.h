@@ -0,0 +1,158 @@
+/*
+ * @Descripttion: Simulated transport-layer counters with link episodes, shared by the bench and tests targets
+ * @version:
+ * @Date: 2026-10-20 06:47:25
+ * @LastEditTime: 2026-10-20 06:47:25
+ */
+
+#ifndef DUAL_CAM_RECORDER_STREAM_SIMULATION_H
+#define DUAL_CAM_RECORDER_STREAM_SIMULATION_H
+
+#include <stdint.h>
+#include <string.h>
+#include "stream_diagnostics.h"
+
+// What a simulated link goes through for one interval. Clean intervals
+// still see a few resends that arrive in time, as real links do.
+enum linkEpisode
+{
+    EPISODE_CLEAN,
+    EPISODE_UNDERRUN,
+    EPISODE_SATURATION,
+    EPISODE_PACKET_LOSS,
+    EPISODE_LATE_RESENDS,
+    NUM_LINK_EPISODES
+};
+
+// The cause each episode must be attributed to
+const streamCause k_episodeCauses[NUM_LINK_EPISODES] = {STREAM_CAUSE_UNKNOWN, STREAM_CAUSE_BUFFER_UNDERRUN,
+                                                        STREAM_CAUSE_LINK_SATURATION, STREAM_CAUSE_PACKET_LOSS,
+                                                        STREAM_CAUSE_RESENDS};
+
+// A GigE link of 125 MB/s with the camera limited to 110 MB/s
+const double k_simulatedLinkLimit = 110e6;
+
+// Simulated hour of readings at 1 s intervals
+const unsigned int k_simulatedIntervals = 3600;
+
+// xorshift, so every run sees the same episodes
+struct EpisodeRandom
+{
+    uint32_t state;
+
+    explicit EpisodeRandom(uint32_t seed) : state(seed * 2654435761u + 1)
+    {
+    }
+
+    uint32_t Next(uint32_t range)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state % range;
+    }
+};
+
+// Counters of one simulated camera, advanced one interval at a time. A
+// transport layer without resend statistics (USB3) leaves them missing.
+struct SimulatedStream
+{
+    StreamSample sample;
+    EpisodeRandom random;
+
+    SimulatedStream(bool resendCounters, uint32_t seed) : random(seed)
+    {
+        sample.counters[STREAM_LOST_PACKETS] = 0;
+        sample.counters[STREAM_BUFFER_UNDERRUNS] = 0;
+        sample.counters[STREAM_DROPPED_FRAMES] = 0;
+        if (resendCounters)
+        {
+            sample.counters[STREAM_RESEND_REQUESTS] = 0;
+            sample.counters[STREAM_RESENT_PACKETS] = 0;
+        }
+        sample.linkThroughputLimit = k_simulatedLinkLimit;
+    }
+
+    // Advances the counters by one interval of the episode; returns the
+    // incomplete frames the frame path sees
+    uint64_t Advance(linkEpisode episode)
+    {
+        sample.hostNs += 1000000000ULL;
+        sample.linkThroughput = k_simulatedLinkLimit * (0.6 + random.Next(30) / 100.0);
+        int64_t resends = random.Next(4) == 0 ? 1 + random.Next(20) : 0;
+        uint64_t incomplete = 0;
+        switch (episode)
+        {
+        case EPISODE_UNDERRUN:
+            sample.counters[STREAM_BUFFER_UNDERRUNS] += 1 + random.Next(5);
+            sample.counters[STREAM_DROPPED_FRAMES] += random.Next(3);
+            incomplete = 1 + random.Next(5);
+            break;
+        case EPISODE_SATURATION:
+            sample.linkThroughput = k_simulatedLinkLimit * (0.96 + random.Next(4) / 100.0);
+            sample.counters[STREAM_LOST_PACKETS] += 10 + random.Next(200);
+            resends += 100 + random.Next(400);
+            incomplete = 1 + random.Next(10);
+            break;
+        case EPISODE_PACKET_LOSS:
+            sample.counters[STREAM_LOST_PACKETS] += 1 + random.Next(50);
+            resends += 10 + random.Next(100);
+            incomplete = 1 + random.Next(5);
+            break;
+        case EPISODE_LATE_RESENDS:
+            resends += 50 + random.Next(200);
+            incomplete = 1 + random.Next(3);
+            break;
+        default:
+            break;
+        }
+        if (sample.counters[STREAM_RESEND_REQUESTS] >= 0)
+        {
+            sample.counters[STREAM_RESEND_REQUESTS] += resends;
+            sample.counters[STREAM_RESENT_PACKETS] += resends * 4;
+        }
+        return incomplete;
+    }
+};
+
+// Outcome of a simulated hour: per episode, how often each cause was given
+struct AttributionRun
+{
+    uint64_t episodes; // intervals that went through an episode
+    uint64_t correct;  // of them, attributed to the episode's cause
+    uint64_t causes[NUM_LINK_EPISODES][NUM_STREAM_CAUSES];
+
+    AttributionRun() : episodes(0), correct(0)
+    {
+        memset(causes, 0, sizeof(causes));
+    }
+};
+
+// A simulated hour of readings at 1 s intervals, one interval in ten going
+// through an episode of incomplete frames, analysed by a StreamModel
+inline AttributionRun SimulateAttribution(bool resendCounters)
+{
+    SimulatedStream stream(resendCounters, 7);
+    EpisodeRandom schedule(11);
+    StreamModel model(StreamDiagnosticsConfig().saturationRatio);
+    StreamInterval interval;
+    model.AddSample(stream.sample, 0, interval);
+    AttributionRun run;
+    for (unsigned int i = 0; i < k_simulatedIntervals; i++)
+    {
+        const linkEpisode episode =
+            schedule.Next(10) == 0 ? (linkEpisode)(1 + schedule.Next(NUM_LINK_EPISODES - 1)) : EPISODE_CLEAN;
+        const uint64_t incomplete = stream.Advance(episode);
+        model.AddSample(stream.sample, incomplete, interval);
+        if (episode == EPISODE_CLEAN)
+        {
+            continue;
+        }
+        run.episodes++;
+        run.causes[episode][interval.cause]++;
+        run.correct += interval.cause == k_episodeCauses[episode];
+    }
+    return run;
+}
+
+#endif // DUAL_CAM_RECORDER_STREAM_SIMULATION_H
@@ -0,0 +1,536 @@
+/*
+ * @Descripttion: Capture daemon keeping cameras initialized, and its command line client
+ * @version:
+ * @Date: 2026-10-19 23:24:17
+ * @LastEditTime: 2026-10-19 23:24:17
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Spinnaker.h"
+#include "SpinGenApi/SpinnakerGenApi.h"
+#include "async_logger.h"
+#include "capture_daemon.h"
+#include "capture_protocol.h"
+#include "time_utils.h"
+
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace Spinnaker::GenICam;
+using namespace std;
+
+// Command line of the daemon and of its client commands
+struct DaemonOptions
+{
+    string command;
+    string socketPath;
+    string outputPath;      // serve: parent of the session directories; snapshot: PGM file to write
+    unsigned int synthetic; // serve: run this many synthetic cameras instead of Spinnaker cameras
+    uint32_t cameraMask;    // 0 for every camera
+    unsigned int camera;    // snapshot
+    uint32_t frames;        // start: frames per camera, 0 until stop
+    unsigned int timeoutMs; // snapshot
+    vector<pair<captureParameter, double> > parameters;
+
+    DaemonOptions()
+        : socketPath(CaptureDaemonConfig().socketPath), synthetic(0), cameraMask(k_captureAllCameras), camera(0),
+          frames(0), timeoutMs(1000)
+    {
+    }
+};
+
+// Frames of synthetic cameras
+const unsigned int k_syntheticWidth = 1440;
+const unsigned int k_syntheticHeight = 1080;
+const double k_syntheticFrameRate = 30.0;
+
+// This function prints the usage of the daemon.
+void PrintUsage()
+{
+    cout << "Usage: capture_daemon <command> [options]" << endl
+         << "  serve [--out=<dir>] [--synthetic=<n>]    keep the cameras streaming and serve commands" << endl
+         << "  status                                    state and counters of every camera" << endl
+         << "  start [--cameras=<mask>] [--frames=<n>]  record into a new session directory of <dir>" << endl
+         << "  stop [--cameras=<mask>]                  stop recording; the session closes with the last camera"
+         << endl
+         << "  snapshot [--camera=<i>] [--out=<file>]   next frame of a camera, written as PGM if Mono8" << endl
+         << "           [--timeout-ms=<ms>]" << endl
+         << "  reconfigure [--cameras=<mask>] [--exposure-us=<us>] [--gain-db=<dB>] [--fps=<rate>]" << endl
+         << "Every command takes [--socket=<path>]; a camera mask of 0 selects every camera." << endl;
+}
+
+// This function parses the command line. Returns -1 on a usage error.
+int ParseOptions(int argc, char** argv, DaemonOptions& options)
+{
+    if (argc < 2)
+    {
+        return -1;
+    }
+    options.command = argv[1];
+    for (int i = 2; i < argc; i++)
+    {
+        const string arg = argv[i];
+        const size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || equals == string::npos)
+        {
+            return -1;
+        }
+        const string key = arg.substr(2, equals - 2);
+        const string value = arg.substr(equals + 1);
+        if (key == "socket")
+        {
+            options.socketPath = value;
+        }
+        else if (key == "out")
+        {
+            options.outputPath = value;
+        }
+        else if (key == "synthetic")
+        {
+            options.synthetic = (unsigned int)atoi(value.c_str());
+        }
+        else if (key == "cameras")
+        {
+            options.cameraMask = (uint32_t)strtoul(value.c_str(), nullptr, 0);
+        }
+        else if (key == "camera")
+        {
+            options.camera = (unsigned int)atoi(value.c_str());
+        }
+        else if (key == "frames")
+        {
+            options.frames = (uint32_t)strtoul(value.c_str(), nullptr, 0);
+        }
+        else if (key == "timeout-ms")
+        {
+            options.timeoutMs = (unsigned int)atoi(value.c_str());
+        }
+        else if (key == "exposure-us")
+        {
+            options.parameters.push_back(make_pair(CAPTURE_PARAM_EXPOSURE_US, atof(value.c_str())));
+        }
+        else if (key == "gain-db")
+        {
+            options.parameters.push_back(make_pair(CAPTURE_PARAM_GAIN_DB, atof(value.c_str())));
+        }
+        else if (key == "fps")
+        {
+            options.parameters.push_back(make_pair(CAPTURE_PARAM_FRAME_RATE, atof(value.c_str())));
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Spinnaker camera kept initialized by the daemon. Parameters are written to
+// the GenICam nodes while the camera streams, turning off the matching auto
+// function first.
+class SpinnakerCaptureCamera : public CaptureCamera
+{
+  public:
+    explicit SpinnakerCaptureCamera(CameraPtr cam) : m_cam(cam), m_acquiring(false)
+    {
+        CStringPtr ptrStringSerial = m_cam->GetTLDeviceNodeMap().GetNode("DeviceSerialNumber");
+        if (IsAvailable(ptrStringSerial) && IsReadable(ptrStringSerial))
+        {
+            m_serialNumber = ptrStringSerial->GetValue();
+        }
+    }
+
+    ~SpinnakerCaptureCamera()
+    {
+        try
+        {
+            EndAcquisition();
+            m_cam->DeInit();
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            cout << "[" << m_serialNumber << "] Error: " << e.what() << endl;
+        }
+    }
+
+    // This function initializes the camera for continuous acquisition.
+    int Initialize()
+    {
+        try
+        {
+            m_cam->Init();
+            CEnumerationPtr ptrAcquisitionMode = m_cam->GetNodeMap().GetNode("AcquisitionMode");
+            if (!IsAvailable(ptrAcquisitionMode) || !IsWritable(ptrAcquisitionMode))
+            {
+                cout << "[" << m_serialNumber << "] Unable to set acquisition mode to continuous..." << endl;
+                return -1;
+            }
+            CEnumEntryPtr ptrContinuous = ptrAcquisitionMode->GetEntryByName("Continuous");
+            if (!IsAvailable(ptrContinuous) || !IsReadable(ptrContinuous))
+            {
+                cout << "[" << m_serialNumber << "] Unable to set acquisition mode to continuous..." << endl;
+                return -1;
+            }
+            ptrAcquisitionMode->SetIntValue(ptrContinuous->GetValue());
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            cout << "[" << m_serialNumber << "] Error: " << e.what() << endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    string GetSerialNumber() const
+    {
+        return m_serialNumber;
+    }
+
+    int SetParameter(captureParameter parameter, double value)
+    {
+        if (parameter < CAPTURE_PARAM_EXPOSURE_US || parameter >= NUM_CAPTURE_PARAMS)
+        {
+            return -1;
+        }
+        const char* autoNode = parameter == CAPTURE_PARAM_EXPOSURE_US ? "ExposureAuto"
+                               : parameter == CAPTURE_PARAM_GAIN_DB   ? "GainAuto"
+                                                                      : nullptr;
+        try
+        {
+            INodeMap& nodeMap = m_cam->GetNodeMap();
+            if (autoNode != nullptr)
+            {
+                CEnumerationPtr ptrAuto = nodeMap.GetNode(autoNode);
+                if (IsAvailable(ptrAuto) && IsWritable(ptrAuto))
+                {
+                    CEnumEntryPtr ptrOff = ptrAuto->GetEntryByName("Off");
+                    if (IsAvailable(ptrOff) && IsReadable(ptrOff))
+                    {
+                        ptrAuto->SetIntValue(ptrOff->GetValue());
+                    }
+                }
+            }
+            else if (parameter == CAPTURE_PARAM_FRAME_RATE)
+            {
+                CBooleanPtr ptrEnable = nodeMap.GetNode("AcquisitionFrameRateEnable");
+                if (IsAvailable(ptrEnable) && IsWritable(ptrEnable))
+                {
+                    ptrEnable->SetValue(true);
+                }
+            }
+            CFloatPtr ptrValue = nodeMap.GetNode(GetNodeName(parameter));
+            if (!IsAvailable(ptrValue) || !IsWritable(ptrValue) || value < ptrValue->GetMin() ||
+                value > ptrValue->GetMax())
+            {
+                return -1;
+            }
+            ptrValue->SetValue(value);
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "[{}] Error: {}", m_serialNumber, e.what());
+            return -1;
+        }
+        return 0;
+    }
+
+    double GetParameter(captureParameter parameter)
+    {
+        try
+        {
+            CFloatPtr ptrValue = m_cam->GetNodeMap().GetNode(GetNodeName(parameter));
+            return IsAvailable(ptrValue) && IsReadable(ptrValue) ? ptrValue->GetValue() : 0.0;
+        }
+        catch (Spinnaker::Exception&)
+        {
+            return 0.0;
+        }
+    }
+
+    int BeginAcquisition()
+    {
+        try
+        {
+            m_cam->BeginAcquisition();
+            m_acquiring = true;
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            cout << "[" << m_serialNumber << "] Error: " << e.what() << endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    void EndAcquisition()
+    {
+        if (m_acquiring)
+        {
+            m_acquiring = false;
+            m_cam->EndAcquisition();
+        }
+    }
+
+    int Grab(unsigned int timeoutMs, CaptureFrame& frame)
+    {
+        try
+        {
+            ImagePtr image = m_cam->GetNextImage(timeoutMs);
+            const uint64_t hostTimestamp = GetMonotonicNs();
+            if (image->IsIncomplete())
+            {
+                ASYNC_LOG_RATE_LIMITED_BY(m_incompleteLog, SEVERITY_WARNING, 1000,
+                                          "[{}] Image incomplete with image status {}...", m_serialNumber,
+                                          image->GetImageStatus());
+                image->Release();
+                return 0;
+            }
+            m_image = image;
+            frame.data = (const uint8_t*)image->GetData();
+            frame.size = image->GetImageSize();
+            frame.width = (uint32_t)image->GetWidth();
+            frame.height = (uint32_t)image->GetHeight();
+            frame.pixelFormat = (uint32_t)image->GetPixelFormat();
+            frame.packing = GetPixelPacking(image->GetPixelFormat());
+            frame.frameIndex = image->GetFrameID();
+            frame.deviceTimestamp = image->GetTimeStamp();
+            frame.hostTimestamp = hostTimestamp;
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            // GetNextImage reports a timeout as an exception too
+            return e.GetError() == SPINNAKER_ERR_TIMEOUT ? 0 : -1;
+        }
+        return 1;
+    }
+
+    void Release(CaptureFrame&)
+    {
+        m_image->Release();
+    }
+
+  private:
+    static const char* GetNodeName(captureParameter parameter)
+    {
+        return parameter == CAPTURE_PARAM_EXPOSURE_US ? "ExposureTime"
+               : parameter == CAPTURE_PARAM_GAIN_DB   ? "Gain"
+                                                      : "AcquisitionFrameRate";
+    }
+
+    // This function returns how a pixel format is packed, or PACKING_NONE if
+    // its samples are whole bytes.
+    static pixelPacking GetPixelPacking(PixelFormatEnums format)
+    {
+        switch (format)
+        {
+        case PixelFormat_Mono10p:
+            return PACKING_10P;
+        case PixelFormat_Mono12p:
+        case PixelFormat_BayerRG12p:
+            return PACKING_12P;
+        case PixelFormat_Mono12Packed:
+        case PixelFormat_BayerRG12Packed:
+            return PACKING_12PACKED;
+        default:
+            return PACKING_NONE;
+        }
+    }
+
+    CameraPtr m_cam;
+    string m_serialNumber;
+    bool m_acquiring;
+    ImagePtr m_image;
+    LogRateLimiter m_incompleteLog; // rate limit of this camera's incomplete images
+};
+
+// This function writes a Mono8 snapshot as a binary PGM.
+int WriteSnapshotPgm(const CaptureSnapshot& snapshot, const string& path)
+{
+    if (snapshot.pixels.size() != (size_t)snapshot.width * snapshot.height)
+    {
+        cout << "Snapshot is not 8 bits per pixel, not written" << endl;
+        return -1;
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        cout << "Unable to create " << path << endl;
+        return -1;
+    }
+    fprintf(file, "P5\n%u %u\n255\n", snapshot.width, snapshot.height);
+    const bool ok = fwrite(&snapshot.pixels[0], 1, snapshot.pixels.size(), file) == snapshot.pixels.size();
+    return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+// This function prints camera statuses returned by the daemon.
+void PrintStatuses(const vector<CaptureCameraStatus>& statuses)
+{
+    for (size_t i = 0; i < statuses.size(); i++)
+    {
+        const CaptureCameraStatus& status = statuses[i];
+        cout << i << " [" << status.serialNumber << "] " << (status.recording ? "recording" : "idle") << ", "
+             << status.framesGrabbed << " grabbed, " << status.framesRecorded << " recorded, "
+             << status.framesDropped << " dropped";
+        if (status.firstFrameLatencyNs > 0)
+        {
+            cout << ", first frame " << status.firstFrameLatencyNs / 1e6 << " ms after start";
+        }
+        cout << ", exposure " << status.exposureUs << " us, gain " << status.gainDb << " dB, " << status.frameRate
+             << " fps" << endl;
+    }
+}
+
+// This function sends one client command to the daemon and prints the reply.
+int RunClient(const DaemonOptions& options)
+{
+    CaptureClient client;
+    if (client.Connect(options.socketPath) < 0)
+    {
+        cout << "Unable to connect to " << options.socketPath << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    vector<CaptureCameraStatus> statuses;
+    CaptureSnapshot snapshot;
+    const uint64_t sentNs = GetMonotonicNs();
+    int status;
+    if (options.command == "status")
+    {
+        status = client.Status(statuses);
+    }
+    else if (options.command == "start")
+    {
+        status = client.Start(options.cameraMask, options.frames, statuses);
+    }
+    else if (options.command == "stop")
+    {
+        status = client.Stop(options.cameraMask, statuses);
+    }
+    else if (options.command == "snapshot")
+    {
+        status = client.Snapshot(options.camera, options.timeoutMs, snapshot);
+    }
+    else if (options.command == "reconfigure")
+    {
+        status = client.Reconfigure(options.cameraMask, options.parameters, statuses);
+    }
+    else
+    {
+        PrintUsage();
+        return -1;
+    }
+    const double roundTripMs = (GetMonotonicNs() - sentNs) / 1e6;
+    if (status < 0)
+    {
+        cout << "Connection to the daemon lost" << endl;
+        return -1;
+    }
+    cout << options.command << ": " << GetCaptureStatusName((unsigned int)status) << " in " << roundTripMs << " ms"
+         << endl;
+    PrintStatuses(statuses);
+    if (options.command == "snapshot" && status == CAPTURE_OK)
+    {
+        cout << "Frame " << snapshot.frameIndex << ", " << snapshot.width << "x" << snapshot.height << ", "
+             << snapshot.latencyNs / 1e6 << " ms after the command arrived" << endl;
+        if (!options.outputPath.empty() && WriteSnapshotPgm(snapshot, options.outputPath) < 0)
+        {
+            return -1;
+        }
+    }
+    return status == CAPTURE_OK ? 0 : -1;
+}
+
+// This function runs the daemon until SIGINT or SIGTERM.
+int RunDaemon(const DaemonOptions& options)
+{
+    // Taken by sigwait() below; blocked before any thread starts so none of them gets it
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    SystemPtr system;
+    CameraList camList;
+    vector<unique_ptr<CaptureCamera> > cameras;
+    if (options.synthetic > 0)
+    {
+        for (unsigned int i = 0; i < options.synthetic; i++)
+        {
+            cameras.push_back(unique_ptr<CaptureCamera>(new SyntheticCamera(
+                "synthetic" + to_string(i), k_syntheticWidth, k_syntheticHeight, k_syntheticFrameRate,
+                PixelFormat_Mono8)));
+        }
+    }
+    else
+    {
+        system = System::GetInstance();
+        camList = system->GetCameras();
+        cout << "Number of cameras detected: " << camList.GetSize() << endl;
+        for (unsigned int i = 0; i < camList.GetSize(); i++)
+        {
+            unique_ptr<SpinnakerCaptureCamera> camera(new SpinnakerCaptureCamera(camList.GetByIndex(i)));
+            if (camera->Initialize() == 0)
+            {
+                cameras.push_back(unique_ptr<CaptureCamera>(camera.release()));
+            }
+        }
+    }
+    int result = 0;
+    if (cameras.empty())
+    {
+        cout << "Not enough cameras!" << endl;
+        result = -1;
+    }
+    else
+    {
+        CaptureDaemonConfig config;
+        config.socketPath = options.socketPath;
+        config.storage.directory = options.outputPath.empty() ? "." : options.outputPath;
+        CaptureDaemon daemon(config, cameras);
+        if (daemon.Start() < 0)
+        {
+            cout << "Unable to start the daemon on " << config.socketPath << endl;
+            result = -1;
+        }
+        else
+        {
+            cout << daemon.GetCameraCount() << " cameras streaming, listening on " << config.socketPath << endl;
+            int signal = 0;
+            sigwait(&signals, &signal);
+            cout << "Stopping..." << endl;
+            daemon.Stop();
+        }
+    }
+    AsyncLogger::Instance().Shutdown();
+    // Cameras hold references into the camera list
+    cameras.clear();
+    if (options.synthetic == 0)
+    {
+        camList.Clear();
+        system->ReleaseInstance();
+    }
+    return result;
+}
+
+// 常驻采集服务：相机保持初始化，通过Unix套接字接收开始、停止、抓拍和重新配置命令
+int main(int argc, char** argv)
+{
+    DaemonOptions options;
+    if (ParseOptions(argc, argv, options) < 0)
+    {
+        PrintUsage();
+        return -1;
+    }
+    if (options.command == "serve")
+    {
+        return RunDaemon(options);
+    }
+    return RunClient(options);
+}
@@ -0,0 +1,544 @@
+/*
+ * @Descripttion: Asynchronous logger with per-thread lock-free buffers for the grab hot path
+ * @version:
+ * @Date: 2026-10-19 13:02:44
+ * @LastEditTime: 2026-10-19 13:02:44
+ */
+
+#ifndef DUAL_CAM_RECORDER_ASYNC_LOGGER_H
+#define DUAL_CAM_RECORDER_ASYNC_LOGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "time_utils.h"
+
+// Severity of a log message; messages below the configured minimum are
+// rejected with a single relaxed load before any argument is touched
+enum logSeverity
+{
+    SEVERITY_DEBUG,
+    SEVERITY_INFO,
+    SEVERITY_WARNING,
+    SEVERITY_ERROR
+};
+
+// One message as written by the logging thread: the format string pointer
+// (always a literal), a timestamp and the raw argument values. Formatting to
+// text happens on the background thread.
+struct LogRecord
+{
+    static const unsigned int k_maxArgs = 8;
+    static const unsigned int k_payloadSize = 176;
+
+    enum argType
+    {
+        ARG_INT,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_STRING
+    };
+
+    uint64_t timestamp; // ns, CLOCK_REALTIME
+    const char* format; // "{}" marks each argument
+    uint32_t suppressed; // similar messages dropped by a rate limit before this one
+    uint8_t severity;
+    uint8_t numArgs;
+    uint8_t argTypes[k_maxArgs];
+    uint16_t payloadUsed;
+    char payload[k_payloadSize];
+};
+
+// Single-producer single-consumer ring of records owned by one logging
+// thread. The producer never blocks or locks: a full ring drops the message
+// and counts it.
+class LogThreadBuffer
+{
+  public:
+    static const size_t k_capacity = 1024; // power of two
+
+    LogThreadBuffer() : m_records(k_capacity), m_head(0), m_tail(0), m_dropped(0), m_retired(false)
+    {
+    }
+
+    // Producer side: returns a slot to fill, or nullptr if the ring is full
+    LogRecord* Reserve()
+    {
+        const uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= k_capacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &m_records[head & (k_capacity - 1)];
+    }
+
+    void Commit()
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side: records in [tail, head) are ready
+    uint64_t GetTail() const
+    {
+        return m_tail.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetHead() const
+    {
+        return m_head.load(std::memory_order_acquire);
+    }
+
+    const LogRecord& At(uint64_t index) const
+    {
+        return m_records[index & (k_capacity - 1)];
+    }
+
+    void Release(uint64_t newTail)
+    {
+        m_tail.store(newTail, std::memory_order_release);
+    }
+
+    uint64_t TakeDropped()
+    {
+        return m_dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    // Set when the owning thread exits; the buffer is freed once drained
+    void Retire()
+    {
+        m_retired.store(true, std::memory_order_release);
+    }
+
+    bool IsRetired() const
+    {
+        return m_retired.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::vector<LogRecord> m_records;
+    // Written by the producer only
+    std::atomic<uint64_t> m_head;
+    // Written by the consumer only
+    std::atomic<uint64_t> m_tail;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<bool> m_retired;
+};
+
+// Lets a log statement through at most once per interval. Calls in between
+// are counted and the count is attached to the next message that passes.
+class LogRateLimiter
+{
+  public:
+    LogRateLimiter() : m_nextAllowed(0), m_suppressed(0)
+    {
+    }
+
+    bool Allow(uint64_t intervalNs, uint32_t& suppressed)
+    {
+        const uint64_t now = GetMonotonicNs();
+        uint64_t next = m_nextAllowed.load(std::memory_order_relaxed);
+        if (now >= next && m_nextAllowed.compare_exchange_strong(next, now + intervalNs, std::memory_order_relaxed))
+        {
+            suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+  private:
+    std::atomic<uint64_t> m_nextAllowed;
+    std::atomic<uint32_t> m_suppressed;
+};
+
+// Process-wide asynchronous logger. Logging threads encode messages into
+// their own LogThreadBuffer; one background thread collects all buffers,
+// orders the records by timestamp, formats them and writes them out in one
+// write per pass. Use through the ASYNC_LOG macros below.
+class AsyncLogger
+{
+  public:
+    static AsyncLogger& Instance()
+    {
+        static AsyncLogger logger;
+        return logger;
+    }
+
+    static bool Enabled(logSeverity severity)
+    {
+        return (int)severity >= MinSeverity().load(std::memory_order_relaxed);
+    }
+
+    static void SetMinSeverity(logSeverity severity)
+    {
+        MinSeverity().store((int)severity, std::memory_order_relaxed);
+    }
+
+    // Output stream, stderr by default so that log lines never mix into what a
+    // program prints on stdout. Only change it while nothing is logging.
+    void SetOutput(FILE* output)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_output = output;
+    }
+
+    template <typename... Args>
+    void Log(logSeverity severity, uint32_t suppressed, const char* format, const Args&... args)
+    {
+        LogThreadBuffer& buffer = CurrentThreadBuffer();
+        LogRecord* record = buffer.Reserve();
+        if (record == nullptr)
+        {
+            return;
+        }
+        record->timestamp = GetRealtimeNs();
+        record->format = format;
+        record->suppressed = suppressed;
+        record->severity = (uint8_t)severity;
+        record->numArgs = 0;
+        record->payloadUsed = 0;
+        EncodeArgs(*record, args...);
+        buffer.Commit();
+    }
+
+    // Blocks until everything logged before the call has been written
+    void Flush()
+    {
+        const uint64_t target = m_passes.load() + 2;
+        while (m_passes.load() < target && m_running.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Writes out everything still buffered and stops the background thread
+    void Shutdown()
+    {
+        if (m_running.exchange(false))
+        {
+            m_thread.join();
+            WritePass();
+        }
+    }
+
+    ~AsyncLogger()
+    {
+        Shutdown();
+    }
+
+  private:
+    // Keeps the buffer alive after its thread exits until it is drained
+    struct ThreadBufferHolder
+    {
+        std::shared_ptr<LogThreadBuffer> buffer;
+
+        ~ThreadBufferHolder()
+        {
+            if (buffer)
+            {
+                buffer->Retire();
+            }
+        }
+    };
+
+    AsyncLogger() : m_output(stderr), m_running(true), m_passes(0)
+    {
+        m_thread = std::thread(&AsyncLogger::Run, this);
+    }
+
+    static std::atomic<int>& MinSeverity()
+    {
+        static std::atomic<int> minSeverity(SEVERITY_INFO);
+        return minSeverity;
+    }
+
+    LogThreadBuffer& CurrentThreadBuffer()
+    {
+        static thread_local ThreadBufferHolder holder;
+        if (!holder.buffer)
+        {
+            holder.buffer.reset(new LogThreadBuffer());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_buffers.push_back(holder.buffer);
+        }
+        return *holder.buffer;
+    }
+
+    // Argument encoding; strings are copied because the caller's storage may
+    // be gone by the time the record is formatted
+    static void EncodeArgs(LogRecord&)
+    {
+    }
+
+    template <typename First, typename... Rest>
+    static void EncodeArgs(LogRecord& record, const First& first, const Rest&... rest)
+    {
+        if (record.numArgs < LogRecord::k_maxArgs)
+        {
+            EncodeArg(record, first);
+        }
+        EncodeArgs(record, rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    EncodeArg(LogRecord& record, const T& value)
+    {
+        if (std::is_signed<T>::value || std::is_enum<T>::value)
+        {
+            PutValue(record, LogRecord::ARG_INT, (int64_t)value);
+        }
+        else
+        {
+            PutValue(record, LogRecord::ARG_UINT, (uint64_t)value);
+        }
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type EncodeArg(LogRecord& record,
+                                                                                    const T& value)
+    {
+        PutValue(record, LogRecord::ARG_DOUBLE, (double)value);
+    }
+
+    static void EncodeArg(LogRecord& record, const char* value)
+    {
+        PutString(record, value, strlen(value));
+    }
+
+    static void EncodeArg(LogRecord& record, const std::string& value)
+    {
+        PutString(record, value.data(), value.size());
+    }
+
+    template <typename T>
+    static void PutValue(LogRecord& record, LogRecord::argType type, const T& value)
+    {
+        if (record.payloadUsed + sizeof(T) > LogRecord::k_payloadSize)
+        {
+            return;
+        }
+        memcpy(record.payload + record.payloadUsed, &value, sizeof(T));
+        record.payloadUsed += sizeof(T);
+        record.argTypes[record.numArgs++] = (uint8_t)type;
+    }
+
+    static void PutString(LogRecord& record, const char* value, size_t length)
+    {
+        const size_t room = LogRecord::k_payloadSize - record.payloadUsed;
+        if (room <= sizeof(uint16_t))
+        {
+            return;
+        }
+        const uint16_t stored = (uint16_t)std::min(length, room - sizeof(uint16_t));
+        memcpy(record.payload + record.payloadUsed, &stored, sizeof(stored));
+        memcpy(record.payload + record.payloadUsed + sizeof(stored), value, stored);
+        record.payloadUsed += sizeof(stored) + stored;
+        record.argTypes[record.numArgs++] = (uint8_t)LogRecord::ARG_STRING;
+    }
+
+    // Formats one record as "HH:MM:SS.uuuuuu L message"
+    static std::string Format(const LogRecord& record)
+    {
+        static const char k_severityLetters[] = {'D', 'I', 'W', 'E'};
+        char prefix[48];
+        const time_t seconds = (time_t)(record.timestamp / 1000000000ULL);
+        struct tm local;
+        localtime_r(&seconds, &local);
+        snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%06u %c ", local.tm_hour, local.tm_min, local.tm_sec,
+                 (unsigned int)((record.timestamp % 1000000000ULL) / 1000), k_severityLetters[record.severity & 3]);
+
+        std::string text(prefix);
+        const char* p = record.format;
+        size_t offset = 0;
+        unsigned int arg = 0;
+        while (*p != '\0')
+        {
+            if (p[0] == '{' && p[1] == '}' && arg < record.numArgs)
+            {
+                AppendArg(text, record, record.argTypes[arg++], offset);
+                p += 2;
+                continue;
+            }
+            text.push_back(*p++);
+        }
+        if (record.suppressed > 0)
+        {
+            char suffix[64];
+            snprintf(suffix, sizeof(suffix), " (%u similar messages suppressed)", record.suppressed);
+            text += suffix;
+        }
+        text.push_back('\n');
+        return text;
+    }
+
+    static void AppendArg(std::string& text, const LogRecord& record, uint8_t type, size_t& offset)
+    {
+        char buffer[32];
+        switch (type)
+        {
+        case LogRecord::ARG_INT:
+        {
+            int64_t value;
+            memcpy(&value, record.payload + offset, sizeof(value));
+            offset += sizeof(value);
+            snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+            text += buffer;
+            break;
+        }
+        case LogRecord::ARG_UINT:
+        {
+            uint64_t value;
+            memcpy(&value, record.payload + offset, sizeof(value));
+            offset += sizeof(value);
+            snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)value);
+            text += buffer;
+            break;
+        }
+        case LogRecord::ARG_DOUBLE:
+        {
+            double value;
+            memcpy(&value, record.payload + offset, sizeof(value));
+            offset += sizeof(value);
+            snprintf(buffer, sizeof(buffer), "%g", value);
+            text += buffer;
+            break;
+        }
+        default:
+        {
+            uint16_t length;
+            memcpy(&length, record.payload + offset, sizeof(length));
+            text.append(record.payload + offset + sizeof(length), length);
+            offset += sizeof(length) + length;
+            break;
+        }
+        }
+    }
+
+    // Collects every ready record, orders by timestamp and writes them out
+    void WritePass()
+    {
+        std::vector<std::shared_ptr<LogThreadBuffer> > buffers;
+        FILE* output;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            buffers = m_buffers;
+            output = m_output;
+        }
+
+        std::vector<std::pair<uint64_t, std::string> > lines;
+        uint64_t dropped = 0;
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            LogThreadBuffer& buffer = *buffers[i];
+            const uint64_t head = buffer.GetHead();
+            for (uint64_t index = buffer.GetTail(); index < head; index++)
+            {
+                lines.push_back(std::make_pair(buffer.At(index).timestamp, Format(buffer.At(index))));
+            }
+            buffer.Release(head);
+            dropped += buffer.TakeDropped();
+        }
+        std::stable_sort(lines.begin(), lines.end(),
+                         [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) {
+                             return a.first < b.first;
+                         });
+
+        std::string out;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            out += lines[i].second;
+        }
+        if (dropped > 0)
+        {
+            char text[96];
+            snprintf(text, sizeof(text), "%llu log messages dropped on full buffers\n", (unsigned long long)dropped);
+            out += text;
+        }
+        if (!out.empty())
+        {
+            fwrite(out.data(), 1, out.size(), output);
+            fflush(output);
+        }
+
+        // Forget buffers of exited threads once they are empty
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_buffers.size();)
+        {
+            if (m_buffers[i]->IsRetired() && m_buffers[i]->GetTail() == m_buffers[i]->GetHead())
+            {
+                m_buffers.erase(m_buffers.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    void Run()
+    {
+        while (m_running.load())
+        {
+            WritePass();
+            m_passes.fetch_add(1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<LogThreadBuffer> > m_buffers;
+    FILE* m_output;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_passes;
+    std::thread m_thread;
+};
+
+// Logs a message; "{}" in the format is replaced by the next argument.
+// The format must be a string literal.
+#define ASYNC_LOG(severity, ...)                                                                                      \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (AsyncLogger::Enabled(severity))                                                                            \
+        {                                                                                                              \
+            AsyncLogger::Instance().Log(severity, 0, __VA_ARGS__);                                                     \
+        }                                                                                                              \
+    } while (0)
+
+// Like ASYNC_LOG, but this call site emits at most one message per
+// intervalMs; the next message that passes reports how many were suppressed.
+// The limit is shared by everything logging from the call site, so messages
+// about one camera should use ASYNC_LOG_RATE_LIMITED_BY instead.
+#define ASYNC_LOG_RATE_LIMITED(severity, intervalMs, ...)                                                             \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static LogRateLimiter s_logRateLimiter;                                                                        \
+        ASYNC_LOG_RATE_LIMITED_BY(s_logRateLimiter, severity, intervalMs, __VA_ARGS__);                                \
+    } while (0)
+
+// Like ASYNC_LOG_RATE_LIMITED, but limited by the given LogRateLimiter, e.g.
+// one held per camera, so a burst from one camera neither hides the messages
+// of another nor has its suppressed count reported on them
+#define ASYNC_LOG_RATE_LIMITED_BY(limiter, severity, intervalMs, ...)                                                  \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        uint32_t logSuppressed = 0;                                                                                    \
+        if (AsyncLogger::Enabled(severity) && (limiter).Allow((uint64_t)(intervalMs) * 1000000ULL, logSuppressed))     \
+        {                                                                                                              \
+            AsyncLogger::Instance().Log(severity, logSuppressed, __VA_ARGS__);                                         \
+        }                                                                                                              \
+    } while (0)
+
+#endif // DUAL_CAM_RECORDER_ASYNC_LOGGER_H
@@ -0,0 +1,793 @@
+/*
+ * @Descripttion: Long-running capture service keeping cameras streaming and recording on command
+ * @version:
+ * @Date: 2026-10-19 22:58:40
+ * @LastEditTime: 2026-10-19 22:58:40
+ */
+
+#ifndef DUAL_CAM_RECORDER_CAPTURE_DAEMON_H
+#define DUAL_CAM_RECORDER_CAPTURE_DAEMON_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "async_logger.h"
+#include "capture_protocol.h"
+#include "packed_pixels.h"
+#include "storage_manager.h"
+#include "task_scheduler.h"
+#include "time_utils.h"
+
+// A frame delivered by a camera backend. The data stays valid until the
+// frame is handed back with CaptureCamera::Release().
+struct CaptureFrame
+{
+    const uint8_t* data;
+    size_t size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelFormat; // Spinnaker PixelFormatEnums value
+    pixelPacking packing;
+    uint64_t frameIndex;
+    uint64_t deviceTimestamp; // ns, camera clock
+    uint64_t hostTimestamp;   // ns, host CLOCK_MONOTONIC when the frame was received
+
+    CaptureFrame()
+        : data(nullptr), size(0), width(0), height(0), pixelFormat(0), packing(PACKING_NONE), frameIndex(0),
+          deviceTimestamp(0), hostTimestamp(0)
+    {
+    }
+};
+
+// Camera the daemon keeps initialized. Grab() and Release() run on the
+// camera's grab thread; SetParameter() and GetParameter() on the command
+// thread, while the camera streams.
+class CaptureCamera
+{
+  public:
+    virtual ~CaptureCamera()
+    {
+    }
+
+    virtual std::string GetSerialNumber() const = 0;
+    // Returns -1 if the parameter is unsupported or the value rejected
+    virtual int SetParameter(captureParameter parameter, double value) = 0;
+    virtual double GetParameter(captureParameter parameter) = 0;
+    virtual int BeginAcquisition() = 0;
+    virtual void EndAcquisition() = 0;
+    // Waits up to timeoutMs for the next frame. Returns 1 with a frame, 0 on
+    // a timeout or a frame not worth keeping (incomplete), -1 on an error.
+    virtual int Grab(unsigned int timeoutMs, CaptureFrame& frame) = 0;
+    virtual void Release(CaptureFrame& frame) = 0;
+};
+
+// Camera without hardware: Mono8 frames of a moving pattern at the set frame
+// rate, paced on the host clock. Used to run and test the daemon anywhere.
+class SyntheticCamera : public CaptureCamera
+{
+  public:
+    SyntheticCamera(const std::string& serialNumber, unsigned int width, unsigned int height, double frameRate,
+                    uint32_t pixelFormat)
+        : m_serialNumber(serialNumber), m_width(width), m_height(height), m_pixelFormat(pixelFormat),
+          m_exposureUs(10000.0), m_gainDb(0.0), m_frameRate(frameRate), m_acquiring(false), m_nextFrameNs(0),
+          m_frameIndex(0), m_nextBuffer(0)
+    {
+        for (unsigned int i = 0; i < k_numBuffers; i++)
+        {
+            m_buffers[i].resize((size_t)width * height);
+            for (size_t p = 0; p < m_buffers[i].size(); p++)
+            {
+                m_buffers[i][p] = (uint8_t)((p % width + p / width) * 255 / (width + height));
+            }
+        }
+    }
+
+    std::string GetSerialNumber() const
+    {
+        return m_serialNumber;
+    }
+
+    int SetParameter(captureParameter parameter, double value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (parameter == CAPTURE_PARAM_EXPOSURE_US && value > 0.0 && value <= 1e6 / m_frameRate)
+        {
+            m_exposureUs = value;
+        }
+        else if (parameter == CAPTURE_PARAM_GAIN_DB && value >= 0.0 && value <= 48.0)
+        {
+            m_gainDb = value;
+        }
+        else if (parameter == CAPTURE_PARAM_FRAME_RATE && value > 0.0 && value <= 1000.0)
+        {
+            m_frameRate = value;
+            m_exposureUs = std::min(m_exposureUs, 1e6 / value);
+        }
+        else
+        {
+            return -1;
+        }
+        return 0;
+    }
+
+    double GetParameter(captureParameter parameter)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return parameter == CAPTURE_PARAM_EXPOSURE_US ? m_exposureUs
+                                                       : parameter == CAPTURE_PARAM_GAIN_DB ? m_gainDb : m_frameRate;
+    }
+
+    int BeginAcquisition()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_acquiring = true;
+        m_nextFrameNs = GetMonotonicNs();
+        return 0;
+    }
+
+    void EndAcquisition()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_acquiring = false;
+    }
+
+    int Grab(unsigned int timeoutMs, CaptureFrame& frame)
+    {
+        uint64_t due;
+        uint64_t periodNs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_acquiring)
+            {
+                return -1;
+            }
+            due = m_nextFrameNs;
+            periodNs = (uint64_t)(1e9 / m_frameRate);
+        }
+        const uint64_t now = GetMonotonicNs();
+        const uint64_t timeoutNs = timeoutMs * 1000000ULL;
+        if (due > now + timeoutNs)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(timeoutNs));
+            return 0;
+        }
+        if (due > now)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+        // A late reader loses the frames it missed, like a camera's buffers
+        const uint64_t received = GetMonotonicNs();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_nextFrameNs = received - due > periodNs ? received + periodNs : due + periodNs;
+        }
+        std::vector<uint8_t>& buffer = m_buffers[m_nextBuffer];
+        m_nextBuffer = (m_nextBuffer + 1) % k_numBuffers;
+        // A bright band moving down one line per frame
+        const uint64_t index = m_frameIndex++;
+        const size_t band = (size_t)(index % m_height) * m_width;
+        memset(&buffer[band], 255, m_width);
+        const size_t previous = (size_t)((index + m_height - k_numBuffers) % m_height) * m_width;
+        memset(&buffer[previous], 128, m_width);
+        frame.data = &buffer[0];
+        frame.size = buffer.size();
+        frame.width = m_width;
+        frame.height = m_height;
+        frame.pixelFormat = m_pixelFormat;
+        frame.packing = PACKING_NONE;
+        frame.frameIndex = index;
+        frame.deviceTimestamp = due;
+        frame.hostTimestamp = received;
+        return 1;
+    }
+
+    void Release(CaptureFrame&)
+    {
+    }
+
+  private:
+    enum
+    {
+        k_numBuffers = 4
+    };
+
+    const std::string m_serialNumber;
+    const unsigned int m_width;
+    const unsigned int m_height;
+    const uint32_t m_pixelFormat;
+    std::mutex m_mutex;
+    double m_exposureUs;
+    double m_gainDb;
+    double m_frameRate;
+    bool m_acquiring;
+    uint64_t m_nextFrameNs;
+    uint64_t m_frameIndex;
+    unsigned int m_nextBuffer;
+    std::vector<uint8_t> m_buffers[k_numBuffers];
+};
+
+struct CaptureDaemonConfig
+{
+    std::string socketPath;
+    // Every START opens a session directory session-<time>-<n> here with a
+    // segment writer per camera; STOP closes it once no camera records
+    StorageConfig storage;
+    unsigned int grabTimeoutMs;
+    unsigned int numWorkers; // segment writes; 0 uses one per hardware thread
+
+    CaptureDaemonConfig() : socketPath("/tmp/capture_daemon.sock"), grabTimeoutMs(1000), numWorkers(2)
+    {
+    }
+};
+
+// Keeps cameras initialized, configured and streaming so commands act on the
+// next frame instead of waiting for enumeration, Init() and the start of
+// acquisition. One grab thread per camera hands frames to pending snapshots
+// and, while recording, to the session's segment writers on the worker pool.
+// Commands are served one at a time by a thread polling the socket.
+class CaptureDaemon
+{
+  public:
+    CaptureDaemon(const CaptureDaemonConfig& config, std::vector<std::unique_ptr<CaptureCamera> >& cameras)
+        : m_config(config), m_scheduler(config.numWorkers), m_listenFd(-1), m_wakeFd(-1), m_running(false),
+          m_sessionCount(0)
+    {
+        for (size_t i = 0; i < cameras.size(); i++)
+        {
+            m_sessions.push_back(std::unique_ptr<CameraSession>(new CameraSession(std::move(cameras[i]))));
+        }
+        cameras.clear();
+    }
+
+    ~CaptureDaemon()
+    {
+        Stop();
+    }
+
+    // Starts every camera streaming and listens on the socket. Returns -1 if
+    // the socket cannot be bound or a camera does not start.
+    int Start()
+    {
+        struct sockaddr_un address;
+        if (m_config.socketPath.size() >= sizeof(address.sun_path))
+        {
+            return -1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, m_config.socketPath.c_str(), m_config.socketPath.size());
+        unlink(m_config.socketPath.c_str());
+        m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        m_wakeFd = eventfd(0, EFD_CLOEXEC);
+        if (m_listenFd < 0 || m_wakeFd < 0 ||
+            bind(m_listenFd, (const struct sockaddr*)&address, sizeof(address)) != 0 || listen(m_listenFd, 8) != 0)
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "Unable to listen on {}: {}", m_config.socketPath, strerror(errno));
+            CloseFds();
+            return -1;
+        }
+        m_running = true;
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            CameraSession& session = *m_sessions[i];
+            if (session.camera->BeginAcquisition() < 0)
+            {
+                ASYNC_LOG(SEVERITY_ERROR, "[{}] Unable to start acquisition", session.serialNumber);
+                Stop();
+                return -1;
+            }
+            session.thread = std::thread(&CaptureDaemon::GrabLoop, this, std::ref(session));
+        }
+        m_serverThread = std::thread(&CaptureDaemon::ServeLoop, this);
+        return 0;
+    }
+
+    // Ends a recording in progress, stops the cameras and closes the socket
+    void Stop()
+    {
+        if (!m_running.exchange(false))
+        {
+            return;
+        }
+        const uint64_t one = 1;
+        if (write(m_wakeFd, &one, sizeof(one)) < 0)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "Unable to wake the command thread: {}", strerror(errno));
+        }
+        if (m_serverThread.joinable())
+        {
+            m_serverThread.join();
+        }
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            if (m_sessions[i]->thread.joinable())
+            {
+                m_sessions[i]->thread.join();
+            }
+            m_sessions[i]->camera->EndAcquisition();
+        }
+        StopRecording(k_captureAllCameras);
+        CloseFds();
+        unlink(m_config.socketPath.c_str());
+    }
+
+    size_t GetCameraCount() const
+    {
+        return m_sessions.size();
+    }
+
+    // Directory of the current or last recording, empty before the first START
+    std::string GetSessionDirectory()
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        return m_sessionDirectory;
+    }
+
+    // Runs one request; the socket thread calls this for every message
+    void Handle(const CaptureMessage& request, uint8_t version, CaptureMessage& response)
+    {
+        const uint64_t arrivedNs = GetMonotonicNs();
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        response.command = request.command;
+        response.sequence = request.sequence;
+        response.payload.clear();
+        CapturePayloadReader reader(request.payload);
+        if (version != k_captureVersion)
+        {
+            response.status = CAPTURE_UNKNOWN_COMMAND;
+        }
+        else if (request.command == CAPTURE_STATUS)
+        {
+            response.status = reader.IsComplete() ? CAPTURE_OK : CAPTURE_BAD_REQUEST;
+        }
+        else if (request.command == CAPTURE_START)
+        {
+            const uint32_t mask = reader.U32();
+            const uint32_t maxFrames = reader.U32();
+            response.status = !reader.IsComplete() ? CAPTURE_BAD_REQUEST
+                              : !SelectsCamera(mask) ? CAPTURE_BAD_CAMERA
+                                                     : StartRecording(mask, maxFrames, arrivedNs);
+        }
+        else if (request.command == CAPTURE_STOP)
+        {
+            const uint32_t mask = reader.U32();
+            response.status = !reader.IsComplete() ? CAPTURE_BAD_REQUEST
+                              : !SelectsCamera(mask) ? CAPTURE_BAD_CAMERA
+                                                     : StopRecording(mask);
+        }
+        else if (request.command == CAPTURE_SNAPSHOT)
+        {
+            const uint32_t camera = reader.U32();
+            const uint32_t timeoutMs = reader.U32();
+            if (!reader.IsComplete())
+            {
+                response.status = CAPTURE_BAD_REQUEST;
+            }
+            else if (camera >= m_sessions.size())
+            {
+                response.status = CAPTURE_BAD_CAMERA;
+            }
+            else
+            {
+                CaptureSnapshot snapshot;
+                response.status = TakeSnapshot(*m_sessions[camera], arrivedNs, timeoutMs, snapshot);
+                if (response.status == CAPTURE_OK)
+                {
+                    EncodeSnapshot(snapshot, response.payload);
+                }
+                return;
+            }
+        }
+        else if (request.command == CAPTURE_RECONFIGURE)
+        {
+            const uint32_t mask = reader.U32();
+            const uint16_t count = reader.U16();
+            std::vector<std::pair<captureParameter, double> > parameters;
+            for (uint16_t i = 0; i < count && reader.IsOk(); i++)
+            {
+                const uint16_t parameter = reader.U16();
+                parameters.push_back(std::make_pair((captureParameter)parameter, reader.F64()));
+            }
+            response.status = !reader.IsComplete() ? CAPTURE_BAD_REQUEST
+                              : !SelectsCamera(mask) ? CAPTURE_BAD_CAMERA
+                                                     : Reconfigure(mask, parameters);
+        }
+        else
+        {
+            response.status = CAPTURE_UNKNOWN_COMMAND;
+        }
+        if (response.status == CAPTURE_OK || response.status == CAPTURE_CAMERA_ERROR)
+        {
+            EncodeCameraStatuses(GetStatuses(), response.payload);
+        }
+    }
+
+  private:
+    struct CameraSession
+    {
+        std::unique_ptr<CaptureCamera> camera;
+        std::string serialNumber;
+        std::thread thread;
+        // Guards recording state against the grab thread, and the snapshot hand-off
+        std::mutex mutex;
+        std::condition_variable snapshotCond;
+        bool recording;
+        uint64_t framesLeft; // frames still to record, 0 for no limit
+        uint64_t startNs;    // arrival of the START command
+        bool firstFrameRecorded;
+        SegmentWriter* segments;
+        std::unique_ptr<Strand> writer;
+        bool snapshotPending;
+        uint64_t snapshotAfterNs;
+        CaptureSnapshot* snapshot;
+        std::atomic<uint64_t> framesGrabbed;
+        std::atomic<uint64_t> framesRecorded;
+        std::atomic<uint64_t> framesDropped;
+        std::atomic<uint64_t> firstFrameLatencyNs;
+        LogRateLimiter grabFailureLog; // rate limit of this camera's grab failures
+
+        explicit CameraSession(std::unique_ptr<CaptureCamera> cam)
+            : camera(std::move(cam)), serialNumber(camera->GetSerialNumber()), recording(false), framesLeft(0),
+              startNs(0), firstFrameRecorded(false), segments(nullptr), snapshotPending(false), snapshotAfterNs(0),
+              snapshot(nullptr), framesGrabbed(0), framesRecorded(0), framesDropped(0), firstFrameLatencyNs(0)
+        {
+        }
+    };
+
+    bool SelectsCamera(uint32_t mask) const
+    {
+        return mask == k_captureAllCameras || (m_sessions.size() < 32 && (mask >> m_sessions.size()) == 0);
+    }
+
+    static bool InMask(uint32_t mask, size_t index)
+    {
+        return mask == k_captureAllCameras || (index < 32 && (mask >> index) & 1);
+    }
+
+    std::vector<CaptureCameraStatus> GetStatuses()
+    {
+        std::vector<CaptureCameraStatus> statuses;
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            CameraSession& session = *m_sessions[i];
+            CaptureCameraStatus status;
+            status.serialNumber = session.serialNumber;
+            {
+                std::lock_guard<std::mutex> lock(session.mutex);
+                status.recording = session.recording;
+            }
+            status.framesGrabbed = session.framesGrabbed.load(std::memory_order_relaxed);
+            status.framesRecorded = session.framesRecorded.load(std::memory_order_relaxed);
+            status.framesDropped = session.framesDropped.load(std::memory_order_relaxed);
+            status.firstFrameLatencyNs = session.firstFrameLatencyNs.load(std::memory_order_relaxed);
+            status.exposureUs = session.camera->GetParameter(CAPTURE_PARAM_EXPOSURE_US);
+            status.gainDb = session.camera->GetParameter(CAPTURE_PARAM_GAIN_DB);
+            status.frameRate = session.camera->GetParameter(CAPTURE_PARAM_FRAME_RATE);
+            statuses.push_back(status);
+        }
+        return statuses;
+    }
+
+    // Opens a session on the first START; cameras already recording carry on
+    int StartRecording(uint32_t mask, uint32_t maxFrames, uint64_t arrivedNs)
+    {
+        if (!m_storage)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "/session-%lld-%u", (long long)time(nullptr), ++m_sessionCount);
+            StorageConfig storageConfig = m_config.storage;
+            storageConfig.directory += name;
+            std::unique_ptr<StorageManager> storage(new StorageManager(storageConfig));
+            if (mkdir(storageConfig.directory.c_str(), 0755) != 0 || storage->Start() < 0)
+            {
+                ASYNC_LOG(SEVERITY_ERROR, "Unable to open session {}: {}", storageConfig.directory, strerror(errno));
+                return CAPTURE_CAMERA_ERROR;
+            }
+            for (size_t i = 0; i < m_sessions.size(); i++)
+            {
+                m_sessions[i]->segments = storage->OpenWriter(m_sessions[i]->serialNumber);
+                m_sessions[i]->writer.reset(new Strand(m_scheduler));
+            }
+            m_storage = std::move(storage);
+            m_sessionDirectory = storageConfig.directory;
+        }
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            CameraSession& session = *m_sessions[i];
+            if (!InMask(mask, i))
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(session.mutex);
+            if (!session.recording)
+            {
+                session.framesRecorded = 0;
+                session.framesDropped = 0;
+                session.firstFrameLatencyNs = 0;
+                session.firstFrameRecorded = false;
+            }
+            session.recording = true;
+            session.framesLeft = maxFrames;
+            session.startNs = arrivedNs;
+        }
+        return CAPTURE_OK;
+    }
+
+    // Closes the session, with every admitted frame written, once no camera records
+    int StopRecording(uint32_t mask)
+    {
+        bool anyRecording = false;
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            CameraSession& session = *m_sessions[i];
+            std::lock_guard<std::mutex> lock(session.mutex);
+            if (InMask(mask, i))
+            {
+                session.recording = false;
+            }
+            anyRecording = anyRecording || session.recording;
+        }
+        if (anyRecording || !m_storage)
+        {
+            return CAPTURE_OK;
+        }
+        // No grab thread posts writes any more
+        m_scheduler.WaitIdle();
+        m_storage->Stop();
+        int status = CAPTURE_OK;
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            CameraSession& session = *m_sessions[i];
+            if (session.segments->GetWriteErrorCount() > 0)
+            {
+                status = CAPTURE_CAMERA_ERROR;
+            }
+            session.segments = nullptr;
+            session.writer.reset();
+        }
+        m_storage.reset();
+        return status;
+    }
+
+    int Reconfigure(uint32_t mask, const std::vector<std::pair<captureParameter, double> >& parameters)
+    {
+        int status = CAPTURE_OK;
+        for (size_t i = 0; i < m_sessions.size(); i++)
+        {
+            if (!InMask(mask, i))
+            {
+                continue;
+            }
+            for (size_t p = 0; p < parameters.size(); p++)
+            {
+                if (m_sessions[i]->camera->SetParameter(parameters[p].first, parameters[p].second) < 0)
+                {
+                    ASYNC_LOG(SEVERITY_WARNING, "[{}] Parameter {} = {} rejected", m_sessions[i]->serialNumber,
+                              (unsigned int)parameters[p].first, parameters[p].second);
+                    status = CAPTURE_CAMERA_ERROR;
+                }
+            }
+        }
+        return status;
+    }
+
+    // Waits for the first frame the camera delivers after the command arrived
+    int TakeSnapshot(CameraSession& session, uint64_t arrivedNs, uint32_t timeoutMs, CaptureSnapshot& snapshot)
+    {
+        std::unique_lock<std::mutex> lock(session.mutex);
+        session.snapshot = &snapshot;
+        session.snapshotAfterNs = arrivedNs;
+        session.snapshotPending = true;
+        session.snapshotCond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                      [&session] { return !session.snapshotPending; });
+        const bool taken = !session.snapshotPending;
+        session.snapshotPending = false;
+        session.snapshot = nullptr;
+        return taken ? CAPTURE_OK : CAPTURE_TIMEOUT;
+    }
+
+    void GrabLoop(CameraSession& session)
+    {
+        while (m_running.load(std::memory_order_relaxed))
+        {
+            CaptureFrame frame;
+            const int grabbed = session.camera->Grab(m_config.grabTimeoutMs, frame);
+            if (grabbed < 0)
+            {
+                ASYNC_LOG_RATE_LIMITED_BY(session.grabFailureLog, SEVERITY_ERROR, 1000, "[{}] Grab failed",
+                                          session.serialNumber);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            if (grabbed == 0)
+            {
+                continue;
+            }
+            session.framesGrabbed.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(session.mutex);
+                if (session.snapshotPending && frame.hostTimestamp >= session.snapshotAfterNs)
+                {
+                    CaptureSnapshot& snapshot = *session.snapshot;
+                    snapshot.frameIndex = frame.frameIndex;
+                    snapshot.deviceTimestamp = frame.deviceTimestamp;
+                    snapshot.hostTimestamp = frame.hostTimestamp;
+                    snapshot.latencyNs = frame.hostTimestamp - session.snapshotAfterNs;
+                    snapshot.width = frame.width;
+                    snapshot.height = frame.height;
+                    snapshot.pixelFormat = frame.pixelFormat;
+                    snapshot.pixels.assign(frame.data, frame.data + frame.size);
+                    session.snapshotPending = false;
+                    session.snapshotCond.notify_all();
+                }
+                if (session.recording && frame.hostTimestamp >= session.startNs)
+                {
+                    Record(session, frame);
+                }
+            }
+            session.camera->Release(frame);
+        }
+    }
+
+    // Copies a frame out of the camera's buffer and queues its append. Runs
+    // under the session's mutex.
+    void Record(CameraSession& session, const CaptureFrame& frame)
+    {
+        if (!m_storage->Admit(frame.frameIndex))
+        {
+            session.framesDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            if (!session.firstFrameRecorded)
+            {
+                session.firstFrameLatencyNs = frame.hostTimestamp - session.startNs;
+                session.firstFrameRecorded = true;
+            }
+            std::shared_ptr<SegmentRecordHeader> header(new SegmentRecordHeader());
+            memset(header.get(), 0, sizeof(SegmentRecordHeader));
+            header->frameIndex = frame.frameIndex;
+            header->deviceTimestamp = frame.deviceTimestamp;
+            header->hostTimestamp = frame.hostTimestamp;
+            header->wallTime = time(nullptr);
+            header->width = frame.width;
+            header->height = frame.height;
+            header->pixelFormat = frame.pixelFormat;
+            header->packing = (uint32_t)frame.packing;
+            header->bitDepth = GetPackingBitDepth(frame.packing);
+            std::shared_ptr<std::vector<uint8_t> > payload(
+                new std::vector<uint8_t>(frame.data, frame.data + frame.size));
+            SegmentWriter* segments = session.segments;
+            std::atomic<uint64_t>& recorded = session.framesRecorded;
+            std::atomic<uint64_t>& dropped = session.framesDropped;
+            session.writer->Post([segments, header, payload, &recorded, &dropped] {
+                const void* data = payload->empty() ? nullptr : &(*payload)[0];
+                if (segments->Append(*header, data, (uint32_t)payload->size()))
+                {
+                    recorded.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        if (session.framesLeft > 0 && --session.framesLeft == 0)
+        {
+            session.recording = false;
+        }
+    }
+
+    // Accepts clients and serves their requests until Stop()
+    void ServeLoop()
+    {
+        std::vector<int> clients;
+        while (m_running.load(std::memory_order_relaxed))
+        {
+            std::vector<struct pollfd> fds(2 + clients.size());
+            fds[0].fd = m_wakeFd;
+            fds[1].fd = m_listenFd;
+            for (size_t i = 0; i < clients.size(); i++)
+            {
+                fds[2 + i].fd = clients[i];
+            }
+            for (size_t i = 0; i < fds.size(); i++)
+            {
+                fds[i].events = POLLIN;
+                fds[i].revents = 0;
+            }
+            if (poll(&fds[0], fds.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ASYNC_LOG(SEVERITY_ERROR, "Command socket poll failed: {}", strerror(errno));
+                break;
+            }
+            if (fds[0].revents != 0)
+            {
+                break;
+            }
+            for (size_t i = clients.size(); i-- > 0;)
+            {
+                if (fds[2 + i].revents == 0)
+                {
+                    continue;
+                }
+                CaptureMessage request;
+                CaptureMessage response;
+                uint8_t version = 0;
+                bool connected = ReceiveCaptureMessage(clients[i], request, &version) == 0;
+                if (connected)
+                {
+                    Handle(request, version, response);
+                    connected = SendCaptureMessage(clients[i], response);
+                }
+                if (!connected)
+                {
+                    close(clients[i]);
+                    clients.erase(clients.begin() + i);
+                }
+            }
+            if (fds[1].revents & POLLIN)
+            {
+                const int client = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0)
+                {
+                    clients.push_back(client);
+                }
+            }
+        }
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            close(clients[i]);
+        }
+    }
+
+    void CloseFds()
+    {
+        if (m_listenFd >= 0)
+        {
+            close(m_listenFd);
+            m_listenFd = -1;
+        }
+        if (m_wakeFd >= 0)
+        {
+            close(m_wakeFd);
+            m_wakeFd = -1;
+        }
+    }
+
+    const CaptureDaemonConfig m_config;
+    TaskScheduler m_scheduler;
+    std::vector<std::unique_ptr<CameraSession> > m_sessions;
+    int m_listenFd;
+    int m_wakeFd;
+    std::atomic<bool> m_running;
+    std::thread m_serverThread;
+    // Serializes commands; the storage of the open session
+    std::mutex m_commandMutex;
+    std::unique_ptr<StorageManager> m_storage;
+    std::string m_sessionDirectory;
+    unsigned int m_sessionCount;
+};
+
+#endif // DUAL_CAM_RECORDER_CAPTURE_DAEMON_H
@@ -0,0 +1,564 @@
+/*
+ * @Descripttion: Binary command protocol of the capture daemon over a Unix domain socket, and its client
+ * @version:
+ * @Date: 2026-10-19 22:31:05
+ * @LastEditTime: 2026-10-19 22:31:05
+ */
+
+#ifndef DUAL_CAM_RECORDER_CAPTURE_PROTOCOL_H
+#define DUAL_CAM_RECORDER_CAPTURE_PROTOCOL_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Every message is a CaptureMessageHeader followed by payloadSize bytes, all
+// little endian. A client sends one request at a time and reads its
+// response, which echoes the command and sequence number; status is 0 in
+// requests.
+enum captureCommand
+{
+    CAPTURE_STATUS = 1,  // -> camera statuses
+    CAPTURE_START,       // u32 camera mask, u32 frames per camera (0: until STOP) -> camera statuses
+    CAPTURE_STOP,        // u32 camera mask -> camera statuses, after the recording is on disk
+    CAPTURE_SNAPSHOT,    // u32 camera, u32 timeout ms -> the next frame of the camera
+    CAPTURE_RECONFIGURE, // u32 camera mask, u16 count, count x (u16 parameter, f64 value) -> camera statuses
+    NUM_CAPTURE_COMMANDS
+};
+
+enum captureStatus
+{
+    CAPTURE_OK,
+    CAPTURE_BAD_REQUEST,     // malformed payload
+    CAPTURE_UNKNOWN_COMMAND, // or a newer protocol version
+    CAPTURE_BAD_CAMERA,      // camera index or mask selects no camera
+    CAPTURE_TIMEOUT,         // no frame within the snapshot timeout
+    CAPTURE_CAMERA_ERROR,    // the camera rejected a parameter, or storage failed
+    NUM_CAPTURE_STATUSES
+};
+
+// Parameters of CAPTURE_RECONFIGURE; cameras apply them while streaming
+enum captureParameter
+{
+    CAPTURE_PARAM_EXPOSURE_US = 1,
+    CAPTURE_PARAM_GAIN_DB,
+    CAPTURE_PARAM_FRAME_RATE,
+    NUM_CAPTURE_PARAMS
+};
+
+// A mask of 0 selects every camera
+const uint32_t k_captureAllCameras = 0;
+
+struct CaptureMessageHeader
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t command;
+    uint16_t status;
+    uint32_t sequence;
+    uint32_t payloadSize;
+};
+
+const uint32_t k_captureMagic = 0x44504143; // "CAPD"
+const uint8_t k_captureVersion = 1;
+// Largest payload accepted, enough for a 16-bit 5 MP snapshot
+const uint32_t k_captureMaxPayload = 64U << 20;
+
+struct CaptureMessage
+{
+    uint8_t command;
+    uint16_t status;
+    uint32_t sequence;
+    std::vector<uint8_t> payload;
+
+    CaptureMessage() : command(0), status(CAPTURE_OK), sequence(0)
+    {
+    }
+};
+
+inline const char* GetCaptureStatusName(unsigned int status)
+{
+    const char* names[] = {"ok", "bad request", "unknown command", "bad camera", "timeout", "camera error"};
+    return status < NUM_CAPTURE_STATUSES ? names[status] : "unknown status";
+}
+
+// Appends little-endian fields to a payload
+class CapturePayloadWriter
+{
+  public:
+    explicit CapturePayloadWriter(std::vector<uint8_t>& out) : m_out(out)
+    {
+    }
+
+    void U8(uint8_t value)
+    {
+        m_out.push_back(value);
+    }
+
+    void U16(uint16_t value)
+    {
+        Little(value, 2);
+    }
+
+    void U32(uint32_t value)
+    {
+        Little(value, 4);
+    }
+
+    void U64(uint64_t value)
+    {
+        Little(value, 8);
+    }
+
+    void F64(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        U64(bits);
+    }
+
+    void String(const std::string& value)
+    {
+        U16((uint16_t)value.size());
+        Raw(value.data(), value.size());
+    }
+
+    void Raw(const void* data, size_t size)
+    {
+        m_out.insert(m_out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    }
+
+  private:
+    void Little(uint64_t value, unsigned int bytes)
+    {
+        for (unsigned int i = 0; i < bytes; i++)
+        {
+            m_out.push_back((uint8_t)(value >> (8 * i)));
+        }
+    }
+
+    std::vector<uint8_t>& m_out;
+};
+
+// Reads little-endian fields of a payload. Reading past the end yields
+// zeros and clears IsOk(), so a decoder checks once at the end.
+class CapturePayloadReader
+{
+  public:
+    explicit CapturePayloadReader(const std::vector<uint8_t>& payload)
+        : m_data(payload.empty() ? nullptr : &payload[0]), m_size(payload.size()), m_offset(0), m_ok(true)
+    {
+    }
+
+    uint8_t U8()
+    {
+        return (uint8_t)Little(1);
+    }
+
+    uint16_t U16()
+    {
+        return (uint16_t)Little(2);
+    }
+
+    uint32_t U32()
+    {
+        return (uint32_t)Little(4);
+    }
+
+    uint64_t U64()
+    {
+        return Little(8);
+    }
+
+    double F64()
+    {
+        const uint64_t bits = U64();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string String()
+    {
+        const uint16_t size = U16();
+        const uint8_t* data = Take(size);
+        return data != nullptr ? std::string((const char*)data, size) : std::string();
+    }
+
+    // Pointer to the next size bytes, or null if fewer are left
+    const uint8_t* Take(size_t size)
+    {
+        if (!m_ok || m_size - m_offset < size)
+        {
+            m_ok = false;
+            return nullptr;
+        }
+        const uint8_t* data = m_data + m_offset;
+        m_offset += size;
+        return data;
+    }
+
+    bool IsOk() const
+    {
+        return m_ok;
+    }
+
+    // Whether the payload was read exactly to its end
+    bool IsComplete() const
+    {
+        return m_ok && m_offset == m_size;
+    }
+
+  private:
+    uint64_t Little(unsigned int bytes)
+    {
+        const uint8_t* data = Take(bytes);
+        uint64_t value = 0;
+        for (unsigned int i = 0; data != nullptr && i < bytes; i++)
+        {
+            value |= (uint64_t)data[i] << (8 * i);
+        }
+        return value;
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset;
+    bool m_ok;
+};
+
+// State of one camera in CAPTURE_STATUS and the other status replies
+struct CaptureCameraStatus
+{
+    std::string serialNumber;
+    bool recording;
+    uint64_t framesGrabbed;  // since the daemon started
+    uint64_t framesRecorded; // in the current or last recording
+    uint64_t framesDropped;  // not recorded while recording: storage policy, write errors
+    uint64_t firstFrameLatencyNs; // from the last START to its first recorded frame
+    double exposureUs;
+    double gainDb;
+    double frameRate;
+
+    CaptureCameraStatus()
+        : recording(false), framesGrabbed(0), framesRecorded(0), framesDropped(0), firstFrameLatencyNs(0),
+          exposureUs(0.0), gainDb(0.0), frameRate(0.0)
+    {
+    }
+};
+
+inline void EncodeCameraStatuses(const std::vector<CaptureCameraStatus>& statuses, std::vector<uint8_t>& payload)
+{
+    CapturePayloadWriter writer(payload);
+    writer.U32((uint32_t)statuses.size());
+    for (size_t i = 0; i < statuses.size(); i++)
+    {
+        const CaptureCameraStatus& status = statuses[i];
+        writer.String(status.serialNumber);
+        writer.U8(status.recording ? 1 : 0);
+        writer.U64(status.framesGrabbed);
+        writer.U64(status.framesRecorded);
+        writer.U64(status.framesDropped);
+        writer.U64(status.firstFrameLatencyNs);
+        writer.F64(status.exposureUs);
+        writer.F64(status.gainDb);
+        writer.F64(status.frameRate);
+    }
+}
+
+inline bool DecodeCameraStatuses(const std::vector<uint8_t>& payload, std::vector<CaptureCameraStatus>& statuses)
+{
+    CapturePayloadReader reader(payload);
+    const uint32_t count = reader.U32();
+    statuses.clear();
+    for (uint32_t i = 0; i < count && reader.IsOk(); i++)
+    {
+        CaptureCameraStatus status;
+        status.serialNumber = reader.String();
+        status.recording = reader.U8() != 0;
+        status.framesGrabbed = reader.U64();
+        status.framesRecorded = reader.U64();
+        status.framesDropped = reader.U64();
+        status.firstFrameLatencyNs = reader.U64();
+        status.exposureUs = reader.F64();
+        status.gainDb = reader.F64();
+        status.frameRate = reader.F64();
+        statuses.push_back(status);
+    }
+    return reader.IsComplete();
+}
+
+// Reply to CAPTURE_SNAPSHOT: the first frame the camera delivered after the
+// command arrived, as transmitted
+struct CaptureSnapshot
+{
+    uint64_t frameIndex;
+    uint64_t deviceTimestamp; // ns, camera clock
+    uint64_t hostTimestamp;   // ns, host CLOCK_MONOTONIC
+    uint64_t latencyNs;       // from the command's arrival to the frame's
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelFormat; // Spinnaker PixelFormatEnums value
+    std::vector<uint8_t> pixels;
+
+    CaptureSnapshot()
+        : frameIndex(0), deviceTimestamp(0), hostTimestamp(0), latencyNs(0), width(0), height(0), pixelFormat(0)
+    {
+    }
+};
+
+inline void EncodeSnapshot(const CaptureSnapshot& snapshot, std::vector<uint8_t>& payload)
+{
+    CapturePayloadWriter writer(payload);
+    writer.U64(snapshot.frameIndex);
+    writer.U64(snapshot.deviceTimestamp);
+    writer.U64(snapshot.hostTimestamp);
+    writer.U64(snapshot.latencyNs);
+    writer.U32(snapshot.width);
+    writer.U32(snapshot.height);
+    writer.U32(snapshot.pixelFormat);
+    writer.U32((uint32_t)snapshot.pixels.size());
+    writer.Raw(snapshot.pixels.empty() ? nullptr : &snapshot.pixels[0], snapshot.pixels.size());
+}
+
+inline bool DecodeSnapshot(const std::vector<uint8_t>& payload, CaptureSnapshot& snapshot)
+{
+    CapturePayloadReader reader(payload);
+    snapshot.frameIndex = reader.U64();
+    snapshot.deviceTimestamp = reader.U64();
+    snapshot.hostTimestamp = reader.U64();
+    snapshot.latencyNs = reader.U64();
+    snapshot.width = reader.U32();
+    snapshot.height = reader.U32();
+    snapshot.pixelFormat = reader.U32();
+    const uint32_t size = reader.U32();
+    const uint8_t* pixels = reader.Take(size);
+    snapshot.pixels.assign(pixels, pixels != nullptr ? pixels + size : pixels);
+    return reader.IsComplete();
+}
+
+// Writes all of size bytes. Returns false on error or a closed peer.
+inline bool WriteCaptureBytes(int fd, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0)
+    {
+        const ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+// Reads exactly size bytes. Returns false on error or a closed peer.
+inline bool ReadCaptureBytes(int fd, void* data, size_t size)
+{
+    uint8_t* bytes = (uint8_t*)data;
+    while (size > 0)
+    {
+        const ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+inline bool SendCaptureMessage(int fd, const CaptureMessage& message)
+{
+    std::vector<uint8_t> header;
+    CapturePayloadWriter writer(header);
+    writer.U32(k_captureMagic);
+    writer.U8(k_captureVersion);
+    writer.U8(message.command);
+    writer.U16(message.status);
+    writer.U32(message.sequence);
+    writer.U32((uint32_t)message.payload.size());
+    // One send for small messages keeps a round trip to one wakeup per side
+    if (message.payload.size() <= 4096)
+    {
+        header.insert(header.end(), message.payload.begin(), message.payload.end());
+        return WriteCaptureBytes(fd, &header[0], header.size());
+    }
+    return WriteCaptureBytes(fd, &header[0], header.size()) &&
+           WriteCaptureBytes(fd, &message.payload[0], message.payload.size());
+}
+
+// Reads one message. Returns -1 if the connection closed or the stream is
+// not this protocol; a newer version is read and left to the caller.
+inline int ReceiveCaptureMessage(int fd, CaptureMessage& message, uint8_t* version = nullptr)
+{
+    std::vector<uint8_t> header(sizeof(CaptureMessageHeader));
+    if (!ReadCaptureBytes(fd, &header[0], header.size()))
+    {
+        return -1;
+    }
+    CapturePayloadReader reader(header);
+    const uint32_t magic = reader.U32();
+    const uint8_t messageVersion = reader.U8();
+    message.command = reader.U8();
+    message.status = reader.U16();
+    message.sequence = reader.U32();
+    const uint32_t payloadSize = reader.U32();
+    if (magic != k_captureMagic || payloadSize > k_captureMaxPayload)
+    {
+        return -1;
+    }
+    if (version != nullptr)
+    {
+        *version = messageVersion;
+    }
+    message.payload.resize(payloadSize);
+    return payloadSize == 0 || ReadCaptureBytes(fd, &message.payload[0], payloadSize) ? 0 : -1;
+}
+
+// Synchronous client of the daemon. Each call returns a captureStatus, or -1
+// if the daemon could not be reached or the connection broke.
+class CaptureClient
+{
+  public:
+    CaptureClient() : m_fd(-1), m_sequence(0)
+    {
+    }
+
+    ~CaptureClient()
+    {
+        Close();
+    }
+
+    int Connect(const std::string& socketPath)
+    {
+        Close();
+        struct sockaddr_un address;
+        if (socketPath.size() >= sizeof(address.sun_path))
+        {
+            return -1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+        m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_fd < 0 || connect(m_fd, (const struct sockaddr*)&address, sizeof(address)) != 0)
+        {
+            Close();
+            return -1;
+        }
+        return 0;
+    }
+
+    void Close()
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    // Sends a request and waits for its response
+    int Call(captureCommand command, const std::vector<uint8_t>& payload, CaptureMessage& response)
+    {
+        CaptureMessage request;
+        request.command = (uint8_t)command;
+        request.sequence = ++m_sequence;
+        request.payload = payload;
+        if (m_fd < 0 || !SendCaptureMessage(m_fd, request) || ReceiveCaptureMessage(m_fd, response) < 0 ||
+            response.sequence != request.sequence)
+        {
+            Close();
+            return -1;
+        }
+        return response.status;
+    }
+
+    int Status(std::vector<CaptureCameraStatus>& statuses)
+    {
+        return CallForStatuses(CAPTURE_STATUS, std::vector<uint8_t>(), statuses);
+    }
+
+    int Start(uint32_t cameraMask, uint32_t maxFrames, std::vector<CaptureCameraStatus>& statuses)
+    {
+        std::vector<uint8_t> payload;
+        CapturePayloadWriter writer(payload);
+        writer.U32(cameraMask);
+        writer.U32(maxFrames);
+        return CallForStatuses(CAPTURE_START, payload, statuses);
+    }
+
+    int Stop(uint32_t cameraMask, std::vector<CaptureCameraStatus>& statuses)
+    {
+        std::vector<uint8_t> payload;
+        CapturePayloadWriter writer(payload);
+        writer.U32(cameraMask);
+        return CallForStatuses(CAPTURE_STOP, payload, statuses);
+    }
+
+    int Snapshot(uint32_t camera, uint32_t timeoutMs, CaptureSnapshot& snapshot)
+    {
+        std::vector<uint8_t> payload;
+        CapturePayloadWriter writer(payload);
+        writer.U32(camera);
+        writer.U32(timeoutMs);
+        CaptureMessage response;
+        const int status = Call(CAPTURE_SNAPSHOT, payload, response);
+        if (status == CAPTURE_OK && !DecodeSnapshot(response.payload, snapshot))
+        {
+            return CAPTURE_BAD_REQUEST;
+        }
+        return status;
+    }
+
+    int Reconfigure(uint32_t cameraMask, const std::vector<std::pair<captureParameter, double> >& parameters,
+                    std::vector<CaptureCameraStatus>& statuses)
+    {
+        std::vector<uint8_t> payload;
+        CapturePayloadWriter writer(payload);
+        writer.U32(cameraMask);
+        writer.U16((uint16_t)parameters.size());
+        for (size_t i = 0; i < parameters.size(); i++)
+        {
+            writer.U16((uint16_t)parameters[i].first);
+            writer.F64(parameters[i].second);
+        }
+        return CallForStatuses(CAPTURE_RECONFIGURE, payload, statuses);
+    }
+
+  private:
+    int CallForStatuses(captureCommand command, const std::vector<uint8_t>& payload,
+                        std::vector<CaptureCameraStatus>& statuses)
+    {
+        CaptureMessage response;
+        const int status = Call(command, payload, response);
+        if (status >= 0 && !response.payload.empty() && !DecodeCameraStatuses(response.payload, statuses))
+        {
+            return CAPTURE_BAD_REQUEST;
+        }
+        return status;
+    }
+
+    int m_fd;
+    uint32_t m_sequence;
+};
+
+#endif // DUAL_CAM_RECORDER_CAPTURE_PROTOCOL_H
@@ -0,0 +1,539 @@
+/*
+ * @Descripttion: Device-to-host clock synchronization from periodic timestamp latches
+ * @version:
+ * @Date: 2026-10-19 18:05:52
+ * @LastEditTime: 2026-10-19 18:05:52
+ */
+
+#ifndef DUAL_CAM_RECORDER_CLOCK_SYNC_H
+#define DUAL_CAM_RECORDER_CLOCK_SYNC_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "time_utils.h"
+
+// One latch of a camera's timestamp counter. The latch happened somewhere
+// between the two host readings, so their midpoint is the best estimate of
+// its host time and half the round trip is the uncertainty of one sample.
+struct ClockSample
+{
+    uint64_t deviceTimestamp; // ns, camera clock at the latch
+    uint64_t hostBefore;      // ns, host CLOCK_MONOTONIC before the latch command
+    uint64_t hostAfter;       // ns, host CLOCK_MONOTONIC after it completed
+    int64_t realtimeOffset;   // ns, CLOCK_REALTIME - CLOCK_MONOTONIC at the latch
+
+    ClockSample() : deviceTimestamp(0), hostBefore(0), hostAfter(0), realtimeOffset(0)
+    {
+    }
+};
+
+struct ClockSyncConfig
+{
+    unsigned int windowSize;            // latches the drift/offset fit uses
+    unsigned int minSamples;            // latches needed before timestamps are mapped
+    double roundTripFactor;             // a latch slower than this times the median round trip is rejected
+    double residualFactor;              // a latch further than this many sigmas from the fit is rejected
+    uint64_t residualFloorNs;           // ... but only if it is also further than this
+    unsigned int maxConsecutiveRejects; // then the camera clock is assumed to have jumped and the fit restarts
+    double errorSigmas;                 // width of the error bound in standard errors of the fit
+    uint64_t maxExtrapolationNs;        // timestamps further than this outside the window are not mapped
+
+    ClockSyncConfig()
+        : windowSize(32), minSamples(4), roundTripFactor(2.5), residualFactor(5.0), residualFloorNs(20000),
+          maxConsecutiveRejects(8), errorSigmas(3.0), maxExtrapolationNs(10000000000ULL)
+    {
+    }
+};
+
+// Fitted model of one camera clock:
+//   host = device + yOrigin + offset + drift * (device - xOrigin - xMean)
+// The fit is done on (host - device) against device time relative to an
+// origin, so that every value stays small enough to be exact in a double.
+struct ClockFit
+{
+    uint64_t xOrigin;         // device timestamp the fit is relative to
+    int64_t yOrigin;          // host - device of the first latch after a reset
+    double xMean;             // mean device time of the window, relative to xOrigin
+    double offset;            // host - device - yOrigin at xMean
+    double drift;             // host ns gained per device ns, i.e. the rate error of the camera clock
+    double sigma;             // residual standard deviation of the window
+    double sxx;               // sum of squared device time deviations of the window
+    double latchUncertainty;  // half the smallest round trip of the window
+    double firstX;            // device time of the oldest latch of the window, relative to xOrigin
+    double lastX;             // device time of the newest latch, relative to xOrigin
+    unsigned int samples;     // latches in the window
+    int64_t realtimeOffset;   // CLOCK_REALTIME - CLOCK_MONOTONIC at the last latch
+    double errorSigmas;
+
+    ClockFit()
+        : xOrigin(0), yOrigin(0), xMean(0.0), offset(0.0), drift(0.0), sigma(0.0), sxx(0.0), latchUncertainty(0.0),
+          firstX(0.0), lastX(0.0), samples(0), realtimeOffset(0), errorSigmas(3.0)
+    {
+    }
+
+    // Residual of host - device at device time x (relative to xOrigin)
+    double Predict(double x) const
+    {
+        return offset + drift * (x - xMean);
+    }
+
+    // Standard error of Predict at x: the uncertainty of offset and drift,
+    // growing as x moves away from the window
+    double StandardError(double x) const
+    {
+        const double dx = x - xMean;
+        return sigma * sqrt(1.0 / samples + (sxx > 0.0 ? dx * dx / sxx : 0.0));
+    }
+
+    // Maps a device timestamp. Invalid if the model has too few latches, or
+    // if the timestamp is too far outside the window for the fit to hold
+    // (e.g. the camera clock was reset and the fit has not restarted yet).
+    SyncedTimestamp Map(uint64_t deviceTimestamp, const ClockSyncConfig& config) const
+    {
+        SyncedTimestamp result;
+        const double x = (double)(int64_t)(deviceTimestamp - xOrigin);
+        const double limit = (double)config.maxExtrapolationNs;
+        if (samples < config.minSamples || samples == 0 || x < firstX - limit || x > lastX + limit)
+        {
+            return result;
+        }
+        const double y = Predict(x);
+        result.monotonic = (uint64_t)((int64_t)deviceTimestamp + yOrigin + (int64_t)llround(y));
+        result.realtime = (uint64_t)((int64_t)result.monotonic + realtimeOffset);
+        // The midpoint of a latch can be off by up to half its round trip in
+        // the same direction every time, which no amount of averaging removes
+        result.errorNs = (uint64_t)ceil(errorSigmas * StandardError(x) + latchUncertainty);
+        result.valid = true;
+        return result;
+    }
+
+    // Error bound of a timestamp taken at the newest latch
+    double CurrentErrorBound() const
+    {
+        return samples > 0 ? errorSigmas * StandardError(lastX) + latchUncertainty : 0.0;
+    }
+};
+
+enum clockSampleResult
+{
+    CLOCK_SAMPLE_ACCEPTED,
+    CLOCK_SAMPLE_SLOW_LATCH, // round trip too long to trust
+    CLOCK_SAMPLE_OUTLIER,    // too far from the fit
+    CLOCK_SAMPLE_RESET,      // the camera clock jumped; the fit restarted from this latch
+    CLOCK_LATCH_FAILED,      // the camera could not latch; counted by ClockSyncService only
+    NUM_CLOCK_SAMPLE_RESULTS
+};
+
+// Online least-squares fit of drift and offset over a sliding window of
+// latches, with two outlier gates: latches whose round trip is much longer
+// than usual (the thread was preempted or the link was busy), and latches
+// that disagree with the current fit. Not thread-safe; ClockSyncService
+// publishes the resulting ClockFit to readers.
+class ClockModel
+{
+  public:
+    explicit ClockModel(const ClockSyncConfig& config) : m_config(config), m_consecutiveRejects(0)
+    {
+        m_fit.errorSigmas = config.errorSigmas;
+    }
+
+    clockSampleResult AddSample(const ClockSample& sample)
+    {
+        const uint64_t roundTrip = sample.hostAfter > sample.hostBefore ? sample.hostAfter - sample.hostBefore : 0;
+        const uint64_t hostMid = sample.hostBefore + roundTrip / 2;
+        clockSampleResult result = CLOCK_SAMPLE_ACCEPTED;
+        m_roundTrips.push_back(roundTrip);
+        if (m_roundTrips.size() > m_config.windowSize)
+        {
+            m_roundTrips.pop_front();
+        }
+        if (!m_window.empty() && sample.deviceTimestamp <= m_window.back().deviceTimestamp)
+        {
+            // Counter went backwards: a bad reading, or a camera reset if it persists
+            result = CLOCK_SAMPLE_OUTLIER;
+        }
+        else if (m_roundTrips.size() >= m_config.minSamples &&
+                 (double)roundTrip > m_config.roundTripFactor * (double)MedianRoundTrip())
+        {
+            result = CLOCK_SAMPLE_SLOW_LATCH;
+        }
+        else if (m_fit.samples >= m_config.minSamples)
+        {
+            const double x = (double)(int64_t)(sample.deviceTimestamp - m_fit.xOrigin);
+            const double y = (double)((int64_t)(hostMid - sample.deviceTimestamp) - m_fit.yOrigin);
+            const double limit = std::max((double)m_config.residualFloorNs,
+                                          m_config.residualFactor * std::max(m_fit.sigma, m_fit.StandardError(x)));
+            if (fabs(y - m_fit.Predict(x)) > limit)
+            {
+                result = CLOCK_SAMPLE_OUTLIER;
+            }
+        }
+        if (result != CLOCK_SAMPLE_ACCEPTED)
+        {
+            if (++m_consecutiveRejects < m_config.maxConsecutiveRejects)
+            {
+                return result;
+            }
+            Reset(sample, hostMid, roundTrip);
+            return CLOCK_SAMPLE_RESET;
+        }
+        m_consecutiveRejects = 0;
+        if (m_window.empty())
+        {
+            m_fit.xOrigin = sample.deviceTimestamp;
+            m_fit.yOrigin = (int64_t)(hostMid - sample.deviceTimestamp);
+        }
+        Point point;
+        point.deviceTimestamp = sample.deviceTimestamp;
+        point.x = (double)(int64_t)(sample.deviceTimestamp - m_fit.xOrigin);
+        point.y = (double)((int64_t)(hostMid - sample.deviceTimestamp) - m_fit.yOrigin);
+        point.roundTrip = roundTrip;
+        m_window.push_back(point);
+        if (m_window.size() > m_config.windowSize)
+        {
+            m_window.pop_front();
+        }
+        m_fit.realtimeOffset = sample.realtimeOffset;
+        Refit();
+        return result;
+    }
+
+    const ClockFit& GetFit() const
+    {
+        return m_fit;
+    }
+
+  private:
+    struct Point
+    {
+        uint64_t deviceTimestamp;
+        double x;
+        double y;
+        uint64_t roundTrip;
+    };
+
+    void Reset(const ClockSample& sample, uint64_t hostMid, uint64_t roundTrip)
+    {
+        m_window.clear();
+        m_roundTrips.clear();
+        m_roundTrips.push_back(roundTrip);
+        m_consecutiveRejects = 0;
+        m_fit = ClockFit();
+        m_fit.errorSigmas = m_config.errorSigmas;
+        m_fit.xOrigin = sample.deviceTimestamp;
+        m_fit.yOrigin = (int64_t)(hostMid - sample.deviceTimestamp);
+        m_fit.realtimeOffset = sample.realtimeOffset;
+        Point point;
+        point.deviceTimestamp = sample.deviceTimestamp;
+        point.x = 0.0;
+        point.y = 0.0;
+        point.roundTrip = roundTrip;
+        m_window.push_back(point);
+        Refit();
+    }
+
+    uint64_t MedianRoundTrip() const
+    {
+        std::vector<uint64_t> sorted(m_roundTrips.begin(), m_roundTrips.end());
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+
+    void Refit()
+    {
+        const size_t n = m_window.size();
+        double xMean = 0.0;
+        double yMean = 0.0;
+        uint64_t minRoundTrip = m_window[0].roundTrip;
+        for (size_t i = 0; i < n; i++)
+        {
+            xMean += m_window[i].x;
+            yMean += m_window[i].y;
+            minRoundTrip = std::min(minRoundTrip, m_window[i].roundTrip);
+        }
+        xMean /= n;
+        yMean /= n;
+        double sxx = 0.0;
+        double sxy = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const double dx = m_window[i].x - xMean;
+            sxx += dx * dx;
+            sxy += dx * (m_window[i].y - yMean);
+        }
+        const double drift = sxx > 0.0 ? sxy / sxx : 0.0;
+        double sse = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const double residual = m_window[i].y - yMean - drift * (m_window[i].x - xMean);
+            sse += residual * residual;
+        }
+        m_fit.xMean = xMean;
+        m_fit.offset = yMean;
+        m_fit.drift = drift;
+        m_fit.sxx = sxx;
+        m_fit.firstX = m_window.front().x;
+        m_fit.lastX = m_window.back().x;
+        m_fit.samples = (unsigned int)n;
+        m_fit.latchUncertainty = minRoundTrip / 2.0;
+        // Never trust a fit more than the spread of a latch taken at a
+        // uniformly random point of its round trip
+        const double latchSigma = minRoundTrip / sqrt(12.0);
+        m_fit.sigma = std::max(latchSigma, n > 2 ? sqrt(sse / (n - 2)) : 0.0);
+    }
+
+    const ClockSyncConfig m_config;
+    std::deque<Point> m_window;
+    std::deque<uint64_t> m_roundTrips;
+    unsigned int m_consecutiveRejects;
+    ClockFit m_fit;
+};
+
+// Keeps one ClockModel per camera up to date from a background thread that
+// latches the timestamp counter of every active camera each interval. A
+// camera is active from Activate(), once it is initialized, until Suspend(),
+// before it is deinitialized. ToHost() maps a
+// device timestamp of any camera onto the host clocks, so frames of different
+// cameras can be aligned on one time base; it only copies the published fit
+// under a short lock and is cheap enough for the grab path.
+class ClockSyncService
+{
+  public:
+    // Latches the camera clock and fills in the sample. Returns 0 on success,
+    // -1 if the camera cannot latch.
+    typedef std::function<int(ClockSample&)> LatchFunction;
+
+    ClockSyncService(const ClockSyncConfig& config, unsigned int intervalMs)
+        : m_config(config), m_intervalMs(intervalMs), m_running(false)
+    {
+    }
+
+    ~ClockSyncService()
+    {
+        Stop();
+    }
+
+    // Registers a camera before Start(); returns its index for ToHost()
+    unsigned int AddClock(const std::string& name, LatchFunction latch)
+    {
+        m_clocks.push_back(std::unique_ptr<Clock>(new Clock(name, latch, m_config)));
+        return (unsigned int)(m_clocks.size() - 1);
+    }
+
+    void Start()
+    {
+        m_running = true;
+        m_thread = std::thread(&ClockSyncService::Run, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+            {
+                return;
+            }
+            m_running = false;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+
+    // Takes minSamples latches of the camera right away, so that its first
+    // frames are already mapped, and includes it in the periodic latches
+    void Activate(unsigned int clock)
+    {
+        Clock& state = *m_clocks[clock];
+        for (unsigned int round = 0; round < m_config.minSamples; round++)
+        {
+            if (round > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            Latch(state, false);
+        }
+        state.active = true;
+    }
+
+    // Stops latching the camera; its last fit stays usable
+    void Suspend(unsigned int clock)
+    {
+        Clock& state = *m_clocks[clock];
+        state.active = false;
+        // Wait out a latch that already started
+        std::lock_guard<std::mutex> lock(state.modelMutex);
+    }
+
+    SyncedTimestamp ToHost(unsigned int clock, uint64_t deviceTimestamp) const
+    {
+        ClockFit fit;
+        {
+            std::lock_guard<std::mutex> lock(m_clocks[clock]->fitMutex);
+            fit = m_clocks[clock]->fit;
+        }
+        return fit.Map(deviceTimestamp, m_config);
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out) const
+    {
+        CollectFamily(out, "recorder_clock_drift_ppm", [](const ClockFit& fit) { return fit.drift * 1e6; });
+        CollectFamily(out, "recorder_clock_error_bound_ns",
+                      [](const ClockFit& fit) { return fit.CurrentErrorBound(); });
+        CollectFamily(out, "recorder_clock_sigma_ns", [](const ClockFit& fit) { return fit.sigma; });
+        out += "# TYPE recorder_clock_latches_total counter\n";
+        static const char* k_resultNames[] = {"accepted", "slow_latch", "outlier", "reset", "failed"};
+        char line[256];
+        for (size_t i = 0; i < m_clocks.size(); i++)
+        {
+            for (int r = 0; r < NUM_CLOCK_SAMPLE_RESULTS; r++)
+            {
+                snprintf(line, sizeof(line), "recorder_clock_latches_total{camera=\"%s\",result=\"%s\"} %llu\n",
+                         m_clocks[i]->name.c_str(), k_resultNames[r],
+                         (unsigned long long)m_clocks[i]->counters[r].load(std::memory_order_relaxed));
+                out += line;
+            }
+        }
+    }
+
+    void PrintSummary() const
+    {
+        for (size_t i = 0; i < m_clocks.size(); i++)
+        {
+            const Clock& clock = *m_clocks[i];
+            ClockFit fit;
+            {
+                std::lock_guard<std::mutex> lock(clock.fitMutex);
+                fit = clock.fit;
+            }
+            printf("[%s] Clock sync: drift %.3f ppm, sigma %.1f us, %llu latches accepted, %llu slow, %llu outliers, "
+                   "%llu resets, %llu failed\n",
+                   clock.name.c_str(), fit.drift * 1e6, fit.sigma / 1e3,
+                   (unsigned long long)clock.counters[CLOCK_SAMPLE_ACCEPTED].load(),
+                   (unsigned long long)clock.counters[CLOCK_SAMPLE_SLOW_LATCH].load(),
+                   (unsigned long long)clock.counters[CLOCK_SAMPLE_OUTLIER].load(),
+                   (unsigned long long)clock.counters[CLOCK_SAMPLE_RESET].load(),
+                   (unsigned long long)clock.counters[CLOCK_LATCH_FAILED].load());
+        }
+    }
+
+  private:
+    struct Clock
+    {
+        std::string name;
+        LatchFunction latch;
+        std::atomic<bool> active;
+        std::mutex modelMutex; // held for a latch and the model update
+        ClockModel model;
+        mutable std::mutex fitMutex;
+        ClockFit fit; // published copy of model.GetFit()
+        std::atomic<uint64_t> counters[NUM_CLOCK_SAMPLE_RESULTS];
+        LogRateLimiter latchFailureLog; // rate limit of this clock's latch failures
+
+        Clock(const std::string& clockName, LatchFunction latchFunction, const ClockSyncConfig& config)
+            : name(clockName), latch(latchFunction), active(false), model(config)
+        {
+            for (int i = 0; i < NUM_CLOCK_SAMPLE_RESULTS; i++)
+            {
+                counters[i] = 0;
+            }
+        }
+    };
+
+    // One gauge per camera with a usable fit
+    template <class Value>
+    void CollectFamily(std::string& out, const char* metric, Value value) const
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "# TYPE %s gauge\n", metric);
+        out += line;
+        for (size_t i = 0; i < m_clocks.size(); i++)
+        {
+            ClockFit fit;
+            {
+                std::lock_guard<std::mutex> lock(m_clocks[i]->fitMutex);
+                fit = m_clocks[i]->fit;
+            }
+            if (fit.samples < m_config.minSamples)
+            {
+                continue;
+            }
+            snprintf(line, sizeof(line), "%s{camera=\"%s\"} %.3f\n", metric, m_clocks[i]->name.c_str(),
+                     value(fit));
+            out += line;
+        }
+    }
+
+    void Latch(Clock& clock, bool onlyIfActive)
+    {
+        std::lock_guard<std::mutex> modelLock(clock.modelMutex);
+        if (onlyIfActive && !clock.active)
+        {
+            return;
+        }
+        ClockSample sample;
+        if (clock.latch(sample) < 0)
+        {
+            clock.counters[CLOCK_LATCH_FAILED]++;
+            ASYNC_LOG_RATE_LIMITED_BY(clock.latchFailureLog, SEVERITY_WARNING, 10000,
+                                      "[{}] Unable to latch the camera clock", clock.name);
+            return;
+        }
+        const clockSampleResult result = clock.model.AddSample(sample);
+        clock.counters[result]++;
+        if (result == CLOCK_SAMPLE_RESET)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "[{}] Camera clock jumped, clock sync restarted", clock.name);
+        }
+        std::lock_guard<std::mutex> fitLock(clock.fitMutex);
+        clock.fit = clock.model.GetFit();
+    }
+
+    void LatchActive()
+    {
+        for (size_t i = 0; i < m_clocks.size(); i++)
+        {
+            Latch(*m_clocks[i], true);
+        }
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_intervalMs));
+            if (!m_running)
+            {
+                break;
+            }
+            lock.unlock();
+            LatchActive();
+            lock.lock();
+        }
+    }
+
+    const ClockSyncConfig m_config;
+    const unsigned int m_intervalMs;
+    std::vector<std::unique_ptr<Clock> > m_clocks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_running;
+    std::thread m_thread;
+};
+
+#endif // DUAL_CAM_RECORDER_CLOCK_SYNC_H
@@ -0,0 +1,702 @@
+/*
+ * @Descripttion: RGGB demosaic, white balance and color correction to BGR8 or I420, SIMD kernels over row bands
+ * @version:
+ * @Date: 2026-10-20 03:48:30
+ * @LastEditTime: 2026-10-20 03:48:30
+ */
+
+#ifndef DUAL_CAM_RECORDER_COLOR_PIPELINE_H
+#define DUAL_CAM_RECORDER_COLOR_PIPELINE_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frame_arena.h"
+#include "task_scheduler.h"
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define COLOR_PIPELINE_SIMD 1
+#endif
+
+// How the two missing colors of each Bayer sample are estimated
+enum demosaicMethod
+{
+    DEMOSAIC_BILINEAR,   // average of the nearest samples of the color
+    DEMOSAIC_EDGE_AWARE, // green along the smoother direction with a Laplacian correction, then red and
+                         // blue from color differences to green (Hamilton-Adams)
+    NUM_DEMOSAIC_METHODS
+};
+
+inline const char* GetDemosaicMethodName(demosaicMethod method)
+{
+    static const char* k_names[NUM_DEMOSAIC_METHODS] = {"bilinear", "edge_aware"};
+    return method < NUM_DEMOSAIC_METHODS ? k_names[method] : "unknown";
+}
+
+enum colorOutput
+{
+    COLOR_OUTPUT_BGR8,   // packed, for JPEG_INPUT_BGR
+    COLOR_OUTPUT_YUV420, // I420 planes, for JPEG_INPUT_YUV420
+    NUM_COLOR_OUTPUTS
+};
+
+inline const char* GetColorOutputName(colorOutput output)
+{
+    static const char* k_names[NUM_COLOR_OUTPUTS] = {"BGR8", "YUV420"};
+    return output < NUM_COLOR_OUTPUTS ? k_names[output] : "unknown";
+}
+
+enum colorKernel
+{
+    COLOR_KERNEL_SCALAR,
+    COLOR_KERNEL_SSE2,
+    NUM_COLOR_KERNELS
+};
+
+inline const char* GetColorKernelName(colorKernel kernel)
+{
+    static const char* k_names[NUM_COLOR_KERNELS] = {"scalar", "sse2"};
+    return kernel < NUM_COLOR_KERNELS ? k_names[kernel] : "unknown";
+}
+
+// What ColorPipeline does to a BayerRG8 frame: demosaic, white balance gains,
+// then the color correction matrix, then packing
+struct ColorConfig
+{
+    demosaicMethod demosaic;
+    colorOutput output;
+    double whiteBalance[3]; // gains of red, green and blue
+    double ccm[9];          // row-major, from white-balanced camera RGB to output RGB
+
+    ColorConfig() : demosaic(DEMOSAIC_EDGE_AWARE), output(COLOR_OUTPUT_BGR8)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            whiteBalance[i] = 1.0;
+        }
+        for (int i = 0; i < 9; i++)
+        {
+            ccm[i] = i % 4 == 0 ? 1.0 : 0.0;
+        }
+    }
+};
+
+// A converted frame. BGR8 rows are 3 * width bytes, stride apart. YUV420 is
+// I420 in one buffer: width x height Y rows stride apart, then the U and V
+// planes at half resolution with rows stride / 2 apart. The stride is then a
+// multiple of 16 and the padding repeats each row's last pixel, so libjpeg
+// can read whole blocks.
+struct ColorFrame
+{
+    ArenaBytes data;
+    colorOutput output;
+    unsigned int width;
+    unsigned int height;
+    size_t stride;
+
+    explicit ColorFrame(FrameArena* arena = nullptr)
+        : data(ArenaAllocator<uint8_t>(arena)), output(COLOR_OUTPUT_BGR8), width(0), height(0), stride(0)
+    {
+    }
+
+    // YUV420 plane 0 (Y), 1 (U) or 2 (V)
+    uint8_t* GetPlane(unsigned int plane)
+    {
+        const size_t chromaSize = stride / 2 * ((height + 1) / 2);
+        return &data[0] + (plane == 0 ? 0 : stride * height + (plane - 1) * chromaSize);
+    }
+};
+
+// Q12 fixed-point form of out = M * (r, g, b) + offset, per output channel
+struct ColorMatrix
+{
+    int16_t m[9];
+    int16_t offset[3];
+};
+
+// Mirrors an index into [0, size) without repeating the edge sample, which
+// keeps the Bayer phase: -1 maps to 1 and size to size - 2
+inline int ReflectBayer(int i, int size)
+{
+    return i < 0 ? -i : (i >= size ? 2 * size - 2 - i : i);
+}
+
+inline uint8_t ClampColor(int value)
+{
+    return (uint8_t)std::min(255, std::max(0, value));
+}
+
+// Green of row y at columns [x0, x1), given raw rows y - 2 .. y + 2; the
+// scalar reference. RGGB puts green where x + y is odd.
+inline void DemosaicGreenScalar(const uint8_t* const* rows, unsigned int y, int width, demosaicMethod method,
+                                uint8_t* green, int x0, int x1)
+{
+    const uint8_t* row = rows[2];
+    for (int x = x0; x < x1; x++)
+    {
+        if (((unsigned int)x + y) & 1)
+        {
+            green[x] = row[x];
+            continue;
+        }
+        const int c = row[x];
+        const int n = rows[1][x];
+        const int s = rows[3][x];
+        const int w = row[ReflectBayer(x - 1, width)];
+        const int e = row[ReflectBayer(x + 1, width)];
+        if (method == DEMOSAIC_BILINEAR)
+        {
+            green[x] = (uint8_t)((n + s + w + e + 2) >> 2);
+            continue;
+        }
+        const int lapH = 2 * c - row[ReflectBayer(x - 2, width)] - row[ReflectBayer(x + 2, width)];
+        const int lapV = 2 * c - rows[0][x] - rows[4][x];
+        const int dh = abs(w - e) + abs(lapH);
+        const int dv = abs(n - s) + abs(lapV);
+        const int gh = 2 * (w + e) + lapH;
+        const int gv = 2 * (n + s) + lapV;
+        green[x] = ClampColor(dh < dv ? (gh + 2) >> 2 : (dv < dh ? (gv + 2) >> 2 : (gh + gv + 4) >> 3));
+    }
+}
+
+// Red and blue of row y at columns [x0, x1), given raw rows y - 1 .. y + 1
+// and their green rows; the scalar reference. H, V and D estimate the color
+// of the horizontal, vertical and diagonal neighbours; which one a site
+// needs depends on its place in the RGGB pattern.
+inline void DemosaicRedBlueScalar(const uint8_t* const* raw, const uint8_t* const* green, unsigned int y, int width,
+                                  demosaicMethod method, uint8_t* red, uint8_t* blue, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++)
+    {
+        const int xw = ReflectBayer(x - 1, width);
+        const int xe = ReflectBayer(x + 1, width);
+        const int c = raw[1][x];
+        int h;
+        int v;
+        int d;
+        if (method == DEMOSAIC_BILINEAR)
+        {
+            h = (raw[1][xw] + raw[1][xe] + 1) >> 1;
+            v = (raw[0][x] + raw[2][x] + 1) >> 1;
+            d = (raw[0][xw] + raw[0][xe] + raw[2][xw] + raw[2][xe] + 2) >> 2;
+        }
+        else
+        {
+            const int g = green[1][x];
+            h = ClampColor(g + (((raw[1][xw] - green[1][xw]) + (raw[1][xe] - green[1][xe])) >> 1));
+            v = ClampColor(g + (((raw[0][x] - green[0][x]) + (raw[2][x] - green[2][x])) >> 1));
+            d = ClampColor(g + (((raw[0][xw] - green[0][xw]) + (raw[0][xe] - green[0][xe]) +
+                                 (raw[2][xw] - green[2][xw]) + (raw[2][xe] - green[2][xe])) >>
+                                2));
+        }
+        const bool evenX = (x & 1) == 0;
+        if ((y & 1) == 0)
+        {
+            red[x] = (uint8_t)(evenX ? c : h);
+            blue[x] = (uint8_t)(evenX ? d : v);
+        }
+        else
+        {
+            red[x] = (uint8_t)(evenX ? v : d);
+            blue[x] = (uint8_t)(evenX ? h : c);
+        }
+    }
+}
+
+// out[c] = clamp(((M[c] . (r, g, b) + 2048) >> 12) + offset[c]) at columns
+// [x0, x1); the scalar reference
+inline void ApplyColorMatrixScalar(const ColorMatrix& matrix, const uint8_t* r, const uint8_t* g, const uint8_t* b,
+                                   uint8_t* const* out, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            const int sum = matrix.m[3 * c] * r[x] + matrix.m[3 * c + 1] * g[x] + matrix.m[3 * c + 2] * b[x];
+            out[c][x] = ClampColor(((sum + 2048) >> 12) + matrix.offset[c]);
+        }
+    }
+}
+
+#if defined(COLOR_PIPELINE_SIMD)
+// Lanes of 8 consecutive columns starting at an even one whose column is odd
+inline __m128i GetOddColumnLanes()
+{
+    return _mm_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+}
+
+inline __m128i LoadBayer8(const uint8_t* pixels)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pixels), _mm_setzero_si128());
+}
+
+inline __m128i SelectColor(__m128i mask, __m128i ifSet, __m128i otherwise)
+{
+    return _mm_or_si128(_mm_and_si128(mask, ifSet), _mm_andnot_si128(mask, otherwise));
+}
+
+inline __m128i AbsColor(__m128i value)
+{
+    return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+// SSE2 kernels: 8 columns per step from column 2 on, the same integer
+// operations as the scalar ones, so results are bit-identical. They leave
+// the first 2 columns and the tail to the scalar kernels and return the
+// first column they did not process.
+inline int DemosaicGreenSse2(const uint8_t* const* rows, unsigned int y, int width, demosaicMethod method,
+                             uint8_t* green)
+{
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i four = _mm_set1_epi16(4);
+    const __m128i odd = GetOddColumnLanes();
+    const __m128i greenLanes = (y & 1) ? _mm_xor_si128(odd, _mm_set1_epi16(-1)) : odd;
+    const uint8_t* row = rows[2];
+    int x = 2;
+    for (; x + 10 <= width; x += 8)
+    {
+        const __m128i c = LoadBayer8(row + x);
+        const __m128i n = LoadBayer8(rows[1] + x);
+        const __m128i s = LoadBayer8(rows[3] + x);
+        const __m128i w = LoadBayer8(row + x - 1);
+        const __m128i e = LoadBayer8(row + x + 1);
+        __m128i g;
+        if (method == DEMOSAIC_BILINEAR)
+        {
+            g = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(n, s), _mm_add_epi16(w, e)), two), 2);
+        }
+        else
+        {
+            const __m128i c2 = _mm_add_epi16(c, c);
+            const __m128i lapH = _mm_sub_epi16(_mm_sub_epi16(c2, LoadBayer8(row + x - 2)), LoadBayer8(row + x + 2));
+            const __m128i lapV = _mm_sub_epi16(_mm_sub_epi16(c2, LoadBayer8(rows[0] + x)), LoadBayer8(rows[4] + x));
+            const __m128i dh = _mm_add_epi16(AbsColor(_mm_sub_epi16(w, e)), AbsColor(lapH));
+            const __m128i dv = _mm_add_epi16(AbsColor(_mm_sub_epi16(n, s)), AbsColor(lapV));
+            const __m128i gh = _mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(w, e), 1), lapH);
+            const __m128i gv = _mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(n, s), 1), lapV);
+            const __m128i alongH = _mm_srai_epi16(_mm_add_epi16(gh, two), 2);
+            const __m128i alongV = _mm_srai_epi16(_mm_add_epi16(gv, two), 2);
+            const __m128i both = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(gh, gv), four), 3);
+            g = SelectColor(_mm_cmplt_epi16(dh, dv), alongH, SelectColor(_mm_cmplt_epi16(dv, dh), alongV, both));
+        }
+        g = SelectColor(greenLanes, c, g);
+        _mm_storel_epi64((__m128i*)(green + x), _mm_packus_epi16(g, g));
+    }
+    return x;
+}
+
+inline int DemosaicRedBlueSse2(const uint8_t* const* raw, const uint8_t* const* green, unsigned int y, int width,
+                               demosaicMethod method, uint8_t* red, uint8_t* blue)
+{
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i odd = GetOddColumnLanes();
+    int x = 2;
+    for (; x + 10 <= width; x += 8)
+    {
+        const __m128i c = LoadBayer8(raw[1] + x);
+        const __m128i w = LoadBayer8(raw[1] + x - 1);
+        const __m128i e = LoadBayer8(raw[1] + x + 1);
+        const __m128i n = LoadBayer8(raw[0] + x);
+        const __m128i s = LoadBayer8(raw[2] + x);
+        const __m128i nw = LoadBayer8(raw[0] + x - 1);
+        const __m128i ne = LoadBayer8(raw[0] + x + 1);
+        const __m128i sw = LoadBayer8(raw[2] + x - 1);
+        const __m128i se = LoadBayer8(raw[2] + x + 1);
+        __m128i h;
+        __m128i v;
+        __m128i d;
+        if (method == DEMOSAIC_BILINEAR)
+        {
+            h = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(w, e), one), 1);
+            v = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(n, s), one), 1);
+            d = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(nw, ne), _mm_add_epi16(sw, se)), two), 2);
+        }
+        else
+        {
+            const __m128i g = LoadBayer8(green[1] + x);
+            const __m128i dw = _mm_sub_epi16(w, LoadBayer8(green[1] + x - 1));
+            const __m128i de = _mm_sub_epi16(e, LoadBayer8(green[1] + x + 1));
+            const __m128i dn = _mm_sub_epi16(n, LoadBayer8(green[0] + x));
+            const __m128i ds = _mm_sub_epi16(s, LoadBayer8(green[2] + x));
+            const __m128i dnw = _mm_sub_epi16(nw, LoadBayer8(green[0] + x - 1));
+            const __m128i dne = _mm_sub_epi16(ne, LoadBayer8(green[0] + x + 1));
+            const __m128i dsw = _mm_sub_epi16(sw, LoadBayer8(green[2] + x - 1));
+            const __m128i dse = _mm_sub_epi16(se, LoadBayer8(green[2] + x + 1));
+            h = _mm_add_epi16(g, _mm_srai_epi16(_mm_add_epi16(dw, de), 1));
+            v = _mm_add_epi16(g, _mm_srai_epi16(_mm_add_epi16(dn, ds), 1));
+            d = _mm_add_epi16(g, _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(dnw, dne), _mm_add_epi16(dsw, dse)), 2));
+        }
+        __m128i r;
+        __m128i b;
+        if ((y & 1) == 0)
+        {
+            r = SelectColor(odd, h, c);
+            b = SelectColor(odd, v, d);
+        }
+        else
+        {
+            r = SelectColor(odd, d, v);
+            b = SelectColor(odd, c, h);
+        }
+        _mm_storel_epi64((__m128i*)(red + x), _mm_packus_epi16(r, r));
+        _mm_storel_epi64((__m128i*)(blue + x), _mm_packus_epi16(b, b));
+    }
+    return x;
+}
+
+// 16 pixels per step from column 0
+inline int ApplyColorMatrixSse2(const ColorMatrix& matrix, const uint8_t* r, const uint8_t* g, const uint8_t* b,
+                                uint8_t* const* out, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i coefRG[3];
+    __m128i coefB1[3];
+    __m128i offset[3];
+    for (int c = 0; c < 3; c++)
+    {
+        // Pairs of 16-bit coefficients, low word first, for _mm_madd_epi16
+        coefRG[c] = _mm_set1_epi32((int)((uint16_t)matrix.m[3 * c] | ((uint32_t)(uint16_t)matrix.m[3 * c + 1] << 16)));
+        coefB1[c] = _mm_set1_epi32((int)((uint16_t)matrix.m[3 * c + 2] | (2048u << 16)));
+        offset[c] = _mm_set1_epi16(matrix.offset[c]);
+    }
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i r8 = _mm_loadu_si128((const __m128i*)(r + x));
+        const __m128i g8 = _mm_loadu_si128((const __m128i*)(g + x));
+        const __m128i b8 = _mm_loadu_si128((const __m128i*)(b + x));
+        __m128i words[3][2];
+        for (int half = 0; half < 2; half++)
+        {
+            const __m128i r16 = half ? _mm_unpackhi_epi8(r8, zero) : _mm_unpacklo_epi8(r8, zero);
+            const __m128i g16 = half ? _mm_unpackhi_epi8(g8, zero) : _mm_unpacklo_epi8(g8, zero);
+            const __m128i b16 = half ? _mm_unpackhi_epi8(b8, zero) : _mm_unpacklo_epi8(b8, zero);
+            const __m128i rgLo = _mm_unpacklo_epi16(r16, g16);
+            const __m128i rgHi = _mm_unpackhi_epi16(r16, g16);
+            const __m128i b1Lo = _mm_unpacklo_epi16(b16, one);
+            const __m128i b1Hi = _mm_unpackhi_epi16(b16, one);
+            for (int c = 0; c < 3; c++)
+            {
+                const __m128i lo =
+                    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rgLo, coefRG[c]), _mm_madd_epi16(b1Lo, coefB1[c])), 12);
+                const __m128i hi =
+                    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rgHi, coefRG[c]), _mm_madd_epi16(b1Hi, coefB1[c])), 12);
+                words[c][half] = _mm_add_epi16(_mm_packs_epi32(lo, hi), offset[c]);
+            }
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            _mm_storeu_si128((__m128i*)(out[c] + x), _mm_packus_epi16(words[c][0], words[c][1]));
+        }
+    }
+    return x;
+}
+#endif
+
+// Turns BayerRG8 frames into color frames for the encoders. Configure()
+// fixes the demosaic, the white balance gains and color correction matrix,
+// folded into one fixed-point matrix together with the RGB to YCbCr
+// conversion for YUV420, and the output. Process() splits the frame into
+// bands of rows and runs them on a TaskScheduler, or inline without one.
+class ColorPipeline
+{
+  public:
+    ColorPipeline() : m_kernel(COLOR_KERNEL_SCALAR), m_identity(true)
+    {
+#if defined(COLOR_PIPELINE_SIMD)
+        m_kernel = COLOR_KERNEL_SSE2;
+#endif
+        Configure(ColorConfig());
+    }
+
+    // Returns -1 if a coefficient of the folded matrix is out of the fixed
+    // point range (magnitude 8 or more); the configuration is then kept
+    int Configure(const ColorConfig& config)
+    {
+        if (config.demosaic >= NUM_DEMOSAIC_METHODS || config.output >= NUM_COLOR_OUTPUTS)
+        {
+            return -1;
+        }
+        // JFIF YCbCr, the full-range BT.601 JPEG uses
+        static const double k_toYCbCr[9] = {0.299, 0.587, 0.114, -0.168736, -0.331264, 0.5, 0.5, -0.418688,
+                                            -0.081312};
+        double folded[9];
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                double value = 0.0;
+                for (int k = 0; k < 3; k++)
+                {
+                    const double ycc = config.output == COLOR_OUTPUT_YUV420 ? k_toYCbCr[3 * row + k] : row == k;
+                    value += ycc * config.ccm[3 * k + col];
+                }
+                folded[3 * row + col] = value * config.whiteBalance[col];
+            }
+        }
+        ColorMatrix matrix;
+        bool identity = config.output == COLOR_OUTPUT_BGR8;
+        for (int i = 0; i < 9; i++)
+        {
+            const long coefficient = lround(folded[i] * 4096.0);
+            if (coefficient <= -32768 || coefficient >= 32768)
+            {
+                return -1;
+            }
+            matrix.m[i] = (int16_t)coefficient;
+            identity = identity && coefficient == (i % 4 == 0 ? 4096 : 0);
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            matrix.offset[c] = config.output == COLOR_OUTPUT_YUV420 && c > 0 ? 128 : 0;
+        }
+        m_config = config;
+        m_matrix = matrix;
+        m_identity = identity;
+        return 0;
+    }
+
+    const ColorConfig& GetConfig() const
+    {
+        return m_config;
+    }
+
+    // Picks a kernel, e.g. to compare them; falls back to scalar if the
+    // build has no SIMD
+    void SetKernel(colorKernel kernel)
+    {
+        m_kernel = COLOR_KERNEL_SCALAR;
+#if defined(COLOR_PIPELINE_SIMD)
+        m_kernel = kernel;
+#else
+        (void)kernel;
+#endif
+    }
+
+    colorKernel GetKernel() const
+    {
+        return m_kernel;
+    }
+
+    // e.g. "edge_aware -> BGR8 (sse2)"
+    std::string Describe() const
+    {
+        return std::string(GetDemosaicMethodName(m_config.demosaic)) + " -> " + GetColorOutputName(m_config.output) +
+               " (" + GetColorKernelName(m_kernel) + ")";
+    }
+
+    // Converts a width x height BayerRG8 frame with rows stride bytes apart.
+    // bandRows rows (rounded up to even) go to each task; the calling thread
+    // runs the last band and waits for the rest. Returns -1 if the frame is
+    // smaller than 4 x 4.
+    int Process(const uint8_t* bayer, size_t stride, unsigned int width, unsigned int height, ColorFrame& frame,
+                TaskScheduler* scheduler = nullptr, unsigned int bandRows = 64) const
+    {
+        if (width < 4 || height < 4)
+        {
+            return -1;
+        }
+        frame.output = m_config.output;
+        frame.width = width;
+        frame.height = height;
+        if (m_config.output == COLOR_OUTPUT_BGR8)
+        {
+            frame.stride = (size_t)width * 3;
+            frame.data.resize(frame.stride * height);
+        }
+        else
+        {
+            frame.stride = ((size_t)width + 15) & ~(size_t)15;
+            frame.data.resize(frame.stride * height + frame.stride / 2 * ((height + 1) / 2) * 2);
+        }
+        bandRows = std::max(2u, (bandRows + 1) & ~1u);
+        const unsigned int numBands = scheduler == nullptr ? 1 : (height + bandRows - 1) / bandRows;
+        if (numBands <= 1)
+        {
+            ProcessBand(bayer, stride, width, height, 0, height, frame);
+            return 0;
+        }
+
+        struct Latch
+        {
+            std::mutex mutex;
+            std::condition_variable done;
+            unsigned int remaining;
+        } latch;
+        latch.remaining = numBands - 1;
+        const ColorPipeline* self = this;
+        ColorFrame* pFrame = &frame;
+        Latch* pLatch = &latch;
+        for (unsigned int band = 0; band + 1 < numBands; band++)
+        {
+            const unsigned int rowBegin = band * bandRows;
+            scheduler->Submit([self, bayer, stride, width, height, rowBegin, bandRows, pFrame, pLatch]() {
+                self->ProcessBand(bayer, stride, width, height, rowBegin, rowBegin + bandRows, *pFrame);
+                std::lock_guard<std::mutex> lock(pLatch->mutex);
+                if (--pLatch->remaining == 0)
+                {
+                    pLatch->done.notify_one();
+                }
+            });
+        }
+        ProcessBand(bayer, stride, width, height, (numBands - 1) * bandRows, height, frame);
+        std::unique_lock<std::mutex> lock(latch.mutex);
+        latch.done.wait(lock, [&]() { return latch.remaining == 0; });
+        return 0;
+    }
+
+  private:
+    void DemosaicGreen(const uint8_t* bayer, size_t stride, int width, int height, int y, uint8_t* green) const
+    {
+        const uint8_t* rows[5];
+        for (int k = 0; k < 5; k++)
+        {
+            rows[k] = bayer + (size_t)ReflectBayer(y + k - 2, height) * stride;
+        }
+        int done = 0;
+#if defined(COLOR_PIPELINE_SIMD)
+        if (m_kernel == COLOR_KERNEL_SSE2)
+        {
+            DemosaicGreenScalar(rows, (unsigned int)y, width, m_config.demosaic, green, 0, 2);
+            done = DemosaicGreenSse2(rows, (unsigned int)y, width, m_config.demosaic, green);
+        }
+#endif
+        DemosaicGreenScalar(rows, (unsigned int)y, width, m_config.demosaic, green, done, width);
+    }
+
+    // Rows [rowBegin, rowEnd); rowBegin is even, so YUV420 chroma rows are
+    // never split between bands
+    void ProcessBand(const uint8_t* bayer, size_t stride, unsigned int width, unsigned int height,
+                     unsigned int rowBegin, unsigned int rowEnd, ColorFrame& frame) const
+    {
+        const int w = (int)width;
+        const int h = (int)height;
+        rowEnd = std::min(rowEnd, height);
+        // Green of rows y - 1, y and y + 1, red, blue, the matrix output and
+        // for YUV420 the full resolution U and V of the previous row
+        std::vector<uint8_t> scratch((size_t)width * 10);
+        uint8_t* greenRows[3] = {&scratch[0], &scratch[width], &scratch[2 * (size_t)width]};
+        uint8_t* red = &scratch[3 * (size_t)width];
+        uint8_t* blue = &scratch[4 * (size_t)width];
+        uint8_t* out[3] = {&scratch[5 * (size_t)width], &scratch[6 * (size_t)width], &scratch[7 * (size_t)width]};
+        uint8_t* previousUV[2] = {&scratch[8 * (size_t)width], &scratch[9 * (size_t)width]};
+        DemosaicGreen(bayer, stride, w, h, ReflectBayer((int)rowBegin - 1, h), greenRows[0]);
+        DemosaicGreen(bayer, stride, w, h, (int)rowBegin, greenRows[1]);
+        for (unsigned int y = rowBegin; y < rowEnd; y++)
+        {
+            DemosaicGreen(bayer, stride, w, h, ReflectBayer((int)y + 1, h), greenRows[2]);
+            const uint8_t* raw[3];
+            for (int k = 0; k < 3; k++)
+            {
+                raw[k] = bayer + (size_t)ReflectBayer((int)y + k - 1, h) * stride;
+            }
+            const uint8_t* green[3] = {greenRows[0], greenRows[1], greenRows[2]};
+            int done = 0;
+#if defined(COLOR_PIPELINE_SIMD)
+            if (m_kernel == COLOR_KERNEL_SSE2)
+            {
+                DemosaicRedBlueScalar(raw, green, y, w, m_config.demosaic, red, blue, 0, 2);
+                done = DemosaicRedBlueSse2(raw, green, y, w, m_config.demosaic, red, blue);
+            }
+#endif
+            DemosaicRedBlueScalar(raw, green, y, w, m_config.demosaic, red, blue, done, w);
+
+            if (m_config.output == COLOR_OUTPUT_YUV420)
+            {
+                // Y straight into its plane
+                out[0] = frame.GetPlane(0) + (size_t)y * frame.stride;
+            }
+            const uint8_t* rgb[3] = {red, greenRows[1], blue};
+            if (!m_identity)
+            {
+                ApplyMatrix(red, greenRows[1], blue, out, w);
+                for (int c = 0; c < 3; c++)
+                {
+                    rgb[c] = out[c];
+                }
+            }
+            if (m_config.output == COLOR_OUTPUT_BGR8)
+            {
+                uint8_t* bgr = &frame.data[0] + (size_t)y * frame.stride;
+                for (unsigned int x = 0; x < width; x++)
+                {
+                    bgr[3 * x] = rgb[2][x];
+                    bgr[3 * x + 1] = rgb[1][x];
+                    bgr[3 * x + 2] = rgb[0][x];
+                }
+            }
+            else
+            {
+                PadRow(out[0], width, frame.stride);
+                if ((y & 1) == 0)
+                {
+                    memcpy(previousUV[0], out[1], width);
+                    memcpy(previousUV[1], out[2], width);
+                }
+                if ((y & 1) == 1 || y + 1 == height)
+                {
+                    WriteChromaRow(previousUV, out + 1, y / 2, frame);
+                }
+            }
+            std::swap(greenRows[0], greenRows[1]);
+            std::swap(greenRows[1], greenRows[2]);
+        }
+    }
+
+    void ApplyMatrix(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* const* out, int width) const
+    {
+        int done = 0;
+#if defined(COLOR_PIPELINE_SIMD)
+        if (m_kernel == COLOR_KERNEL_SSE2)
+        {
+            done = ApplyColorMatrixSse2(m_matrix, r, g, b, out, width);
+        }
+#endif
+        ApplyColorMatrixScalar(m_matrix, r, g, b, out, done, width);
+    }
+
+    // Averages 2x2 blocks of full resolution U and V of two rows into chroma
+    // row chromaRow; on the last row of an odd height both rows are the same
+    void WriteChromaRow(uint8_t* const* top, uint8_t* const* bottom, unsigned int chromaRow, ColorFrame& frame) const
+    {
+        const unsigned int width = frame.width;
+        const size_t chromaStride = frame.stride / 2;
+        for (int c = 0; c < 2; c++)
+        {
+            uint8_t* plane = frame.GetPlane(1 + c) + chromaRow * chromaStride;
+            for (unsigned int x = 0; x < width / 2; x++)
+            {
+                plane[x] = (uint8_t)((top[c][2 * x] + top[c][2 * x + 1] + bottom[c][2 * x] + bottom[c][2 * x + 1] +
+                                      2) >>
+                                     2);
+            }
+            if (width & 1)
+            {
+                plane[width / 2] = (uint8_t)((top[c][width - 1] + bottom[c][width - 1] + 1) >> 1);
+            }
+            PadRow(plane, (width + 1) / 2, chromaStride);
+        }
+    }
+
+    static void PadRow(uint8_t* row, size_t width, size_t stride)
+    {
+        memset(row + width, row[width - 1], stride - width);
+    }
+
+    ColorConfig m_config;
+    ColorMatrix m_matrix;
+    colorKernel m_kernel;
+    // BGR8 with unit gains and matrix: the demosaiced colors are packed as they are
+    bool m_identity;
+};
+
+#endif // DUAL_CAM_RECORDER_COLOR_PIPELINE_H
@@ -0,0 +1,317 @@
+/*
+ * @Descripttion: Multithreaded in-order frame decoding with bounded read-ahead for playback
+ * @version:
+ * @Date: 2026-10-19 19:40:36
+ * @LastEditTime: 2026-10-19 19:40:36
+ */
+
+#ifndef DUAL_CAM_RECORDER_DECODE_PIPELINE_H
+#define DUAL_CAM_RECORDER_DECODE_PIPELINE_H
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <jpeglib.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "packed_pixels.h"
+#include "session_index.h"
+#include "task_scheduler.h"
+
+// One frame read and decoded to pixels
+struct DecodedFrame
+{
+    SessionFrame frame;
+    std::vector<uint8_t> pixels;
+    unsigned int width;
+    unsigned int height;
+    unsigned int channels; // 1 gray, 3 RGB; 0 if the payload layout is unknown and pixels holds it as stored
+    unsigned int bitDepth; // 8, or 10/12 for packed frames, unpacked to 16-bit samples in native byte order
+    bool ok;
+    std::string error;
+
+    DecodedFrame() : width(0), height(0), channels(0), bitDepth(8), ok(false)
+    {
+    }
+};
+
+// Wraps one libjpeg decompressor, created once per thread like JpegEncoder
+class JpegDecoder
+{
+  public:
+    JpegDecoder()
+    {
+        m_cinfo.err = jpeg_std_error(&m_error.base);
+        m_error.base.error_exit = &JpegDecoder::OnError;
+        m_error.base.output_message = &JpegDecoder::OnMessage;
+        jpeg_create_decompress(&m_cinfo);
+    }
+
+    ~JpegDecoder()
+    {
+        jpeg_destroy_decompress(&m_cinfo);
+    }
+
+    static JpegDecoder& ForCurrentThread()
+    {
+        static thread_local JpegDecoder decoder;
+        return decoder;
+    }
+
+    // Decodes a JPEG held in memory to gray or RGB pixels. Returns 0 on
+    // success, -1 on error (in output.error).
+    int Decode(const uint8_t* data, size_t size, DecodedFrame& output)
+    {
+        if (setjmp(m_error.jump) != 0)
+        {
+            jpeg_abort_decompress(&m_cinfo);
+            output.error = m_error.message;
+            return -1;
+        }
+        jpeg_mem_src(&m_cinfo, const_cast<unsigned char*>(data), (unsigned long)size);
+        jpeg_read_header(&m_cinfo, TRUE);
+        if (m_cinfo.jpeg_color_space != JCS_GRAYSCALE)
+        {
+            m_cinfo.out_color_space = JCS_RGB;
+        }
+        jpeg_start_decompress(&m_cinfo);
+        output.width = m_cinfo.output_width;
+        output.height = m_cinfo.output_height;
+        output.channels = (unsigned int)m_cinfo.output_components;
+        const size_t rowBytes = (size_t)output.width * output.channels;
+        output.pixels.resize(rowBytes * output.height);
+        while (m_cinfo.output_scanline < m_cinfo.output_height)
+        {
+            JSAMPROW row = &output.pixels[(size_t)m_cinfo.output_scanline * rowBytes];
+            jpeg_read_scanlines(&m_cinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&m_cinfo);
+        return 0;
+    }
+
+  private:
+    struct ErrorManager
+    {
+        struct jpeg_error_mgr base;
+        jmp_buf jump;
+        std::string message;
+    };
+
+    static void OnError(j_common_ptr cinfo)
+    {
+        ErrorManager* error = (ErrorManager*)cinfo->err;
+        char message[JMSG_LENGTH_MAX];
+        (*cinfo->err->format_message)(cinfo, message);
+        error->message = message;
+        longjmp(error->jump, 1);
+    }
+
+    // Warnings (e.g. a truncated file) are not printed from worker threads
+    static void OnMessage(j_common_ptr)
+    {
+    }
+
+    struct jpeg_decompress_struct m_cinfo;
+    ErrorManager m_error;
+};
+
+// Decodes a list of frames on a TaskScheduler and hands them back in list
+// order. At most readAhead frames are being decoded or waiting to be taken,
+// so memory stays bounded while every worker is kept busy. The buffers of
+// frames returned by Next() are recycled for later frames.
+class DecodePipeline
+{
+  public:
+    DecodePipeline(const SessionIndex& index, TaskScheduler& scheduler, size_t readAhead)
+        : m_index(index), m_scheduler(scheduler), m_slots(std::max<size_t>(1, readAhead)), m_nextSubmit(0),
+          m_nextDeliver(0), m_inFlight(0), m_bytesRead(0)
+    {
+    }
+
+    ~DecodePipeline()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_inFlight == 0; });
+    }
+
+    // Starts decoding frames. The previous list must have been fully taken.
+    void Start(const std::vector<SessionFrame>& frames)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frames = frames;
+        m_nextSubmit = 0;
+        m_nextDeliver = 0;
+        SubmitLocked();
+    }
+
+    // Takes the next frame in list order, waiting for its decode. Returns
+    // false after the last frame.
+    bool Next(DecodedFrame& frame)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_nextDeliver >= m_frames.size())
+        {
+            return false;
+        }
+        Slot& slot = m_slots[m_nextDeliver % m_slots.size()];
+        m_cond.wait(lock, [&slot] { return slot.ready; });
+        std::swap(frame, slot.frame);
+        slot.ready = false;
+        m_nextDeliver++;
+        SubmitLocked();
+        return true;
+    }
+
+    // Payload bytes read from the sources so far
+    uint64_t GetBytesRead() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytesRead;
+    }
+
+  private:
+    struct Slot
+    {
+        DecodedFrame frame;
+        bool ready;
+
+        Slot() : ready(false)
+        {
+        }
+    };
+
+    // Fills free slots; called with m_mutex held
+    void SubmitLocked()
+    {
+        while (m_nextSubmit < m_frames.size() && m_nextSubmit < m_nextDeliver + m_slots.size())
+        {
+            const size_t position = m_nextSubmit++;
+            m_inFlight++;
+            m_scheduler.Submit([this, position]() { Decode(position); });
+        }
+    }
+
+    void Decode(size_t position)
+    {
+        Slot* slot;
+        SessionFrame frame;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot = &m_slots[position % m_slots.size()];
+            frame = m_frames[position];
+        }
+        // The slot is not touched by anyone else until it is marked ready
+        DecodedFrame& output = slot->frame;
+        output.frame = frame;
+        output.ok = false;
+        output.error.clear();
+        output.bitDepth = 8;
+        const SessionSource& source = m_index.GetSources()[frame.source];
+        std::vector<uint8_t>& buffer = ReadBuffer();
+        const bool jpeg = source.kind == SOURCE_JPEG_FILE;
+        const bool packed = !jpeg && frame.packing != PACKING_NONE && frame.packing < NUM_PIXEL_PACKINGS;
+        std::vector<uint8_t>& target = jpeg || packed ? buffer : output.pixels;
+        if (ReadPayload(source.path, frame.offset, frame.size, target) < 0)
+        {
+            output.error = std::string("unable to read ") + source.path + ": " + strerror(errno);
+        }
+        else if (jpeg && buffer.empty())
+        {
+            output.error = "empty JPEG file " + source.path;
+        }
+        else if (jpeg)
+        {
+            output.ok = JpegDecoder::ForCurrentThread().Decode(&buffer[0], buffer.size(), output) == 0;
+        }
+        else if (packed)
+        {
+            const pixelPacking packing = (pixelPacking)frame.packing;
+            const size_t count = (size_t)frame.width * frame.height;
+            if (count == 0 || GetPackedSize(packing, count) > buffer.size())
+            {
+                output.error = "packed payload shorter than its frame";
+            }
+            else
+            {
+                output.width = frame.width;
+                output.height = frame.height;
+                output.channels = 1;
+                output.bitDepth = GetPackingBitDepth(packing);
+                output.pixels.resize(count * sizeof(uint16_t));
+                UnpackPixels16(packing, &buffer[0], count, (uint16_t*)&output.pixels[0]);
+                output.ok = true;
+            }
+        }
+        else
+        {
+            output.width = frame.width;
+            output.height = frame.height;
+            const uint64_t pixels = (uint64_t)frame.width * frame.height;
+            output.channels = pixels > 0 && frame.size % pixels == 0 && frame.size / pixels <= 3
+                                  ? (unsigned int)(frame.size / pixels)
+                                  : 0;
+            if (output.channels == 2)
+            {
+                output.channels = 0;
+            }
+            output.ok = true;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bytesRead += frame.size;
+        slot->ready = true;
+        m_inFlight--;
+        m_cond.notify_all();
+    }
+
+    // Compressed data of the calling worker, kept between frames
+    static std::vector<uint8_t>& ReadBuffer()
+    {
+        static thread_local std::vector<uint8_t> buffer;
+        return buffer;
+    }
+
+    static int ReadPayload(const std::string& path, uint64_t offset, uint32_t size, std::vector<uint8_t>& data)
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        data.resize(size);
+        size_t done = 0;
+        while (done < size)
+        {
+            const ssize_t got = pread(fd, &data[done], size - done, (off_t)(offset + done));
+            if (got <= 0)
+            {
+                if (got == 0)
+                {
+                    errno = EIO;
+                }
+                close(fd);
+                return -1;
+            }
+            done += (size_t)got;
+        }
+        close(fd);
+        return 0;
+    }
+
+    const SessionIndex& m_index;
+    TaskScheduler& m_scheduler;
+    std::vector<Slot> m_slots;
+    std::vector<SessionFrame> m_frames;
+    size_t m_nextSubmit;
+    size_t m_nextDeliver;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    unsigned int m_inFlight;
+    uint64_t m_bytesRead;
+};
+
+#endif // DUAL_CAM_RECORDER_DECODE_PIPELINE_H
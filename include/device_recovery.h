@@ -0,0 +1,266 @@
+/*
+ * @Descripttion: Quarantine and bounded reacquisition of a camera that dropped off the bus, with a gap log
+ * @version:
+ * @Date: 2026-10-20 03:06:37
+ * @LastEditTime: 2026-10-20 03:06:37
+ */
+
+#ifndef DUAL_CAM_RECORDER_DEVICE_RECOVERY_H
+#define DUAL_CAM_RECORDER_DEVICE_RECOVERY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "async_logger.h"
+#include "time_utils.h"
+
+// Where a camera is in its recovery
+enum deviceState
+{
+    DEVICE_STREAMING,   // frames arrive, or grabs fail without the device being gone yet
+    DEVICE_QUARANTINED, // taken out of acquisition and searched for by serial number
+    DEVICE_LOST,        // not back within the reacquisition timeout; the camera is given up
+    NUM_DEVICE_STATES
+};
+
+inline const char* GetDeviceStateName(deviceState state)
+{
+    static const char* k_names[NUM_DEVICE_STATES] = {"streaming", "quarantined", "lost"};
+    return state < NUM_DEVICE_STATES ? k_names[state] : "unknown";
+}
+
+struct DeviceRecoveryConfig
+{
+    // Consecutive failed grabs after which a device still listed on the bus
+    // counts as lost too (a removed device is quarantined at once)
+    unsigned int errorsToQuarantine;
+    // The bus is searched for the serial number this often
+    unsigned int rescanIntervalMs;
+    // Bound on one recovery: a device not streaming again after this long
+    // is given up and the other cameras record on
+    unsigned int reacquireTimeoutMs;
+
+    DeviceRecoveryConfig() : errorsToQuarantine(3), rescanIntervalMs(100), reacquireTimeoutMs(10000)
+    {
+    }
+};
+
+// Recovery of one camera. The grab path reports every frame and every failed
+// grab; once the device counts as lost, Recover() quarantines it and calls
+// back until the device is found by its serial number and configured again,
+// or the timeout passes. Every outage is a line of the gap file: when it
+// started and ended, how long recovery took and the last frame before and
+// the first frame after it (device timestamps restart if the camera lost
+// power). Counters may be read from any thread. Frames and failed grabs may
+// be reported from different threads, as EVENT acquisition does, as long as
+// no frame is reported while Recover() runs.
+class DeviceRecovery
+{
+  public:
+    DeviceRecovery(const DeviceRecoveryConfig& config, const std::string& serialNumber,
+                   const std::string& metadataPath)
+        : m_config(config), m_serialNumber(serialNumber), m_state(DEVICE_STREAMING), m_consecutiveErrors(0),
+          m_hasFrame(false), m_lastFrameIndex(0), m_lastDeviceTimestamp(0), m_gapOpen(false), m_quarantinedNs(0),
+          m_recoveredNs(0), m_attempts(0), m_removals(0), m_recoveries(0), m_lastRecoveryNs(0), m_maxRecoveryNs(0),
+          m_totalGapNs(0)
+    {
+        m_metadata = metadataPath.empty() ? nullptr : fopen(metadataPath.c_str(), "w");
+        if (m_metadata != nullptr)
+        {
+            fprintf(m_metadata, "quarantined_ns,recovered_ns,recovery_ms,attempts,last_frame,last_device_ts,"
+                                "first_frame,first_device_ts,outcome\n");
+        }
+    }
+
+    ~DeviceRecovery()
+    {
+        Finish();
+    }
+
+    // A frame arrived; closes the gap of a recovery that preceded it
+    void OnFrame(uint64_t frameIndex, uint64_t deviceTimestamp)
+    {
+        m_consecutiveErrors = 0;
+        if (m_gapOpen)
+        {
+            WriteGap("recovered", true, frameIndex, deviceTimestamp);
+        }
+        m_hasFrame = true;
+        m_lastFrameIndex = frameIndex;
+        m_lastDeviceTimestamp = deviceTimestamp;
+    }
+
+    // A grab failed. Returns true once the device counts as lost: at once if
+    // it is no longer on the bus, else after errorsToQuarantine failures
+    bool OnGrabError(bool removed)
+    {
+        m_consecutiveErrors++;
+        return removed || m_consecutiveErrors >= m_config.errorsToQuarantine;
+    }
+
+    // Quarantines the device and calls reacquire() every rescanIntervalMs
+    // until it returns 0, meaning the device was found, initialized with its
+    // configuration and is acquiring again. Returns -1 if that did not happen
+    // within reacquireTimeoutMs; the device is then given up.
+    template <class Reacquire>
+    int Recover(Reacquire reacquire)
+    {
+        const uint64_t start = GetMonotonicNs();
+        const uint64_t deadline = start + (uint64_t)m_config.reacquireTimeoutMs * 1000000ULL;
+        m_state.store(DEVICE_QUARANTINED, std::memory_order_relaxed);
+        m_removals.fetch_add(1, std::memory_order_relaxed);
+        m_gapOpen = true;
+        m_quarantinedNs = start;
+        m_recoveredNs = 0;
+        m_attempts = 0;
+        ASYNC_LOG(SEVERITY_WARNING, "[{}] Camera lost after frame {}, quarantined and searching by serial number",
+                  m_serialNumber, m_lastFrameIndex);
+        while (true)
+        {
+            m_attempts++;
+            if (reacquire() == 0)
+            {
+                m_recoveredNs = GetMonotonicNs();
+                const uint64_t recoveryNs = m_recoveredNs - start;
+                m_lastRecoveryNs.store(recoveryNs, std::memory_order_relaxed);
+                m_maxRecoveryNs.store(std::max(m_maxRecoveryNs.load(std::memory_order_relaxed), recoveryNs),
+                                      std::memory_order_relaxed);
+                m_recoveries.fetch_add(1, std::memory_order_relaxed);
+                m_consecutiveErrors = 0;
+                m_state.store(DEVICE_STREAMING, std::memory_order_relaxed);
+                ASYNC_LOG(SEVERITY_INFO, "[{}] Camera recovered in {} ms after {} attempts", m_serialNumber,
+                          recoveryNs / 1000000, m_attempts);
+                return 0;
+            }
+            const uint64_t now = GetMonotonicNs();
+            if (now >= deadline)
+            {
+                break;
+            }
+            const uint64_t waitNs = std::min<uint64_t>((uint64_t)m_config.rescanIntervalMs * 1000000ULL,
+                                                       deadline - now);
+            std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+        }
+        m_state.store(DEVICE_LOST, std::memory_order_relaxed);
+        ASYNC_LOG(SEVERITY_ERROR, "[{}] Camera not back within {} ms, giving it up", m_serialNumber,
+                  m_config.reacquireTimeoutMs);
+        WriteGap("lost", false, 0, 0);
+        return -1;
+    }
+
+    // Writes the gap of a recovery no frame followed and closes the gap file
+    void Finish()
+    {
+        if (m_gapOpen)
+        {
+            WriteGap("recovered", false, 0, 0);
+        }
+        if (m_metadata != nullptr)
+        {
+            fclose(m_metadata);
+            m_metadata = nullptr;
+        }
+    }
+
+    deviceState GetState() const
+    {
+        return m_state.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetRemovalCount() const
+    {
+        return m_removals.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetRecoveryCount() const
+    {
+        return m_recoveries.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetLastRecoveryNs() const
+    {
+        return m_lastRecoveryNs.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetMaxRecoveryNs() const
+    {
+        return m_maxRecoveryNs.load(std::memory_order_relaxed);
+    }
+
+    // Time spent in outages, from each quarantine to the first frame after
+    // it, the give-up or the end of the session
+    uint64_t GetTotalGapNs() const
+    {
+        return m_totalGapNs.load(std::memory_order_relaxed);
+    }
+
+  private:
+    DeviceRecovery(const DeviceRecovery&);
+    DeviceRecovery& operator=(const DeviceRecovery&);
+
+    void WriteGap(const char* outcome, bool hasFirst, uint64_t firstFrameIndex, uint64_t firstDeviceTimestamp)
+    {
+        m_gapOpen = false;
+        m_totalGapNs.fetch_add(GetMonotonicNs() - m_quarantinedNs, std::memory_order_relaxed);
+        if (m_metadata == nullptr)
+        {
+            return;
+        }
+        fprintf(m_metadata, "%llu,", (unsigned long long)m_quarantinedNs);
+        if (m_recoveredNs != 0)
+        {
+            fprintf(m_metadata, "%llu,%.1f,", (unsigned long long)m_recoveredNs,
+                    (m_recoveredNs - m_quarantinedNs) / 1e6);
+        }
+        else
+        {
+            fprintf(m_metadata, ",,");
+        }
+        fprintf(m_metadata, "%u,", m_attempts);
+        if (m_hasFrame)
+        {
+            fprintf(m_metadata, "%llu,%llu,", (unsigned long long)m_lastFrameIndex,
+                    (unsigned long long)m_lastDeviceTimestamp);
+        }
+        else
+        {
+            fprintf(m_metadata, ",,");
+        }
+        if (hasFirst)
+        {
+            fprintf(m_metadata, "%llu,%llu,", (unsigned long long)firstFrameIndex,
+                    (unsigned long long)firstDeviceTimestamp);
+        }
+        else
+        {
+            fprintf(m_metadata, ",,");
+        }
+        fprintf(m_metadata, "%s\n", outcome);
+        fflush(m_metadata);
+    }
+
+    const DeviceRecoveryConfig m_config;
+    const std::string m_serialNumber;
+    FILE* m_metadata;
+    std::atomic<deviceState> m_state;
+    std::atomic<unsigned int> m_consecutiveErrors;
+    bool m_hasFrame;
+    uint64_t m_lastFrameIndex;
+    uint64_t m_lastDeviceTimestamp;
+    // The outage whose gap line is not written yet
+    bool m_gapOpen;
+    uint64_t m_quarantinedNs;
+    uint64_t m_recoveredNs;
+    unsigned int m_attempts;
+    std::atomic<uint64_t> m_removals;
+    std::atomic<uint64_t> m_recoveries;
+    std::atomic<uint64_t> m_lastRecoveryNs;
+    std::atomic<uint64_t> m_maxRecoveryNs;
+    std::atomic<uint64_t> m_totalGapNs;
+};
+
+#endif // DUAL_CAM_RECORDER_DEVICE_RECOVERY_H
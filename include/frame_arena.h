@@ -0,0 +1,464 @@
+/*
+ * @Descripttion: Frame memory arena on 2 MB huge pages (hugetlbfs or transparent), falling back to regular pages
+ * @version:
+ * @Date: 2026-10-20 02:24:51
+ * @LastEditTime: 2026-10-20 02:24:51
+ */
+
+#ifndef DUAL_CAM_RECORDER_FRAME_ARENA_H
+#define DUAL_CAM_RECORDER_FRAME_ARENA_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Page size of the huge page backings
+const size_t k_arenaHugePageBytes = 2ULL << 20;
+// Blocks are carved in multiples of this; smaller requests go to the heap,
+// where they do not cost TLB entries worth saving
+const size_t k_arenaGranuleBytes = 64ULL << 10;
+// Size of the default arena. Address space only: pages are touched, and
+// with hugetlbfs reserved, as frames need them.
+const size_t k_arenaDefaultBytes = 512ULL << 20;
+
+// Pages an arena asks for
+enum arenaPages
+{
+    ARENA_PAGES_HUGE,    // hugetlbfs, else transparent huge pages, else regular
+    ARENA_PAGES_REGULAR, // 4 KB pages, transparent huge pages turned off
+    NUM_ARENA_PAGES
+};
+
+// Pages an arena got
+enum arenaBacking
+{
+    ARENA_BACKING_HUGETLB,  // MAP_HUGETLB from the reserved huge page pool
+    ARENA_BACKING_THP,      // madvise(MADV_HUGEPAGE); the kernel promotes what it can
+    ARENA_BACKING_REGULAR,  // 4 KB pages
+    ARENA_BACKING_HEAP,     // no mapping at all; every block comes from the heap
+    NUM_ARENA_BACKINGS
+};
+
+inline const char* GetArenaBackingName(arenaBacking backing)
+{
+    static const char* k_names[NUM_ARENA_BACKINGS] = {"hugetlb", "thp", "regular", "heap"};
+    return backing < NUM_ARENA_BACKINGS ? k_names[backing] : "unknown";
+}
+
+// One region of address space that frame sized blocks are carved from:
+// frame buffers, conversion outputs, encoded staging buffers and the
+// staging tier's flush copy buffer. Freed blocks are kept by size and
+// reused, so a camera's steady stream of equal frames reuses the same pages.
+// When the region is full, blocks come from the heap instead and are
+// counted. Thread-safe.
+class FrameArena
+{
+  public:
+    FrameArena(size_t capacity, arenaPages pages)
+        : m_base(nullptr), m_capacity(0), m_mappedBytes(0), m_backing(ARENA_BACKING_HEAP), m_top(0), m_inUse(0),
+          m_peak(0), m_blocks(0), m_heapBlocks(0)
+    {
+        capacity = (capacity + k_arenaHugePageBytes - 1) & ~(k_arenaHugePageBytes - 1);
+        if (capacity == 0)
+        {
+            return;
+        }
+        if (pages == ARENA_PAGES_HUGE)
+        {
+            // Reserved up front: fails unless the pool has enough pages
+            void* base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                              -1, 0);
+            if (base != MAP_FAILED)
+            {
+                Map(base, capacity, capacity, ARENA_BACKING_HUGETLB);
+                return;
+            }
+        }
+        // Over-allocated by one huge page so the region can start on a
+        // huge page boundary, which THP needs to back it
+        const size_t mapped = capacity + k_arenaHugePageBytes;
+        void* base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            return;
+        }
+        const uintptr_t aligned = ((uintptr_t)base + k_arenaHugePageBytes - 1) & ~(uintptr_t)(k_arenaHugePageBytes - 1);
+        const size_t head = aligned - (uintptr_t)base;
+        if (head > 0)
+        {
+            munmap(base, head);
+        }
+        if (mapped - head > capacity)
+        {
+            munmap((uint8_t*)aligned + capacity, mapped - head - capacity);
+        }
+        arenaBacking backing = ARENA_BACKING_REGULAR;
+#ifdef MADV_HUGEPAGE
+        if (pages == ARENA_PAGES_HUGE && madvise((void*)aligned, capacity, MADV_HUGEPAGE) == 0)
+        {
+            backing = ARENA_BACKING_THP;
+        }
+#endif
+#ifdef MADV_NOHUGEPAGE
+        if (pages == ARENA_PAGES_REGULAR)
+        {
+            // THP set to "always" would otherwise promote these pages too
+            madvise((void*)aligned, capacity, MADV_NOHUGEPAGE);
+        }
+#endif
+        Map((void*)aligned, capacity, capacity, backing);
+    }
+
+    ~FrameArena()
+    {
+        if (m_base != nullptr)
+        {
+            munmap(m_base, m_mappedBytes);
+        }
+    }
+
+    // The arena of allocations that name none. The first call creates it;
+    // the recorder makes that call from main() with its configuration.
+    static FrameArena& Default(size_t capacity = k_arenaDefaultBytes, arenaPages pages = ARENA_PAGES_HUGE)
+    {
+        static FrameArena arena(capacity, pages);
+        return arena;
+    }
+
+    // A block of at least size bytes, aligned to 64 bytes
+    void* Allocate(size_t size)
+    {
+        if (size >= k_arenaGranuleBytes && m_base != nullptr)
+        {
+            const size_t rounded = (size + k_arenaGranuleBytes - 1) & ~(k_arenaGranuleBytes - 1);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t offset = 0;
+            size_t blockSize = 0;
+            if (TakeFree(rounded, 2 * rounded, offset, blockSize) || Carve(rounded, offset, blockSize) ||
+                TakeFree(rounded, m_capacity, offset, blockSize))
+            {
+                m_used[offset] = blockSize;
+                m_inUse += blockSize;
+                m_peak = std::max(m_peak, m_inUse);
+                m_blocks++;
+                return m_base + offset;
+            }
+        }
+        void* block = nullptr;
+        if (posix_memalign(&block, 64, std::max<size_t>(size, 1)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        if (size >= k_arenaGranuleBytes)
+        {
+            m_heapBlocks.fetch_add(1, std::memory_order_relaxed);
+        }
+        return block;
+    }
+
+    // A block freed when the last holder lets go
+    std::shared_ptr<uint8_t> AllocateShared(size_t size)
+    {
+        FrameArena* arena = this;
+        return std::shared_ptr<uint8_t>((uint8_t*)Allocate(size), [arena](uint8_t* block) {
+            arena->Deallocate(block);
+        });
+    }
+
+    void Deallocate(void* block)
+    {
+        if (block == nullptr)
+        {
+            return;
+        }
+        if (!Contains(block))
+        {
+            free(block);
+            return;
+        }
+        const size_t offset = (uint8_t*)block - m_base;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<size_t, size_t>::iterator it = m_used.find(offset);
+        if (it == m_used.end())
+        {
+            return;
+        }
+        m_free[it->second].push_back(offset);
+        m_inUse -= it->second;
+        m_blocks--;
+        m_used.erase(it);
+    }
+
+    bool Contains(const void* block) const
+    {
+        return m_base != nullptr && (const uint8_t*)block >= m_base && (const uint8_t*)block < m_base + m_capacity;
+    }
+
+    arenaBacking GetBacking() const
+    {
+        return m_backing;
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+    // Bytes of blocks handed out and not freed, and the most there were
+    size_t GetBytesInUse()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_inUse;
+    }
+
+    size_t GetPeakBytes()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_peak;
+    }
+
+    size_t GetBlocksInUse()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_blocks;
+    }
+
+    // Frame sized blocks the full region had to leave to the heap
+    uint64_t GetHeapBlocks() const
+    {
+        return m_heapBlocks.load(std::memory_order_relaxed);
+    }
+
+    // Bytes of the region the kernel backs with huge pages right now, from
+    // /proc/self/smaps; for THP this is what promotion actually achieved.
+    // -1 if it cannot be read.
+    int64_t GetHugePageBytes() const
+    {
+        if (m_base == nullptr)
+        {
+            return 0;
+        }
+        if (m_backing == ARENA_BACKING_HUGETLB)
+        {
+            return (int64_t)m_capacity;
+        }
+        FILE* file = fopen("/proc/self/smaps", "r");
+        if (file == nullptr)
+        {
+            return -1;
+        }
+        int64_t bytes = -1;
+        bool inRegion = false;
+        char line[512];
+        while (fgets(line, sizeof(line), file) != nullptr)
+        {
+            unsigned long start = 0;
+            unsigned long end = 0;
+            long kb = 0;
+            if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+            {
+                inRegion = start < (uintptr_t)m_base + m_capacity && end > (uintptr_t)m_base;
+            }
+            else if (inRegion && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            {
+                bytes = std::max<int64_t>(bytes, 0) + (int64_t)kb * 1024;
+            }
+        }
+        fclose(file);
+        return bytes;
+    }
+
+    // One line for logs and end of session summaries
+    std::string Describe()
+    {
+        char text[256];
+        const int64_t hugeBytes = GetHugePageBytes();
+        snprintf(text, sizeof(text), "%zu MB %s arena, %.1f MB in use (peak %.1f MB), %.1f MB on huge pages, "
+                 "%llu blocks from the heap",
+                 m_capacity >> 20, GetArenaBackingName(m_backing), GetBytesInUse() / 1048576.0,
+                 GetPeakBytes() / 1048576.0, hugeBytes < 0 ? 0.0 : hugeBytes / 1048576.0,
+                 (unsigned long long)GetHeapBlocks());
+        return text;
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out)
+    {
+        char lines[768];
+        snprintf(lines, sizeof(lines),
+                 "# TYPE recorder_arena_capacity_bytes gauge\nrecorder_arena_capacity_bytes{backing=\"%s\"} %zu\n"
+                 "# TYPE recorder_arena_bytes_in_use gauge\nrecorder_arena_bytes_in_use %zu\n"
+                 "# TYPE recorder_arena_peak_bytes gauge\nrecorder_arena_peak_bytes %zu\n"
+                 "# TYPE recorder_arena_huge_page_bytes gauge\nrecorder_arena_huge_page_bytes %lld\n"
+                 "# TYPE recorder_arena_heap_blocks_total counter\nrecorder_arena_heap_blocks_total %llu\n",
+                 GetArenaBackingName(m_backing), m_capacity, GetBytesInUse(), GetPeakBytes(),
+                 (long long)GetHugePageBytes(), (unsigned long long)GetHeapBlocks());
+        out += lines;
+    }
+
+  private:
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    void Map(void* base, size_t capacity, size_t mapped, arenaBacking backing)
+    {
+        m_base = (uint8_t*)base;
+        m_capacity = capacity;
+        m_mappedBytes = mapped;
+        m_backing = backing;
+    }
+
+    // The smallest free block of size to maxSize bytes
+    bool TakeFree(size_t size, size_t maxSize, size_t& offset, size_t& blockSize)
+    {
+        std::map<size_t, std::vector<size_t> >::iterator it = m_free.lower_bound(size);
+        while (it != m_free.end() && it->second.empty())
+        {
+            it = m_free.erase(it);
+        }
+        if (it == m_free.end() || it->first > maxSize)
+        {
+            return false;
+        }
+        offset = it->second.back();
+        blockSize = it->first;
+        it->second.pop_back();
+        return true;
+    }
+
+    // A new block from the untouched end of the region
+    bool Carve(size_t size, size_t& offset, size_t& blockSize)
+    {
+        if (m_capacity - m_top < size)
+        {
+            return false;
+        }
+        offset = m_top;
+        blockSize = size;
+        m_top += size;
+        return true;
+    }
+
+    uint8_t* m_base;
+    size_t m_capacity;
+    size_t m_mappedBytes;
+    arenaBacking m_backing;
+    std::mutex m_mutex;
+    size_t m_top;
+    std::map<size_t, std::vector<size_t> > m_free;  // free block offsets by block size
+    std::unordered_map<size_t, size_t> m_used;      // block size by offset
+    size_t m_inUse;
+    size_t m_peak;
+    size_t m_blocks;
+    std::atomic<uint64_t> m_heapBlocks;
+};
+
+// Standard allocator over a FrameArena, the default one unless given, so
+// frame sized vectors live in the arena
+template <class T>
+class ArenaAllocator
+{
+  public:
+    typedef T value_type;
+
+    ArenaAllocator() : m_arena(&FrameArena::Default())
+    {
+    }
+
+    explicit ArenaAllocator(FrameArena* arena) : m_arena(arena != nullptr ? arena : &FrameArena::Default())
+    {
+    }
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.GetArena())
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return (T*)m_arena->Allocate(count * sizeof(T));
+    }
+
+    void deallocate(T* block, size_t)
+    {
+        m_arena->Deallocate(block);
+    }
+
+    FrameArena* GetArena() const
+    {
+        return m_arena;
+    }
+
+  private:
+    FrameArena* m_arena;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() == b.GetArena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() != b.GetArena();
+}
+
+// Frame sized byte buffers
+typedef std::vector<uint8_t, ArenaAllocator<uint8_t> > ArenaBytes;
+
+// One block owned like a std::unique_ptr<uint8_t[]>, for buffers that track
+// their own size
+class ArenaBlock
+{
+  public:
+    // Takes the arena now, so one held by a static outlives its block
+    ArenaBlock() : m_arena(&FrameArena::Default()), m_data(nullptr)
+    {
+    }
+
+    explicit ArenaBlock(size_t size, FrameArena* arena = nullptr)
+        : m_arena(arena != nullptr ? arena : &FrameArena::Default()), m_data((uint8_t*)m_arena->Allocate(size))
+    {
+    }
+
+    ~ArenaBlock()
+    {
+        if (m_data != nullptr)
+        {
+            m_arena->Deallocate(m_data);
+        }
+    }
+
+    uint8_t* get() const
+    {
+        return m_data;
+    }
+
+    void swap(ArenaBlock& other)
+    {
+        std::swap(m_arena, other.m_arena);
+        std::swap(m_data, other.m_data);
+    }
+
+  private:
+    ArenaBlock(const ArenaBlock&);
+    ArenaBlock& operator=(const ArenaBlock&);
+
+    FrameArena* m_arena;
+    uint8_t* m_data;
+};
+
+#endif // DUAL_CAM_RECORDER_FRAME_ARENA_H
@@ -0,0 +1,177 @@
+/*
+ * @Descripttion: Reference-counted leases on acquisition buffers that downstream stages read in place
+ * @version:
+ * @Date: 2026-10-20 01:41:26
+ * @LastEditTime: 2026-10-20 01:41:26
+ */
+
+#ifndef DUAL_CAM_RECORDER_FRAME_LEASE_H
+#define DUAL_CAM_RECORDER_FRAME_LEASE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include "async_logger.h"
+
+class FrameLeaseTracker;
+
+// A grabbed buffer kept from the driver while downstream stages read it in
+// place. Whoever holds the shared pointer holds the buffer; the release
+// function hands it back once the last holder lets go, or earlier through
+// Release(). A stage reading the pixels calls Check() first, so a buffer
+// already returned is reported instead of read. A lease without a tracker
+// only keeps memory the frame owns alive, such as its copy in the arena.
+class FrameLease
+{
+  public:
+    typedef std::function<void()> ReleaseFunction;
+
+    FrameLease(FrameLeaseTracker* tracker, ReleaseFunction release)
+        : m_tracker(tracker), m_release(release), m_released(false)
+    {
+    }
+
+    ~FrameLease()
+    {
+        Release();
+    }
+
+    // Returns the buffer; later calls do nothing
+    void Release();
+
+    bool IsReleased() const
+    {
+        return m_released.load(std::memory_order_acquire);
+    }
+
+    // Whether consumer may still read the buffer. Counts and logs a read
+    // after release.
+    bool Check(const char* consumer) const;
+
+  private:
+    FrameLease(const FrameLease&);
+    FrameLease& operator=(const FrameLease&);
+
+    FrameLeaseTracker* m_tracker;
+    ReleaseFunction m_release;
+    std::atomic<bool> m_released;
+};
+
+typedef std::shared_ptr<FrameLease> FrameLeasePtr;
+
+// Hands out the leases of one camera. The driver only has so many buffers:
+// past maxLeases outstanding Acquire() refuses and the caller copies the
+// frame instead, so a slow writer cannot starve acquisition. Must outlive
+// its leases.
+class FrameLeaseTracker
+{
+  public:
+    FrameLeaseTracker(unsigned int maxLeases, const std::string& serialNumber)
+        : m_maxLeases(maxLeases), m_serialNumber(serialNumber), m_outstanding(0), m_maxOutstanding(0), m_leased(0),
+          m_refused(0), m_violations(0)
+    {
+    }
+
+    // A lease calling release when done, or null at the limit
+    FrameLeasePtr Acquire(FrameLease::ReleaseFunction release)
+    {
+        unsigned int outstanding = m_outstanding.load(std::memory_order_relaxed);
+        do
+        {
+            if (outstanding >= m_maxLeases)
+            {
+                m_refused.fetch_add(1, std::memory_order_relaxed);
+                return FrameLeasePtr();
+            }
+        } while (!m_outstanding.compare_exchange_weak(outstanding, outstanding + 1, std::memory_order_relaxed));
+        unsigned int highest = m_maxOutstanding.load(std::memory_order_relaxed);
+        while (outstanding + 1 > highest &&
+               !m_maxOutstanding.compare_exchange_weak(highest, outstanding + 1, std::memory_order_relaxed))
+        {
+        }
+        m_leased.fetch_add(1, std::memory_order_relaxed);
+        return FrameLeasePtr(new FrameLease(this, release));
+    }
+
+    unsigned int GetOutstanding() const
+    {
+        return m_outstanding.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetMaxOutstanding() const
+    {
+        return m_maxOutstanding.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetLeasedCount() const
+    {
+        return m_leased.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetRefusedCount() const
+    {
+        return m_refused.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetViolationCount() const
+    {
+        return m_violations.load(std::memory_order_relaxed);
+    }
+
+  private:
+    friend class FrameLease;
+
+    void OnReleased()
+    {
+        m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void OnViolation(const char* consumer)
+    {
+        m_violations.fetch_add(1, std::memory_order_relaxed);
+        ASYNC_LOG_RATE_LIMITED_BY(m_violationLog, SEVERITY_ERROR, 1000, "[{}] {} read a frame buffer after its release",
+                                  m_serialNumber, std::string(consumer));
+    }
+
+    const unsigned int m_maxLeases;
+    const std::string m_serialNumber;
+    std::atomic<unsigned int> m_outstanding;
+    std::atomic<unsigned int> m_maxOutstanding;
+    std::atomic<uint64_t> m_leased;
+    std::atomic<uint64_t> m_refused;
+    std::atomic<uint64_t> m_violations;
+    LogRateLimiter m_violationLog; // rate limit of this camera's violations
+};
+
+inline void FrameLease::Release()
+{
+    if (m_released.exchange(true, std::memory_order_acq_rel))
+    {
+        return;
+    }
+    if (m_release)
+    {
+        m_release();
+    }
+    if (m_tracker != nullptr)
+    {
+        m_tracker->OnReleased();
+    }
+}
+
+inline bool FrameLease::Check(const char* consumer) const
+{
+    if (!IsReleased())
+    {
+        return true;
+    }
+    if (m_tracker != nullptr)
+    {
+        m_tracker->OnViolation(consumer);
+    }
+    return false;
+}
+
+#endif // DUAL_CAM_RECORDER_FRAME_LEASE_H
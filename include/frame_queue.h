@@ -0,0 +1,247 @@
+/*
+ * @Descripttion: Per-camera frame handoff queue and wake-up latency statistics
+ * @version:
+ * @Date: 2026-10-19 09:20:11
+ * @LastEditTime: 2026-10-19 09:20:11
+ */
+
+#ifndef DUAL_CAM_RECORDER_FRAME_QUEUE_H
+#define DUAL_CAM_RECORDER_FRAME_QUEUE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Spinnaker.h"
+#include "time_utils.h"
+
+// Everything a downstream worker needs to know about one received image. The
+// grab path fills this in and hands it off without touching the pixels.
+struct GrabbedFrame
+{
+    Spinnaker::ImagePtr image;          // null for an incomplete EVENT frame, which is not copied
+    uint64_t frameIndex;                // per-camera sequence number assigned at handoff
+    uint64_t frameId;                   // frame ID reported by the camera
+    bool incomplete;                    // image arrived with missing data; its pixels are not used
+    Spinnaker::ImageStatus imageStatus; // status of the image as received
+    uint64_t deviceTimestamp;           // ns, camera clock
+    uint64_t hostTimestamp;             // ns, host CLOCK_MONOTONIC when the image was received
+    time_t wallTime;                    // s, host wall clock when the image was received (used in filenames)
+    SyncedTimestamp synced;             // deviceTimestamp on the host clocks, for aligning cameras
+    bool fromCamera;                    // image came from GetNextImage and must be Release()d when done
+    std::shared_ptr<uint8_t> storage;   // pixels of a copied image, which only wraps them
+
+    GrabbedFrame()
+        : frameIndex(0), frameId(0), incomplete(false), imageStatus(), deviceTimestamp(0), hostTimestamp(0),
+          wallTime(0), fromCamera(false)
+    {
+    }
+};
+
+// This function records the state of a received image that downstream stages
+// need after the image itself may be gone: completeness, status, frame ID and
+// device timestamp. It takes any image pointer, so tests can hand in images
+// without a camera.
+template <typename ImagePointer>
+void RecordImageState(const ImagePointer& image, GrabbedFrame& frame)
+{
+    frame.incomplete = image->IsIncomplete();
+    frame.imageStatus = image->GetImageStatus();
+    frame.frameId = image->GetFrameID();
+    frame.deviceTimestamp = image->GetTimeStamp();
+}
+
+// This function hands the image of an image event over to a frame. Spinnaker
+// releases the image buffer back to the driver as soon as the event handler
+// returns, so the pixels of a complete image are copied into a block from
+// allocate(size), which the frame's image wraps. An incomplete image is not
+// copied, as no stage reads its pixels; its frame only carries its state.
+template <typename ImagePointer, typename Allocate>
+void CopyEventImage(const ImagePointer& image, Allocate allocate, GrabbedFrame& frame)
+{
+    RecordImageState(image, frame);
+    if (frame.incomplete)
+    {
+        return;
+    }
+    const size_t size = image->GetImageSize();
+    frame.storage = allocate(size);
+    memcpy(frame.storage.get(), image->GetData(), size);
+    frame.image = Spinnaker::Image::Create(image->GetWidth(), image->GetHeight(), 0, 0, image->GetPixelFormat(),
+                                           frame.storage.get());
+}
+
+// Bounded FIFO of grabbed frames for one camera. Push never blocks: when the
+// queue is full the frame is dropped and counted, so an event callback always
+// returns to the driver immediately.
+class FrameQueue
+{
+  public:
+    explicit FrameQueue(size_t capacity) : m_capacity(capacity), m_closed(false), m_received(0), m_dropped(0)
+    {
+    }
+
+    // Moves the frame into the queue. Returns false if it was dropped.
+    bool Push(GrabbedFrame& frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_received++;
+        if (m_closed || m_frames.size() >= m_capacity)
+        {
+            m_dropped++;
+            return false;
+        }
+        m_frames.push_back(GrabbedFrame());
+        std::swap(m_frames.back(), frame);
+        return true;
+    }
+
+    bool TryPop(GrabbedFrame& frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_frames.empty())
+        {
+            return false;
+        }
+        std::swap(frame, m_frames.front());
+        m_frames.pop_front();
+        return true;
+    }
+
+    // No more frames will be accepted; frames already queued can still be popped.
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_closedCond.notify_all();
+    }
+
+    // Waits until the queue is closed, giving up if no frame was pushed for
+    // stallTimeoutMs. Returns false on a stall.
+    bool WaitClosed(unsigned int stallTimeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_closed)
+        {
+            const uint64_t received = m_received;
+            const std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(stallTimeoutMs);
+            m_closedCond.wait_until(lock, deadline, [this] { return m_closed; });
+            if (!m_closed && m_received == received)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool IsClosed()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+
+    // Closed and empty: nothing left for the workers to do.
+    bool IsDrained()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed && m_frames.empty();
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_frames.size();
+    }
+
+    uint64_t DroppedCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_closedCond;
+    std::deque<GrabbedFrame> m_frames;
+    size_t m_capacity;
+    bool m_closed;
+    uint64_t m_received;
+    uint64_t m_dropped;
+};
+
+// Per-frame wake-up latency of one camera, so POLLING and EVENT acquisition can
+// be compared on the same hardware.
+//
+// Delivery latency is the host receive time minus the device timestamp,
+// normalized by the smallest such offset seen in the session; it therefore
+// measures how much later than the best case a frame reached user code.
+// Dispatch latency is the time a frame waited between handoff and the start of
+// processing on a worker.
+class LatencyStats
+{
+  public:
+    void AddDelivery(uint64_t hostNs, uint64_t deviceNs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_offsets.push_back((int64_t)(hostNs - deviceNs));
+    }
+
+    void AddDispatch(uint64_t waitNs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_dispatch.push_back((int64_t)waitNs);
+    }
+
+    void Print(const std::string& serialNumber, const std::string& mode)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<int64_t> delivery(m_offsets);
+        if (!delivery.empty())
+        {
+            const int64_t minOffset = *std::min_element(delivery.begin(), delivery.end());
+            for (size_t i = 0; i < delivery.size(); i++)
+            {
+                delivery[i] -= minOffset;
+            }
+        }
+        std::cout << "[" << serialNumber << "] " << mode << " wake-up latency (us): delivery "
+                  << Summary(delivery) << "; dispatch " << Summary(m_dispatch) << std::endl;
+    }
+
+  private:
+    // "mean/p99/max over n frames" of a set of nanosecond samples, in microseconds
+    static std::string Summary(std::vector<int64_t> samples)
+    {
+        if (samples.empty())
+        {
+            return "n/a";
+        }
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            sum += (double)samples[i];
+        }
+        const size_t p99 = std::min(samples.size() - 1, (samples.size() * 99) / 100);
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "mean %.1f / p99 %.1f / max %.1f over %zu frames",
+                 sum / samples.size() / 1000.0, samples[p99] / 1000.0, samples.back() / 1000.0, samples.size());
+        return buffer;
+    }
+
+    std::mutex m_mutex;
+    std::vector<int64_t> m_offsets;
+    std::vector<int64_t> m_dispatch;
+};
+
+#endif // DUAL_CAM_RECORDER_FRAME_QUEUE_H
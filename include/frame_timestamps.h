@@ -0,0 +1,137 @@
+/*
+ * @Descripttion: Per-camera sidecar of frame timestamps for outputs that do not store them (JPEG files)
+ * @version:
+ * @Date: 2026-10-20 07:31:52
+ * @LastEditTime: 2026-10-20 07:31:52
+ */
+
+#ifndef DUAL_CAM_RECORDER_FRAME_TIMESTAMPS_H
+#define DUAL_CAM_RECORDER_FRAME_TIMESTAMPS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "time_utils.h"
+
+// Sidecars are named <recording start>-<serial>-timestamps.csv
+const char* const k_frameTimestampsSuffix = "-timestamps.csv";
+
+// One frame of a sidecar
+struct FrameTimestamps
+{
+    uint64_t frameIndex;
+    uint64_t deviceTimestamp; // ns, camera clock
+    uint64_t hostTimestamp;   // ns, host CLOCK_MONOTONIC when the frame was received
+    uint64_t syncedTimestamp; // ns, deviceTimestamp on host CLOCK_MONOTONIC, 0 if not synchronized
+    uint64_t errorBoundNs;    // bound on the error of syncedTimestamp, 0 if not synchronized
+
+    FrameTimestamps() : frameIndex(0), deviceTimestamp(0), hostTimestamp(0), syncedTimestamp(0), errorBoundNs(0)
+    {
+    }
+};
+
+// Writes the timestamps of every frame of one camera, one CSV line per frame
+// in write order. JPEG files only keep the whole second of the wall clock in
+// their name, so the sidecar is what gives them a host-domain timestamp with
+// an error bound. The synced columns are left empty until the camera's clock
+// model is usable. Append() is only called from the camera's writer strand.
+class FrameTimestampLog
+{
+  public:
+    explicit FrameTimestampLog(const std::string& path) : m_file(fopen(path.c_str(), "w"))
+    {
+        if (m_file != nullptr)
+        {
+            fprintf(m_file, "frame,device_ts,host_ts,synced_ts,error_bound\n");
+        }
+    }
+
+    ~FrameTimestampLog()
+    {
+        if (m_file != nullptr)
+        {
+            fclose(m_file);
+        }
+    }
+
+    bool IsOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    void Append(uint64_t frameIndex, uint64_t deviceTimestamp, uint64_t hostTimestamp, const SyncedTimestamp& synced)
+    {
+        if (m_file == nullptr)
+        {
+            return;
+        }
+        fprintf(m_file, "%llu,%llu,%llu,", (unsigned long long)frameIndex, (unsigned long long)deviceTimestamp,
+                (unsigned long long)hostTimestamp);
+        if (synced.valid)
+        {
+            fprintf(m_file, "%llu,%llu\n", (unsigned long long)synced.monotonic, (unsigned long long)synced.errorNs);
+        }
+        else
+        {
+            fprintf(m_file, ",\n");
+        }
+    }
+
+  private:
+    FrameTimestampLog(const FrameTimestampLog&);
+    FrameTimestampLog& operator=(const FrameTimestampLog&);
+
+    FILE* m_file;
+};
+
+// This function reads a sidecar written by FrameTimestampLog up to its first
+// incomplete line, which a recording still in progress may have left. Returns
+// -1 if the file cannot be opened or is not a sidecar.
+inline int ReadFrameTimestamps(const std::string& path, std::vector<FrameTimestamps>& frames)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return -1;
+    }
+    char line[256];
+    if (fgets(line, sizeof(line), file) == nullptr || strncmp(line, "frame,device_ts,", 16) != 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != nullptr && strchr(line, '\n') != nullptr)
+    {
+        uint64_t values[5] = {0, 0, 0, 0, 0};
+        const char* field = line;
+        int count = 0;
+        for (; count < 5; count++)
+        {
+            char* end;
+            values[count] = strtoull(field, &end, 10);
+            if (*end != (count < 4 ? ',' : '\n'))
+            {
+                break;
+            }
+            field = end + 1;
+        }
+        if (count < 5)
+        {
+            break;
+        }
+        FrameTimestamps frame;
+        frame.frameIndex = values[0];
+        frame.deviceTimestamp = values[1];
+        frame.hostTimestamp = values[2];
+        frame.syncedTimestamp = values[3];
+        frame.errorBoundNs = values[4];
+        frames.push_back(frame);
+    }
+    fclose(file);
+    return 0;
+}
+
+#endif // DUAL_CAM_RECORDER_FRAME_TIMESTAMPS_H
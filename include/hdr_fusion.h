@@ -0,0 +1,381 @@
+/*
+ * @Descripttion: Radiance merge of exposure-bracketed Mono8 frames, SIMD kernels run over row bands in parallel
+ * @version:
+ * @Date: 2026-10-20 00:52:16
+ * @LastEditTime: 2026-10-20 00:52:16
+ */
+
+#ifndef DUAL_CAM_RECORDER_HDR_FUSION_H
+#define DUAL_CAM_RECORDER_HDR_FUSION_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "task_scheduler.h"
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HDR_FUSION_SIMD 1
+#endif
+
+// Exposures of one bracket, 2 to k_hdrMaxExposures
+const unsigned int k_hdrMaxExposures = 4;
+
+enum hdrKernel
+{
+    HDR_KERNEL_SCALAR,
+    HDR_KERNEL_SSE2,
+    HDR_KERNEL_AVX2,
+    NUM_HDR_KERNELS
+};
+
+inline const char* GetHdrKernelName(hdrKernel kernel)
+{
+    static const char* k_names[NUM_HDR_KERNELS] = {"scalar", "sse2", "avx2"};
+    return kernel < NUM_HDR_KERNELS ? k_names[kernel] : "unknown";
+}
+
+// Per-exposure constants of the merge. A sample z of exposure i contributes
+// z * gain with weight min(z * lowSlope + lowOffset, highOffset - z * highSlope):
+// a hat that trusts mid-tones most. The shortest exposure keeps full weight
+// up to white and the longest down to black, since nothing else covers
+// those ends.
+struct HdrExposureWeights
+{
+    float gain; // longest exposure time / this exposure time
+    float lowSlope;
+    float lowOffset;
+    float highSlope;
+    float highOffset;
+};
+
+// One fused frame: radiance in units of the longest exposure's gray levels,
+// stored as radiance * radianceScale in 16 bits so the brightest value a
+// bracket can hold fills the range, and a tone-mapped Mono8 rendition
+struct HdrFrame
+{
+    std::vector<uint16_t> radiance;
+    std::vector<uint8_t> toneMapped;
+    unsigned int width;
+    unsigned int height;
+    float radianceScale;
+
+    HdrFrame() : width(0), height(0), radianceScale(0.0f)
+    {
+    }
+};
+
+// Merges rows [rowBegin, rowEnd) of count exposures; scalar reference
+inline void FuseHdrRowsScalar(const uint8_t* const* pixels, const size_t* strides, unsigned int count,
+                              const HdrExposureWeights* weights, float outScale, unsigned int width,
+                              unsigned int rowBegin, unsigned int rowEnd, uint16_t* radiance, size_t x0 = 0)
+{
+    for (unsigned int y = rowBegin; y < rowEnd; y++)
+    {
+        uint16_t* out = radiance + (size_t)y * width;
+        for (size_t x = x0; x < width; x++)
+        {
+            float num = 0.0f;
+            float den = 0.0f;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const float z = (float)pixels[i][(size_t)y * strides[i] + x];
+                const float w = std::min(z * weights[i].lowSlope + weights[i].lowOffset,
+                                         weights[i].highOffset - z * weights[i].highSlope);
+                num = num + w * z * weights[i].gain;
+                den = den + w;
+            }
+            const float value = num / den * outScale + 0.5f;
+            out[x] = (uint16_t)std::min(value, 65535.0f);
+        }
+    }
+}
+
+#if defined(HDR_FUSION_SIMD)
+// Whether the AVX2 kernel can run here, checked once
+inline bool CpuHasAvx2()
+{
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return has;
+}
+
+// SSE2 kernel: 16 pixels per step, the same operations in the same order as
+// the scalar one, so results are bit-identical. Returns the first column it
+// did not process.
+inline size_t FuseHdrRowsSse2(const uint8_t* const* pixels, const size_t* strides, unsigned int count,
+                              const HdrExposureWeights* weights, float outScale, unsigned int width,
+                              unsigned int rowBegin, unsigned int rowEnd, uint16_t* radiance)
+{
+    const size_t end = width & ~(size_t)15;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(outScale);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 maximum = _mm_set1_ps(65535.0f);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    for (unsigned int y = rowBegin; y < rowEnd; y++)
+    {
+        uint16_t* out = radiance + (size_t)y * width;
+        for (size_t x = 0; x < end; x += 16)
+        {
+            __m128 num[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+            __m128 den[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const __m128i bytes = _mm_loadu_si128((const __m128i*)(pixels[i] + (size_t)y * strides[i] + x));
+                const __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+                const __m128 gain = _mm_set1_ps(weights[i].gain);
+                const __m128 lowSlope = _mm_set1_ps(weights[i].lowSlope);
+                const __m128 lowOffset = _mm_set1_ps(weights[i].lowOffset);
+                const __m128 highSlope = _mm_set1_ps(weights[i].highSlope);
+                const __m128 highOffset = _mm_set1_ps(weights[i].highOffset);
+                for (int q = 0; q < 4; q++)
+                {
+                    const __m128i dwords = (q & 1) ? _mm_unpackhi_epi16(words[q >> 1], zero)
+                                                   : _mm_unpacklo_epi16(words[q >> 1], zero);
+                    const __m128 z = _mm_cvtepi32_ps(dwords);
+                    const __m128 w = _mm_min_ps(_mm_add_ps(_mm_mul_ps(z, lowSlope), lowOffset),
+                                                _mm_sub_ps(highOffset, _mm_mul_ps(z, highSlope)));
+                    num[q] = _mm_add_ps(num[q], _mm_mul_ps(_mm_mul_ps(w, z), gain));
+                    den[q] = _mm_add_ps(den[q], w);
+                }
+            }
+            __m128i values[4];
+            for (int q = 0; q < 4; q++)
+            {
+                const __m128 value = _mm_add_ps(_mm_mul_ps(_mm_div_ps(num[q], den[q]), scale), half);
+                // Truncate like the scalar cast; SSE2 has no unsigned 32 to 16 bit pack
+                values[q] = _mm_sub_epi32(_mm_cvttps_epi32(_mm_min_ps(value, maximum)), bias32);
+            }
+            _mm_storeu_si128((__m128i*)(out + x), _mm_xor_si128(_mm_packs_epi32(values[0], values[1]), bias16));
+            _mm_storeu_si128((__m128i*)(out + x + 8), _mm_xor_si128(_mm_packs_epi32(values[2], values[3]), bias16));
+        }
+    }
+    return end;
+}
+
+// AVX2 kernel: 16 pixels per step in two 8-lane halves
+__attribute__((target("avx2"))) inline size_t FuseHdrRowsAvx2(const uint8_t* const* pixels, const size_t* strides,
+                                                              unsigned int count, const HdrExposureWeights* weights,
+                                                              float outScale, unsigned int width,
+                                                              unsigned int rowBegin, unsigned int rowEnd,
+                                                              uint16_t* radiance)
+{
+    const size_t end = width & ~(size_t)15;
+    const __m256 scale = _mm256_set1_ps(outScale);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 maximum = _mm256_set1_ps(65535.0f);
+    for (unsigned int y = rowBegin; y < rowEnd; y++)
+    {
+        uint16_t* out = radiance + (size_t)y * width;
+        for (size_t x = 0; x < end; x += 16)
+        {
+            __m256 num[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+            __m256 den[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const uint8_t* src = pixels[i] + (size_t)y * strides[i] + x;
+                const __m256 gain = _mm256_set1_ps(weights[i].gain);
+                const __m256 lowSlope = _mm256_set1_ps(weights[i].lowSlope);
+                const __m256 lowOffset = _mm256_set1_ps(weights[i].lowOffset);
+                const __m256 highSlope = _mm256_set1_ps(weights[i].highSlope);
+                const __m256 highOffset = _mm256_set1_ps(weights[i].highOffset);
+                for (int h = 0; h < 2; h++)
+                {
+                    const __m128i bytes = _mm_loadl_epi64((const __m128i*)(src + h * 8));
+                    const __m256 z = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+                    const __m256 w = _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(z, lowSlope), lowOffset),
+                                                   _mm256_sub_ps(highOffset, _mm256_mul_ps(z, highSlope)));
+                    num[h] = _mm256_add_ps(num[h], _mm256_mul_ps(_mm256_mul_ps(w, z), gain));
+                    den[h] = _mm256_add_ps(den[h], w);
+                }
+            }
+            __m256i values[2];
+            for (int h = 0; h < 2; h++)
+            {
+                const __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(num[h], den[h]), scale), half);
+                values[h] = _mm256_cvttps_epi32(_mm256_min_ps(value, maximum));
+            }
+            // packus works within 128-bit lanes; restore the pixel order
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(values[0], values[1]), 0xD8);
+            _mm256_storeu_si256((__m256i*)(out + x), packed);
+        }
+    }
+    return end;
+}
+#endif
+
+// Merges a bracket of Mono8 exposures into one radiance frame. Configure()
+// fixes the exposure times; Fuse() splits the frame into bands of rows and
+// runs them on a TaskScheduler, or inline without one.
+class HdrFusion
+{
+  public:
+    HdrFusion() : m_count(0), m_outScale(0.0f), m_kernel(HDR_KERNEL_SCALAR)
+    {
+#if defined(HDR_FUSION_SIMD)
+        m_kernel = CpuHasAvx2() ? HDR_KERNEL_AVX2 : HDR_KERNEL_SSE2;
+#endif
+    }
+
+    // Exposure times in any order and unit. Returns -1 unless there are 2 to
+    // k_hdrMaxExposures positive times.
+    int Configure(const double* exposures, unsigned int count)
+    {
+        if (count < 2 || count > k_hdrMaxExposures)
+        {
+            return -1;
+        }
+        double shortest = exposures[0];
+        double longest = exposures[0];
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (exposures[i] <= 0.0)
+            {
+                return -1;
+            }
+            shortest = std::min(shortest, exposures[i]);
+            longest = std::max(longest, exposures[i]);
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            HdrExposureWeights& weights = m_weights[i];
+            weights.gain = (float)(longest / exposures[i]);
+            const bool isShortest = exposures[i] == shortest;
+            const bool isLongest = exposures[i] == longest;
+            weights.lowSlope = isLongest ? 0.0f : 1.0f;
+            weights.lowOffset = isLongest ? 128.0f : 1.0f;
+            weights.highSlope = isShortest ? 0.0f : 1.0f;
+            weights.highOffset = isShortest ? 128.0f : 256.0f;
+        }
+        m_count = count;
+        m_outScale = (float)(65535.0 / (255.0 * longest / shortest));
+        BuildToneCurve(longest / shortest);
+        return 0;
+    }
+
+    // Picks a kernel, e.g. to compare them; falls back to scalar if the CPU
+    // lacks the instructions
+    void SetKernel(hdrKernel kernel)
+    {
+        m_kernel = HDR_KERNEL_SCALAR;
+#if defined(HDR_FUSION_SIMD)
+        if (kernel == HDR_KERNEL_SSE2 || (kernel == HDR_KERNEL_AVX2 && CpuHasAvx2()))
+        {
+            m_kernel = kernel;
+        }
+#endif
+    }
+
+    hdrKernel GetKernel() const
+    {
+        return m_kernel;
+    }
+
+    unsigned int GetCount() const
+    {
+        return m_count;
+    }
+
+    // Fuses one bracket in the order of the exposure times given to
+    // Configure(). bandRows rows go to each task; the calling thread runs
+    // the last band and waits for the rest.
+    int Fuse(const uint8_t* const* pixels, const size_t* strides, unsigned int width, unsigned int height,
+             HdrFrame& frame, TaskScheduler* scheduler = nullptr, unsigned int bandRows = 64) const
+    {
+        if (m_count == 0 || width == 0 || height == 0)
+        {
+            return -1;
+        }
+        frame.width = width;
+        frame.height = height;
+        frame.radianceScale = m_outScale;
+        frame.radiance.resize((size_t)width * height);
+        frame.toneMapped.resize((size_t)width * height);
+        const unsigned int numBands = scheduler == nullptr ? 1 : (height + bandRows - 1) / bandRows;
+        if (numBands <= 1)
+        {
+            FuseBand(pixels, strides, width, 0, height, frame);
+            return 0;
+        }
+
+        struct Latch
+        {
+            std::mutex mutex;
+            std::condition_variable done;
+            unsigned int remaining;
+        } latch;
+        latch.remaining = numBands - 1;
+        const HdrFusion* self = this;
+        HdrFrame* pFrame = &frame;
+        Latch* pLatch = &latch;
+        for (unsigned int band = 0; band + 1 < numBands; band++)
+        {
+            const unsigned int rowBegin = band * bandRows;
+            scheduler->Submit([self, pixels, strides, width, rowBegin, bandRows, pFrame, pLatch]() {
+                self->FuseBand(pixels, strides, width, rowBegin, rowBegin + bandRows, *pFrame);
+                std::lock_guard<std::mutex> lock(pLatch->mutex);
+                if (--pLatch->remaining == 0)
+                {
+                    pLatch->done.notify_one();
+                }
+            });
+        }
+        FuseBand(pixels, strides, width, (numBands - 1) * bandRows, height, frame);
+        std::unique_lock<std::mutex> lock(latch.mutex);
+        latch.done.wait(lock, [&]() { return latch.remaining == 0; });
+        return 0;
+    }
+
+  private:
+    // Log curve from 16-bit radiance to 8 bits, so a bracket covering a
+    // dynamic range of ratio * 255 levels fits one JPEG-able frame
+    void BuildToneCurve(double ratio)
+    {
+        m_toneCurve.resize(65536);
+        const double knee = 65535.0 / (ratio * 64.0);
+        const double norm = 255.0 / log1p(65535.0 / knee);
+        for (unsigned int v = 0; v < 65536; v++)
+        {
+            m_toneCurve[v] = (uint8_t)std::min(255.0, log1p(v / knee) * norm + 0.5);
+        }
+    }
+
+    void FuseBand(const uint8_t* const* pixels, const size_t* strides, unsigned int width, unsigned int rowBegin,
+                  unsigned int rowEnd, HdrFrame& frame) const
+    {
+        size_t done = 0;
+#if defined(HDR_FUSION_SIMD)
+        if (m_kernel == HDR_KERNEL_AVX2)
+        {
+            done = FuseHdrRowsAvx2(pixels, strides, m_count, m_weights, m_outScale, width, rowBegin, rowEnd,
+                                   &frame.radiance[0]);
+        }
+        else if (m_kernel == HDR_KERNEL_SSE2)
+        {
+            done = FuseHdrRowsSse2(pixels, strides, m_count, m_weights, m_outScale, width, rowBegin, rowEnd,
+                                   &frame.radiance[0]);
+        }
+#endif
+        // Columns past the last 16-pixel step
+        FuseHdrRowsScalar(pixels, strides, m_count, m_weights, m_outScale, width, rowBegin, rowEnd,
+                          &frame.radiance[0], done);
+        const size_t begin = (size_t)rowBegin * width;
+        const size_t end = (size_t)rowEnd * width;
+        for (size_t i = begin; i < end; i++)
+        {
+            frame.toneMapped[i] = m_toneCurve[frame.radiance[i]];
+        }
+    }
+
+    HdrExposureWeights m_weights[k_hdrMaxExposures];
+    unsigned int m_count;
+    float m_outScale;
+    hdrKernel m_kernel;
+    std::vector<uint8_t> m_toneCurve;
+};
+
+#endif // DUAL_CAM_RECORDER_HDR_FUSION_H
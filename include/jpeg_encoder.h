@@ -0,0 +1,349 @@
+/*
+ * @Descripttion: Direct libjpeg(-turbo) encoder with a persistent compressor per thread
+ * @version:
+ * @Date: 2026-10-19 16:27:45
+ * @LastEditTime: 2026-10-19 16:27:45
+ */
+
+#ifndef DUAL_CAM_RECORDER_JPEG_ENCODER_H
+#define DUAL_CAM_RECORDER_JPEG_ENCODER_H
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <jpeglib.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frame_arena.h"
+
+enum jpegSubsampling
+{
+    JPEG_SUBSAMPLING_444,
+    JPEG_SUBSAMPLING_422,
+    JPEG_SUBSAMPLING_420
+};
+
+enum jpegDct
+{
+    JPEG_DCT_ACCURATE, // JDCT_ISLOW, same as libjpeg's default
+    JPEG_DCT_FAST,     // JDCT_IFAST, slightly lower quality at high settings
+    JPEG_DCT_FLOAT     // JDCT_FLOAT
+};
+
+// Layout of the pixels handed to the encoder
+enum jpegInput
+{
+    JPEG_INPUT_GRAY,  // Mono8
+    JPEG_INPUT_RGB,   // RGB8, packed
+    JPEG_INPUT_BGR,   // BGR8, packed
+    JPEG_INPUT_YUV420 // I420 planes as ColorFrame lays them out; always encoded 4:2:0, no color conversion
+};
+
+struct JpegOptions
+{
+    int quality;                 // 1..100
+    jpegSubsampling subsampling; // chroma subsampling of color input; ignored for gray
+    jpegDct dct;
+
+    JpegOptions() : quality(90), subsampling(JPEG_SUBSAMPLING_420), dct(JPEG_DCT_ACCURATE)
+    {
+    }
+};
+
+// Growable output buffer of encoded bytes. Unlike std::vector it does not
+// zero memory when it grows, and it keeps its capacity between frames. The
+// bytes live in the default FrameArena.
+class JpegBuffer
+{
+  public:
+    JpegBuffer() : m_capacity(0), m_size(0)
+    {
+    }
+
+    const uint8_t* Data() const
+    {
+        return m_data.get();
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    size_t Capacity() const
+    {
+        return m_capacity;
+    }
+
+  private:
+    friend class JpegEncoder;
+
+    // Grows to at least capacity bytes, keeping the first m_size bytes
+    void Grow(size_t capacity)
+    {
+        if (capacity <= m_capacity)
+        {
+            return;
+        }
+        ArenaBlock data(capacity);
+        if (m_size > 0)
+        {
+            memcpy(data.get(), m_data.get(), m_size);
+        }
+        m_data.swap(data);
+        m_capacity = capacity;
+    }
+
+    ArenaBlock m_data;
+    size_t m_capacity;
+    size_t m_size;
+};
+
+// Free list of JpegBuffers, so that an encoded frame can be handed to another
+// thread (e.g. the writer strand) without allocating a new buffer per frame.
+// Buffers return to the pool when the last shared_ptr to them is released.
+class JpegBufferPool
+{
+  public:
+    JpegBufferPool() : m_state(new State())
+    {
+    }
+
+    std::shared_ptr<JpegBuffer> Acquire()
+    {
+        JpegBuffer* buffer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            if (!m_state->free.empty())
+            {
+                buffer = m_state->free.back().release();
+                m_state->free.pop_back();
+            }
+        }
+        if (buffer == nullptr)
+        {
+            buffer = new JpegBuffer();
+        }
+        std::shared_ptr<State> state = m_state;
+        return std::shared_ptr<JpegBuffer>(buffer, [state](JpegBuffer* released) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->free.push_back(std::unique_ptr<JpegBuffer>(released));
+        });
+    }
+
+  private:
+    // Shared with the deleters, so buffers may outlive the pool
+    struct State
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<JpegBuffer> > free;
+    };
+
+    std::shared_ptr<State> m_state;
+};
+
+// Wraps one libjpeg compressor. Creating a jpeg_compress_struct and its
+// memory pools is done once; each Encode() only resets the parameters and
+// runs the compression straight from the caller's pixel pointer into a
+// JpegBuffer. Not thread-safe: use one encoder per thread, e.g. through
+// ForCurrentThread().
+class JpegEncoder
+{
+  public:
+    JpegEncoder()
+    {
+        m_cinfo.err = jpeg_std_error(&m_error.base);
+        m_error.base.error_exit = &JpegEncoder::OnError;
+        m_error.base.output_message = &JpegEncoder::OnMessage;
+        jpeg_create_compress(&m_cinfo);
+        m_destination.base.init_destination = &JpegEncoder::InitDestination;
+        m_destination.base.empty_output_buffer = &JpegEncoder::EmptyOutputBuffer;
+        m_destination.base.term_destination = &JpegEncoder::TermDestination;
+        m_destination.buffer = nullptr;
+        m_cinfo.dest = &m_destination.base;
+    }
+
+    ~JpegEncoder()
+    {
+        jpeg_destroy_compress(&m_cinfo);
+    }
+
+    // The encoder of the calling thread, created on first use
+    static JpegEncoder& ForCurrentThread()
+    {
+        static thread_local JpegEncoder encoder;
+        return encoder;
+    }
+
+    // Encodes width x height pixels with rows stride bytes apart into output.
+    // For JPEG_INPUT_YUV420 stride is that of the Y plane, a multiple of 16;
+    // U and V follow with rows stride / 2 apart. Returns 0 on success, -1 on
+    // error (see GetLastError()).
+    int Encode(const uint8_t* pixels, unsigned int width, unsigned int height, size_t stride, jpegInput input,
+               const JpegOptions& options, JpegBuffer& output)
+    {
+        m_destination.buffer = &output;
+        if (setjmp(m_error.jump) != 0)
+        {
+            jpeg_abort_compress(&m_cinfo);
+            m_destination.buffer = nullptr;
+            return -1;
+        }
+        m_cinfo.image_width = width;
+        m_cinfo.image_height = height;
+        if (input == JPEG_INPUT_GRAY)
+        {
+            m_cinfo.input_components = 1;
+            m_cinfo.in_color_space = JCS_GRAYSCALE;
+        }
+        else if (input == JPEG_INPUT_YUV420)
+        {
+            m_cinfo.input_components = 3;
+            m_cinfo.in_color_space = JCS_YCbCr;
+        }
+        else
+        {
+            m_cinfo.input_components = 3;
+#ifdef JCS_EXTENSIONS
+            m_cinfo.in_color_space = input == JPEG_INPUT_BGR ? JCS_EXT_BGR : JCS_RGB;
+#else
+            if (input == JPEG_INPUT_BGR)
+            {
+                m_error.message = "BGR input needs libjpeg-turbo";
+                return -1;
+            }
+            m_cinfo.in_color_space = JCS_RGB;
+#endif
+        }
+        jpeg_set_defaults(&m_cinfo);
+        jpeg_set_quality(&m_cinfo, std::max(1, std::min(100, options.quality)), TRUE);
+        static const J_DCT_METHOD k_dctMethods[] = {JDCT_ISLOW, JDCT_IFAST, JDCT_FLOAT};
+        m_cinfo.dct_method = k_dctMethods[options.dct];
+        if (input == JPEG_INPUT_YUV420)
+        {
+            // The planes go in as they are, libjpeg neither converts nor
+            // downsamples
+            m_cinfo.raw_data_in = TRUE;
+            m_cinfo.comp_info[0].h_samp_factor = 2;
+            m_cinfo.comp_info[0].v_samp_factor = 2;
+        }
+        else if (input != JPEG_INPUT_GRAY)
+        {
+            // Luma sampling factors; chroma stays at 1x1
+            m_cinfo.comp_info[0].h_samp_factor = options.subsampling == JPEG_SUBSAMPLING_444 ? 1 : 2;
+            m_cinfo.comp_info[0].v_samp_factor = options.subsampling == JPEG_SUBSAMPLING_420 ? 2 : 1;
+        }
+        // Size the buffer for a typical frame up front, so libjpeg rarely
+        // has to ask for more
+        output.m_size = 0;
+        output.Grow((size_t)width * height * m_cinfo.input_components / 4 + 4096);
+        jpeg_start_compress(&m_cinfo, TRUE);
+        if (input == JPEG_INPUT_YUV420)
+        {
+            WriteRawYuv420(pixels, height, stride);
+        }
+        while (m_cinfo.next_scanline < m_cinfo.image_height)
+        {
+            JSAMPROW row = const_cast<JSAMPROW>(pixels + (size_t)m_cinfo.next_scanline * stride);
+            jpeg_write_scanlines(&m_cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&m_cinfo);
+        m_destination.buffer = nullptr;
+        return 0;
+    }
+
+    const std::string& GetLastError() const
+    {
+        return m_error.message;
+    }
+
+  private:
+    // Hands I420 planes to libjpeg 16 luma and 8 chroma rows at a time,
+    // repeating the last row of each plane past the bottom of the image
+    void WriteRawYuv420(const uint8_t* pixels, unsigned int height, size_t stride)
+    {
+        const unsigned int chromaHeight = (height + 1) / 2;
+        const size_t chromaStride = stride / 2;
+        const uint8_t* planes[3] = {pixels, pixels + stride * height,
+                                    pixels + stride * height + chromaStride * chromaHeight};
+        JSAMPROW rows[3][16];
+        JSAMPARRAY groups[3] = {rows[0], rows[1], rows[2]};
+        while (m_cinfo.next_scanline < m_cinfo.image_height)
+        {
+            const unsigned int y = m_cinfo.next_scanline;
+            for (unsigned int i = 0; i < 16; i++)
+            {
+                rows[0][i] = const_cast<JSAMPROW>(planes[0] + std::min(y + i, height - 1) * stride);
+            }
+            for (unsigned int i = 0; i < 8; i++)
+            {
+                const size_t chromaRow = std::min(y / 2 + i, chromaHeight - 1);
+                rows[1][i] = const_cast<JSAMPROW>(planes[1] + chromaRow * chromaStride);
+                rows[2][i] = const_cast<JSAMPROW>(planes[2] + chromaRow * chromaStride);
+            }
+            jpeg_write_raw_data(&m_cinfo, groups, 16);
+        }
+    }
+
+    struct ErrorManager
+    {
+        struct jpeg_error_mgr base;
+        jmp_buf jump;
+        std::string message;
+    };
+
+    struct DestinationManager
+    {
+        struct jpeg_destination_mgr base;
+        JpegBuffer* buffer;
+    };
+
+    static void OnError(j_common_ptr cinfo)
+    {
+        ErrorManager* error = (ErrorManager*)cinfo->err;
+        char message[JMSG_LENGTH_MAX];
+        (*cinfo->err->format_message)(cinfo, message);
+        error->message = message;
+        longjmp(error->jump, 1);
+    }
+
+    // Warnings are not printed from worker threads
+    static void OnMessage(j_common_ptr)
+    {
+    }
+
+    static void InitDestination(j_compress_ptr cinfo)
+    {
+        JpegBuffer& buffer = *((DestinationManager*)cinfo->dest)->buffer;
+        buffer.m_size = 0;
+        cinfo->dest->next_output_byte = buffer.m_data.get();
+        cinfo->dest->free_in_buffer = buffer.m_capacity;
+    }
+
+    // Called when the buffer is full: double it and continue after the data so far
+    static boolean EmptyOutputBuffer(j_compress_ptr cinfo)
+    {
+        JpegBuffer& buffer = *((DestinationManager*)cinfo->dest)->buffer;
+        buffer.m_size = buffer.m_capacity;
+        buffer.Grow(buffer.m_capacity * 2);
+        cinfo->dest->next_output_byte = buffer.m_data.get() + buffer.m_size;
+        cinfo->dest->free_in_buffer = buffer.m_capacity - buffer.m_size;
+        return TRUE;
+    }
+
+    static void TermDestination(j_compress_ptr cinfo)
+    {
+        JpegBuffer& buffer = *((DestinationManager*)cinfo->dest)->buffer;
+        buffer.m_size = buffer.m_capacity - cinfo->dest->free_in_buffer;
+    }
+
+    struct jpeg_compress_struct m_cinfo;
+    ErrorManager m_error;
+    DestinationManager m_destination;
+};
+
+#endif // DUAL_CAM_RECORDER_JPEG_ENCODER_H
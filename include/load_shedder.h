@@ -0,0 +1,267 @@
+/*
+ * @Descripttion: Degradation controller stepping through cheaper output policies while the pipeline falls behind
+ * @version:
+ * @Date: 2026-10-19 23:58:41
+ * @LastEditTime: 2026-10-19 23:58:41
+ */
+
+#ifndef DUAL_CAM_RECORDER_LOAD_SHEDDER_H
+#define DUAL_CAM_RECORDER_LOAD_SHEDDER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "async_logger.h"
+#include "time_utils.h"
+
+// Levels of the controller, cheapest degradation first. Each level keeps the
+// measures of the enabled levels below it.
+enum sheddingLevel
+{
+    SHEDDING_NONE,
+    SHEDDING_JPEG_QUALITY, // encode at reducedJpegQuality
+    SHEDDING_DROP_NTH,     // drop one frame in dropInterval
+    SHEDDING_BINNED,       // record 2x2 binned frames
+    SHEDDING_DROP,         // drop every new frame until the backlog has drained
+    NUM_SHEDDING_LEVELS
+};
+
+inline const char* GetSheddingLevelName(sheddingLevel level)
+{
+    static const char* k_names[NUM_SHEDDING_LEVELS] = {"none", "jpeg_quality", "drop_nth", "binned", "drop"};
+    return level < NUM_SHEDDING_LEVELS ? k_names[level] : "unknown";
+}
+
+struct LoadShedderConfig
+{
+    // Under pressure while the grab to worker queue is at least enterOccupancy
+    // full or frames reach storage enterLatencyNs after they were received;
+    // calm once both are below the exit thresholds. In between the level holds.
+    // A level is only left for the next one if the backlog did not shrink
+    // while it was in force: a draining backlog needs time, not more shedding.
+    double enterOccupancy;
+    double exitOccupancy;
+    uint64_t enterLatencyNs;
+    uint64_t exitLatencyNs;
+    unsigned int escalateMs; // pressure held this long without improving steps one level up
+    unsigned int recoverMs;  // calm held this long steps one level down
+    bool enabled[NUM_SHEDDING_LEVELS]; // levels that are skipped stay out of the sequence
+    int reducedJpegQuality;
+    unsigned int dropInterval;
+
+    LoadShedderConfig()
+        : enterOccupancy(0.5), exitOccupancy(0.2), enterLatencyNs(500000000ULL), exitLatencyNs(150000000ULL),
+          escalateMs(250), recoverMs(1000), reducedJpegQuality(50), dropInterval(3)
+    {
+        for (unsigned int i = 0; i < NUM_SHEDDING_LEVELS; i++)
+        {
+            enabled[i] = true;
+        }
+    }
+};
+
+// One level change, kept for the end of session summary
+struct SheddingTransition
+{
+    uint64_t realtimeNs;
+    sheddingLevel from;
+    sheddingLevel to;
+    double occupancy;
+    uint64_t latencyNs;
+};
+
+// Watches the output backlog of one camera and sets the shedding level.
+// Observe() and Admit() run on the camera's grab path; ReportLatency() on the
+// writer strand; the level getters anywhere.
+class LoadShedder
+{
+  public:
+    LoadShedder(const LoadShedderConfig& config, const std::string& serialNumber)
+        : m_config(config), m_serialNumber(serialNumber), m_level(SHEDDING_NONE), m_latencyNs(0),
+          m_latencyReportNs(0), m_shed(0), m_pressureSinceNs(0), m_calmSinceNs(0), m_lastChangeNs(0),
+          m_windowOccupancy(0.0), m_windowLatencyNs(0)
+    {
+    }
+
+    // Latency of the newest frame to reach storage, from its host timestamp
+    void ReportLatency(uint64_t latencyNs, uint64_t now)
+    {
+        m_latencyNs.store(latencyNs, std::memory_order_relaxed);
+        m_latencyReportNs.store(now, std::memory_order_relaxed);
+    }
+
+    // Updates the level from the queue occupancy (0 to 1) and the last
+    // reported latency. A latency older than recoverMs counts as zero: while
+    // frames are being dropped nothing reaches storage.
+    void Observe(double occupancy, uint64_t now)
+    {
+        uint64_t latencyNs = m_latencyNs.load(std::memory_order_relaxed);
+        if (now - m_latencyReportNs.load(std::memory_order_relaxed) > m_config.recoverMs * 1000000ULL)
+        {
+            latencyNs = 0;
+        }
+        const bool pressure = occupancy >= m_config.enterOccupancy || latencyNs >= m_config.enterLatencyNs;
+        const bool calm = occupancy <= m_config.exitOccupancy && latencyNs <= m_config.exitLatencyNs;
+        if (!pressure)
+        {
+            m_pressureSinceNs = 0;
+        }
+        else if (m_pressureSinceNs == 0)
+        {
+            StartWindow(occupancy, latencyNs, now);
+        }
+        if (!calm)
+        {
+            m_calmSinceNs = 0;
+        }
+        else if (m_calmSinceNs == 0)
+        {
+            m_calmSinceNs = now;
+        }
+
+        // Each step restarts the wait, so one burst moves one level at a time
+        const sheddingLevel level = GetLevel();
+        if (pressure && now - std::max(m_pressureSinceNs, m_lastChangeNs) >= m_config.escalateMs * 1000000ULL)
+        {
+            const bool improving = occupancy < m_windowOccupancy || latencyNs < m_windowLatencyNs;
+            const sheddingLevel next = NextEnabled(level, 1);
+            if (!improving && next != level)
+            {
+                ChangeLevel(level, next, occupancy, latencyNs, now);
+            }
+            StartWindow(occupancy, latencyNs, now);
+        }
+        else if (calm && now - std::max(m_calmSinceNs, m_lastChangeNs) >= m_config.recoverMs * 1000000ULL)
+        {
+            const sheddingLevel next = NextEnabled(level, -1);
+            if (next != level)
+            {
+                ChangeLevel(level, next, occupancy, latencyNs, now);
+            }
+        }
+    }
+
+    // Whether a new frame is recorded at the current level. Drops keep the
+    // same frame indices on every camera.
+    bool Admit(uint64_t frameIndex)
+    {
+        const sheddingLevel level = GetLevel();
+        bool admit = true;
+        if (level == SHEDDING_DROP)
+        {
+            admit = false;
+        }
+        else if (IsActive(level, SHEDDING_DROP_NTH) && m_config.dropInterval > 1)
+        {
+            admit = frameIndex % m_config.dropInterval != m_config.dropInterval - 1;
+        }
+        if (!admit)
+        {
+            m_shed.fetch_add(1, std::memory_order_relaxed);
+        }
+        return admit;
+    }
+
+    int GetJpegQuality(int quality) const
+    {
+        return IsActive(GetLevel(), SHEDDING_JPEG_QUALITY) ? std::min(quality, m_config.reducedJpegQuality)
+                                                           : quality;
+    }
+
+    bool UseBinning() const
+    {
+        return IsActive(GetLevel(), SHEDDING_BINNED);
+    }
+
+    sheddingLevel GetLevel() const
+    {
+        return (sheddingLevel)m_level.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetShedCount() const
+    {
+        return m_shed.load(std::memory_order_relaxed);
+    }
+
+    std::vector<SheddingTransition> GetTransitions()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_transitions;
+    }
+
+  private:
+    void StartWindow(double occupancy, uint64_t latencyNs, uint64_t now)
+    {
+        m_pressureSinceNs = now;
+        m_windowOccupancy = occupancy;
+        m_windowLatencyNs = latencyNs;
+    }
+
+    bool IsActive(sheddingLevel current, sheddingLevel measure) const
+    {
+        return current >= measure && m_config.enabled[measure];
+    }
+
+    sheddingLevel NextEnabled(sheddingLevel level, int step) const
+    {
+        int next = (int)level + step;
+        while (next > SHEDDING_NONE && next < NUM_SHEDDING_LEVELS && !m_config.enabled[next])
+        {
+            next += step;
+        }
+        if (next < SHEDDING_NONE || next >= NUM_SHEDDING_LEVELS)
+        {
+            return level;
+        }
+        return (sheddingLevel)next;
+    }
+
+    void ChangeLevel(sheddingLevel from, sheddingLevel to, double occupancy, uint64_t latencyNs, uint64_t now)
+    {
+        m_level.store(to, std::memory_order_relaxed);
+        m_lastChangeNs = now;
+        SheddingTransition transition;
+        transition.realtimeNs = GetRealtimeNs();
+        transition.from = from;
+        transition.to = to;
+        transition.occupancy = occupancy;
+        transition.latencyNs = latencyNs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_transitions.push_back(transition);
+        }
+        if (to > from)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "[{}] Output falling behind (queue {}%, latency {} ms), shedding {} -> {}",
+                      m_serialNumber, (int)(occupancy * 100.0), latencyNs / 1000000, GetSheddingLevelName(from),
+                      GetSheddingLevelName(to));
+        }
+        else
+        {
+            ASYNC_LOG(SEVERITY_INFO, "[{}] Output recovered (queue {}%, latency {} ms), shedding {} -> {}",
+                      m_serialNumber, (int)(occupancy * 100.0), latencyNs / 1000000, GetSheddingLevelName(from),
+                      GetSheddingLevelName(to));
+        }
+    }
+
+    const LoadShedderConfig m_config;
+    const std::string m_serialNumber;
+    std::atomic<int> m_level;
+    std::atomic<uint64_t> m_latencyNs;
+    std::atomic<uint64_t> m_latencyReportNs;
+    std::atomic<uint64_t> m_shed;
+    // Observe() state, grab path only
+    uint64_t m_pressureSinceNs;
+    uint64_t m_calmSinceNs;
+    uint64_t m_lastChangeNs;
+    // Backlog at the start of the current escalation wait
+    double m_windowOccupancy;
+    uint64_t m_windowLatencyNs;
+    std::mutex m_mutex;
+    std::vector<SheddingTransition> m_transitions;
+};
+
+#endif // DUAL_CAM_RECORDER_LOAD_SHEDDER_H
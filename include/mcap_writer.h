@@ -0,0 +1,918 @@
+/*
+ * @Descripttion: Streams recorded frames into an MCAP file that ROS 2 tools open directly
+ * @version:
+ * @Date: 2026-10-19 20:12:09
+ * @LastEditTime: 2026-10-19 20:12:09
+ */
+
+#ifndef DUAL_CAM_RECORDER_MCAP_WRITER_H
+#define DUAL_CAM_RECORDER_MCAP_WRITER_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#if defined(RECORDER_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(RECORDER_HAVE_LZ4)
+#include <lz4frame.h>
+#endif
+#include "async_logger.h"
+#include "time_utils.h"
+
+// Compression of MCAP chunks. ZSTD and LZ4 are available when the recorder
+// is built with the library (CMake defines RECORDER_HAVE_ZSTD and
+// RECORDER_HAVE_LZ4 if it finds them); otherwise chunks are stored as is.
+enum mcapCompression
+{
+    MCAP_COMPRESSION_NONE,
+    MCAP_COMPRESSION_ZSTD,
+    MCAP_COMPRESSION_LZ4
+};
+
+// Message type of a camera channel
+enum mcapImageType
+{
+    MCAP_IMAGE_RAW, // sensor_msgs/msg/Image, mono8
+    MCAP_IMAGE_JPEG // sensor_msgs/msg/CompressedImage, jpeg
+};
+
+struct McapConfig
+{
+    mcapCompression compression;
+    int compressionLevel;    // zstd level; lz4 uses its fast default
+    uint64_t chunkSize;      // message bytes collected before a chunk is written
+    unsigned int chunkMaxMs; // a chunk open this long is written even if not full
+    uint64_t maxQueuedBytes; // frames beyond this are rejected instead of queued
+    bool crc;                // CRC32 of chunks, the data section and the summary
+
+    McapConfig()
+        : compression(MCAP_COMPRESSION_ZSTD), compressionLevel(1), chunkSize(8ULL << 20), chunkMaxMs(1000),
+          maxQueuedBytes(512ULL << 20), crc(true)
+    {
+    }
+};
+
+// One frame handed to McapWriter. The payload stays valid until keepAlive is
+// released, which happens once the frame is copied into the current chunk.
+struct McapFrame
+{
+    unsigned int channel; // index returned by McapWriter::AddChannel
+    uint32_t sequence;    // frame index
+    uint64_t logTime;     // ns since the epoch, when the host received the frame
+    uint64_t publishTime; // ns since the epoch, the device timestamp on the host clock; also the header stamp
+    uint32_t width;
+    uint32_t height;
+    const void* payload; // Mono8 pixels or JPEG bytes, as the channel's type says
+    uint32_t payloadSize;
+    std::shared_ptr<const void> keepAlive;
+    // Called on the I/O thread once the frame is in a chunk (or failed)
+    std::function<void(bool written, uint64_t serializeNs)> done;
+
+    McapFrame()
+        : channel(0), sequence(0), logTime(0), publishTime(0), width(0), height(0), payload(nullptr), payloadSize(0)
+    {
+    }
+};
+
+// CRC32 (IEEE, as used by MCAP and zlib), eight bytes per step
+class Crc32
+{
+  public:
+    static uint32_t Update(uint32_t crc, const void* data, size_t size)
+    {
+        const uint32_t(*table)[256] = GetTables();
+        const uint8_t* p = (const uint8_t*)data;
+        crc = ~crc;
+        while (size >= 8)
+        {
+            uint32_t one;
+            uint32_t two;
+            memcpy(&one, p, 4);
+            memcpy(&two, p + 4, 4);
+            one ^= crc;
+            crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^ table[5][(one >> 16) & 0xFF] ^
+                  table[4][one >> 24] ^ table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF] ^
+                  table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+            p += 8;
+            size -= 8;
+        }
+        while (size-- > 0)
+        {
+            crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+        }
+        return ~crc;
+    }
+
+  private:
+    static const uint32_t (*GetTables())[256]
+    {
+        static uint32_t tables[8][256];
+        static bool initialized = InitTables(tables);
+        (void)initialized;
+        return tables;
+    }
+
+    static bool InitTables(uint32_t (*tables)[256])
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0u);
+            }
+            tables[0][i] = crc;
+        }
+        for (int k = 1; k < 8; k++)
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+            }
+        }
+        return true;
+    }
+};
+
+// Little-endian MCAP record and CDR serialization into a byte buffer
+class McapBuffer
+{
+  public:
+    std::vector<uint8_t> bytes;
+
+    void U8(uint8_t value)
+    {
+        bytes.push_back(value);
+    }
+
+    void U16(uint16_t value)
+    {
+        Raw(&value, sizeof(value));
+    }
+
+    void U32(uint32_t value)
+    {
+        Raw(&value, sizeof(value));
+    }
+
+    void U64(uint64_t value)
+    {
+        Raw(&value, sizeof(value));
+    }
+
+    void Raw(const void* data, size_t size)
+    {
+        const uint8_t* p = (const uint8_t*)data;
+        bytes.insert(bytes.end(), p, p + size);
+    }
+
+    void String(const std::string& value)
+    {
+        U32((uint32_t)value.size());
+        Raw(value.data(), value.size());
+    }
+
+    // Starts a record; returns the position to pass to EndRecord
+    size_t BeginRecord(uint8_t opcode)
+    {
+        U8(opcode);
+        const size_t position = bytes.size();
+        U64(0);
+        return position;
+    }
+
+    void EndRecord(size_t position)
+    {
+        const uint64_t length = bytes.size() - position - sizeof(uint64_t);
+        memcpy(&bytes[position], &length, sizeof(length));
+    }
+
+    // A length-prefixed map or array is closed like a record
+    size_t BeginPrefixed()
+    {
+        const size_t position = bytes.size();
+        U32(0);
+        return position;
+    }
+
+    void EndPrefixed(size_t position)
+    {
+        const uint32_t length = (uint32_t)(bytes.size() - position - sizeof(uint32_t));
+        memcpy(&bytes[position], &length, sizeof(length));
+    }
+
+    // CDR aligns each primitive to its size, counted from the start of the
+    // data after the encapsulation header
+    void CdrAlign(size_t cdrStart, size_t alignment)
+    {
+        while ((bytes.size() - cdrStart) % alignment != 0)
+        {
+            bytes.push_back(0);
+        }
+    }
+
+    void CdrString(size_t cdrStart, const std::string& value)
+    {
+        CdrAlign(cdrStart, 4);
+        U32((uint32_t)value.size() + 1);
+        Raw(value.c_str(), value.size() + 1);
+    }
+
+    void CdrU32(size_t cdrStart, uint32_t value)
+    {
+        CdrAlign(cdrStart, 4);
+        U32(value);
+    }
+};
+
+// Writes frames of every camera as ROS 2 messages into one MCAP file
+// (profile ros2, ros2msg schemas, CDR messages): one channel per camera,
+// messages collected into chunks that are optionally compressed and followed
+// by their message indexes, and on Stop() a summary section with schemas,
+// channels, statistics and the chunk index, so readers can seek without
+// scanning. All serialization, compression and writing runs on one I/O
+// thread; Submit() never blocks.
+class McapWriter
+{
+  public:
+    McapWriter(const std::string& path, const McapConfig& config)
+        : m_path(path), m_config(config), m_file(nullptr), m_offset(0), m_dataCrc(0), m_running(false),
+          m_failed(false), m_chunkStartTime(0), m_chunkEndTime(0), m_chunkOpenedNs(0), m_chunkMessages(0),
+          m_messageStartTime(0), m_messageEndTime(0), m_queuedBytes(0), m_rejected(0), m_messages(0),
+          m_bytesWritten(0), m_uncompressedBytes(0), m_compressedBytes(0), m_chunks(0), m_writeErrors(0),
+          m_writeNs(0), m_compressNs(0)
+#if defined(RECORDER_HAVE_ZSTD)
+          ,
+          m_zstd(nullptr)
+#endif
+    {
+        if (m_config.compression == MCAP_COMPRESSION_ZSTD)
+        {
+#if defined(RECORDER_HAVE_ZSTD)
+            m_zstd = ZSTD_createCCtx();
+#else
+            ASYNC_LOG(SEVERITY_WARNING, "Built without zstd, MCAP chunks of {} are not compressed", path);
+            m_config.compression = MCAP_COMPRESSION_NONE;
+#endif
+        }
+#if !defined(RECORDER_HAVE_LZ4)
+        if (m_config.compression == MCAP_COMPRESSION_LZ4)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "Built without lz4, MCAP chunks of {} are not compressed", path);
+            m_config.compression = MCAP_COMPRESSION_NONE;
+        }
+#endif
+    }
+
+    ~McapWriter()
+    {
+        Stop();
+#if defined(RECORDER_HAVE_ZSTD)
+        ZSTD_freeCCtx(m_zstd);
+#endif
+    }
+
+    // Registers a camera before Start(); returns its index for McapFrame::channel
+    unsigned int AddChannel(const std::string& serialNumber, mcapImageType type)
+    {
+        Channel channel;
+        channel.serialNumber = serialNumber;
+        channel.type = type;
+        channel.topic = "/camera_" + serialNumber + (type == MCAP_IMAGE_JPEG ? "/image_raw/compressed" : "/image_raw");
+        channel.messages = 0;
+        m_channels.push_back(channel);
+        m_messageIndex.push_back(std::vector<std::pair<uint64_t, uint64_t> >());
+        return (unsigned int)m_channels.size() - 1;
+    }
+
+    // Creates the file, writes the header, schemas and channels and starts
+    // the I/O thread. Returns -1 if the file cannot be created.
+    int Start()
+    {
+        m_file = fopen(m_path.c_str(), "wb");
+        if (m_file == nullptr)
+        {
+            return -1;
+        }
+        setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+        m_chunk.bytes.reserve(m_config.chunkSize + (8 << 20));
+        McapBuffer start;
+        start.Raw(Magic(), k_magicSize);
+        size_t record = start.BeginRecord(OP_HEADER);
+        start.String("ros2");
+        start.String("dual_cam_recorder");
+        start.EndRecord(record);
+        AddSchemas(start);
+        AddChannels(start);
+        Write(start.bytes.data(), start.bytes.size());
+        if (m_failed)
+        {
+            fclose(m_file);
+            m_file = nullptr;
+            return -1;
+        }
+        m_running = true;
+        m_thread = std::thread(&McapWriter::Run, this);
+        return 0;
+    }
+
+    // Writes everything queued, the last chunk, the summary and the footer
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+            {
+                return;
+            }
+            m_running = false;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+        FlushChunk();
+        Finish();
+        if (fclose(m_file) != 0 && !m_failed)
+        {
+            m_failed = true;
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            ASYNC_LOG(SEVERITY_ERROR, "Unable to close {}: {}", m_path, strerror(errno));
+        }
+        m_file = nullptr;
+    }
+
+    // Queues a frame. Returns false if the queue is full or the file failed;
+    // the frame is then not recorded.
+    bool Submit(McapFrame& frame)
+    {
+        if (m_failed.load(std::memory_order_relaxed) ||
+            m_queuedBytes.load(std::memory_order_relaxed) + frame.payloadSize > m_config.maxQueuedBytes)
+        {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_queuedBytes.fetch_add(frame.payloadSize, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_frames.push_back(McapFrame());
+            std::swap(m_frames.back(), frame);
+        }
+        m_cond.notify_one();
+        return true;
+    }
+
+    const std::string& GetPath() const
+    {
+        return m_path;
+    }
+
+    uint64_t GetRejectedCount() const
+    {
+        return m_rejected.load(std::memory_order_relaxed);
+    }
+
+    // Prints messages, chunks, bytes and compression of the file
+    void PrintSummary()
+    {
+        const uint64_t uncompressed = m_uncompressedBytes.load(std::memory_order_relaxed);
+        const uint64_t compressed = m_compressedBytes.load(std::memory_order_relaxed);
+        const uint64_t writeNs = m_writeNs.load(std::memory_order_relaxed);
+        printf("MCAP %s: %llu messages in %llu chunks, %.1f MB (%.2fx compression, %.1f ms compressing), "
+               "%.1f MB/s while writing, %llu rejected, %llu write errors\n",
+               m_path.c_str(), (unsigned long long)m_messages.load(std::memory_order_relaxed),
+               (unsigned long long)m_chunks.load(std::memory_order_relaxed),
+               m_bytesWritten.load(std::memory_order_relaxed) / 1e6,
+               compressed > 0 ? (double)uncompressed / compressed : 1.0,
+               m_compressNs.load(std::memory_order_relaxed) / 1e6,
+               writeNs > 0 ? m_bytesWritten.load(std::memory_order_relaxed) * 1e3 / writeNs : 0.0,
+               (unsigned long long)GetRejectedCount(),
+               (unsigned long long)m_writeErrors.load(std::memory_order_relaxed));
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out)
+    {
+        const uint64_t uncompressed = m_uncompressedBytes.load(std::memory_order_relaxed);
+        const uint64_t compressed = m_compressedBytes.load(std::memory_order_relaxed);
+        char lines[1024];
+        snprintf(lines, sizeof(lines),
+                 "# TYPE recorder_mcap_bytes_written_total counter\nrecorder_mcap_bytes_written_total %llu\n"
+                 "# TYPE recorder_mcap_messages_total counter\nrecorder_mcap_messages_total %llu\n"
+                 "# TYPE recorder_mcap_queued_bytes gauge\nrecorder_mcap_queued_bytes %llu\n"
+                 "# TYPE recorder_mcap_rejected_total counter\nrecorder_mcap_rejected_total %llu\n"
+                 "# TYPE recorder_mcap_compression_ratio gauge\nrecorder_mcap_compression_ratio %.3f\n",
+                 (unsigned long long)m_bytesWritten.load(std::memory_order_relaxed),
+                 (unsigned long long)m_messages.load(std::memory_order_relaxed),
+                 (unsigned long long)m_queuedBytes.load(std::memory_order_relaxed),
+                 (unsigned long long)GetRejectedCount(), compressed > 0 ? (double)uncompressed / compressed : 1.0);
+        out += lines;
+    }
+
+  private:
+    enum opcode
+    {
+        OP_HEADER = 0x01,
+        OP_FOOTER = 0x02,
+        OP_SCHEMA = 0x03,
+        OP_CHANNEL = 0x04,
+        OP_MESSAGE = 0x05,
+        OP_CHUNK = 0x06,
+        OP_MESSAGE_INDEX = 0x07,
+        OP_CHUNK_INDEX = 0x08,
+        OP_STATISTICS = 0x0B,
+        OP_SUMMARY_OFFSET = 0x0E,
+        OP_DATA_END = 0x0F
+    };
+
+    enum
+    {
+        k_magicSize = 8
+    };
+
+    // Starts and ends every MCAP file
+    static const uint8_t* Magic()
+    {
+        static const uint8_t magic[k_magicSize] = {0x89, 'M', 'C', 'A', 'P', 0x30, '\r', '\n'};
+        return magic;
+    }
+
+    struct Channel
+    {
+        std::string serialNumber;
+        mcapImageType type;
+        std::string topic;
+        uint64_t messages;
+    };
+
+    struct ChunkIndex
+    {
+        uint64_t startTime;
+        uint64_t endTime;
+        uint64_t offset;
+        uint64_t length;
+        std::vector<std::pair<uint16_t, uint64_t> > messageIndexOffsets;
+        uint64_t messageIndexLength;
+        std::string compression;
+        uint64_t compressedSize;
+        uint64_t uncompressedSize;
+    };
+
+    // Schema id of a message type; 0 means no schema in MCAP
+    static uint16_t SchemaId(mcapImageType type)
+    {
+        return type == MCAP_IMAGE_RAW ? 1 : 2;
+    }
+
+    // Whether a channel uses the type, so its schema is written
+    bool UsesType(mcapImageType type) const
+    {
+        for (size_t i = 0; i < m_channels.size(); i++)
+        {
+            if (m_channels[i].type == type)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Schema records of the message types in use, with the definitions of
+    // the nested types appended the way ROS 2 stores them
+    void AddSchemas(McapBuffer& buffer)
+    {
+        const std::string separator(80, '=');
+        const std::string headerDefinition = separator + "\n"
+                                                         "MSG: std_msgs/Header\n"
+                                                         "builtin_interfaces/Time stamp\n"
+                                                         "string frame_id\n" +
+                                             separator + "\n"
+                                                         "MSG: builtin_interfaces/Time\n"
+                                                         "int32 sec\n"
+                                                         "uint32 nanosec\n";
+        const mcapImageType types[] = {MCAP_IMAGE_RAW, MCAP_IMAGE_JPEG};
+        for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++)
+        {
+            const mcapImageType type = types[t];
+            if (!UsesType(type))
+            {
+                continue;
+            }
+            const size_t record = buffer.BeginRecord(OP_SCHEMA);
+            buffer.U16(SchemaId(type));
+            buffer.String(type == MCAP_IMAGE_RAW ? "sensor_msgs/msg/Image" : "sensor_msgs/msg/CompressedImage");
+            buffer.String("ros2msg");
+            const std::string definition =
+                type == MCAP_IMAGE_RAW ? std::string("std_msgs/Header header\n"
+                                                     "uint32 height\n"
+                                                     "uint32 width\n"
+                                                     "string encoding\n"
+                                                     "uint8 is_bigendian\n"
+                                                     "uint32 step\n"
+                                                     "uint8[] data\n") + headerDefinition
+                                       : std::string("std_msgs/Header header\n"
+                                                     "string format\n"
+                                                     "uint8[] data\n") + headerDefinition;
+            buffer.String(definition);
+            buffer.EndRecord(record);
+        }
+    }
+
+    // One channel record per camera
+    void AddChannels(McapBuffer& buffer)
+    {
+        for (size_t i = 0; i < m_channels.size(); i++)
+        {
+            const size_t record = buffer.BeginRecord(OP_CHANNEL);
+            buffer.U16((uint16_t)i);
+            buffer.U16(SchemaId(m_channels[i].type));
+            buffer.String(m_channels[i].topic);
+            buffer.String("cdr");
+            const size_t metadata = buffer.BeginPrefixed();
+            buffer.String("serial_number");
+            buffer.String(m_channels[i].serialNumber);
+            buffer.EndPrefixed(metadata);
+            buffer.EndRecord(record);
+        }
+    }
+
+    // Writes to the file, keeping the offset and the data section CRC
+    void Write(const void* data, size_t size)
+    {
+        if (m_failed)
+        {
+            return;
+        }
+        if (fwrite(data, 1, size, m_file) != size)
+        {
+            m_failed = true;
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            ASYNC_LOG(SEVERITY_ERROR, "Unable to write {}: {}", m_path, strerror(errno));
+            return;
+        }
+        if (m_config.crc)
+        {
+            m_dataCrc = Crc32::Update(m_dataCrc, data, size);
+        }
+        m_offset += size;
+        m_bytesWritten.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    // Appends one frame as a message record to the current chunk
+    void AddMessage(const McapFrame& frame)
+    {
+        const Channel& channel = m_channels[frame.channel];
+        McapBuffer& chunk = m_chunk;
+        if (m_chunkMessages == 0)
+        {
+            m_chunkStartTime = frame.logTime;
+            m_chunkEndTime = frame.logTime;
+            m_chunkOpenedNs = GetMonotonicNs();
+        }
+        m_messageIndex[frame.channel].push_back(std::make_pair(frame.logTime, (uint64_t)chunk.bytes.size()));
+        const size_t record = chunk.BeginRecord(OP_MESSAGE);
+        chunk.U16((uint16_t)frame.channel);
+        chunk.U32(frame.sequence);
+        chunk.U64(frame.logTime);
+        chunk.U64(frame.publishTime);
+        // CDR, little endian
+        chunk.U32(0x00000100);
+        const size_t cdrStart = chunk.bytes.size();
+        chunk.U32((uint32_t)(frame.publishTime / 1000000000ULL));
+        chunk.U32((uint32_t)(frame.publishTime % 1000000000ULL));
+        chunk.CdrString(cdrStart, channel.serialNumber);
+        if (channel.type == MCAP_IMAGE_RAW)
+        {
+            chunk.CdrU32(cdrStart, frame.height);
+            chunk.CdrU32(cdrStart, frame.width);
+            chunk.CdrString(cdrStart, "mono8");
+            chunk.U8(0);
+            chunk.CdrU32(cdrStart, frame.height > 0 ? frame.payloadSize / frame.height : 0);
+        }
+        else
+        {
+            chunk.CdrString(cdrStart, "jpeg");
+        }
+        chunk.CdrU32(cdrStart, frame.payloadSize);
+        chunk.Raw(frame.payload, frame.payloadSize);
+        chunk.EndRecord(record);
+
+        m_chunkStartTime = std::min(m_chunkStartTime, frame.logTime);
+        m_chunkEndTime = std::max(m_chunkEndTime, frame.logTime);
+        if (m_messages.load(std::memory_order_relaxed) == 0)
+        {
+            m_messageStartTime = frame.logTime;
+            m_messageEndTime = frame.logTime;
+        }
+        m_messageStartTime = std::min(m_messageStartTime, frame.logTime);
+        m_messageEndTime = std::max(m_messageEndTime, frame.logTime);
+        m_channels[frame.channel].messages++;
+        m_chunkMessages++;
+        m_messages.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Compresses the chunk's records into m_compressed. Returns false if the
+    // records are to be stored as is.
+    bool Compress(const McapBuffer& records)
+    {
+        const size_t size = records.bytes.size();
+#if defined(RECORDER_HAVE_ZSTD)
+        if (m_config.compression == MCAP_COMPRESSION_ZSTD)
+        {
+            m_compressed.resize(ZSTD_compressBound(size));
+            const size_t compressed = ZSTD_compressCCtx(m_zstd, &m_compressed[0], m_compressed.size(),
+                                                        records.bytes.data(), size, m_config.compressionLevel);
+            if (ZSTD_isError(compressed))
+            {
+                ASYNC_LOG_RATE_LIMITED(SEVERITY_WARNING, 1000, "zstd failed on an MCAP chunk: {}",
+                                       ZSTD_getErrorName(compressed));
+                return false;
+            }
+            m_compressed.resize(compressed);
+            return true;
+        }
+#endif
+#if defined(RECORDER_HAVE_LZ4)
+        if (m_config.compression == MCAP_COMPRESSION_LZ4)
+        {
+            LZ4F_preferences_t preferences;
+            memset(&preferences, 0, sizeof(preferences));
+            preferences.frameInfo.contentSize = size;
+            m_compressed.resize(LZ4F_compressFrameBound(size, &preferences));
+            const size_t compressed =
+                LZ4F_compressFrame(&m_compressed[0], m_compressed.size(), records.bytes.data(), size, &preferences);
+            if (LZ4F_isError(compressed))
+            {
+                ASYNC_LOG_RATE_LIMITED(SEVERITY_WARNING, 1000, "lz4 failed on an MCAP chunk: {}",
+                                       LZ4F_getErrorName(compressed));
+                return false;
+            }
+            m_compressed.resize(compressed);
+            return true;
+        }
+#endif
+        (void)size;
+        return false;
+    }
+
+    // Writes the current chunk followed by the message index of each of its channels
+    void FlushChunk()
+    {
+        if (m_chunkMessages == 0)
+        {
+            return;
+        }
+        const uint64_t writeStart = GetMonotonicNs();
+        const uint64_t uncompressedSize = m_chunk.bytes.size();
+        const uint32_t uncompressedCrc =
+            m_config.crc ? Crc32::Update(0, m_chunk.bytes.data(), m_chunk.bytes.size()) : 0;
+        // A chunk that does not shrink (JPEG payloads, noise) is stored as is
+        const uint64_t compressStart = GetMonotonicNs();
+        const bool compressed = Compress(m_chunk) && m_compressed.size() < uncompressedSize;
+        m_compressNs.fetch_add(GetMonotonicNs() - compressStart, std::memory_order_relaxed);
+        const uint8_t* records = compressed ? m_compressed.data() : m_chunk.bytes.data();
+        const uint64_t recordsSize = compressed ? m_compressed.size() : uncompressedSize;
+
+        ChunkIndex index;
+        index.startTime = m_chunkStartTime;
+        index.endTime = m_chunkEndTime;
+        index.offset = m_offset;
+        index.compression = !compressed ? "" : m_config.compression == MCAP_COMPRESSION_ZSTD ? "zstd" : "lz4";
+        index.compressedSize = recordsSize;
+        index.uncompressedSize = uncompressedSize;
+        McapBuffer header;
+        header.U8(OP_CHUNK);
+        header.U64(8 + 8 + 8 + 4 + 4 + index.compression.size() + 8 + recordsSize);
+        header.U64(m_chunkStartTime);
+        header.U64(m_chunkEndTime);
+        header.U64(uncompressedSize);
+        header.U32(uncompressedCrc);
+        header.String(index.compression);
+        header.U64(recordsSize);
+        Write(header.bytes.data(), header.bytes.size());
+        Write(records, recordsSize);
+        index.length = m_offset - index.offset;
+
+        McapBuffer messageIndexes;
+        for (size_t c = 0; c < m_messageIndex.size(); c++)
+        {
+            std::vector<std::pair<uint64_t, uint64_t> >& entries = m_messageIndex[c];
+            if (entries.empty())
+            {
+                continue;
+            }
+            index.messageIndexOffsets.push_back(
+                std::make_pair((uint16_t)c, m_offset + messageIndexes.bytes.size()));
+            const size_t record = messageIndexes.BeginRecord(OP_MESSAGE_INDEX);
+            messageIndexes.U16((uint16_t)c);
+            const size_t array = messageIndexes.BeginPrefixed();
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                messageIndexes.U64(entries[i].first);
+                messageIndexes.U64(entries[i].second);
+            }
+            messageIndexes.EndPrefixed(array);
+            messageIndexes.EndRecord(record);
+            entries.clear();
+        }
+        index.messageIndexLength = messageIndexes.bytes.size();
+        Write(messageIndexes.bytes.data(), messageIndexes.bytes.size());
+        m_chunkIndexes.push_back(index);
+
+        m_uncompressedBytes.fetch_add(uncompressedSize, std::memory_order_relaxed);
+        m_compressedBytes.fetch_add(recordsSize, std::memory_order_relaxed);
+        m_chunks.fetch_add(1, std::memory_order_relaxed);
+        m_writeNs.fetch_add(GetMonotonicNs() - writeStart, std::memory_order_relaxed);
+        m_chunk.bytes.clear();
+        m_chunkMessages = 0;
+    }
+
+    // Writes the data end record, the summary with its offsets, the footer and the closing magic
+    void Finish()
+    {
+        McapBuffer dataEnd;
+        const size_t dataEndRecord = dataEnd.BeginRecord(OP_DATA_END);
+        dataEnd.U32(m_dataCrc);
+        dataEnd.EndRecord(dataEndRecord);
+        Write(dataEnd.bytes.data(), dataEnd.bytes.size());
+
+        const uint64_t summaryStart = m_offset;
+        McapBuffer summary;
+        std::vector<std::pair<uint8_t, std::pair<uint64_t, uint64_t> > > groups;
+        size_t groupStart = summary.bytes.size();
+        AddSchemas(summary);
+        groups.push_back(std::make_pair((uint8_t)OP_SCHEMA,
+                                        std::make_pair(groupStart, summary.bytes.size() - groupStart)));
+        groupStart = summary.bytes.size();
+        AddChannels(summary);
+        groups.push_back(std::make_pair((uint8_t)OP_CHANNEL,
+                                        std::make_pair(groupStart, summary.bytes.size() - groupStart)));
+
+        groupStart = summary.bytes.size();
+        const size_t statistics = summary.BeginRecord(OP_STATISTICS);
+        summary.U64(m_messages.load(std::memory_order_relaxed));
+        summary.U16((uint16_t)(UsesType(MCAP_IMAGE_RAW) + UsesType(MCAP_IMAGE_JPEG)));
+        summary.U32((uint32_t)m_channels.size());
+        summary.U32(0); // attachments
+        summary.U32(0); // metadata
+        summary.U32((uint32_t)m_chunkIndexes.size());
+        summary.U64(m_messageStartTime);
+        summary.U64(m_messageEndTime);
+        const size_t channelCounts = summary.BeginPrefixed();
+        for (size_t c = 0; c < m_channels.size(); c++)
+        {
+            summary.U16((uint16_t)c);
+            summary.U64(m_channels[c].messages);
+        }
+        summary.EndPrefixed(channelCounts);
+        summary.EndRecord(statistics);
+        groups.push_back(std::make_pair((uint8_t)OP_STATISTICS,
+                                        std::make_pair(groupStart, summary.bytes.size() - groupStart)));
+
+        if (!m_chunkIndexes.empty())
+        {
+            groupStart = summary.bytes.size();
+            for (size_t i = 0; i < m_chunkIndexes.size(); i++)
+            {
+                const ChunkIndex& index = m_chunkIndexes[i];
+                const size_t record = summary.BeginRecord(OP_CHUNK_INDEX);
+                summary.U64(index.startTime);
+                summary.U64(index.endTime);
+                summary.U64(index.offset);
+                summary.U64(index.length);
+                const size_t offsets = summary.BeginPrefixed();
+                for (size_t c = 0; c < index.messageIndexOffsets.size(); c++)
+                {
+                    summary.U16(index.messageIndexOffsets[c].first);
+                    summary.U64(index.messageIndexOffsets[c].second);
+                }
+                summary.EndPrefixed(offsets);
+                summary.U64(index.messageIndexLength);
+                summary.String(index.compression);
+                summary.U64(index.compressedSize);
+                summary.U64(index.uncompressedSize);
+                summary.EndRecord(record);
+            }
+            groups.push_back(std::make_pair((uint8_t)OP_CHUNK_INDEX,
+                                            std::make_pair(groupStart, summary.bytes.size() - groupStart)));
+        }
+
+        const uint64_t summaryOffsetStart = summaryStart + summary.bytes.size();
+        for (size_t i = 0; i < groups.size(); i++)
+        {
+            if (groups[i].second.second == 0)
+            {
+                continue;
+            }
+            const size_t record = summary.BeginRecord(OP_SUMMARY_OFFSET);
+            summary.U8(groups[i].first);
+            summary.U64(summaryStart + groups[i].second.first);
+            summary.U64(groups[i].second.second);
+            summary.EndRecord(record);
+        }
+        // The summary CRC covers the footer up to its own field
+        summary.U8(OP_FOOTER);
+        summary.U64(8 + 8 + 4);
+        summary.U64(summaryStart);
+        summary.U64(summaryOffsetStart);
+        summary.U32(m_config.crc ? Crc32::Update(0, summary.bytes.data(), summary.bytes.size()) : 0);
+        summary.Raw(Magic(), k_magicSize);
+        Write(summary.bytes.data(), summary.bytes.size());
+    }
+
+    void Run()
+    {
+        const uint64_t chunkMaxNs = (uint64_t)m_config.chunkMaxMs * 1000000ULL;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cond.wait_for(lock, std::chrono::milliseconds(std::max(1u, m_config.chunkMaxMs / 4)),
+                            [this] { return !m_running || !m_frames.empty(); });
+            while (!m_frames.empty())
+            {
+                McapFrame frame;
+                std::swap(frame, m_frames.front());
+                m_frames.pop_front();
+                lock.unlock();
+                const uint64_t start = GetMonotonicNs();
+                const bool written = !m_failed;
+                if (written)
+                {
+                    AddMessage(frame);
+                }
+                m_queuedBytes.fetch_sub(frame.payloadSize, std::memory_order_relaxed);
+                if (frame.done)
+                {
+                    frame.done(written, GetMonotonicNs() - start);
+                }
+                // Release the frame before taking the next one
+                frame = McapFrame();
+                if (m_chunk.bytes.size() >= m_config.chunkSize)
+                {
+                    FlushChunk();
+                }
+                lock.lock();
+            }
+            if (!m_running)
+            {
+                return;
+            }
+            if (m_chunkMessages > 0 && GetMonotonicNs() - m_chunkOpenedNs >= chunkMaxNs)
+            {
+                lock.unlock();
+                FlushChunk();
+                lock.lock();
+            }
+        }
+    }
+
+    const std::string m_path;
+    McapConfig m_config;
+    std::vector<Channel> m_channels; // fixed after Start()
+    FILE* m_file;
+    uint64_t m_offset;
+    uint32_t m_dataCrc;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<McapFrame> m_frames;
+    bool m_running;
+    std::thread m_thread;
+    std::atomic<bool> m_failed;
+    // Current chunk and index state, used on the I/O thread only
+    McapBuffer m_chunk;
+    std::vector<uint8_t> m_compressed;
+    std::vector<std::vector<std::pair<uint64_t, uint64_t> > > m_messageIndex; // per channel: log time, offset
+    uint64_t m_chunkStartTime;
+    uint64_t m_chunkEndTime;
+    uint64_t m_chunkOpenedNs;
+    uint64_t m_chunkMessages;
+    std::vector<ChunkIndex> m_chunkIndexes;
+    uint64_t m_messageStartTime;
+    uint64_t m_messageEndTime;
+    std::atomic<uint64_t> m_queuedBytes;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<uint64_t> m_messages;
+    std::atomic<uint64_t> m_bytesWritten;
+    std::atomic<uint64_t> m_uncompressedBytes;
+    std::atomic<uint64_t> m_compressedBytes;
+    std::atomic<uint64_t> m_chunks;
+    std::atomic<uint64_t> m_writeErrors;
+    std::atomic<uint64_t> m_writeNs;
+    std::atomic<uint64_t> m_compressNs;
+#if defined(RECORDER_HAVE_ZSTD)
+    ZSTD_CCtx* m_zstd;
+#endif
+};
+
+#endif // DUAL_CAM_RECORDER_MCAP_WRITER_H
@@ -0,0 +1,466 @@
+/*
+ * @Descripttion: Per-camera pipeline metrics with a Prometheus endpoint and file snapshots
+ * @version:
+ * @Date: 2026-10-19 14:10:09
+ * @LastEditTime: 2026-10-19 14:10:09
+ */
+
+#ifndef DUAL_CAM_RECORDER_METRICS_H
+#define DUAL_CAM_RECORDER_METRICS_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "time_utils.h"
+
+// Pipeline stages with a duration histogram
+enum pipelineStage
+{
+    STAGE_CONVERT,
+    STAGE_ENCODE,
+    STAGE_WRITE,
+    NUM_PIPELINE_STAGES
+};
+
+// Duration histogram with fixed buckets. Observe() is two relaxed atomic adds
+// and a short scan, cheap enough for every frame.
+class DurationHistogram
+{
+  public:
+    static const unsigned int k_numBuckets = 11;
+
+    DurationHistogram() : m_count(0), m_sumNs(0)
+    {
+        for (unsigned int i = 0; i < k_numBuckets + 1; i++)
+        {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Observe(uint64_t durationNs)
+    {
+        unsigned int bucket = 0;
+        while (bucket < k_numBuckets && durationNs > BucketBoundNs(bucket))
+        {
+            bucket++;
+        }
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sumNs.fetch_add(durationNs, std::memory_order_relaxed);
+    }
+
+    // Upper bound of a bucket; the last, unnamed bucket is +Inf
+    static uint64_t BucketBoundNs(unsigned int bucket)
+    {
+        static const uint64_t k_boundsUs[k_numBuckets] = {100,   250,   500,    1000,   2500,  5000,
+                                                          10000, 25000, 50000, 100000, 250000};
+        return k_boundsUs[bucket] * 1000ULL;
+    }
+
+    // Appends Prometheus histogram lines (cumulative buckets, _sum, _count)
+    void Render(std::string& out, const std::string& name, const std::string& labels) const
+    {
+        uint64_t cumulative = 0;
+        char line[256];
+        for (unsigned int i = 0; i < k_numBuckets + 1; i++)
+        {
+            cumulative += m_buckets[i].load(std::memory_order_relaxed);
+            if (i < k_numBuckets)
+            {
+                snprintf(line, sizeof(line), "%s_bucket{%s,le=\"%g\"} %llu\n", name.c_str(), labels.c_str(),
+                         BucketBoundNs(i) / 1e9, (unsigned long long)cumulative);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %llu\n", name.c_str(), labels.c_str(),
+                         (unsigned long long)cumulative);
+            }
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_sum{%s} %.9f\n%s_count{%s} %llu\n", name.c_str(), labels.c_str(),
+                 m_sumNs.load(std::memory_order_relaxed) / 1e9, name.c_str(), labels.c_str(),
+                 (unsigned long long)m_count.load(std::memory_order_relaxed));
+        out += line;
+    }
+
+  private:
+    std::atomic<uint64_t> m_buckets[k_numBuckets + 1];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sumNs;
+};
+
+// Counters of one camera. Written from the grab path and the workers with
+// relaxed atomics only; read by the reporter thread.
+struct CameraMetrics
+{
+    std::string serialNumber;
+    std::atomic<uint64_t> framesReceived;
+    std::atomic<uint64_t> framesIncomplete;
+    std::atomic<uint64_t> framesDropped; // dropped by the host pipeline, e.g. on a full queue
+    std::atomic<uint64_t> grabTimeouts;
+    std::atomic<uint64_t> framesSkipped; // not recorded by the motion gate
+    std::atomic<uint64_t> framesShed;    // dropped by the load shedder while output falls behind
+    std::atomic<uint64_t> framesZeroCopy; // POLLING only: written from the acquisition buffer, without a copy
+    std::atomic<uint64_t> framesWritten;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> queueDepth;
+    std::atomic<uint64_t> queueCapacity;
+    std::atomic<uint64_t> sheddingLevel;
+    std::atomic<uint64_t> leasedBuffers; // POLLING acquisition buffers held for in-place writes
+    std::atomic<uint64_t> deviceRemovals;   // times the camera dropped off the bus and was quarantined
+    std::atomic<uint64_t> deviceRecoveries; // times it was reacquired after that
+    std::atomic<uint64_t> recoveryMs;       // duration of the last recovery
+    DurationHistogram stageDurations[NUM_PIPELINE_STAGES];
+
+    explicit CameraMetrics(const std::string& serial)
+        : serialNumber(serial), framesReceived(0), framesIncomplete(0), framesDropped(0), grabTimeouts(0),
+          framesSkipped(0), framesShed(0), framesZeroCopy(0), framesWritten(0), bytesWritten(0), queueDepth(0),
+          queueCapacity(0), sheddingLevel(0), leasedBuffers(0), deviceRemovals(0), deviceRecoveries(0), recoveryMs(0)
+    {
+    }
+
+    void Increment(std::atomic<uint64_t>& counter, uint64_t amount = 1)
+    {
+        counter.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void Set(std::atomic<uint64_t>& gauge, uint64_t value)
+    {
+        gauge.store(value, std::memory_order_relaxed);
+    }
+};
+
+// Owns the metrics of every camera and renders them in the Prometheus text
+// exposition format. Other subsystems can append their own lines through
+// AddCollector.
+class MetricsRegistry
+{
+  public:
+    typedef std::function<void(std::string&)> Collector;
+
+    std::shared_ptr<CameraMetrics> AddCamera(const std::string& serialNumber)
+    {
+        std::shared_ptr<CameraMetrics> metrics(new CameraMetrics(serialNumber));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cameras.push_back(metrics);
+        m_lastReceived.push_back(0);
+        m_lastBytes.push_back(0);
+        m_fps.push_back(0.0);
+        m_bytesPerSecond.push_back(0.0);
+        return metrics;
+    }
+
+    void AddCollector(Collector collector)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_collectors.push_back(collector);
+    }
+
+    // Recomputes the fps and throughput gauges from counter deltas; called
+    // by the reporter once per interval
+    void UpdateRates(double intervalSeconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            const uint64_t received = m_cameras[i]->framesReceived.load(std::memory_order_relaxed);
+            const uint64_t bytes = m_cameras[i]->bytesWritten.load(std::memory_order_relaxed);
+            m_fps[i] = (received - m_lastReceived[i]) / intervalSeconds;
+            m_bytesPerSecond[i] = (bytes - m_lastBytes[i]) / intervalSeconds;
+            m_lastReceived[i] = received;
+            m_lastBytes[i] = bytes;
+        }
+    }
+
+    std::string RenderPrometheus()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string out;
+        RenderCounter(out, "recorder_frames_received_total", "counter", "Frames received from the camera",
+                      &CameraMetrics::framesReceived);
+        RenderCounter(out, "recorder_frames_incomplete_total", "counter", "Frames received incomplete",
+                      &CameraMetrics::framesIncomplete);
+        RenderCounter(out, "recorder_frames_dropped_total", "counter", "Frames dropped by the host pipeline",
+                      &CameraMetrics::framesDropped);
+        RenderCounter(out, "recorder_grab_timeouts_total", "counter", "Grabs that timed out or failed",
+                      &CameraMetrics::grabTimeouts);
+        RenderCounter(out, "recorder_frames_skipped_total", "counter", "Frames not recorded by the motion gate",
+                      &CameraMetrics::framesSkipped);
+        RenderCounter(out, "recorder_frames_shed_total", "counter", "Frames dropped by the load shedder",
+                      &CameraMetrics::framesShed);
+        RenderCounter(out, "recorder_frames_zero_copy_total", "counter",
+                      "POLLING frames written from the acquisition buffer without a copy",
+                      &CameraMetrics::framesZeroCopy);
+        RenderCounter(out, "recorder_frames_written_total", "counter", "Frames written to storage",
+                      &CameraMetrics::framesWritten);
+        RenderCounter(out, "recorder_bytes_written_total", "counter", "Bytes written to storage",
+                      &CameraMetrics::bytesWritten);
+        RenderCounter(out, "recorder_queue_depth", "gauge", "Frames waiting between grab and workers",
+                      &CameraMetrics::queueDepth);
+        RenderCounter(out, "recorder_queue_capacity", "gauge", "Capacity of the grab to worker queue",
+                      &CameraMetrics::queueCapacity);
+        RenderCounter(out, "recorder_shedding_level", "gauge", "Degradation level of the load shedder, 0 for none",
+                      &CameraMetrics::sheddingLevel);
+        RenderCounter(out, "recorder_leased_buffers", "gauge", "POLLING acquisition buffers held by in-place writes",
+                      &CameraMetrics::leasedBuffers);
+        RenderCounter(out, "recorder_device_removals_total", "counter", "Times the camera dropped off the bus",
+                      &CameraMetrics::deviceRemovals);
+        RenderCounter(out, "recorder_device_recoveries_total", "counter", "Times the camera was reacquired",
+                      &CameraMetrics::deviceRecoveries);
+        RenderCounter(out, "recorder_device_recovery_ms", "gauge", "Duration of the last camera recovery",
+                      &CameraMetrics::recoveryMs);
+        RenderRate(out, "recorder_fps", "Frames received per second over the last interval", m_fps);
+        RenderRate(out, "recorder_write_bytes_per_second", "Bytes written per second over the last interval",
+                   m_bytesPerSecond);
+
+        static const char* k_stageNames[NUM_PIPELINE_STAGES] = {"convert", "encode", "write"};
+        out += "# HELP recorder_stage_duration_seconds Per-frame duration of each pipeline stage\n"
+               "# TYPE recorder_stage_duration_seconds histogram\n";
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            for (unsigned int stage = 0; stage < NUM_PIPELINE_STAGES; stage++)
+            {
+                const std::string labels =
+                    "camera=\"" + m_cameras[i]->serialNumber + "\",stage=\"" + k_stageNames[stage] + "\"";
+                m_cameras[i]->stageDurations[stage].Render(out, "recorder_stage_duration_seconds", labels);
+            }
+        }
+        for (size_t i = 0; i < m_collectors.size(); i++)
+        {
+            m_collectors[i](out);
+        }
+        return out;
+    }
+
+  private:
+    void RenderCounter(std::string& out, const char* name, const char* type, const char* help,
+                       std::atomic<uint64_t> CameraMetrics::*field)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+        out += line;
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            snprintf(line, sizeof(line), "%s{camera=\"%s\"} %llu\n", name, m_cameras[i]->serialNumber.c_str(),
+                     (unsigned long long)((*m_cameras[i]).*field).load(std::memory_order_relaxed));
+            out += line;
+        }
+    }
+
+    void RenderRate(std::string& out, const char* name, const char* help, const std::vector<double>& values)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+        out += line;
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            snprintf(line, sizeof(line), "%s{camera=\"%s\"} %.3f\n", name, m_cameras[i]->serialNumber.c_str(),
+                     values[i]);
+            out += line;
+        }
+    }
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<CameraMetrics> > m_cameras;
+    std::vector<uint64_t> m_lastReceived;
+    std::vector<uint64_t> m_lastBytes;
+    std::vector<double> m_fps;
+    std::vector<double> m_bytesPerSecond;
+    std::vector<Collector> m_collectors;
+};
+
+// Background thread that serves GET /metrics on 127.0.0.1:<port> and writes
+// the same text to a snapshot file every interval (written to a temporary
+// file and renamed, so readers never see a partial snapshot). Either output
+// can be disabled with port 0 or an empty path.
+class MetricsReporter
+{
+  public:
+    MetricsReporter(MetricsRegistry& registry, int port, const std::string& snapshotPath, unsigned int intervalMs)
+        : m_registry(registry), m_port(port), m_snapshotPath(snapshotPath), m_intervalMs(intervalMs),
+          m_listenFd(-1), m_lastReportNs(0), m_running(false)
+    {
+    }
+
+    ~MetricsReporter()
+    {
+        Stop();
+    }
+
+    // Returns 0 on success, -1 if the port could not be opened
+    int Start()
+    {
+        int result = 0;
+        if (m_port > 0)
+        {
+            m_listenFd = OpenListenSocket(m_port);
+            if (m_listenFd < 0)
+            {
+                result = -1;
+            }
+        }
+        m_running = true;
+        m_thread = std::thread(&MetricsReporter::Run, this);
+        return result;
+    }
+
+    void Stop()
+    {
+        if (m_running.exchange(false))
+        {
+            m_thread.join();
+            // Leave a final snapshot behind
+            Report(GetMonotonicNs());
+        }
+        if (m_listenFd >= 0)
+        {
+            close(m_listenFd);
+            m_listenFd = -1;
+        }
+    }
+
+  private:
+    static int OpenListenSocket(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t)port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 4) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void Serve(int clientFd)
+    {
+        // A scrape request fits in one read; wait briefly for it
+        struct pollfd pfd = {clientFd, POLLIN, 0};
+        char request[1024];
+        ssize_t length = 0;
+        if (poll(&pfd, 1, 200) > 0)
+        {
+            length = recv(clientFd, request, sizeof(request) - 1, 0);
+        }
+        std::string response;
+        if (length > 0 && strncmp(request, "GET /metrics", 12) == 0)
+        {
+            const std::string body = m_registry.RenderPrometheus();
+            char header[160];
+            snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+                     body.size());
+            response = header + body;
+        }
+        else
+        {
+            response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            ssize_t n = send(clientFd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                break;
+            }
+            sent += (size_t)n;
+        }
+        close(clientFd);
+    }
+
+    void WriteSnapshot()
+    {
+        if (m_snapshotPath.empty())
+        {
+            return;
+        }
+        const std::string body = m_registry.RenderPrometheus();
+        const std::string tmpPath = m_snapshotPath + ".tmp";
+        FILE* file = fopen(tmpPath.c_str(), "w");
+        if (file == nullptr)
+        {
+            return;
+        }
+        fwrite(body.data(), 1, body.size(), file);
+        fclose(file);
+        rename(tmpPath.c_str(), m_snapshotPath.c_str());
+    }
+
+    void Report(uint64_t now)
+    {
+        if (now > m_lastReportNs)
+        {
+            m_registry.UpdateRates((now - m_lastReportNs) / 1e9);
+        }
+        WriteSnapshot();
+        m_lastReportNs = now;
+    }
+
+    void Run()
+    {
+        m_lastReportNs = GetMonotonicNs();
+        while (m_running.load())
+        {
+            const uint64_t now = GetMonotonicNs();
+            const uint64_t elapsedMs = (now - m_lastReportNs) / 1000000ULL;
+            if (elapsedMs >= m_intervalMs)
+            {
+                Report(now);
+                continue;
+            }
+            // Wake at least every 100 ms so Stop() is prompt
+            const int timeoutMs = (int)std::min<uint64_t>(100, m_intervalMs - elapsedMs);
+            if (m_listenFd < 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+                continue;
+            }
+            struct pollfd pfd = {m_listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, timeoutMs) > 0)
+            {
+                int clientFd = accept(m_listenFd, nullptr, nullptr);
+                if (clientFd >= 0)
+                {
+                    Serve(clientFd);
+                }
+            }
+        }
+    }
+
+    MetricsRegistry& m_registry;
+    int m_port;
+    std::string m_snapshotPath;
+    unsigned int m_intervalMs;
+    int m_listenFd;
+    uint64_t m_lastReportNs;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+#endif // DUAL_CAM_RECORDER_METRICS_H
@@ -0,0 +1,324 @@
+/*
+ * @Descripttion: Change detection on a downsampled grid to skip frames of a static scene
+ * @version:
+ * @Date: 2026-10-19 17:20:33
+ * @LastEditTime: 2026-10-19 17:20:33
+ */
+
+#ifndef DUAL_CAM_RECORDER_MOTION_GATE_H
+#define DUAL_CAM_RECORDER_MOTION_GATE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct MotionGateConfig
+{
+    // Grid cells are cellSize x cellSize pixels, of which one row in rowStep
+    // is sampled. (cellSize / rowStep) * cellSize must not exceed 128 so cell
+    // sums fit the 16-bit grid; a cellSize multiple of 16 takes the SIMD path.
+    unsigned int cellSize;
+    unsigned int rowStep;
+    unsigned int cellThreshold;  // a cell changed if its mean moved by more than this many gray levels
+    double areaThreshold;        // a frame is active if at least this fraction of cells changed
+    unsigned int keyframeInterval; // record at least one frame in this many, 0 for never
+    unsigned int preFrames;      // frames recorded before the start of activity
+    unsigned int postFrames;     // frames recorded after the end of activity
+
+    MotionGateConfig()
+        : cellSize(16), rowStep(4), cellThreshold(6), areaThreshold(0.002), keyframeInterval(300), preFrames(5),
+          postFrames(15)
+    {
+    }
+};
+
+// Sum of sampled pixels of every grid cell of a Mono8 frame. Averaging whole
+// cells keeps sensor noise out of the change metric, and sampling one row in
+// rowStep keeps the cost to a fraction of a pass over the frame.
+class MotionGrid
+{
+  public:
+    MotionGrid() : m_cols(0), m_rows(0), m_samplesPerCell(0)
+    {
+    }
+
+    void Compute(const uint8_t* pixels, unsigned int width, unsigned int height, size_t stride,
+                 const MotionGateConfig& config)
+    {
+        const unsigned int cellSize = config.cellSize;
+        m_cols = width / cellSize;
+        m_rows = height / cellSize;
+        m_samplesPerCell = ((cellSize + config.rowStep - 1) / config.rowStep) * cellSize;
+        m_sums.assign((size_t)m_cols * m_rows, 0);
+        for (unsigned int row = 0; row < m_rows; row++)
+        {
+            uint16_t* sums = &m_sums[(size_t)row * m_cols];
+            for (unsigned int y = 0; y < cellSize; y += config.rowStep)
+            {
+                const uint8_t* line = pixels + ((size_t)row * cellSize + y) * stride;
+                AddRow(line, cellSize, sums);
+            }
+        }
+    }
+
+    // Fraction of cells whose mean moved by more than cellThreshold from reference
+    double ChangedFraction(const MotionGrid& reference, unsigned int cellThreshold) const
+    {
+        if (reference.m_sums.size() != m_sums.size() || m_sums.empty())
+        {
+            return 1.0;
+        }
+        const uint16_t threshold = (uint16_t)std::min<unsigned int>(32767, cellThreshold * m_samplesPerCell);
+        const size_t count = m_sums.size();
+        const uint16_t* a = &m_sums[0];
+        const uint16_t* b = &reference.m_sums[0];
+        size_t changed = 0;
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i limit = _mm_set1_epi16((short)threshold);
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+            const __m128i diff = _mm_or_si128(_mm_subs_epu16(x, y), _mm_subs_epu16(y, x));
+            // Sums stay below 32768, so the signed compare is exact
+            const int mask = _mm_movemask_epi8(_mm_cmpgt_epi16(diff, limit));
+            changed += (size_t)__builtin_popcount(mask) / 2;
+        }
+#endif
+        for (; i < count; i++)
+        {
+            if (abs((int)a[i] - (int)b[i]) > threshold)
+            {
+                changed++;
+            }
+        }
+        return (double)changed / (double)count;
+    }
+
+    bool Empty() const
+    {
+        return m_sums.empty();
+    }
+
+    void Swap(MotionGrid& other)
+    {
+        std::swap(m_cols, other.m_cols);
+        std::swap(m_rows, other.m_rows);
+        std::swap(m_samplesPerCell, other.m_samplesPerCell);
+        m_sums.swap(other.m_sums);
+    }
+
+  private:
+    void AddRow(const uint8_t* line, unsigned int cellSize, uint16_t* sums)
+    {
+        unsigned int col = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; cellSize % 16 == 0 && col < m_cols; col++)
+        {
+            const uint8_t* cell = line + (size_t)col * cellSize;
+            __m128i total = zero;
+            for (unsigned int x = 0; x < cellSize; x += 16)
+            {
+                // Two partial sums of 8 bytes each, in the low 16 bits of each half
+                total = _mm_add_epi64(total, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(cell + x)), zero));
+            }
+            sums[col] = (uint16_t)(sums[col] + _mm_cvtsi128_si32(total) + _mm_extract_epi16(total, 4));
+        }
+#endif
+        for (; col < m_cols; col++)
+        {
+            const uint8_t* cell = line + (size_t)col * cellSize;
+            unsigned int total = 0;
+            for (unsigned int x = 0; x < cellSize; x++)
+            {
+                total += cell[x];
+            }
+            sums[col] = (uint16_t)(sums[col] + total);
+        }
+    }
+
+    unsigned int m_cols;
+    unsigned int m_rows;
+    unsigned int m_samplesPerCell;
+    std::vector<uint16_t> m_sums;
+};
+
+enum gateDecision
+{
+    GATE_SKIPPED,
+    GATE_ACTIVITY,
+    GATE_KEYFRAME,
+    GATE_PRE_WINDOW,
+    GATE_POST_WINDOW
+};
+
+// Decides, frame by frame and in frame order, which frames of one camera are
+// recorded. A frame is recorded if enough grid cells changed against the last
+// recorded frame, inside the pre/post window around such activity, or as a
+// periodic keyframe. Up to preFrames undecided frames are held so they can
+// still be recorded when activity starts. Every frame, recorded or not, gets
+// a line in the metadata file.
+class MotionGate
+{
+  public:
+    typedef std::function<void()> WriteTask;
+
+    MotionGate(const MotionGateConfig& config, const std::string& metadataPath)
+        : m_config(config), m_postRemaining(0), m_lastRecorded(0), m_hasRecorded(false), m_recorded(0),
+          m_skipped(0)
+    {
+        m_metadata = fopen(metadataPath.c_str(), "w");
+        if (m_metadata != nullptr)
+        {
+            fprintf(m_metadata, "frame,device_ts,host_ts,changed_fraction,decision\n");
+        }
+    }
+
+    ~MotionGate()
+    {
+        Finish();
+    }
+
+    // Runs write if the frame is recorded. Must be called in frame order,
+    // e.g. from the camera's writer strand.
+    void Process(uint64_t frameIndex, uint64_t deviceTimestamp, uint64_t hostTimestamp, MotionGrid& grid,
+                 WriteTask write)
+    {
+        HeldFrame frame;
+        frame.frameIndex = frameIndex;
+        frame.deviceTimestamp = deviceTimestamp;
+        frame.hostTimestamp = hostTimestamp;
+        frame.changedFraction = m_reference.Empty() ? 1.0 : grid.ChangedFraction(m_reference, m_config.cellThreshold);
+        frame.write = write;
+
+        gateDecision decision = GATE_SKIPPED;
+        if (frame.changedFraction >= m_config.areaThreshold)
+        {
+            decision = GATE_ACTIVITY;
+            m_postRemaining = m_config.postFrames;
+        }
+        else if (m_postRemaining > 0)
+        {
+            decision = GATE_POST_WINDOW;
+            m_postRemaining--;
+        }
+        else if (!m_hasRecorded ||
+                 (m_config.keyframeInterval > 0 && frameIndex - m_lastRecorded >= m_config.keyframeInterval))
+        {
+            decision = GATE_KEYFRAME;
+        }
+
+        if (decision == GATE_SKIPPED)
+        {
+            m_held.push_back(frame);
+            while (m_held.size() > m_config.preFrames)
+            {
+                Skip(m_held.front());
+                m_held.pop_front();
+            }
+            return;
+        }
+        // Frames held back are older than this one
+        while (!m_held.empty())
+        {
+            if (decision == GATE_ACTIVITY)
+            {
+                Record(m_held.front(), GATE_PRE_WINDOW);
+            }
+            else
+            {
+                Skip(m_held.front());
+            }
+            m_held.pop_front();
+        }
+        m_reference.Swap(grid);
+        Record(frame, decision);
+    }
+
+    // Drops the frames still held and closes the metadata file
+    void Finish()
+    {
+        while (!m_held.empty())
+        {
+            Skip(m_held.front());
+            m_held.pop_front();
+        }
+        if (m_metadata != nullptr)
+        {
+            fclose(m_metadata);
+            m_metadata = nullptr;
+        }
+    }
+
+    uint64_t GetRecordedCount() const
+    {
+        return m_recorded.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetSkippedCount() const
+    {
+        return m_skipped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct HeldFrame
+    {
+        uint64_t frameIndex;
+        uint64_t deviceTimestamp;
+        uint64_t hostTimestamp;
+        double changedFraction;
+        WriteTask write;
+    };
+
+    void Log(const HeldFrame& frame, gateDecision decision)
+    {
+        static const char* k_decisionNames[] = {"skipped", "activity", "keyframe", "pre_window", "post_window"};
+        if (m_metadata != nullptr)
+        {
+            fprintf(m_metadata, "%llu,%llu,%llu,%.5f,%s\n", (unsigned long long)frame.frameIndex,
+                    (unsigned long long)frame.deviceTimestamp, (unsigned long long)frame.hostTimestamp,
+                    frame.changedFraction, k_decisionNames[decision]);
+        }
+    }
+
+    void Record(HeldFrame& frame, gateDecision decision)
+    {
+        Log(frame, decision);
+        m_lastRecorded = frame.frameIndex;
+        m_hasRecorded = true;
+        m_recorded.fetch_add(1, std::memory_order_relaxed);
+        if (frame.write)
+        {
+            frame.write();
+        }
+    }
+
+    void Skip(HeldFrame& frame)
+    {
+        Log(frame, GATE_SKIPPED);
+        m_skipped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const MotionGateConfig m_config;
+    FILE* m_metadata;
+    MotionGrid m_reference; // grid of the last recorded frame
+    std::deque<HeldFrame> m_held;
+    unsigned int m_postRemaining;
+    uint64_t m_lastRecorded;
+    bool m_hasRecorded;
+    std::atomic<uint64_t> m_recorded;
+    std::atomic<uint64_t> m_skipped;
+};
+
+#endif // DUAL_CAM_RECORDER_MOTION_GATE_H
@@ -0,0 +1,253 @@
+/*
+ * @Descripttion: Packed 10/12-bit pixel layouts with scalar and SSSE3 unpacking to 16 or 8 bits
+ * @version:
+ * @Date: 2026-10-19 21:02:44
+ * @LastEditTime: 2026-10-19 21:02:44
+ */
+
+#ifndef DUAL_CAM_RECORDER_PACKED_PIXELS_H
+#define DUAL_CAM_RECORDER_PACKED_PIXELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <tmmintrin.h>
+#define PACKED_PIXELS_SSSE3 1
+#endif
+
+// Bit layouts of the packed pixel formats, independent of Spinnaker so
+// recordings can be read without it. The "p" formats (PFNC) pack samples
+// LSB first with no padding, also across lines. The "Packed" formats (GigE
+// Vision) store two 12-bit samples in three bytes: the 8 MSBs of each
+// sample in its own byte and both 4-bit remainders in the middle byte.
+enum pixelPacking
+{
+    PACKING_NONE,     // one or two whole bytes per sample
+    PACKING_10P,      // Mono10p, BayerRG10p: 4 samples in 5 bytes
+    PACKING_12P,      // Mono12p, BayerRG12p: 2 samples in 3 bytes
+    PACKING_12PACKED, // Mono12Packed, BayerRG12Packed: 2 samples in 3 bytes
+    NUM_PIXEL_PACKINGS
+};
+
+inline unsigned int GetPackingBitDepth(pixelPacking packing)
+{
+    return packing == PACKING_10P ? 10 : packing == PACKING_NONE ? 8 : 12;
+}
+
+// Bytes of count packed samples
+inline size_t GetPackedSize(pixelPacking packing, size_t count)
+{
+    return (count * GetPackingBitDepth(packing) + 7) / 8;
+}
+
+// Unpacks count samples to 16-bit values, right aligned (0..4095 for 12 bits)
+inline void UnpackPixels16Scalar(pixelPacking packing, const uint8_t* src, size_t count, uint16_t* dst)
+{
+    if (packing == PACKING_12PACKED)
+    {
+        for (size_t i = 0; i < count; i += 2)
+        {
+            const uint8_t* p = src + i / 2 * 3;
+            dst[i] = (uint16_t)((p[0] << 4) | (p[1] & 0x0F));
+            if (i + 1 < count)
+            {
+                dst[i + 1] = (uint16_t)((p[2] << 4) | (p[1] >> 4));
+            }
+        }
+        return;
+    }
+    // A 10 or 12-bit sample at bit offset 0..6 always spans two bytes
+    const unsigned int bits = GetPackingBitDepth(packing);
+    const uint16_t mask = (uint16_t)((1u << bits) - 1);
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t bit = i * bits;
+        const uint8_t* p = src + bit / 8;
+        dst[i] = (uint16_t)(((p[0] | (p[1] << 8)) >> (bit % 8)) & mask);
+    }
+}
+
+// Unpacks count samples to their 8 most significant bits
+inline void UnpackPixels8Scalar(pixelPacking packing, const uint8_t* src, size_t count, uint8_t* dst)
+{
+    const unsigned int shift = GetPackingBitDepth(packing) - 8;
+    uint16_t samples[64];
+    for (size_t i = 0; i < count; i += 64)
+    {
+        const size_t n = count - i < 64 ? count - i : 64;
+        UnpackPixels16Scalar(packing, src + GetPackedSize(packing, i), n, samples);
+        for (size_t j = 0; j < n; j++)
+        {
+            dst[i + j] = (uint8_t)(samples[j] >> shift);
+        }
+    }
+}
+
+// Packs count right-aligned 16-bit samples; the bits above the depth are
+// ignored. Used to make packed test frames.
+inline void PackPixels16(pixelPacking packing, const uint16_t* src, size_t count, uint8_t* dst)
+{
+    const unsigned int bits = GetPackingBitDepth(packing);
+    const uint16_t mask = (uint16_t)((1u << bits) - 1);
+    memset(dst, 0, GetPackedSize(packing, count));
+    if (packing == PACKING_12PACKED)
+    {
+        for (size_t i = 0; i < count; i += 2)
+        {
+            uint8_t* p = dst + i / 2 * 3;
+            const uint16_t even = src[i] & mask;
+            p[0] = (uint8_t)(even >> 4);
+            p[1] = (uint8_t)(even & 0x0F);
+            if (i + 1 < count)
+            {
+                const uint16_t odd = src[i + 1] & mask;
+                p[1] |= (uint8_t)((odd & 0x0F) << 4);
+                p[2] = (uint8_t)(odd >> 4);
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t bit = i * bits;
+        const unsigned int value = (unsigned int)(src[i] & mask) << (bit % 8);
+        dst[bit / 8] |= (uint8_t)value;
+        dst[bit / 8 + 1] |= (uint8_t)(value >> 8);
+    }
+}
+
+#if defined(PACKED_PIXELS_SSSE3)
+// Whether the SSSE3 kernels can run here, checked once
+inline bool CpuHasSsse3()
+{
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3") != 0);
+    return has;
+}
+
+// Unpacks 16 samples starting at src into two registers of 16-bit samples.
+// Reads at most 28 bytes (10p: 26).
+__attribute__((target("ssse3"))) inline void UnpackBlock16Ssse3(pixelPacking packing, const uint8_t* src,
+                                                                __m128i& low, __m128i& high)
+{
+    __m128i words[2];
+    if (packing == PACKING_10P)
+    {
+        // Sample j of 8 starts at bit 10j: bytes 10j/8 and the next, shifted
+        // right by 10j%8 = 0,2,4,6 (done as << 6-shift, >> 6)
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+        const __m128i align = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+        for (int half = 0; half < 2; half++)
+        {
+            const __m128i bytes = _mm_loadu_si128((const __m128i*)(src + 10 * half));
+            words[half] = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(bytes, shuffle), align), 6);
+        }
+    }
+    else if (packing == PACKING_12P)
+    {
+        // Even samples are the low 12 bits of bytes (3k, 3k+1), odd samples
+        // the high 12 bits of bytes (3k+1, 3k+2)
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+        const __m128i evenMask = _mm_setr_epi16(0x0FFF, 0, 0x0FFF, 0, 0x0FFF, 0, 0x0FFF, 0);
+        const __m128i evenLanes = _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+        for (int half = 0; half < 2; half++)
+        {
+            const __m128i pairs = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 12 * half)), shuffle);
+            words[half] = _mm_or_si128(_mm_and_si128(pairs, evenMask),
+                                       _mm_andnot_si128(evenLanes, _mm_srli_epi16(pairs, 4)));
+        }
+    }
+    else
+    {
+        // Even samples are bytes (hi 3k, lo 3k+1) as (3k << 4) | (3k+1 & 0xF),
+        // odd samples bytes (hi 3k+2, lo 3k+1) shifted right by 4
+        const __m128i shuffle = _mm_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11);
+        const __m128i highMask = _mm_setr_epi16(0x0FF0, -1, 0x0FF0, -1, 0x0FF0, -1, 0x0FF0, -1);
+        const __m128i lowMask = _mm_setr_epi16(0x000F, 0, 0x000F, 0, 0x000F, 0, 0x000F, 0);
+        for (int half = 0; half < 2; half++)
+        {
+            const __m128i pairs = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 12 * half)), shuffle);
+            words[half] = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(pairs, 4), highMask),
+                                       _mm_and_si128(pairs, lowMask));
+        }
+    }
+    low = words[0];
+    high = words[1];
+}
+
+// Samples the SSSE3 kernels can take from size bytes without reading past
+// them: whole blocks of 16 whose last 16-byte load still fits
+inline size_t GetSsse3Samples(pixelPacking packing, size_t count)
+{
+    const size_t blockBytes = GetPackedSize(packing, 16);
+    const size_t lastLoadEnd = packing == PACKING_10P ? 26 : 28;
+    const size_t size = GetPackedSize(packing, count);
+    const size_t samples = size < lastLoadEnd ? 0 : ((size - lastLoadEnd) / blockBytes + 1) * 16;
+    return samples < count ? samples : count / 16 * 16;
+}
+
+__attribute__((target("ssse3"))) inline size_t UnpackPixels16Ssse3(pixelPacking packing, const uint8_t* src,
+                                                                   size_t count, uint16_t* dst)
+{
+    const size_t samples = GetSsse3Samples(packing, count);
+    const size_t blockBytes = GetPackedSize(packing, 16);
+    for (size_t i = 0; i < samples; i += 16, src += blockBytes)
+    {
+        __m128i low;
+        __m128i high;
+        UnpackBlock16Ssse3(packing, src, low, high);
+        _mm_storeu_si128((__m128i*)(dst + i), low);
+        _mm_storeu_si128((__m128i*)(dst + i + 8), high);
+    }
+    return samples;
+}
+
+__attribute__((target("ssse3"))) inline size_t UnpackPixels8Ssse3(pixelPacking packing, const uint8_t* src,
+                                                                  size_t count, uint8_t* dst)
+{
+    const size_t samples = GetSsse3Samples(packing, count);
+    const size_t blockBytes = GetPackedSize(packing, 16);
+    const int shift = (int)GetPackingBitDepth(packing) - 8;
+    for (size_t i = 0; i < samples; i += 16, src += blockBytes)
+    {
+        __m128i low;
+        __m128i high;
+        UnpackBlock16Ssse3(packing, src, low, high);
+        low = _mm_srli_epi16(low, shift);
+        high = _mm_srli_epi16(high, shift);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(low, high));
+    }
+    return samples;
+}
+#endif
+
+// Unpacks count samples to right-aligned 16-bit values, with SSSE3 where the
+// CPU has it
+inline void UnpackPixels16(pixelPacking packing, const uint8_t* src, size_t count, uint16_t* dst)
+{
+    size_t done = 0;
+#if defined(PACKED_PIXELS_SSSE3)
+    if (CpuHasSsse3())
+    {
+        done = UnpackPixels16Ssse3(packing, src, count, dst);
+    }
+#endif
+    // The kernels stop on a 16-sample boundary, which is byte aligned
+    UnpackPixels16Scalar(packing, src + GetPackedSize(packing, done), count - done, dst + done);
+}
+
+// Unpacks count samples to their 8 most significant bits, with SSSE3 where
+// the CPU has it
+inline void UnpackPixels8(pixelPacking packing, const uint8_t* src, size_t count, uint8_t* dst)
+{
+    size_t done = 0;
+#if defined(PACKED_PIXELS_SSSE3)
+    if (CpuHasSsse3())
+    {
+        done = UnpackPixels8Ssse3(packing, src, count, dst);
+    }
+#endif
+    UnpackPixels8Scalar(packing, src + GetPackedSize(packing, done), count - done, dst + done);
+}
+
+#endif // DUAL_CAM_RECORDER_PACKED_PIXELS_H
@@ -0,0 +1,480 @@
+/*
+ * @Descripttion: Crop, binning, format conversion and LUT fused into one pass per format combination
+ * @version:
+ * @Date: 2026-10-19 21:48:10
+ * @LastEditTime: 2026-10-19 21:48:10
+ */
+
+#ifndef DUAL_CAM_RECORDER_PIXEL_PIPELINE_H
+#define DUAL_CAM_RECORDER_PIXEL_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "frame_arena.h"
+
+// Pixel formats the pipeline reads and writes, independent of Spinnaker
+enum pipelineFormat
+{
+    PIPELINE_MONO8,
+    PIPELINE_MONO16,   // right-aligned samples of PipelineConfig::inputBits
+    PIPELINE_BAYERRG8, // read as gray, from the R, G, G and B of each 2x2 window
+    NUM_PIPELINE_FORMATS
+};
+
+inline const char* GetPipelineFormatName(pipelineFormat format)
+{
+    const char* names[] = {"Mono8", "Mono16", "BayerRG8"};
+    return format < NUM_PIPELINE_FORMATS ? names[format] : "unknown";
+}
+
+// Operations applied to each frame, in this order: crop, bin, convert to the
+// output format, LUT
+struct PipelineConfig
+{
+    // Kept region of the input; a zero width or height keeps the whole
+    // frame. Bayer crops are moved to even offsets to keep the RGGB phase.
+    unsigned int cropX;
+    unsigned int cropY;
+    unsigned int cropWidth;
+    unsigned int cropHeight;
+    unsigned int bin;         // 1, or 2 to average 2x2 blocks
+    unsigned int inputBits;   // depth of PIPELINE_MONO16 samples, 9..16
+    pipelineFormat output;    // PIPELINE_MONO8, or PIPELINE_MONO16 from PIPELINE_MONO16 at the input's depth
+    std::vector<uint8_t> lut; // 256 entries applied to Mono8 output, empty for none
+
+    PipelineConfig()
+        : cropX(0), cropY(0), cropWidth(0), cropHeight(0), bin(1), inputBits(16), output(PIPELINE_MONO8)
+    {
+    }
+
+    // Fills lut with a gamma curve; a gamma of 1.0 clears it
+    void SetGamma(double gamma)
+    {
+        lut.clear();
+        if (gamma == 1.0 || gamma <= 0.0)
+        {
+            return;
+        }
+        lut.resize(256);
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            lut[i] = (uint8_t)std::min(255.0, std::floor(255.0 * std::pow(i / 255.0, 1.0 / gamma) + 0.5));
+        }
+    }
+};
+
+// A processed frame; data is reused between frames and lives in a
+// FrameArena, the default one unless given
+struct PipelineOutput
+{
+    ArenaBytes data;
+    unsigned int width;
+    unsigned int height;
+    size_t stride;
+
+    explicit PipelineOutput(FrameArena* arena = nullptr)
+        : data(ArenaAllocator<uint8_t>(arena)), width(0), height(0), stride(0)
+    {
+    }
+};
+
+// Reads one input sample sum per output pixel. countShift is log2 of the
+// number of samples summed; lookahead is 1 if the sum at x also reads x + 1,
+// in which case the last column sums from x - 1 instead.
+template <pipelineFormat In, unsigned int Bin>
+struct PipelineInput;
+
+template <unsigned int Bin>
+struct PipelineInput<PIPELINE_MONO8, Bin>
+{
+    enum
+    {
+        k_countShift = Bin == 2 ? 2 : 0,
+        k_lookahead = 0
+    };
+
+    static unsigned int Bits(const PipelineConfig&)
+    {
+        return 8;
+    }
+
+    static unsigned int Sum(const uint8_t* row, const uint8_t* next, unsigned int x)
+    {
+        if (Bin == 2)
+        {
+            return row[2 * x] + row[2 * x + 1] + next[2 * x] + next[2 * x + 1];
+        }
+        return row[x];
+    }
+};
+
+template <unsigned int Bin>
+struct PipelineInput<PIPELINE_MONO16, Bin>
+{
+    enum
+    {
+        k_countShift = Bin == 2 ? 2 : 0,
+        k_lookahead = 0
+    };
+
+    static unsigned int Bits(const PipelineConfig& config)
+    {
+        return config.inputBits;
+    }
+
+    static unsigned int Sum(const uint8_t* row, const uint8_t* next, unsigned int x)
+    {
+        const uint16_t* row16 = (const uint16_t*)row;
+        const uint16_t* next16 = (const uint16_t*)next;
+        if (Bin == 2)
+        {
+            return row16[2 * x] + row16[2 * x + 1] + next16[2 * x] + next16[2 * x + 1];
+        }
+        return row16[x];
+    }
+};
+
+// Any 2x2 window of an RGGB mosaic holds one R, two G and one B, so their sum
+// is a luma of (R + 2G + B) / 4 at full resolution. Binned, each output pixel
+// is one RGGB quad.
+template <unsigned int Bin>
+struct PipelineInput<PIPELINE_BAYERRG8, Bin>
+{
+    enum
+    {
+        k_countShift = 2,
+        k_lookahead = Bin == 2 ? 0 : 1
+    };
+
+    static unsigned int Bits(const PipelineConfig&)
+    {
+        return 8;
+    }
+
+    static unsigned int Sum(const uint8_t* row, const uint8_t* next, unsigned int x)
+    {
+        const unsigned int left = Bin * x;
+        return row[left] + row[left + 1] + next[left] + next[left + 1];
+    }
+};
+
+template <pipelineFormat Out, bool Lut>
+struct PipelineOutputWriter;
+
+template <bool Lut>
+struct PipelineOutputWriter<PIPELINE_MONO8, Lut>
+{
+    static void Write(uint8_t* row, unsigned int x, unsigned int value, const uint8_t* lut)
+    {
+        const unsigned int clamped = std::min(value, 255u);
+        row[x] = Lut ? lut[clamped] : (uint8_t)clamped;
+    }
+};
+
+template <bool Lut>
+struct PipelineOutputWriter<PIPELINE_MONO16, Lut>
+{
+    static void Write(uint8_t* row, unsigned int x, unsigned int value, const uint8_t*)
+    {
+        ((uint16_t*)row)[x] = (uint16_t)value;
+    }
+};
+
+// One instantiation per combination: every operation is resolved at compile
+// time and the frame is read once. src points at the crop's first pixel;
+// width and height are the output's.
+template <pipelineFormat In, pipelineFormat Out, unsigned int Bin, bool Lut>
+void RunFusedPipeline(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, unsigned int width,
+                      unsigned int height, const PipelineConfig& config)
+{
+    typedef PipelineInput<In, Bin> Input;
+    typedef PipelineOutputWriter<Out, Lut> Output;
+    const unsigned int shift = Input::k_countShift + (Out == PIPELINE_MONO8 ? Input::Bits(config) - 8 : 0);
+    const uint8_t* lut = Lut ? &config.lut[0] : nullptr;
+    const unsigned int inputRows = height * Bin;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        const unsigned int inputRow = y * Bin;
+        const uint8_t* row = src + inputRow * srcStride;
+        // The window of the last row reaches up instead of down
+        const uint8_t* next = row + srcStride;
+        if (Input::k_lookahead && inputRow + 1 >= inputRows)
+        {
+            next = row - srcStride;
+        }
+        uint8_t* out = dst + y * dstStride;
+        const unsigned int end = width - Input::k_lookahead;
+        for (unsigned int x = 0; x < end; x++)
+        {
+            Output::Write(out, x, Input::Sum(row, next, x) >> shift, lut);
+        }
+        if (Input::k_lookahead)
+        {
+            Output::Write(out, width - 1, Input::Sum(row, next, width - 2) >> shift, lut);
+        }
+    }
+}
+
+typedef void (*PipelineKernel)(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                               unsigned int width, unsigned int height, const PipelineConfig& config);
+
+// Fused kernel of a combination, or null if it is not instantiated
+inline PipelineKernel GetPipelineKernel(pipelineFormat input, pipelineFormat output, unsigned int bin, bool lut)
+{
+    struct Instantiation
+    {
+        pipelineFormat input;
+        pipelineFormat output;
+        unsigned int bin;
+        bool lut;
+        PipelineKernel kernel;
+    };
+    static const Instantiation instantiations[] = {
+        {PIPELINE_MONO8, PIPELINE_MONO8, 1, false, &RunFusedPipeline<PIPELINE_MONO8, PIPELINE_MONO8, 1, false>},
+        {PIPELINE_MONO8, PIPELINE_MONO8, 1, true, &RunFusedPipeline<PIPELINE_MONO8, PIPELINE_MONO8, 1, true>},
+        {PIPELINE_MONO8, PIPELINE_MONO8, 2, false, &RunFusedPipeline<PIPELINE_MONO8, PIPELINE_MONO8, 2, false>},
+        {PIPELINE_MONO8, PIPELINE_MONO8, 2, true, &RunFusedPipeline<PIPELINE_MONO8, PIPELINE_MONO8, 2, true>},
+        {PIPELINE_MONO16, PIPELINE_MONO8, 1, false, &RunFusedPipeline<PIPELINE_MONO16, PIPELINE_MONO8, 1, false>},
+        {PIPELINE_MONO16, PIPELINE_MONO8, 1, true, &RunFusedPipeline<PIPELINE_MONO16, PIPELINE_MONO8, 1, true>},
+        {PIPELINE_MONO16, PIPELINE_MONO8, 2, false, &RunFusedPipeline<PIPELINE_MONO16, PIPELINE_MONO8, 2, false>},
+        {PIPELINE_MONO16, PIPELINE_MONO8, 2, true, &RunFusedPipeline<PIPELINE_MONO16, PIPELINE_MONO8, 2, true>},
+        {PIPELINE_MONO16, PIPELINE_MONO16, 1, false, &RunFusedPipeline<PIPELINE_MONO16, PIPELINE_MONO16, 1, false>},
+        {PIPELINE_MONO16, PIPELINE_MONO16, 2, false, &RunFusedPipeline<PIPELINE_MONO16, PIPELINE_MONO16, 2, false>},
+        {PIPELINE_BAYERRG8, PIPELINE_MONO8, 1, false, &RunFusedPipeline<PIPELINE_BAYERRG8, PIPELINE_MONO8, 1, false>},
+        {PIPELINE_BAYERRG8, PIPELINE_MONO8, 1, true, &RunFusedPipeline<PIPELINE_BAYERRG8, PIPELINE_MONO8, 1, true>},
+        {PIPELINE_BAYERRG8, PIPELINE_MONO8, 2, false, &RunFusedPipeline<PIPELINE_BAYERRG8, PIPELINE_MONO8, 2, false>},
+        {PIPELINE_BAYERRG8, PIPELINE_MONO8, 2, true, &RunFusedPipeline<PIPELINE_BAYERRG8, PIPELINE_MONO8, 2, true>},
+    };
+    for (size_t i = 0; i < sizeof(instantiations) / sizeof(instantiations[0]); i++)
+    {
+        const Instantiation& candidate = instantiations[i];
+        if (candidate.input == input && candidate.output == output && candidate.bin == bin && candidate.lut == lut)
+        {
+            return candidate.kernel;
+        }
+    }
+    return nullptr;
+}
+
+inline unsigned int GetPipelineBytesPerPixel(pipelineFormat format)
+{
+    return format == PIPELINE_MONO16 ? 2 : 1;
+}
+
+// Crop of a width x height frame after clamping and Bayer alignment, and the
+// output size it bins to. Returns false if nothing is left to process.
+inline bool GetPipelineRegion(pipelineFormat input, const PipelineConfig& config, unsigned int width,
+                              unsigned int height, unsigned int& x, unsigned int& y, unsigned int& outputWidth,
+                              unsigned int& outputHeight)
+{
+    const unsigned int align = input == PIPELINE_BAYERRG8 ? 2 : 1;
+    x = std::min(config.cropX / align * align, width);
+    y = std::min(config.cropY / align * align, height);
+    unsigned int regionWidth = config.cropWidth == 0 ? width - x : std::min(config.cropWidth, width - x);
+    unsigned int regionHeight = config.cropHeight == 0 ? height - y : std::min(config.cropHeight, height - y);
+    outputWidth = regionWidth / config.bin;
+    outputHeight = regionHeight / config.bin;
+    // A Bayer window needs two rows and two columns
+    const unsigned int minimum = input == PIPELINE_BAYERRG8 ? 2 : 1;
+    return regionWidth >= minimum && regionHeight >= minimum && outputWidth > 0 && outputHeight > 0;
+}
+
+// Runs the fused kernel picked once for a camera's format and settings, so
+// the per-frame path makes a single indirect call instead of branching on
+// formats and operations per pixel
+class PixelPipeline
+{
+  public:
+    PixelPipeline() : m_input(PIPELINE_MONO8), m_kernel(nullptr)
+    {
+    }
+
+    // Picks the kernel of input under config. Returns -1 if the combination
+    // is not supported.
+    int Select(pipelineFormat input, const PipelineConfig& config)
+    {
+        m_kernel = nullptr;
+        if ((config.bin != 1 && config.bin != 2) || (!config.lut.empty() && config.lut.size() != 256) ||
+            (input == PIPELINE_MONO16 && (config.inputBits < 9 || config.inputBits > 16)))
+        {
+            return -1;
+        }
+        m_kernel = GetPipelineKernel(input, config.output, config.bin, !config.lut.empty());
+        m_input = input;
+        m_config = config;
+        return m_kernel != nullptr ? 0 : -1;
+    }
+
+    bool IsSelected() const
+    {
+        return m_kernel != nullptr;
+    }
+
+    // Whether frames come out as they went in, so the pipeline can be skipped
+    bool IsIdentity() const
+    {
+        return m_input == PIPELINE_MONO8 && m_config.output == PIPELINE_MONO8 && m_config.bin == 1 &&
+               m_config.lut.empty() && m_config.cropWidth == 0 && m_config.cropHeight == 0 && m_config.cropX == 0 &&
+               m_config.cropY == 0;
+    }
+
+    pipelineFormat GetInput() const
+    {
+        return m_input;
+    }
+
+    std::string Describe() const
+    {
+        std::ostringstream description;
+        description << GetPipelineFormatName(m_input) << " -> " << GetPipelineFormatName(m_config.output);
+        if (m_config.cropWidth != 0 || m_config.cropHeight != 0 || m_config.cropX != 0 || m_config.cropY != 0)
+        {
+            description << ", crop " << m_config.cropWidth << "x" << m_config.cropHeight << "+" << m_config.cropX
+                        << "+" << m_config.cropY;
+        }
+        if (m_config.bin != 1)
+        {
+            description << ", bin " << m_config.bin << "x" << m_config.bin;
+        }
+        if (!m_config.lut.empty())
+        {
+            description << ", LUT";
+        }
+        return description.str();
+    }
+
+    // Processes a width x height frame into output. Returns -1 if no kernel
+    // is selected or the crop leaves nothing.
+    int Process(const uint8_t* src, unsigned int width, unsigned int height, size_t stride,
+                PipelineOutput& output) const
+    {
+        unsigned int x;
+        unsigned int y;
+        if (m_kernel == nullptr ||
+            !GetPipelineRegion(m_input, m_config, width, height, x, y, output.width, output.height))
+        {
+            return -1;
+        }
+        output.stride = (size_t)output.width * GetPipelineBytesPerPixel(m_config.output);
+        output.data.resize(output.stride * output.height);
+        m_kernel(src + y * stride + (size_t)x * GetPipelineBytesPerPixel(m_input), stride, &output.data[0],
+                 output.stride, output.width, output.height, m_config);
+        return 0;
+    }
+
+  private:
+    pipelineFormat m_input;
+    PipelineConfig m_config;
+    PipelineKernel m_kernel;
+};
+
+// Intermediate frames of RunChainedPipeline, reused between frames
+struct PipelineStages
+{
+    std::vector<uint8_t> cropped;
+    std::vector<uint16_t> binned;
+    std::vector<uint8_t> converted;
+};
+
+// The same operations as one pass per stage over whole frames, each choosing
+// its branch at run time: crop copies the region, bin averages at the input's
+// depth (a Bayer input is turned to gray here, per quad or per window),
+// convert scales to the output depth and the LUT maps the result. Gives the
+// same output as the fused kernels; kept as their reference and baseline.
+inline int RunChainedPipeline(pipelineFormat input, const PipelineConfig& config, const uint8_t* src,
+                              unsigned int width, unsigned int height, size_t stride, PipelineStages& stages,
+                              PipelineOutput& output)
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int outputWidth;
+    unsigned int outputHeight;
+    if (!GetPipelineRegion(input, config, width, height, x, y, outputWidth, outputHeight))
+    {
+        return -1;
+    }
+    const unsigned int bytesPerPixel = GetPipelineBytesPerPixel(input);
+    const unsigned int bin = config.bin;
+    const unsigned int regionWidth = outputWidth * bin;
+    const unsigned int regionHeight = outputHeight * bin;
+    const size_t croppedStride = (size_t)regionWidth * bytesPerPixel;
+
+    // Crop
+    stages.cropped.resize(croppedStride * regionHeight);
+    for (unsigned int row = 0; row < regionHeight; row++)
+    {
+        memcpy(&stages.cropped[row * croppedStride], src + (y + row) * stride + (size_t)x * bytesPerPixel,
+               croppedStride);
+    }
+
+    // Bin, and Bayer to gray
+    stages.binned.resize((size_t)outputWidth * outputHeight);
+    for (unsigned int row = 0; row < outputHeight; row++)
+    {
+        for (unsigned int column = 0; column < outputWidth; column++)
+        {
+            unsigned int sum = 0;
+            unsigned int count = 0;
+            if (input == PIPELINE_BAYERRG8)
+            {
+                const unsigned int top = row * bin + 1 < regionHeight ? row * bin : row * bin - 1;
+                const unsigned int left = column * bin + 1 < regionWidth ? column * bin : column * bin - 1;
+                for (unsigned int dy = 0; dy < 2; dy++)
+                {
+                    for (unsigned int dx = 0; dx < 2; dx++)
+                    {
+                        sum += stages.cropped[(top + dy) * croppedStride + left + dx];
+                    }
+                }
+                count = 4;
+            }
+            else
+            {
+                for (unsigned int dy = 0; dy < bin; dy++)
+                {
+                    for (unsigned int dx = 0; dx < bin; dx++)
+                    {
+                        const size_t offset = (row * bin + dy) * croppedStride + (column * bin + dx) * bytesPerPixel;
+                        sum += bytesPerPixel == 2 ? *(const uint16_t*)&stages.cropped[offset] : stages.cropped[offset];
+                    }
+                }
+                count = bin * bin;
+            }
+            stages.binned[(size_t)row * outputWidth + column] = (uint16_t)(sum / count);
+        }
+    }
+
+    // Convert
+    const size_t pixels = (size_t)outputWidth * outputHeight;
+    output.width = outputWidth;
+    output.height = outputHeight;
+    output.stride = (size_t)outputWidth * GetPipelineBytesPerPixel(config.output);
+    if (config.output == PIPELINE_MONO16)
+    {
+        output.data.resize(pixels * 2);
+        memcpy(&output.data[0], &stages.binned[0], pixels * 2);
+        return 0;
+    }
+    const unsigned int shift = input == PIPELINE_MONO16 ? config.inputBits - 8 : 0;
+    stages.converted.resize(pixels);
+    for (size_t i = 0; i < pixels; i++)
+    {
+        stages.converted[i] = (uint8_t)std::min(stages.binned[i] >> shift, 255);
+    }
+
+    // LUT
+    output.data.resize(pixels);
+    for (size_t i = 0; i < pixels; i++)
+    {
+        output.data[i] = config.lut.empty() ? stages.converted[i] : config.lut[stages.converted[i]];
+    }
+    return 0;
+}
+
+#endif // DUAL_CAM_RECORDER_PIXEL_PIPELINE_H
@@ -0,0 +1,693 @@
+/*
+ * @Descripttion: Persistent frame index of a recorded session for random access playback
+ * @version:
+ * @Date: 2026-10-19 19:12:08
+ * @LastEditTime: 2026-10-19 19:12:08
+ */
+
+#ifndef DUAL_CAM_RECORDER_SESSION_INDEX_H
+#define DUAL_CAM_RECORDER_SESSION_INDEX_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "frame_timestamps.h"
+#include "storage_manager.h"
+#include "time_utils.h"
+
+// Where the frames of a source file are stored
+enum sessionSourceKind
+{
+    SOURCE_JPEG_FILE, // one <time>-<serial>-<n>.jpg per frame
+    SOURCE_SEGMENT,   // <prefix>-<serial>-<n>.seg, see SegmentRecordHeader
+    SOURCE_TIMESTAMPS // <time>-<serial>-timestamps.csv, see FrameTimestampLog; no frames of its own
+};
+
+// What a frame's timestamp was derived from, best first
+enum sessionTimeBase
+{
+    TIME_SYNCED,       // device timestamp mapped to host CLOCK_MONOTONIC by clock sync
+    TIME_HOST_RECEIVE, // host CLOCK_MONOTONIC when the frame was received
+    TIME_WALL_SECONDS  // host wall clock in whole seconds, from a JPEG filename without a sidecar
+};
+
+struct SessionSource
+{
+    std::string path;
+    uint64_t size;
+    int64_t mtimeNs;
+    uint32_t kind; // sessionSourceKind
+};
+
+// One indexed frame. Stored as is in the index file.
+struct SessionFrame
+{
+    uint32_t source; // index into GetSources()
+    uint32_t camera; // index into GetCameras()
+    uint64_t frameIndex;
+    uint64_t timestamp; // ns, see timeBase
+    uint64_t offset;    // of the payload in the source
+    uint32_t size;      // payload bytes
+    uint32_t width;     // 0 if only known after decoding (JPEG)
+    uint32_t height;
+    uint32_t pixelFormat; // SegmentRecordHeader::pixelFormat, 0 for JPEG
+    uint32_t timeBase;    // sessionTimeBase
+    uint32_t packing;     // SegmentRecordHeader::packing, PACKING_NONE for JPEG
+};
+
+// Index of every frame of a session, which may span several directories
+// (the volumes of a STRIPED recording). Open() loads the index file kept in
+// the first directory and only reads sources that are new or changed since
+// it was written, so reopening a session costs one directory listing.
+// JPEG frames are timed from the timestamp sidecar of their recording, so
+// they are read again whenever a sidecar is new, changed or gone.
+class SessionIndex
+{
+  public:
+    SessionIndex() : m_reusedSources(0), m_scannedSources(0), m_written(false)
+    {
+    }
+
+    // Returns 0 on success, -1 if a directory cannot be listed
+    int Open(const std::vector<std::string>& directories)
+    {
+        m_directories = directories;
+        m_cameras.clear();
+        m_sources.clear();
+        m_frames.clear();
+        m_reusedSources = 0;
+        m_scannedSources = 0;
+        m_written = false;
+
+        std::vector<SessionSource> current;
+        for (size_t i = 0; i < directories.size(); i++)
+        {
+            if (ListSources(directories[i], current) < 0)
+            {
+                return -1;
+            }
+        }
+        std::sort(current.begin(), current.end(),
+                  [](const SessionSource& a, const SessionSource& b) { return a.path < b.path; });
+
+        // Frames of the previous index, grouped by source path
+        std::vector<std::string> oldCameras;
+        std::vector<SessionSource> oldSources;
+        std::vector<SessionFrame> oldFrames;
+        const bool loaded = Load(GetIndexPath(), oldCameras, oldSources, oldFrames) == 0;
+        std::map<std::string, uint32_t> oldSourceByPath;
+        std::vector<std::vector<const SessionFrame*> > oldFramesBySource(oldSources.size());
+        for (size_t i = 0; i < oldSources.size(); i++)
+        {
+            oldSourceByPath[oldSources[i].path] = (uint32_t)i;
+        }
+        for (size_t i = 0; i < oldFrames.size(); i++)
+        {
+            if (oldFrames[i].source < oldSources.size() && oldFrames[i].camera < oldCameras.size())
+            {
+                oldFramesBySource[oldFrames[i].source].push_back(&oldFrames[i]);
+            }
+        }
+
+        std::vector<bool> unchanged(current.size(), false);
+        size_t numSidecars = 0;
+        size_t numUnchangedSidecars = 0;
+        for (size_t i = 0; i < current.size(); i++)
+        {
+            std::map<std::string, uint32_t>::const_iterator old = oldSourceByPath.find(current[i].path);
+            unchanged[i] = old != oldSourceByPath.end() && oldSources[old->second].size == current[i].size &&
+                           oldSources[old->second].mtimeNs == current[i].mtimeNs &&
+                           oldSources[old->second].kind == current[i].kind;
+            if (current[i].kind == SOURCE_TIMESTAMPS)
+            {
+                numSidecars++;
+                numUnchangedSidecars += unchanged[i] ? 1 : 0;
+            }
+        }
+        size_t numOldSidecars = 0;
+        for (size_t i = 0; i < oldSources.size(); i++)
+        {
+            numOldSidecars += oldSources[i].kind == SOURCE_TIMESTAMPS ? 1 : 0;
+        }
+        const bool sidecarsChanged = numUnchangedSidecars != numSidecars || numOldSidecars != numSidecars;
+
+        // Sidecars are only read if a JPEG frame has to be
+        SidecarMap sidecars;
+        bool sidecarsLoaded = false;
+        std::vector<SessionFrame> frames;
+        for (size_t i = 0; i < current.size(); i++)
+        {
+            const SessionSource& source = current[i];
+            const uint32_t sourceIndex = (uint32_t)m_sources.size();
+            m_sources.push_back(source);
+            if (unchanged[i] && (source.kind != SOURCE_JPEG_FILE || !sidecarsChanged))
+            {
+                const uint32_t old = oldSourceByPath[source.path];
+                const std::vector<const SessionFrame*>& reused = oldFramesBySource[old];
+                for (size_t f = 0; f < reused.size(); f++)
+                {
+                    SessionFrame frame = *reused[f];
+                    frame.source = sourceIndex;
+                    frame.camera = GetCameraIndex(oldCameras[frame.camera]);
+                    frames.push_back(frame);
+                }
+                m_reusedSources++;
+                continue;
+            }
+            m_scannedSources++;
+            if (source.kind == SOURCE_JPEG_FILE)
+            {
+                if (!sidecarsLoaded)
+                {
+                    LoadSidecars(current, sidecars);
+                    sidecarsLoaded = true;
+                }
+                IndexJpegFile(source, sourceIndex, sidecars, frames);
+            }
+            else if (source.kind == SOURCE_SEGMENT)
+            {
+                IndexSegment(source, sourceIndex, frames);
+            }
+        }
+
+        m_frames.assign(m_cameras.size(), std::vector<SessionFrame>());
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            m_frames[frames[i].camera].push_back(frames[i]);
+        }
+        for (size_t c = 0; c < m_frames.size(); c++)
+        {
+            std::sort(m_frames[c].begin(), m_frames[c].end(), [](const SessionFrame& a, const SessionFrame& b) {
+                return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.frameIndex < b.frameIndex;
+            });
+        }
+        if (!loaded || m_scannedSources > 0 || oldSources.size() != m_sources.size())
+        {
+            if (Save(GetIndexPath()) < 0)
+            {
+                fprintf(stderr, "Unable to write %s: %s\n", GetIndexPath().c_str(), strerror(errno));
+            }
+            else
+            {
+                m_written = true;
+            }
+        }
+        return 0;
+    }
+
+    const std::vector<std::string>& GetCameras() const
+    {
+        return m_cameras;
+    }
+
+    const std::vector<SessionSource>& GetSources() const
+    {
+        return m_sources;
+    }
+
+    // Frames of one camera in timestamp order
+    const std::vector<SessionFrame>& GetFrames(unsigned int camera) const
+    {
+        return m_frames[camera];
+    }
+
+    // Index of camera, or -1 if the session has no such serial number
+    int FindCamera(const std::string& serialNumber) const
+    {
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            if (m_cameras[i] == serialNumber)
+            {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    // Earliest and latest timestamp over all cameras; 0 if the session is empty
+    uint64_t GetStartTime() const
+    {
+        uint64_t start = UINT64_MAX;
+        for (size_t c = 0; c < m_frames.size(); c++)
+        {
+            if (!m_frames[c].empty())
+            {
+                start = std::min(start, m_frames[c].front().timestamp);
+            }
+        }
+        return start == UINT64_MAX ? 0 : start;
+    }
+
+    uint64_t GetEndTime() const
+    {
+        uint64_t end = 0;
+        for (size_t c = 0; c < m_frames.size(); c++)
+        {
+            if (!m_frames[c].empty())
+            {
+                end = std::max(end, m_frames[c].back().timestamp);
+            }
+        }
+        return end;
+    }
+
+    // Position of the first frame of camera at or after timestamp
+    size_t LowerBound(unsigned int camera, uint64_t timestamp) const
+    {
+        const std::vector<SessionFrame>& frames = m_frames[camera];
+        return std::lower_bound(frames.begin(), frames.end(), timestamp,
+                                [](const SessionFrame& frame, uint64_t t) { return frame.timestamp < t; }) -
+               frames.begin();
+    }
+
+    // Position of the frame of camera closest to timestamp, or -1 if it has none
+    long Nearest(unsigned int camera, uint64_t timestamp) const
+    {
+        const std::vector<SessionFrame>& frames = m_frames[camera];
+        if (frames.empty())
+        {
+            return -1;
+        }
+        const size_t after = LowerBound(camera, timestamp);
+        if (after == 0)
+        {
+            return 0;
+        }
+        if (after == frames.size())
+        {
+            return (long)frames.size() - 1;
+        }
+        const uint64_t before = timestamp - frames[after - 1].timestamp;
+        return frames[after].timestamp - timestamp < before ? (long)after : (long)after - 1;
+    }
+
+    std::string GetIndexPath() const
+    {
+        return m_directories.empty() ? std::string() : m_directories[0] + "/session.idx";
+    }
+
+    // Sources taken from the index file and sources read to build it
+    size_t GetReusedSourceCount() const
+    {
+        return m_reusedSources;
+    }
+
+    size_t GetScannedSourceCount() const
+    {
+        return m_scannedSources;
+    }
+
+    // True if Open() had to write a new index file
+    bool IndexWritten() const
+    {
+        return m_written;
+    }
+
+  private:
+    struct IndexFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t frameSize; // sizeof(SessionFrame)
+        uint32_t numCameras;
+        uint32_t numSources;
+        uint64_t numFrames;
+    };
+
+    // Frames of one sidecar in frame index order
+    struct TimestampSidecar
+    {
+        long long startTime; // s, host wall clock, from the file name
+        std::vector<FrameTimestamps> frames;
+    };
+
+    // Sidecars of each serial number in start time order
+    typedef std::map<std::string, std::vector<TimestampSidecar> > SidecarMap;
+
+    uint32_t GetCameraIndex(const std::string& serialNumber)
+    {
+        const int camera = FindCamera(serialNumber);
+        if (camera >= 0)
+        {
+            return (uint32_t)camera;
+        }
+        m_cameras.push_back(serialNumber);
+        m_frames.push_back(std::vector<SessionFrame>());
+        return (uint32_t)(m_cameras.size() - 1);
+    }
+
+    static bool EndsWith(const std::string& name, const char* suffix)
+    {
+        const size_t length = strlen(suffix);
+        return name.size() > length && name.compare(name.size() - length, length, suffix) == 0;
+    }
+
+    int ListSources(const std::string& directory, std::vector<SessionSource>& sources)
+    {
+        DIR* dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return -1;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            const std::string name = entry->d_name;
+            SessionSource source;
+            if (EndsWith(name, ".jpg"))
+            {
+                source.kind = SOURCE_JPEG_FILE;
+            }
+            else if (EndsWith(name, ".seg"))
+            {
+                source.kind = SOURCE_SEGMENT;
+            }
+            else if (EndsWith(name, k_frameTimestampsSuffix))
+            {
+                source.kind = SOURCE_TIMESTAMPS;
+            }
+            else
+            {
+                continue;
+            }
+            source.path = directory + "/" + name;
+            struct stat info;
+            if (stat(source.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            {
+                continue;
+            }
+            source.size = (uint64_t)info.st_size;
+            source.mtimeNs = (int64_t)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+            sources.push_back(source);
+        }
+        closedir(dir);
+        return 0;
+    }
+
+    // Splits the file name of a source named <wall time>-<serial>-<rest> by the
+    // recorder. Returns false if the name is not of that form.
+    static bool SplitSourceName(const std::string& path, long long& wallTime, std::string& serialNumber,
+                                std::string& rest)
+    {
+        const size_t slash = path.rfind('/');
+        const std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+        const size_t first = name.find('-');
+        const size_t last = name.rfind('-');
+        if (first == std::string::npos || last == first)
+        {
+            return false;
+        }
+        char* end;
+        wallTime = strtoll(name.c_str(), &end, 10);
+        if (end != name.c_str() + first)
+        {
+            return false;
+        }
+        serialNumber = name.substr(first + 1, last - first - 1);
+        rest = name.substr(last + 1);
+        return true;
+    }
+
+    static void LoadSidecars(const std::vector<SessionSource>& sources, SidecarMap& sidecars)
+    {
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            TimestampSidecar sidecar;
+            std::string serialNumber;
+            std::string rest;
+            if (sources[i].kind != SOURCE_TIMESTAMPS ||
+                !SplitSourceName(sources[i].path, sidecar.startTime, serialNumber, rest) ||
+                ReadFrameTimestamps(sources[i].path, sidecar.frames) < 0)
+            {
+                continue;
+            }
+            std::sort(sidecar.frames.begin(), sidecar.frames.end(),
+                      [](const FrameTimestamps& a, const FrameTimestamps& b) { return a.frameIndex < b.frameIndex; });
+            sidecars[serialNumber].push_back(sidecar);
+        }
+        for (SidecarMap::iterator it = sidecars.begin(); it != sidecars.end(); ++it)
+        {
+            std::stable_sort(it->second.begin(), it->second.end(),
+                             [](const TimestampSidecar& a, const TimestampSidecar& b) {
+                                 return a.startTime < b.startTime;
+                             });
+        }
+    }
+
+    // The recorder names JPEG frames <wall time>-<serial>-<frame index>.jpg and
+    // logs their timestamps to the sidecar of the recording, the one of the
+    // same serial started last at or before the frame. A frame that sidecar
+    // does not list yet was written by a recording still in progress and is
+    // left out until it does; without a sidecar, the frame is timed by its
+    // name to the whole second.
+    void IndexJpegFile(const SessionSource& source, uint32_t sourceIndex, const SidecarMap& sidecars,
+                       std::vector<SessionFrame>& frames)
+    {
+        long long wallTime;
+        std::string serialNumber;
+        std::string rest;
+        if (!SplitSourceName(source.path, wallTime, serialNumber, rest))
+        {
+            return;
+        }
+        char* end;
+        const unsigned long long frameIndex = strtoull(rest.c_str(), &end, 10);
+        if (end == rest.c_str() || strcmp(end, ".jpg") != 0)
+        {
+            return;
+        }
+        SessionFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.source = sourceIndex;
+        frame.frameIndex = frameIndex;
+        frame.timestamp = (uint64_t)wallTime * 1000000000ULL;
+        frame.size = (uint32_t)source.size;
+        frame.timeBase = TIME_WALL_SECONDS;
+
+        const TimestampSidecar* sidecar = nullptr;
+        SidecarMap::const_iterator serialSidecars = sidecars.find(serialNumber);
+        for (size_t i = 0; serialSidecars != sidecars.end() && i < serialSidecars->second.size(); i++)
+        {
+            if (serialSidecars->second[i].startTime <= wallTime)
+            {
+                sidecar = &serialSidecars->second[i];
+            }
+        }
+        if (sidecar != nullptr)
+        {
+            FrameTimestamps key;
+            key.frameIndex = frameIndex;
+            std::vector<FrameTimestamps>::const_iterator found =
+                std::lower_bound(sidecar->frames.begin(), sidecar->frames.end(), key,
+                                 [](const FrameTimestamps& a, const FrameTimestamps& b) {
+                                     return a.frameIndex < b.frameIndex;
+                                 });
+            if (found == sidecar->frames.end() || found->frameIndex != frameIndex)
+            {
+                return;
+            }
+            if (found->syncedTimestamp != 0)
+            {
+                frame.timestamp = found->syncedTimestamp;
+                frame.timeBase = TIME_SYNCED;
+            }
+            else
+            {
+                frame.timestamp = found->hostTimestamp;
+                frame.timeBase = TIME_HOST_RECEIVE;
+            }
+        }
+        frame.camera = GetCameraIndex(serialNumber);
+        frames.push_back(frame);
+    }
+
+    // Walks the record headers of a segment up to the first incomplete record
+    void IndexSegment(const SessionSource& source, uint32_t sourceIndex, std::vector<SessionFrame>& frames)
+    {
+        const int fd = open(source.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        SegmentFileHeader fileHeader;
+        if (pread(fd, &fileHeader, sizeof(fileHeader), 0) != (ssize_t)sizeof(fileHeader) ||
+            memcmp(fileHeader.magic, k_segmentFileMagic, sizeof(fileHeader.magic)) != 0)
+        {
+            close(fd);
+            return;
+        }
+        fileHeader.serialNumber[sizeof(fileHeader.serialNumber) - 1] = '\0';
+        const uint32_t camera = GetCameraIndex(fileHeader.serialNumber);
+        uint64_t offset = fileHeader.headerSize;
+        while (offset + 2 * sizeof(uint32_t) <= source.size)
+        {
+            // Older record headers are shorter; fields they lack stay zero
+            SegmentRecordHeader header;
+            memset(&header, 0, sizeof(header));
+            const ssize_t got = pread(fd, &header, sizeof(header), (off_t)offset);
+            if (got < (ssize_t)(2 * sizeof(uint32_t)) || header.magic != k_segmentRecordMagic ||
+                header.headerSize < offsetof(SegmentRecordHeader, syncedTimestamp) ||
+                header.headerSize > sizeof(header) || (ssize_t)header.headerSize > got ||
+                offset + header.headerSize + header.payloadSize > source.size)
+            {
+                break;
+            }
+            memset((char*)&header + header.headerSize, 0, sizeof(header) - header.headerSize);
+            SessionFrame frame;
+            memset(&frame, 0, sizeof(frame));
+            frame.source = sourceIndex;
+            frame.camera = camera;
+            frame.frameIndex = header.frameIndex;
+            if (header.syncedTimestamp != 0)
+            {
+                frame.timestamp = header.syncedTimestamp;
+                frame.timeBase = TIME_SYNCED;
+            }
+            else
+            {
+                frame.timestamp = header.hostTimestamp;
+                frame.timeBase = TIME_HOST_RECEIVE;
+            }
+            frame.offset = offset + header.headerSize;
+            frame.size = header.payloadSize;
+            frame.width = header.width;
+            frame.height = header.height;
+            frame.pixelFormat = header.pixelFormat;
+            frame.packing = header.packing;
+            frames.push_back(frame);
+            offset += header.headerSize + header.payloadSize;
+        }
+        close(fd);
+    }
+
+    static bool WriteString(FILE* file, const std::string& value)
+    {
+        const uint32_t length = (uint32_t)value.size();
+        return fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(value.data(), 1, length, file) == length;
+    }
+
+    static bool ReadString(FILE* file, std::string& value)
+    {
+        uint32_t length;
+        if (fread(&length, sizeof(length), 1, file) != 1 || length > 4096)
+        {
+            return false;
+        }
+        value.resize(length);
+        return length == 0 || fread(&value[0], 1, length, file) == length;
+    }
+
+    // Writes a new index file next to the old one and renames it over it, so a
+    // crash leaves either index intact
+    int Save(const std::string& path) const
+    {
+        const std::string tmpPath = path + ".tmp";
+        FILE* file = fopen(tmpPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return -1;
+        }
+        IndexFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "DCRIDX01", sizeof(header.magic));
+        header.version = 1;
+        header.frameSize = sizeof(SessionFrame);
+        header.numCameras = (uint32_t)m_cameras.size();
+        header.numSources = (uint32_t)m_sources.size();
+        for (size_t c = 0; c < m_frames.size(); c++)
+        {
+            header.numFrames += m_frames[c].size();
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        for (size_t i = 0; ok && i < m_cameras.size(); i++)
+        {
+            ok = WriteString(file, m_cameras[i]);
+        }
+        for (size_t i = 0; ok && i < m_sources.size(); i++)
+        {
+            const SessionSource& source = m_sources[i];
+            ok = WriteString(file, source.path) && fwrite(&source.size, sizeof(source.size), 1, file) == 1 &&
+                 fwrite(&source.mtimeNs, sizeof(source.mtimeNs), 1, file) == 1 &&
+                 fwrite(&source.kind, sizeof(source.kind), 1, file) == 1;
+        }
+        for (size_t c = 0; ok && c < m_frames.size(); c++)
+        {
+            ok = m_frames[c].empty() ||
+                 fwrite(&m_frames[c][0], sizeof(SessionFrame), m_frames[c].size(), file) == m_frames[c].size();
+        }
+        if (fclose(file) != 0 || !ok)
+        {
+            unlink(tmpPath.c_str());
+            return -1;
+        }
+        return rename(tmpPath.c_str(), path.c_str());
+    }
+
+    static int Load(const std::string& path, std::vector<std::string>& cameras, std::vector<SessionSource>& sources,
+                    std::vector<SessionFrame>& frames)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return -1;
+        }
+        struct stat info;
+        IndexFileHeader header;
+        bool ok = fstat(fileno(file), &info) == 0 && fread(&header, sizeof(header), 1, file) == 1 &&
+                  memcmp(header.magic, "DCRIDX01", 8) == 0 && header.version == 1 &&
+                  header.frameSize == sizeof(SessionFrame) &&
+                  header.numFrames <= (uint64_t)info.st_size / sizeof(SessionFrame) &&
+                  header.numSources <= (uint64_t)info.st_size && header.numCameras <= (uint64_t)info.st_size;
+        if (ok)
+        {
+            cameras.resize(header.numCameras);
+            sources.resize(header.numSources);
+        }
+        for (size_t i = 0; ok && i < cameras.size(); i++)
+        {
+            ok = ReadString(file, cameras[i]);
+        }
+        for (size_t i = 0; ok && i < sources.size(); i++)
+        {
+            SessionSource& source = sources[i];
+            ok = ReadString(file, source.path) && fread(&source.size, sizeof(source.size), 1, file) == 1 &&
+                 fread(&source.mtimeNs, sizeof(source.mtimeNs), 1, file) == 1 &&
+                 fread(&source.kind, sizeof(source.kind), 1, file) == 1;
+        }
+        if (ok)
+        {
+            frames.resize(header.numFrames);
+            ok = frames.empty() || fread(&frames[0], sizeof(SessionFrame), frames.size(), file) == frames.size();
+        }
+        fclose(file);
+        if (!ok)
+        {
+            cameras.clear();
+            sources.clear();
+            frames.clear();
+            return -1;
+        }
+        return 0;
+    }
+
+    std::vector<std::string> m_directories;
+    std::vector<std::string> m_cameras;
+    std::vector<SessionSource> m_sources;
+    std::vector<std::vector<SessionFrame> > m_frames;
+    size_t m_reusedSources;
+    size_t m_scannedSources;
+    bool m_written;
+};
+
+#endif // DUAL_CAM_RECORDER_SESSION_INDEX_H
@@ -0,0 +1,584 @@
+/*
+ * @Descripttion: RAM staging tier for segment files, flushed to persistent storage in large sequential batches
+ * @version:
+ * @Date: 2026-10-20 04:17:09
+ * @LastEditTime: 2026-10-20 04:17:09
+ */
+
+#ifndef DUAL_CAM_RECORDER_STAGING_TIER_H
+#define DUAL_CAM_RECORDER_STAGING_TIER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "frame_arena.h"
+#include "time_utils.h"
+
+// The flusher copies staged bytes through a buffer of this size
+const size_t k_stagingCopyBytes = 4 << 20;
+// Flushed staged bytes are given back to RAM in whole pages
+const uint64_t k_stagingPageBytes = 4096;
+// statfs() f_type of tmpfs and ramfs
+const long k_tmpfsMagic = 0x01021994;
+const long k_ramfsMagic = 0x858458f6;
+
+struct StagingConfig
+{
+    std::string directory;              // RAM-backed directory (tmpfs) files are written to first; empty disables
+    uint64_t capacityBytes;             // a record that would take the staged bytes past this is refused
+    uint64_t highWaterBytes;            // above this writers wait for the flusher
+    uint64_t flushBatchBytes;           // the flusher copies once this much is staged...
+    unsigned int flushIntervalMs;       // ...or once staged bytes have waited this long
+    unsigned int backpressureTimeoutMs; // longest a writer waits above the high-water mark
+    unsigned int reportIntervalMs;      // occupancy and throughput are sampled this often
+
+    StagingConfig()
+        : capacityBytes(2ULL << 30), highWaterBytes(1536ULL << 20), flushBatchBytes(64ULL << 20),
+          flushIntervalMs(1000), backpressureTimeoutMs(500), reportIntervalMs(1000)
+    {
+    }
+};
+
+// One file of the staging tier. The writer appends to its own descriptor
+// and publishes how far the file holds complete records; the flusher copies
+// those bytes to the final path and owns everything else.
+struct StagedFile
+{
+    std::string stagedPath;
+    std::string finalPath;
+    int stagedFd; // read, and punched once flushed, by the flusher
+    int finalFd;
+    std::atomic<uint64_t> committed;
+    std::atomic<bool> closed;
+    std::atomic<bool> discarded; // nothing was recorded in it; removed without a copy
+    uint64_t flushed;
+    uint64_t punched;
+    uint64_t pendingSinceNs; // when the oldest unflushed bytes were first seen
+    bool failed;             // a copy failed; the staged file is kept
+
+    StagedFile()
+        : stagedFd(-1), finalFd(-1), committed(0), closed(false), discarded(false), flushed(0), punched(0),
+          pendingSinceNs(0), failed(false)
+    {
+    }
+};
+
+// Two-tier storage for segment files. Writers create each file in a
+// RAM-backed staging directory and write at memory speed; a flusher thread
+// copies what they committed to the file's final path on the recording
+// volume in large sequential runs, and gives the copied pages back to RAM
+// by punching holes into the staged file. Past the high-water mark writers
+// wait for the flusher, which slows down the write path, so the frame
+// queues and the load shedder take over. Past the capacity records are
+// refused. Stop() drains every file, syncs it and checks its size, and keeps
+// a staged file whose copy failed. Occupancy and flush throughput are
+// sampled into a CSV report.
+class StagingTier
+{
+  public:
+    StagingTier(const StagingConfig& config, const std::string& reportPath)
+        : m_config(config), m_reportPath(reportPath), m_report(nullptr), m_running(false), m_stopping(false),
+          m_wake(false), m_stagedBytes(0), m_peakStagedBytes(0), m_unannouncedBytes(0), m_flushedBytes(0),
+          m_flushNs(0), m_flushBytesPerSecond(0.0), m_backpressureWaits(0), m_backpressureNs(0), m_rejected(0),
+          m_flushErrors(0), m_filesFlushed(0), m_integrityFailures(0), m_lastReportNs(0), m_lastReportBytes(0),
+          m_lastReportFlushNs(0)
+    {
+    }
+
+    ~StagingTier()
+    {
+        Stop();
+    }
+
+    // Checks the staging directory and starts the flusher. Returns -1 if
+    // the directory cannot be used.
+    int Start()
+    {
+        struct statfs info;
+        if (statfs(m_config.directory.c_str(), &info) != 0)
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "Unable to use staging directory {}: {}", m_config.directory, strerror(errno));
+            return -1;
+        }
+        if ((long)info.f_type != k_tmpfsMagic && (long)info.f_type != k_ramfsMagic)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "Staging directory {} is not on tmpfs, staged writes may reach a disk",
+                      m_config.directory);
+        }
+        m_report = m_reportPath.empty() ? nullptr : fopen(m_reportPath.c_str(), "w");
+        if (m_report != nullptr)
+        {
+            fprintf(m_report, "monotonic_ns,staged_bytes,peak_staged_bytes,staged_files,flushed_bytes,"
+                              "flush_mb_per_s,flush_busy_mb_per_s,backpressure_waits,rejected_records\n");
+        }
+        m_lastReportNs = GetMonotonicNs();
+        m_running = true;
+        m_thread = std::thread(&StagingTier::Run, this);
+        return 0;
+    }
+
+    // Flushes and closes every file. Writers must have closed theirs.
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+            {
+                return;
+            }
+            m_running = false;
+            m_stopping = true;
+        }
+        m_cond.notify_all();
+        m_roomCond.notify_all();
+        m_thread.join();
+        for (size_t i = 0; i < m_files.size(); i++)
+        {
+            StagedFile& file = *m_files[i];
+            ASYNC_LOG(SEVERITY_ERROR, "{} not fully flushed ({} of {} bytes), kept as {}", file.finalPath,
+                      file.flushed, file.committed.load(std::memory_order_relaxed), file.stagedPath);
+            m_integrityFailures.fetch_add(1, std::memory_order_relaxed);
+            close(file.stagedFd);
+            close(file.finalFd);
+        }
+        m_files.clear();
+        WriteReport(GetMonotonicNs());
+        if (m_report != nullptr)
+        {
+            fclose(m_report);
+            m_report = nullptr;
+        }
+    }
+
+    // Creates a file to be flushed to finalPath, where preallocateBytes are
+    // reserved up front. Returns the descriptor the writer appends to, or -1.
+    int Create(const std::string& finalPath, uint64_t preallocateBytes, std::shared_ptr<StagedFile>& file)
+    {
+        file.reset(new StagedFile());
+        const size_t slash = finalPath.rfind('/');
+        file->finalPath = finalPath;
+        file->stagedPath =
+            m_config.directory + "/" + (slash == std::string::npos ? finalPath : finalPath.substr(slash + 1));
+        const int writeFd = open(file->stagedPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        file->stagedFd = open(file->stagedPath.c_str(), O_RDWR | O_CLOEXEC);
+        file->finalFd = open(finalPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (writeFd < 0 || file->stagedFd < 0 || file->finalFd < 0)
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "Unable to stage {} as {}: {}", finalPath, file->stagedPath, strerror(errno));
+            if (writeFd >= 0)
+            {
+                close(writeFd);
+            }
+            Release(*file);
+            file.reset();
+            return -1;
+        }
+        // On the recording volume, as for unstaged segments
+        fallocate(file->finalFd, FALLOC_FL_KEEP_SIZE, 0, (off_t)preallocateBytes);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_files.push_back(file);
+        return writeFd;
+    }
+
+    // Waits, up to backpressureTimeoutMs, until a record of recordSize bytes
+    // fits under the high-water mark. Returns false, with errno ENOBUFS, if
+    // it would then take the staged bytes past the capacity.
+    bool Reserve(uint64_t recordSize)
+    {
+        if (m_stagedBytes.load(std::memory_order_relaxed) + recordSize <= m_config.highWaterBytes)
+        {
+            return true;
+        }
+        const uint64_t start = GetMonotonicNs();
+        m_backpressureWaits.fetch_add(1, std::memory_order_relaxed);
+        Wake();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_roomCond.wait_for(lock, std::chrono::milliseconds(m_config.backpressureTimeoutMs), [&]() {
+                return m_stopping || m_stagedBytes.load(std::memory_order_relaxed) + recordSize <=
+                                         m_config.highWaterBytes;
+            });
+        }
+        m_backpressureNs.fetch_add(GetMonotonicNs() - start, std::memory_order_relaxed);
+        if (m_stagedBytes.load(std::memory_order_relaxed) + recordSize > m_config.capacityBytes)
+        {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            errno = ENOBUFS;
+            return false;
+        }
+        return true;
+    }
+
+    // The file now holds complete records up to bytes
+    void Commit(StagedFile& file, uint64_t bytes)
+    {
+        const uint64_t previous = file.committed.exchange(bytes, std::memory_order_release);
+        if (bytes <= previous)
+        {
+            return;
+        }
+        const uint64_t added = bytes - previous;
+        const uint64_t staged = m_stagedBytes.fetch_add(added, std::memory_order_relaxed) + added;
+        uint64_t peak = m_peakStagedBytes.load(std::memory_order_relaxed);
+        while (staged > peak && !m_peakStagedBytes.compare_exchange_weak(peak, staged, std::memory_order_relaxed))
+        {
+        }
+        // Wake the flusher once per batch rather than per record
+        if (m_unannouncedBytes.fetch_add(added, std::memory_order_relaxed) + added >= m_config.flushBatchBytes)
+        {
+            m_unannouncedBytes.store(0, std::memory_order_relaxed);
+            Wake();
+        }
+    }
+
+    // The writer closed the file; the flusher copies the rest and finishes it
+    void Close(StagedFile& file)
+    {
+        file.closed.store(true, std::memory_order_release);
+        Wake();
+    }
+
+    // The writer closed a file nothing was recorded in; the flusher removes
+    // its staged copy and final path alike
+    void Discard(StagedFile& file)
+    {
+        file.discarded.store(true, std::memory_order_relaxed);
+        Close(file);
+    }
+
+    uint64_t GetStagedBytes() const
+    {
+        return m_stagedBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetPeakStagedBytes() const
+    {
+        return m_peakStagedBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetFlushedBytes() const
+    {
+        return m_flushedBytes.load(std::memory_order_relaxed);
+    }
+
+    // Of the copies alone, i.e. the write speed of the recording volume
+    double GetFlushBusyBytesPerSecond() const
+    {
+        const uint64_t ns = m_flushNs.load(std::memory_order_relaxed);
+        return ns > 0 ? GetFlushedBytes() * 1e9 / ns : 0.0;
+    }
+
+    uint64_t GetBackpressureWaits() const
+    {
+        return m_backpressureWaits.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetRejectedCount() const
+    {
+        return m_rejected.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetFilesFlushed() const
+    {
+        return m_filesFlushed.load(std::memory_order_relaxed);
+    }
+
+    // Files whose copy on the recording volume is incomplete or failed its
+    // size check; their staged copies are kept
+    uint64_t GetIntegrityFailures() const
+    {
+        return m_integrityFailures.load(std::memory_order_relaxed);
+    }
+
+    void PrintSummary()
+    {
+        printf("Staging %s: %.1f MB flushed in %llu files at %.1f MB/s while copying, peak %.1f of %.1f MB staged, "
+               "%llu backpressure waits (%.1f s), %llu records refused, %llu files not intact\n",
+               m_config.directory.c_str(), GetFlushedBytes() / 1e6, (unsigned long long)GetFilesFlushed(),
+               GetFlushBusyBytesPerSecond() / 1e6, GetPeakStagedBytes() / 1e6, m_config.capacityBytes / 1e6,
+               (unsigned long long)GetBackpressureWaits(), m_backpressureNs.load(std::memory_order_relaxed) / 1e9,
+               (unsigned long long)GetRejectedCount(), (unsigned long long)GetIntegrityFailures());
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out)
+    {
+        char line[1024];
+        snprintf(line, sizeof(line),
+                 "# TYPE recorder_staging_bytes gauge\nrecorder_staging_bytes %llu\n"
+                 "# TYPE recorder_staging_high_water_bytes gauge\nrecorder_staging_high_water_bytes %llu\n"
+                 "# TYPE recorder_staging_flushed_bytes_total counter\nrecorder_staging_flushed_bytes_total %llu\n"
+                 "# TYPE recorder_staging_flush_bytes_per_second gauge\nrecorder_staging_flush_bytes_per_second %.0f\n"
+                 "# TYPE recorder_staging_backpressure_waits_total counter\n"
+                 "recorder_staging_backpressure_waits_total %llu\n"
+                 "# TYPE recorder_staging_rejected_total counter\nrecorder_staging_rejected_total %llu\n",
+                 (unsigned long long)GetStagedBytes(), (unsigned long long)m_config.highWaterBytes,
+                 (unsigned long long)GetFlushedBytes(), m_flushBytesPerSecond.load(std::memory_order_relaxed),
+                 (unsigned long long)GetBackpressureWaits(), (unsigned long long)GetRejectedCount());
+        out += line;
+    }
+
+  private:
+    StagingTier(const StagingTier&);
+    StagingTier& operator=(const StagingTier&);
+
+    void Wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake = true;
+        }
+        m_cond.notify_all();
+    }
+
+    static void Release(StagedFile& file)
+    {
+        if (file.stagedFd >= 0)
+        {
+            close(file.stagedFd);
+            file.stagedFd = -1;
+        }
+        if (file.finalFd >= 0)
+        {
+            close(file.finalFd);
+            file.finalFd = -1;
+        }
+        unlink(file.stagedPath.c_str());
+    }
+
+    // Copies the committed bytes of a file once a batch of them is staged,
+    // they are old enough, the file is closed or the tier is draining
+    void Flush(StagedFile& file, ArenaBytes& buffer, uint64_t now, bool draining)
+    {
+        const uint64_t committed = file.committed.load(std::memory_order_acquire);
+        if (file.failed || committed == file.flushed)
+        {
+            return;
+        }
+        if (file.pendingSinceNs == 0)
+        {
+            file.pendingSinceNs = now;
+        }
+        const bool due = draining || file.closed.load(std::memory_order_acquire) ||
+                         committed - file.flushed >= m_config.flushBatchBytes ||
+                         now - file.pendingSinceNs >= m_config.flushIntervalMs * 1000000ULL;
+        if (!due)
+        {
+            return;
+        }
+        const uint64_t start = GetMonotonicNs();
+        while (file.flushed < committed)
+        {
+            const size_t size = (size_t)std::min<uint64_t>(buffer.size(), committed - file.flushed);
+            if (!CopyRun(file, &buffer[0], size))
+            {
+                ASYNC_LOG(SEVERITY_ERROR, "Unable to flush {} at byte {}: {}, keeping {}", file.finalPath,
+                          file.flushed, strerror(errno), file.stagedPath);
+                m_flushErrors.fetch_add(1, std::memory_order_relaxed);
+                file.failed = true;
+                break;
+            }
+            file.flushed += size;
+            m_flushedBytes.fetch_add(size, std::memory_order_relaxed);
+            m_stagedBytes.fetch_sub(size, std::memory_order_relaxed);
+            // Taking the mutex orders the notification after a writer's
+            // check of the staged bytes, so no wakeup is lost
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            m_roomCond.notify_all();
+        }
+        m_flushNs.fetch_add(GetMonotonicNs() - start, std::memory_order_relaxed);
+        file.pendingSinceNs = 0;
+        // Give the copied pages back; the staged file keeps its size
+        const uint64_t punchEnd = file.flushed & ~(k_stagingPageBytes - 1);
+        if (punchEnd > file.punched &&
+            fallocate(file.stagedFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)file.punched,
+                      (off_t)(punchEnd - file.punched)) == 0)
+        {
+            file.punched = punchEnd;
+        }
+    }
+
+    bool CopyRun(StagedFile& file, uint8_t* buffer, size_t size)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            const ssize_t got = pread(file.stagedFd, buffer + done, size - done, (off_t)(file.flushed + done));
+            if (got <= 0)
+            {
+                if (got < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                errno = got == 0 ? EIO : errno;
+                return false;
+            }
+            done += (size_t)got;
+        }
+        done = 0;
+        while (done < size)
+        {
+            const ssize_t put = pwrite(file.finalFd, buffer + done, size - done, (off_t)(file.flushed + done));
+            if (put < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            done += (size_t)put;
+        }
+        return true;
+    }
+
+    // Trims a closed, fully copied file to its records, syncs it and checks
+    // its size before the staged copy is removed. Returns false if the file
+    // stays staged.
+    bool Finish(StagedFile& file)
+    {
+        const uint64_t committed = file.committed.load(std::memory_order_acquire);
+        struct stat info;
+        if (ftruncate(file.finalFd, (off_t)committed) != 0 || fdatasync(file.finalFd) != 0 ||
+            fstat(file.finalFd, &info) != 0 || (uint64_t)info.st_size != committed)
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "Unable to complete {}: {}, keeping {}", file.finalPath, strerror(errno),
+                      file.stagedPath);
+            m_flushErrors.fetch_add(1, std::memory_order_relaxed);
+            file.failed = true;
+            return false;
+        }
+        Release(file);
+        m_filesFlushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void WriteReport(uint64_t now)
+    {
+        const uint64_t flushed = GetFlushedBytes();
+        const uint64_t flushNs = m_flushNs.load(std::memory_order_relaxed);
+        const double seconds = now > m_lastReportNs ? (now - m_lastReportNs) / 1e9 : 0.0;
+        const double rate = seconds > 0.0 ? (flushed - m_lastReportBytes) / seconds : 0.0;
+        const double busyRate =
+            flushNs > m_lastReportFlushNs ? (flushed - m_lastReportBytes) * 1e9 / (flushNs - m_lastReportFlushNs) : 0.0;
+        m_flushBytesPerSecond.store(rate, std::memory_order_relaxed);
+        m_lastReportNs = now;
+        m_lastReportBytes = flushed;
+        m_lastReportFlushNs = flushNs;
+        if (m_report == nullptr)
+        {
+            return;
+        }
+        size_t files = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            files = m_files.size();
+        }
+        fprintf(m_report, "%llu,%llu,%llu,%zu,%llu,%.1f,%.1f,%llu,%llu\n", (unsigned long long)now,
+                (unsigned long long)GetStagedBytes(), (unsigned long long)GetPeakStagedBytes(), files,
+                (unsigned long long)flushed, rate / 1e6, busyRate / 1e6, (unsigned long long)GetBackpressureWaits(),
+                (unsigned long long)GetRejectedCount());
+        fflush(m_report);
+    }
+
+    void Run()
+    {
+        // The copy buffer of the flusher, from the frame arena like every other
+        // buffer of the write path
+        ArenaBytes buffer(k_stagingCopyBytes);
+        const unsigned int waitMs = std::max(1u, std::min(m_config.flushIntervalMs, m_config.reportIntervalMs) / 2);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cond.wait_for(lock, std::chrono::milliseconds(waitMs), [this] { return m_stopping || m_wake; });
+            m_wake = false;
+            const bool draining = m_stopping;
+            std::vector<std::shared_ptr<StagedFile> > files = m_files;
+            lock.unlock();
+            const uint64_t now = GetMonotonicNs();
+            std::vector<std::shared_ptr<StagedFile> > finished;
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                StagedFile& file = *files[i];
+                if (file.closed.load(std::memory_order_acquire) && file.discarded.load(std::memory_order_relaxed))
+                {
+                    m_stagedBytes.fetch_sub(file.committed.load(std::memory_order_relaxed) - file.flushed,
+                                            std::memory_order_relaxed);
+                    unlink(file.finalPath.c_str());
+                    Release(file);
+                    finished.push_back(files[i]);
+                    continue;
+                }
+                Flush(file, buffer, now, draining);
+                if (!file.failed && file.closed.load(std::memory_order_acquire) &&
+                    file.flushed == file.committed.load(std::memory_order_acquire) && Finish(file))
+                {
+                    finished.push_back(files[i]);
+                }
+            }
+            if (now - m_lastReportNs >= m_config.reportIntervalMs * 1000000ULL)
+            {
+                WriteReport(now);
+            }
+            lock.lock();
+            for (size_t i = 0; i < finished.size(); i++)
+            {
+                m_files.erase(std::remove(m_files.begin(), m_files.end(), finished[i]), m_files.end());
+            }
+            // One pass while draining copies everything; what is left has failed
+            if (draining)
+            {
+                break;
+            }
+        }
+    }
+
+    const StagingConfig m_config;
+    const std::string m_reportPath;
+    FILE* m_report;
+    std::mutex m_mutex;
+    // Wakes the flusher
+    std::condition_variable m_cond;
+    // Wakes writers waiting for room
+    std::condition_variable m_roomCond;
+    bool m_running;
+    bool m_stopping;
+    bool m_wake;
+    std::thread m_thread;
+    std::vector<std::shared_ptr<StagedFile> > m_files;
+    std::atomic<uint64_t> m_stagedBytes;
+    std::atomic<uint64_t> m_peakStagedBytes;
+    std::atomic<uint64_t> m_unannouncedBytes;
+    std::atomic<uint64_t> m_flushedBytes;
+    std::atomic<uint64_t> m_flushNs;
+    std::atomic<double> m_flushBytesPerSecond;
+    std::atomic<uint64_t> m_backpressureWaits;
+    std::atomic<uint64_t> m_backpressureNs;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<uint64_t> m_flushErrors;
+    std::atomic<uint64_t> m_filesFlushed;
+    std::atomic<uint64_t> m_integrityFailures;
+    // Used by the flusher thread only
+    uint64_t m_lastReportNs;
+    uint64_t m_lastReportBytes;
+    uint64_t m_lastReportFlushNs;
+};
+
+#endif // DUAL_CAM_RECORDER_STAGING_TIER_H
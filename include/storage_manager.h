@@ -0,0 +1,772 @@
+/*
+ * @Descripttion: Segmented, preallocated recording files and disk-space-aware write policy
+ * @version:
+ * @Date: 2026-10-19 14:52:36
+ * @LastEditTime: 2026-10-19 14:52:36
+ */
+
+#ifndef DUAL_CAM_RECORDER_STORAGE_MANAGER_H
+#define DUAL_CAM_RECORDER_STORAGE_MANAGER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "staging_tier.h"
+#include "time_utils.h"
+
+// What to do when the output volume runs out of space
+enum storagePolicy
+{
+    STORAGE_DROP,     // keep acquiring, drop every frame while space is critical
+    STORAGE_DECIMATE, // keep one frame in N while space is low, none while critical
+    STORAGE_STOP      // stop the recording cleanly once space is critical
+};
+
+enum storageLevel
+{
+    STORAGE_OK,
+    STORAGE_LOW,     // below the warning thresholds
+    STORAGE_CRITICAL // below the reserve; the policy is in force
+};
+
+struct StorageConfig
+{
+    std::string directory;         // output directory
+    uint64_t segmentMaxBytes;      // a segment is closed before it grows past this (also the preallocation size)
+    unsigned int segmentMaxSeconds; // or once it has been open this long
+    storagePolicy policy;
+    uint64_t warnFreeBytes;    // LOW below this much free space...
+    unsigned int warnSeconds;  // ...or when the reserve would be reached within this time at the current rate
+    uint64_t reserveFreeBytes; // CRITICAL below this much free space
+    unsigned int decimateFactor;
+    unsigned int pollIntervalMs;
+    StagingConfig staging; // RAM staging of the segments; off unless it has a directory
+
+    StorageConfig()
+        : directory("."), segmentMaxBytes(1ULL << 30), segmentMaxSeconds(60), policy(STORAGE_DECIMATE),
+          warnFreeBytes(20ULL << 30), warnSeconds(600), reserveFreeBytes(4ULL << 30), decimateFactor(4),
+          pollIntervalMs(500)
+    {
+    }
+};
+
+// On-disk layout of a segment: one SegmentFileHeader, then records of a
+// SegmentRecordHeader followed by payloadSize bytes. All fields are little
+// endian. A segment cut short by a crash ends at the first record whose
+// magic does not match.
+const char k_segmentFileMagic[8] = {'D', 'C', 'R', 'S', 'E', 'G', '0', '1'};
+const uint32_t k_segmentRecordMagic = 0x304d5246; // "FRM0"
+
+struct SegmentFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t segmentIndex;
+    uint64_t createdRealtimeNs;
+    char serialNumber[32];
+};
+
+struct SegmentRecordHeader
+{
+    uint32_t magic;
+    uint32_t headerSize;
+    uint64_t frameIndex;
+    uint64_t deviceTimestamp; // ns, camera clock
+    uint64_t hostTimestamp;   // ns, host CLOCK_MONOTONIC
+    int64_t wallTime;         // s, host wall clock
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelFormat; // Spinnaker PixelFormatEnums value of the payload
+    uint32_t payloadSize;
+    uint64_t syncedTimestamp; // ns, deviceTimestamp on host CLOCK_MONOTONIC, 0 if not synchronized
+    uint64_t syncedRealtime;  // ns since the Unix epoch, 0 if not synchronized
+    uint64_t syncErrorNs;     // bound on the error of both
+    uint32_t packing;         // pixelPacking of the payload, PACKING_NONE unless recorded packed
+    uint32_t bitDepth;        // significant bits per sample
+};
+
+// Where Append() put a record
+struct SegmentLocation
+{
+    std::string path;
+    uint64_t segmentIndex;
+    uint64_t offset; // of the record header
+
+    SegmentLocation() : segmentIndex(0), offset(0)
+    {
+    }
+};
+
+// Appends frames of one camera to a sequence of segment files named
+// <prefix>-<serial>-<index>.seg. Append() runs on the camera's writer strand.
+// The next segment is opened and preallocated ahead of time by the storage
+// manager thread, and full segments are trimmed and closed there too, so a
+// roll-over on the write path is only a file descriptor swap. With a
+// StagingTier the segments are written to its RAM staging directory and
+// reach the output directory through its flusher.
+class SegmentWriter
+{
+  public:
+    SegmentWriter(const StorageConfig& config, const std::string& prefix, const std::string& serialNumber,
+                  std::function<void()> wakeManager, StagingTier* staging = nullptr)
+        : m_config(config), m_prefix(prefix), m_serialNumber(serialNumber), m_wakeManager(wakeManager),
+          m_staging(staging), m_nextIndex(0), m_writeErrors(0), m_segments(0), m_syncRollovers(0),
+          m_bytesWritten(0)
+    {
+        PrepareNext();
+        TakeNext(m_current);
+    }
+
+    ~SegmentWriter()
+    {
+        Close();
+    }
+
+    // Writes one record. Returns false if the write failed (e.g. disk full).
+    bool Append(SegmentRecordHeader& header, const void* payload, uint32_t payloadSize,
+                SegmentLocation* location = nullptr)
+    {
+        header.magic = k_segmentRecordMagic;
+        header.headerSize = sizeof(SegmentRecordHeader);
+        header.payloadSize = payloadSize;
+        const uint64_t recordSize = sizeof(SegmentRecordHeader) + (uint64_t)payloadSize;
+        const uint64_t now = GetMonotonicNs();
+        const bool full = m_current.records > 0 && m_current.bytes + recordSize > m_config.segmentMaxBytes;
+        const bool expired = now - m_current.openedNs >= m_config.segmentMaxSeconds * 1000000000ULL;
+        if (m_current.fd < 0 || full || expired)
+        {
+            Rollover();
+            if (m_current.fd < 0)
+            {
+                m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        // Backpressure: waits while the staging tier is above its high-water mark
+        if (m_current.staged && !m_staging->Reserve(recordSize))
+        {
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        struct iovec parts[2];
+        parts[0].iov_base = &header;
+        parts[0].iov_len = sizeof(header);
+        parts[1].iov_base = const_cast<void*>(payload);
+        parts[1].iov_len = payloadSize;
+        if (!WriteAll(m_current.fd, parts, 2))
+        {
+            // Leave no partial record behind; the reader stops at the old end
+            if (ftruncate(m_current.fd, (off_t)m_current.bytes) == 0)
+            {
+                lseek(m_current.fd, (off_t)m_current.bytes, SEEK_SET);
+            }
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (location != nullptr)
+        {
+            location->path = m_current.path;
+            location->segmentIndex = m_current.index;
+            location->offset = m_current.bytes;
+        }
+        m_current.bytes += recordSize;
+        m_current.records++;
+        m_bytesWritten.fetch_add(recordSize, std::memory_order_relaxed);
+        if (m_current.staged)
+        {
+            m_staging->Commit(*m_current.staged, m_current.bytes);
+        }
+        return true;
+    }
+
+    // Opens and preallocates the next segment if none is ready. Called by the
+    // manager thread, and by Append() if the manager fell behind.
+    void PrepareNext()
+    {
+        std::lock_guard<std::mutex> prepareLock(m_prepareMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_next.fd >= 0)
+            {
+                return;
+            }
+        }
+        SegmentFile file;
+        file.index = m_nextIndex++;
+        file.path = SegmentPath(file.index);
+        if (m_staging != nullptr)
+        {
+            // The staging tier preallocates the final file; staged pages
+            // are RAM and taken only as records arrive
+            file.fd = m_staging->Create(file.path, m_config.segmentMaxBytes, file.staged);
+        }
+        else
+        {
+            file.fd = open(file.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        if (file.fd < 0)
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "[{}] Unable to create segment {}: {}", m_serialNumber, file.path,
+                      strerror(errno));
+            return;
+        }
+        if (!file.staged)
+        {
+            // KEEP_SIZE so the file size always ends at the last complete
+            // record; unsupported file systems simply run without preallocation
+            fallocate(file.fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)m_config.segmentMaxBytes);
+        }
+        SegmentFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, k_segmentFileMagic, sizeof(header.magic));
+        header.version = 3; // 2: record headers carry synchronized timestamps; 3: packing and bit depth
+        header.headerSize = sizeof(SegmentFileHeader);
+        header.segmentIndex = file.index;
+        header.createdRealtimeNs = GetRealtimeNs();
+        strncpy(header.serialNumber, m_serialNumber.c_str(), sizeof(header.serialNumber) - 1);
+        struct iovec part = {&header, sizeof(header)};
+        if (!WriteAll(file.fd, &part, 1))
+        {
+            ASYNC_LOG(SEVERITY_ERROR, "[{}] Unable to write segment {}: {}", m_serialNumber, file.path,
+                      strerror(errno));
+            Discard(file);
+            return;
+        }
+        file.bytes = sizeof(header);
+        if (file.staged)
+        {
+            m_staging->Commit(*file.staged, file.bytes);
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_next = file;
+    }
+
+    // Trims and closes segments retired by Append(). Called by the manager thread.
+    void FinalizeRetired()
+    {
+        std::vector<SegmentFile> retired;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            retired.swap(m_retired);
+        }
+        for (size_t i = 0; i < retired.size(); i++)
+        {
+            Finalize(retired[i]);
+        }
+    }
+
+    // Closes the current segment and removes the unused prepared one. Must not
+    // run concurrently with Append().
+    void Close()
+    {
+        FinalizeRetired();
+        if (m_current.fd >= 0)
+        {
+            Finalize(m_current);
+        }
+        std::lock_guard<std::mutex> prepareLock(m_prepareMutex);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_next.fd >= 0)
+        {
+            Discard(m_next);
+            m_next = SegmentFile();
+        }
+    }
+
+    const std::string& GetSerialNumber() const
+    {
+        return m_serialNumber;
+    }
+
+    uint64_t GetSegmentCount() const
+    {
+        return m_segments.load(std::memory_order_relaxed);
+    }
+
+    // Roll-overs that had to open the next segment on the write path
+    uint64_t GetSyncRolloverCount() const
+    {
+        return m_syncRollovers.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetWriteErrorCount() const
+    {
+        return m_writeErrors.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetBytesWritten() const
+    {
+        return m_bytesWritten.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct SegmentFile
+    {
+        int fd;
+        uint64_t index;
+        uint64_t bytes;
+        uint64_t records;
+        uint64_t openedNs;
+        std::string path;
+        std::shared_ptr<StagedFile> staged; // set if the segment goes through the staging tier
+
+        SegmentFile() : fd(-1), index(0), bytes(0), records(0), openedNs(0)
+        {
+        }
+    };
+
+    std::string SegmentPath(uint64_t index) const
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "-%05llu.seg", (unsigned long long)index);
+        return m_config.directory + "/" + m_prefix + "-" + m_serialNumber + suffix;
+    }
+
+    static bool WriteAll(int fd, struct iovec* parts, int count)
+    {
+        while (count > 0)
+        {
+            ssize_t written = writev(fd, parts, count);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            while (count > 0 && (size_t)written >= parts->iov_len)
+            {
+                written -= (ssize_t)parts->iov_len;
+                parts++;
+                count--;
+            }
+            if (count > 0)
+            {
+                parts->iov_base = (char*)parts->iov_base + written;
+                parts->iov_len -= (size_t)written;
+            }
+        }
+        return true;
+    }
+
+    bool TakeNext(SegmentFile& file)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_next.fd < 0)
+        {
+            return false;
+        }
+        file = m_next;
+        file.openedNs = GetMonotonicNs();
+        m_next = SegmentFile();
+        m_segments.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Rollover()
+    {
+        if (m_current.fd >= 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_retired.push_back(m_current);
+            m_current = SegmentFile();
+        }
+        if (!TakeNext(m_current))
+        {
+            m_syncRollovers.fetch_add(1, std::memory_order_relaxed);
+            PrepareNext();
+            TakeNext(m_current);
+        }
+        // Let the manager finalize the old segment and prepare the next one
+        m_wakeManager();
+    }
+
+    void Finalize(SegmentFile& file)
+    {
+        // Give back the preallocated tail
+        if (ftruncate(file.fd, (off_t)file.bytes) != 0)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "Unable to trim segment {}: {}", file.path, strerror(errno));
+        }
+        close(file.fd);
+        file.fd = -1;
+        if (file.staged)
+        {
+            // The flusher trims the final file once it has copied the rest
+            m_staging->Close(*file.staged);
+        }
+    }
+
+    // Removes a segment no record went to
+    void Discard(SegmentFile& file)
+    {
+        close(file.fd);
+        file.fd = -1;
+        if (file.staged)
+        {
+            m_staging->Discard(*file.staged);
+        }
+        else
+        {
+            unlink(file.path.c_str());
+        }
+    }
+
+    const StorageConfig m_config;
+    const std::string m_prefix;
+    const std::string m_serialNumber;
+    std::function<void()> m_wakeManager;
+    StagingTier* m_staging;
+    // Serializes PrepareNext() so segment indices are used in order
+    std::mutex m_prepareMutex;
+    uint64_t m_nextIndex;
+    // Guards m_next and m_retired; m_current belongs to the writer strand
+    std::mutex m_mutex;
+    SegmentFile m_current;
+    SegmentFile m_next;
+    std::vector<SegmentFile> m_retired;
+    std::atomic<uint64_t> m_writeErrors;
+    std::atomic<uint64_t> m_segments;
+    std::atomic<uint64_t> m_syncRollovers;
+    std::atomic<uint64_t> m_bytesWritten;
+};
+
+// Owns the segment writers of a session and watches the output volume. A
+// background thread polls free space (statvfs) and the combined write rate,
+// warns while the reserve is approaching and sets the storage level that
+// Admit() applies to every new frame.
+class StorageManager
+{
+  public:
+    explicit StorageManager(const StorageConfig& config)
+        : m_config(config), m_level(STORAGE_OK), m_stopRequested(false), m_running(false), m_wake(false),
+          m_otherBytes(0), m_freeBytes(0), m_bytesPerSecond(0), m_shed(0),
+          m_lastPollNs(0), m_lastWarnNs(0)
+    {
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "%lld", (long long)time(nullptr));
+        m_prefix = prefix;
+    }
+
+    ~StorageManager()
+    {
+        Stop();
+    }
+
+    // Checks the volume once and starts the monitor thread. Returns -1 if the
+    // output directory cannot be queried.
+    int Start()
+    {
+        struct statvfs info;
+        if (statvfs(m_config.directory.c_str(), &info) != 0)
+        {
+            return -1;
+        }
+        if (!m_config.staging.directory.empty())
+        {
+            m_staging.reset(new StagingTier(m_config.staging, m_config.directory + "/" + m_prefix + "-staging.csv"));
+            if (m_staging->Start() < 0)
+            {
+                m_staging.reset();
+                return -1;
+            }
+        }
+        m_running = true;
+        Poll(GetMonotonicNs(), 0);
+        m_thread = std::thread(&StorageManager::Run, this);
+        return 0;
+    }
+
+    // Stops the monitor thread and closes every segment, flushing staged
+    // ones to the output directory. Writes must have finished.
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+            {
+                return;
+            }
+            m_running = false;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+        for (size_t i = 0; i < m_writers.size(); i++)
+        {
+            m_writers[i]->Close();
+        }
+        if (m_staging)
+        {
+            m_staging->Stop();
+        }
+    }
+
+    // Creates the segment writer of one camera; owned by the manager
+    SegmentWriter* OpenWriter(const std::string& serialNumber)
+    {
+        SegmentWriter* writer =
+            new SegmentWriter(m_config, m_prefix, serialNumber, [this] { Wake(); }, m_staging.get());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writers.push_back(std::unique_ptr<SegmentWriter>(writer));
+        return writer;
+    }
+
+    // Decides whether a new frame should be recorded under the current
+    // storage level. Lock-free; called on the grab path.
+    bool Admit(uint64_t frameIndex)
+    {
+        const storageLevel level = (storageLevel)m_level.load(std::memory_order_relaxed);
+        bool admit = true;
+        if (level == STORAGE_CRITICAL)
+        {
+            if (m_config.policy == STORAGE_STOP)
+            {
+                m_stopRequested.store(true, std::memory_order_relaxed);
+            }
+            admit = false;
+        }
+        else if (level == STORAGE_LOW && m_config.policy == STORAGE_DECIMATE)
+        {
+            // Keep the same frame indices on every camera
+            admit = frameIndex % m_config.decimateFactor == 0;
+        }
+        if (!admit)
+        {
+            m_shed.fetch_add(1, std::memory_order_relaxed);
+        }
+        return admit;
+    }
+
+    // True once the STOP policy wants the recording to end
+    bool StopRequested() const
+    {
+        return m_stopRequested.load(std::memory_order_relaxed);
+    }
+
+    // Accounts bytes written outside the segment writers (e.g. per-frame files)
+    void AddBytesWritten(uint64_t bytes)
+    {
+        m_otherBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    storageLevel GetLevel() const
+    {
+        return (storageLevel)m_level.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetShedCount() const
+    {
+        return m_shed.load(std::memory_order_relaxed);
+    }
+
+    // The RAM staging tier, or null if segments are written directly
+    StagingTier* GetStaging()
+    {
+        return m_staging.get();
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out)
+    {
+        char line[768];
+        snprintf(line, sizeof(line),
+                 "# TYPE recorder_storage_free_bytes gauge\nrecorder_storage_free_bytes %llu\n"
+                 "# TYPE recorder_storage_level gauge\nrecorder_storage_level %d\n"
+                 "# TYPE recorder_storage_write_bytes_per_second gauge\nrecorder_storage_write_bytes_per_second %.0f\n"
+                 "# TYPE recorder_storage_frames_shed_total counter\nrecorder_storage_frames_shed_total %llu\n",
+                 (unsigned long long)m_freeBytes.load(std::memory_order_relaxed), (int)GetLevel(),
+                 m_bytesPerSecond.load(std::memory_order_relaxed), (unsigned long long)GetShedCount());
+        out += line;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out += "# TYPE recorder_storage_segments_total counter\n";
+        for (size_t i = 0; i < m_writers.size(); i++)
+        {
+            snprintf(line, sizeof(line), "recorder_storage_segments_total{camera=\"%s\"} %llu\n",
+                     m_writers[i]->GetSerialNumber().c_str(), (unsigned long long)m_writers[i]->GetSegmentCount());
+            out += line;
+        }
+        out += "# TYPE recorder_storage_sync_rollovers_total counter\n";
+        for (size_t i = 0; i < m_writers.size(); i++)
+        {
+            snprintf(line, sizeof(line), "recorder_storage_sync_rollovers_total{camera=\"%s\"} %llu\n",
+                     m_writers[i]->GetSerialNumber().c_str(),
+                     (unsigned long long)m_writers[i]->GetSyncRolloverCount());
+            out += line;
+        }
+        out += "# TYPE recorder_storage_write_errors_total counter\n";
+        for (size_t i = 0; i < m_writers.size(); i++)
+        {
+            snprintf(line, sizeof(line), "recorder_storage_write_errors_total{camera=\"%s\"} %llu\n",
+                     m_writers[i]->GetSerialNumber().c_str(), (unsigned long long)m_writers[i]->GetWriteErrorCount());
+            out += line;
+        }
+        if (m_staging)
+        {
+            m_staging->Collect(out);
+        }
+    }
+
+  private:
+    void Wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake = true;
+        }
+        m_cond.notify_all();
+    }
+
+    uint64_t TotalBytesWritten()
+    {
+        uint64_t total = m_otherBytes.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_writers.size(); i++)
+        {
+            total += m_writers[i]->GetBytesWritten();
+        }
+        return total;
+    }
+
+    // Updates free space, write rate and level. Returns the current total of bytes written.
+    uint64_t Poll(uint64_t now, uint64_t lastBytes)
+    {
+        const uint64_t bytes = TotalBytesWritten();
+        struct statvfs info;
+        if (statvfs(m_config.directory.c_str(), &info) != 0)
+        {
+            ASYNC_LOG_RATE_LIMITED(SEVERITY_ERROR, 10000, "Unable to query free space of {}: {}",
+                                   m_config.directory, strerror(errno));
+            return bytes;
+        }
+        const uint64_t freeBytes = (uint64_t)info.f_bavail * (uint64_t)info.f_frsize;
+        m_freeBytes.store(freeBytes, std::memory_order_relaxed);
+        if (m_lastPollNs != 0 && now > m_lastPollNs)
+        {
+            const double rate = (bytes - lastBytes) * 1e9 / (double)(now - m_lastPollNs);
+            // Smooth over a few polls so one burst does not flip the level
+            m_bytesPerSecond.store(0.7 * m_bytesPerSecond.load(std::memory_order_relaxed) + 0.3 * rate,
+                                   std::memory_order_relaxed);
+        }
+        m_lastPollNs = now;
+
+        // Leaving a level needs this much margin over the threshold that entered it
+        const double hysteresis = 1.05;
+        // While low, repeat the warning this often
+        const uint64_t warnRepeatNs = 30ULL * 1000000000ULL;
+        const storageLevel current = GetLevel();
+        const double rate = m_bytesPerSecond.load(std::memory_order_relaxed);
+        const double margin = freeBytes > m_config.reserveFreeBytes ? (double)(freeBytes - m_config.reserveFreeBytes) : 0.0;
+        const double secondsToReserve = rate > 0.0 ? margin / rate : 1e12;
+        const double criticalScale = current >= STORAGE_CRITICAL ? hysteresis : 1.0;
+        const double lowScale = current >= STORAGE_LOW ? hysteresis : 1.0;
+        storageLevel level = STORAGE_OK;
+        if (freeBytes < m_config.reserveFreeBytes * criticalScale)
+        {
+            level = STORAGE_CRITICAL;
+        }
+        else if (freeBytes < m_config.warnFreeBytes * lowScale || secondsToReserve < m_config.warnSeconds * lowScale)
+        {
+            level = STORAGE_LOW;
+        }
+        m_level.store(level, std::memory_order_relaxed);
+
+        if (level != current || (level != STORAGE_OK && now - m_lastWarnNs >= warnRepeatNs))
+        {
+            m_lastWarnNs = now;
+            if (level == STORAGE_CRITICAL)
+            {
+                static const char* k_actions[] = {"dropping frames", "dropping frames", "stopping the recording"};
+                ASYNC_LOG(SEVERITY_ERROR, "Storage critical on {}: {} MB free, below the {} MB reserve, {}",
+                          m_config.directory, freeBytes >> 20, m_config.reserveFreeBytes >> 20,
+                          k_actions[m_config.policy]);
+            }
+            else if (level == STORAGE_LOW && rate <= 0.0)
+            {
+                ASYNC_LOG(SEVERITY_WARNING, "Storage low on {}: {} MB free{}", m_config.directory, freeBytes >> 20,
+                          m_config.policy == STORAGE_DECIMATE ? ", decimating" : "");
+            }
+            else if (level == STORAGE_LOW)
+            {
+                ASYNC_LOG(SEVERITY_WARNING, "Storage low on {}: {} MB free, reserve reached in {} s at {} MB/s{}",
+                          m_config.directory, freeBytes >> 20, (uint64_t)secondsToReserve, rate / 1e6,
+                          m_config.policy == STORAGE_DECIMATE ? ", decimating" : "");
+            }
+            else
+            {
+                ASYNC_LOG(SEVERITY_INFO, "Storage on {} back to normal: {} MB free", m_config.directory,
+                          freeBytes >> 20);
+            }
+        }
+        return bytes;
+    }
+
+    void Run()
+    {
+        uint64_t lastBytes = TotalBytesWritten();
+        uint64_t nextPoll = GetMonotonicNs() + m_config.pollIntervalMs * 1000000ULL;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_config.pollIntervalMs),
+                            [this] { return !m_running || m_wake; });
+            m_wake = false;
+            std::vector<SegmentWriter*> writers;
+            for (size_t i = 0; i < m_writers.size(); i++)
+            {
+                writers.push_back(m_writers[i].get());
+            }
+            lock.unlock();
+            for (size_t i = 0; i < writers.size(); i++)
+            {
+                writers[i]->FinalizeRetired();
+                writers[i]->PrepareNext();
+            }
+            const uint64_t now = GetMonotonicNs();
+            if (now >= nextPoll)
+            {
+                lastBytes = Poll(now, lastBytes);
+                nextPoll = now + m_config.pollIntervalMs * 1000000ULL;
+            }
+            lock.lock();
+        }
+    }
+
+    const StorageConfig m_config;
+    std::string m_prefix;
+    std::atomic<int> m_level;
+    std::atomic<bool> m_stopRequested;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_running;
+    bool m_wake;
+    std::thread m_thread;
+    // Outlives the writers, which hand it their last segments
+    std::unique_ptr<StagingTier> m_staging;
+    std::vector<std::unique_ptr<SegmentWriter> > m_writers;
+    std::atomic<uint64_t> m_otherBytes;
+    std::atomic<uint64_t> m_freeBytes;
+    std::atomic<double> m_bytesPerSecond;
+    std::atomic<uint64_t> m_shed;
+    // Used by the monitor thread only
+    uint64_t m_lastPollNs;
+    uint64_t m_lastWarnNs;
+};
+
+#endif // DUAL_CAM_RECORDER_STORAGE_MANAGER_H
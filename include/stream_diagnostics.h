@@ -0,0 +1,581 @@
+/*
+ * @Descripttion: Transport-layer stream statistics sampled per camera and correlated with incomplete frames
+ * @version:
+ * @Date: 2026-10-20 04:46:21
+ * @LastEditTime: 2026-10-20 04:46:21
+ */
+
+#ifndef DUAL_CAM_RECORDER_STREAM_DIAGNOSTICS_H
+#define DUAL_CAM_RECORDER_STREAM_DIAGNOSTICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "time_utils.h"
+
+// Counters of the transport layer stream, each cumulative since the stream
+// was opened
+enum streamCounter
+{
+    STREAM_LOST_PACKETS,     // packets that never arrived, after any resends
+    STREAM_RESEND_REQUESTS,  // resend requests the host sent
+    STREAM_RESENT_PACKETS,   // packets that arrived in answer to one
+    STREAM_BUFFER_UNDERRUNS, // frames that arrived with no host buffer to take them
+    STREAM_DROPPED_FRAMES,   // frames the driver dropped before delivery
+    NUM_STREAM_COUNTERS
+};
+
+inline const char* GetStreamCounterName(streamCounter counter)
+{
+    static const char* k_names[] = {"lost_packets", "resend_requests", "resent_packets", "buffer_underruns",
+                                    "dropped_frames"};
+    return counter < NUM_STREAM_COUNTERS ? k_names[counter] : "unknown";
+}
+
+// What an interval with incomplete frames is attributed to, in the order
+// the evidence is weighed
+enum streamCause
+{
+    STREAM_CAUSE_BUFFER_UNDERRUN, // the host had no buffer queued: the recorder falls behind
+    STREAM_CAUSE_LINK_SATURATION, // packets lost while the link ran at its throughput limit
+    STREAM_CAUSE_PACKET_LOSS,     // packets lost below the limit: cabling, NIC or switch
+    STREAM_CAUSE_RESENDS,         // nothing lost for good, but resends came too late for the frame
+    STREAM_CAUSE_UNKNOWN,         // the counters moved in no way that explains it
+    NUM_STREAM_CAUSES
+};
+
+inline const char* GetStreamCauseName(streamCause cause)
+{
+    static const char* k_names[] = {"buffer_underrun", "link_saturation", "packet_loss", "resends", "unknown"};
+    return cause < NUM_STREAM_CAUSES ? k_names[cause] : "unknown";
+}
+
+// One reading of a camera's stream and link. Transport layers name and
+// provide different counters, so any of them may be missing (-1).
+struct StreamSample
+{
+    uint64_t hostNs;                       // host CLOCK_MONOTONIC at the reading
+    int64_t counters[NUM_STREAM_COUNTERS]; // -1 if the transport layer has no such counter
+    double linkThroughput;                 // bytes/s the device currently sends, -1 if unknown
+    double linkThroughputLimit;            // bytes/s the device is limited to, -1 if unknown
+
+    StreamSample() : hostNs(0), linkThroughput(-1.0), linkThroughputLimit(-1.0)
+    {
+        for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+        {
+            counters[i] = -1;
+        }
+    }
+};
+
+struct StreamDiagnosticsConfig
+{
+    unsigned int intervalMs;  // the stream of every active camera is read this often
+    double saturationRatio;   // a link at this fraction of its limit counts as saturated
+    std::string timelinePath; // CSV of every interval of every camera (empty disables)
+
+    StreamDiagnosticsConfig() : intervalMs(1000), saturationRatio(0.95)
+    {
+    }
+};
+
+// The time between two readings of one camera: how much each counter moved,
+// how many incomplete frames the frame path saw meanwhile and what they are
+// attributed to
+struct StreamInterval
+{
+    uint64_t startNs;
+    uint64_t endNs;
+    int64_t deltas[NUM_STREAM_COUNTERS]; // -1 if the counter is missing
+    double linkThroughput;
+    double linkUtilization; // throughput over the limit, -1 if either is unknown
+    uint64_t incompleteFrames;
+    streamCause cause; // only meaningful with incompleteFrames > 0
+
+    StreamInterval()
+        : startNs(0), endNs(0), linkThroughput(-1.0), linkUtilization(-1.0), incompleteFrames(0),
+          cause(STREAM_CAUSE_UNKNOWN)
+    {
+        for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+        {
+            deltas[i] = -1;
+        }
+    }
+
+    double Seconds() const
+    {
+        return endNs > startNs ? (endNs - startNs) / 1e9 : 0.0;
+    }
+
+    double Rate(streamCounter counter) const
+    {
+        const double seconds = Seconds();
+        return deltas[counter] >= 0 && seconds > 0.0 ? deltas[counter] / seconds : 0.0;
+    }
+};
+
+// Turns successive readings of one camera into intervals. A counter that
+// goes backwards was reset with the stream (the camera was reinitialized),
+// so it counts from zero. Not thread-safe; StreamDiagnostics publishes the
+// intervals to readers.
+class StreamModel
+{
+  public:
+    explicit StreamModel(double saturationRatio) : m_saturationRatio(saturationRatio), m_hasPrevious(false)
+    {
+    }
+
+    // Forgets the previous reading; the next one is a new baseline
+    void Reset()
+    {
+        m_hasPrevious = false;
+    }
+
+    // Returns false for a baseline reading, which ends no interval
+    bool AddSample(const StreamSample& sample, uint64_t incompleteFrames, StreamInterval& interval)
+    {
+        if (!m_hasPrevious)
+        {
+            m_previous = sample;
+            m_hasPrevious = true;
+            return false;
+        }
+        interval = StreamInterval();
+        interval.startNs = m_previous.hostNs;
+        interval.endNs = sample.hostNs;
+        for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+        {
+            if (sample.counters[i] < 0)
+            {
+                continue;
+            }
+            const int64_t previous = m_previous.counters[i];
+            interval.deltas[i] = previous >= 0 && sample.counters[i] >= previous ? sample.counters[i] - previous
+                                                                                  : sample.counters[i];
+        }
+        interval.linkThroughput = sample.linkThroughput;
+        if (sample.linkThroughput >= 0.0 && sample.linkThroughputLimit > 0.0)
+        {
+            interval.linkUtilization = sample.linkThroughput / sample.linkThroughputLimit;
+        }
+        interval.incompleteFrames = incompleteFrames;
+        interval.cause = Attribute(interval);
+        m_previous = sample;
+        return true;
+    }
+
+  private:
+    streamCause Attribute(const StreamInterval& interval) const
+    {
+        const bool saturated = interval.linkUtilization >= m_saturationRatio;
+        if (interval.deltas[STREAM_BUFFER_UNDERRUNS] > 0)
+        {
+            return STREAM_CAUSE_BUFFER_UNDERRUN;
+        }
+        if (interval.deltas[STREAM_LOST_PACKETS] > 0)
+        {
+            return saturated ? STREAM_CAUSE_LINK_SATURATION : STREAM_CAUSE_PACKET_LOSS;
+        }
+        if (interval.deltas[STREAM_RESEND_REQUESTS] > 0 || interval.deltas[STREAM_RESENT_PACKETS] > 0)
+        {
+            return STREAM_CAUSE_RESENDS;
+        }
+        return saturated ? STREAM_CAUSE_LINK_SATURATION : STREAM_CAUSE_UNKNOWN;
+    }
+
+    const double m_saturationRatio;
+    bool m_hasPrevious;
+    StreamSample m_previous;
+};
+
+// Reads the stream counters and link throughput of every active camera from
+// a background thread each interval and sets them against the incomplete
+// frames the frame path reported in the same interval. A camera is active
+// from Activate(), once it is initialized, until Suspend(), before it is
+// deinitialized. OnIncompleteFrame() is a relaxed atomic increment, so the
+// frame path pays nothing for the diagnostics; the transport layer is only
+// ever read on the sampler thread. Every interval of every camera is a line
+// of the timeline on the host monotonic clock, the clock frame host
+// timestamps and the gap files use, and intervals with incomplete frames
+// are logged with their cause.
+class StreamDiagnostics
+{
+  public:
+    // Reads the camera's stream and link into the sample, leaving missing
+    // counters at -1. Returns 0 on success, -1 if the camera cannot be read.
+    typedef std::function<int(StreamSample&)> ReadFunction;
+
+    explicit StreamDiagnostics(const StreamDiagnosticsConfig& config)
+        : m_config(config), m_timeline(nullptr), m_running(false)
+    {
+    }
+
+    ~StreamDiagnostics()
+    {
+        Stop();
+    }
+
+    // Registers a camera before Start(); returns its index for OnIncompleteFrame()
+    unsigned int AddCamera(const std::string& name, ReadFunction read)
+    {
+        m_cameras.push_back(std::unique_ptr<Camera>(new Camera(name, read, m_config.saturationRatio)));
+        return (unsigned int)(m_cameras.size() - 1);
+    }
+
+    void Start()
+    {
+        if (!m_config.timelinePath.empty())
+        {
+            m_timeline = fopen(m_config.timelinePath.c_str(), "w");
+            if (m_timeline == nullptr)
+            {
+                ASYNC_LOG(SEVERITY_WARNING, "Unable to create the stream timeline {}", m_config.timelinePath);
+            }
+            else
+            {
+                fprintf(m_timeline, "start_ns,end_ns,camera");
+                for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+                {
+                    fprintf(m_timeline, ",%s", GetStreamCounterName((streamCounter)i));
+                }
+                fprintf(m_timeline, ",link_mb_per_s,link_utilization,incomplete_frames,last_incomplete_ns,cause\n");
+            }
+        }
+        m_running = true;
+        m_thread = std::thread(&StreamDiagnostics::Run, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+            {
+                return;
+            }
+            m_running = false;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+        if (m_timeline != nullptr)
+        {
+            fclose(m_timeline);
+            m_timeline = nullptr;
+        }
+    }
+
+    // Includes the camera in the periodic readings. Its stream may have been
+    // reopened, so the first reading is a new baseline; it is taken on the
+    // sampler thread like every other.
+    void Activate(unsigned int camera)
+    {
+        Camera& state = *m_cameras[camera];
+        std::lock_guard<std::mutex> lock(state.modelMutex);
+        state.model.Reset();
+        state.active = true;
+    }
+
+    // Stops reading the camera
+    void Suspend(unsigned int camera)
+    {
+        Camera& state = *m_cameras[camera];
+        state.active = false;
+        // Wait out a reading that already started
+        std::lock_guard<std::mutex> lock(state.modelMutex);
+    }
+
+    // Called by the frame path for every incomplete frame
+    void OnIncompleteFrame(unsigned int camera, uint64_t hostNs)
+    {
+        Camera& state = *m_cameras[camera];
+        state.incompleteFrames.fetch_add(1, std::memory_order_relaxed);
+        state.lastIncompleteNs.store(hostNs, std::memory_order_relaxed);
+    }
+
+    uint64_t GetIntervalCount(unsigned int camera, streamCause cause) const
+    {
+        return m_cameras[camera]->causes[cause].load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetReadFailures(unsigned int camera) const
+    {
+        return m_cameras[camera]->readFailures.load(std::memory_order_relaxed);
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out) const
+    {
+        char line[256];
+        for (int c = 0; c < NUM_STREAM_COUNTERS; c++)
+        {
+            snprintf(line, sizeof(line), "# TYPE recorder_stream_%s_total counter\n",
+                     GetStreamCounterName((streamCounter)c));
+            out += line;
+            for (size_t i = 0; i < m_cameras.size(); i++)
+            {
+                const int64_t total = m_cameras[i]->totals[c].load(std::memory_order_relaxed);
+                if (total >= 0)
+                {
+                    snprintf(line, sizeof(line), "recorder_stream_%s_total{camera=\"%s\"} %lld\n",
+                             GetStreamCounterName((streamCounter)c), m_cameras[i]->name.c_str(), (long long)total);
+                    out += line;
+                }
+            }
+        }
+        out += "# TYPE recorder_stream_link_utilization gauge\n";
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            StreamInterval last;
+            {
+                std::lock_guard<std::mutex> lock(m_cameras[i]->intervalMutex);
+                last = m_cameras[i]->last;
+            }
+            if (last.linkUtilization >= 0.0)
+            {
+                snprintf(line, sizeof(line), "recorder_stream_link_utilization{camera=\"%s\"} %.3f\n",
+                         m_cameras[i]->name.c_str(), last.linkUtilization);
+                out += line;
+            }
+        }
+        out += "# TYPE recorder_stream_incomplete_intervals_total counter\n";
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            for (int c = 0; c < NUM_STREAM_CAUSES; c++)
+            {
+                snprintf(line, sizeof(line), "recorder_stream_incomplete_intervals_total{camera=\"%s\",cause=\"%s\"} "
+                                             "%llu\n",
+                         m_cameras[i]->name.c_str(), GetStreamCauseName((streamCause)c),
+                         (unsigned long long)m_cameras[i]->causes[c].load(std::memory_order_relaxed));
+                out += line;
+            }
+        }
+        out += "# TYPE recorder_stream_read_failures_total counter\n";
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            snprintf(line, sizeof(line), "recorder_stream_read_failures_total{camera=\"%s\"} %llu\n",
+                     m_cameras[i]->name.c_str(),
+                     (unsigned long long)m_cameras[i]->readFailures.load(std::memory_order_relaxed));
+            out += line;
+        }
+    }
+
+    void PrintSummary() const
+    {
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            const Camera& camera = *m_cameras[i];
+            printf("[%s] Stream:", camera.name.c_str());
+            for (int c = 0; c < NUM_STREAM_COUNTERS; c++)
+            {
+                const int64_t total = camera.totals[c].load();
+                if (total >= 0)
+                {
+                    printf(" %lld %s,", (long long)total, GetStreamCounterName((streamCounter)c));
+                }
+            }
+            printf(" %llu incomplete frames", (unsigned long long)camera.incompleteFrames.load());
+            for (int c = 0; c < NUM_STREAM_CAUSES; c++)
+            {
+                if (camera.causes[c].load() > 0)
+                {
+                    printf(", %llu intervals of %s", (unsigned long long)camera.causes[c].load(),
+                           GetStreamCauseName((streamCause)c));
+                }
+            }
+            printf(", %llu failed readings\n", (unsigned long long)camera.readFailures.load());
+        }
+    }
+
+  private:
+    struct Camera
+    {
+        std::string name;
+        ReadFunction read;
+        std::atomic<bool> active;
+        std::mutex modelMutex; // held for a reading and the model update
+        StreamModel model;
+        uint64_t incompleteSeen; // incompleteFrames at the previous reading
+        mutable std::mutex intervalMutex;
+        StreamInterval last; // published copy of the newest interval
+        std::atomic<uint64_t> incompleteFrames;
+        std::atomic<uint64_t> lastIncompleteNs;
+        std::atomic<int64_t> totals[NUM_STREAM_COUNTERS]; // -1 until the counter was read
+        std::atomic<uint64_t> causes[NUM_STREAM_CAUSES];
+        std::atomic<uint64_t> readFailures;
+        // Rate limits of this camera's messages
+        LogRateLimiter readFailureLog;
+        LogRateLimiter incompleteLog;
+
+        Camera(const std::string& cameraName, ReadFunction readFunction, double saturationRatio)
+            : name(cameraName), read(readFunction), active(false), model(saturationRatio), incompleteSeen(0),
+              incompleteFrames(0), lastIncompleteNs(0), readFailures(0)
+        {
+            for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+            {
+                totals[i] = -1;
+            }
+            for (int i = 0; i < NUM_STREAM_CAUSES; i++)
+            {
+                causes[i] = 0;
+            }
+        }
+    };
+
+    void Sample(Camera& camera)
+    {
+        std::lock_guard<std::mutex> modelLock(camera.modelMutex);
+        if (!camera.active)
+        {
+            return;
+        }
+        StreamSample sample;
+        sample.hostNs = GetMonotonicNs();
+        // Frames reported before the reading belong to the interval it ends
+        const uint64_t incomplete = camera.incompleteFrames.load(std::memory_order_relaxed);
+        if (camera.read(sample) < 0)
+        {
+            camera.readFailures++;
+            ASYNC_LOG_RATE_LIMITED_BY(camera.readFailureLog, SEVERITY_WARNING, 10000,
+                                      "[{}] Unable to read the stream statistics", camera.name);
+            return;
+        }
+        StreamInterval interval;
+        const bool ended = camera.model.AddSample(sample, incomplete - camera.incompleteSeen, interval);
+        camera.incompleteSeen = incomplete;
+        if (!ended)
+        {
+            return;
+        }
+        for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+        {
+            if (interval.deltas[i] >= 0)
+            {
+                const int64_t total = camera.totals[i].load(std::memory_order_relaxed);
+                camera.totals[i].store((total < 0 ? 0 : total) + interval.deltas[i], std::memory_order_relaxed);
+            }
+        }
+        if (interval.incompleteFrames > 0)
+        {
+            camera.causes[interval.cause]++;
+            const uint64_t intervalMs = (interval.endNs - interval.startNs) / 1000000;
+            // The evidence, leaving out counters the transport layer does not have
+            const streamCounter k_evidence[] = {STREAM_LOST_PACKETS, STREAM_RESEND_REQUESTS, STREAM_BUFFER_UNDERRUNS};
+            std::string evidence;
+            for (size_t c = 0; c < sizeof(k_evidence) / sizeof(k_evidence[0]); c++)
+            {
+                if (interval.deltas[k_evidence[c]] >= 0)
+                {
+                    evidence += ", " + std::to_string((long long)interval.deltas[k_evidence[c]]) + " " +
+                                GetStreamCounterName(k_evidence[c]);
+                }
+            }
+            if (interval.linkUtilization >= 0.0)
+            {
+                evidence += ", link at " + std::to_string((int)(interval.linkUtilization * 100.0 + 0.5)) +
+                            " percent of its limit";
+            }
+            ASYNC_LOG_RATE_LIMITED_BY(camera.incompleteLog, SEVERITY_WARNING, 5000,
+                                      "[{}] {} incomplete frames in {} ms, likely {}{}", camera.name,
+                                      interval.incompleteFrames, intervalMs, GetStreamCauseName(interval.cause),
+                                      evidence);
+        }
+        {
+            std::lock_guard<std::mutex> lock(camera.intervalMutex);
+            camera.last = interval;
+        }
+        WriteInterval(camera, interval);
+    }
+
+    // Called on the sampler thread only
+    void WriteInterval(const Camera& camera, const StreamInterval& interval)
+    {
+        if (m_timeline == nullptr)
+        {
+            return;
+        }
+        fprintf(m_timeline, "%llu,%llu,%s", (unsigned long long)interval.startNs, (unsigned long long)interval.endNs,
+                camera.name.c_str());
+        for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+        {
+            if (interval.deltas[i] >= 0)
+            {
+                fprintf(m_timeline, ",%lld", (long long)interval.deltas[i]);
+            }
+            else
+            {
+                fprintf(m_timeline, ",");
+            }
+        }
+        if (interval.linkThroughput >= 0.0)
+        {
+            fprintf(m_timeline, ",%.1f", interval.linkThroughput / 1e6);
+        }
+        else
+        {
+            fprintf(m_timeline, ",");
+        }
+        if (interval.linkUtilization >= 0.0)
+        {
+            fprintf(m_timeline, ",%.3f", interval.linkUtilization);
+        }
+        else
+        {
+            fprintf(m_timeline, ",");
+        }
+        fprintf(m_timeline, ",%llu", (unsigned long long)interval.incompleteFrames);
+        if (interval.incompleteFrames > 0)
+        {
+            fprintf(m_timeline, ",%llu,%s\n",
+                    (unsigned long long)camera.lastIncompleteNs.load(std::memory_order_relaxed),
+                    GetStreamCauseName(interval.cause));
+        }
+        else
+        {
+            fprintf(m_timeline, ",,\n");
+        }
+        fflush(m_timeline);
+    }
+
+    void SampleActive()
+    {
+        for (size_t i = 0; i < m_cameras.size(); i++)
+        {
+            Sample(*m_cameras[i]);
+        }
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_config.intervalMs));
+            if (!m_running)
+            {
+                break;
+            }
+            lock.unlock();
+            SampleActive();
+            lock.lock();
+        }
+    }
+
+    const StreamDiagnosticsConfig m_config;
+    std::vector<std::unique_ptr<Camera> > m_cameras;
+    FILE* m_timeline;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_running;
+    std::thread m_thread;
+};
+
+#endif // DUAL_CAM_RECORDER_STREAM_DIAGNOSTICS_H
@@ -0,0 +1,505 @@
+/*
+ * @Descripttion: Spreads recorded frames over several volumes, one I/O thread per volume
+ * @version:
+ * @Date: 2026-10-19 15:41:27
+ * @LastEditTime: 2026-10-19 15:41:27
+ */
+
+#ifndef DUAL_CAM_RECORDER_STRIPING_WRITER_H
+#define DUAL_CAM_RECORDER_STRIPING_WRITER_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "storage_manager.h"
+#include "time_utils.h"
+
+// How StripingWriter picks a volume for the next frame
+enum stripeMode
+{
+    STRIPE_ROUND_ROBIN, // volumes in turn, skipping any that is backed up
+    STRIPE_WEIGHTED     // the volume expected to finish the frame first, from measured throughput
+};
+
+// One frame handed to the striping writer. The payload stays valid until
+// keepAlive is released, which happens after the write.
+struct StripeJob
+{
+    unsigned int camera; // index returned by StripingWriter::AddCamera
+    SegmentRecordHeader header;
+    const void* payload;
+    uint32_t payloadSize;
+    std::shared_ptr<const void> keepAlive;
+    // Called on the volume's I/O thread after the write
+    std::function<void(bool written, uint64_t writeNs)> done;
+
+    StripeJob() : camera(0), payload(nullptr), payloadSize(0)
+    {
+        memset(&header, 0, sizeof(header));
+    }
+};
+
+// Text manifest of a striped session, one line per frame:
+//   camera,frame,volume,segment,offset,size,device_ts,host_ts
+// Sorting the lines of a camera by frame restores its order.
+class StripeManifest
+{
+  public:
+    StripeManifest() : m_file(nullptr)
+    {
+    }
+
+    ~StripeManifest()
+    {
+        Close();
+    }
+
+    int Open(const std::string& path)
+    {
+        m_file = fopen(path.c_str(), "w");
+        if (m_file == nullptr)
+        {
+            return -1;
+        }
+        setvbuf(m_file, nullptr, _IOFBF, 1 << 16);
+        fprintf(m_file, "camera,frame,volume,segment,offset,size,device_ts,host_ts\n");
+        return 0;
+    }
+
+    void Add(const std::string& serialNumber, unsigned int volume, const SegmentRecordHeader& header,
+             const SegmentLocation& location)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file == nullptr)
+        {
+            return;
+        }
+        fprintf(m_file, "%s,%llu,%u,%s,%llu,%u,%llu,%llu\n", serialNumber.c_str(),
+                (unsigned long long)header.frameIndex, volume, location.path.c_str(),
+                (unsigned long long)location.offset, header.payloadSize, (unsigned long long)header.deviceTimestamp,
+                (unsigned long long)header.hostTimestamp);
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file != nullptr)
+        {
+            fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+  private:
+    std::mutex m_mutex;
+    FILE* m_file;
+};
+
+// Writes frames of every camera into segment files spread over several
+// output directories, each served by its own I/O thread, so the recording
+// rate is bounded by the combined bandwidth rather than by one disk. Submit()
+// never blocks: it queues the frame on a volume and returns.
+class StripingWriter
+{
+  public:
+    // config gives the segment bounds and the free-space reserve of every volume
+    StripingWriter(const std::vector<std::string>& directories, stripeMode mode, const StorageConfig& config,
+                   uint64_t maxQueuedBytesPerVolume)
+        : m_mode(mode), m_config(config), m_maxQueuedBytes(maxQueuedBytesPerVolume), m_nextVolume(0), m_rejected(0)
+    {
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "%lld", (long long)time(nullptr));
+        m_prefix = prefix;
+        for (size_t i = 0; i < directories.size(); i++)
+        {
+            m_volumes.push_back(std::unique_ptr<Volume>(new Volume(*this, (unsigned int)i, directories[i])));
+        }
+    }
+
+    ~StripingWriter()
+    {
+        Stop();
+    }
+
+    // Opens the manifest in the first volume and starts the I/O threads.
+    // Returns -1 if the manifest cannot be created.
+    int Start()
+    {
+        if (m_volumes.empty() ||
+            m_manifest.Open(m_volumes[0]->directory + "/" + m_prefix + "-manifest.csv") < 0)
+        {
+            return -1;
+        }
+        for (size_t i = 0; i < m_volumes.size(); i++)
+        {
+            m_volumes[i]->Start();
+        }
+        return 0;
+    }
+
+    // Writes everything queued, closes all segments and the manifest
+    void Stop()
+    {
+        for (size_t i = 0; i < m_volumes.size(); i++)
+        {
+            m_volumes[i]->Stop();
+        }
+        m_manifest.Close();
+    }
+
+    // Registers a camera before Start(); returns its index for StripeJob::camera
+    unsigned int AddCamera(const std::string& serialNumber)
+    {
+        m_serialNumbers.push_back(serialNumber);
+        for (size_t i = 0; i < m_volumes.size(); i++)
+        {
+            m_volumes[i]->AddCamera(m_prefix, serialNumber);
+        }
+        return (unsigned int)m_serialNumbers.size() - 1;
+    }
+
+    // Queues a frame on a volume. Returns false if every volume is backed up
+    // or out of space; the frame is then not recorded.
+    bool Submit(StripeJob& job)
+    {
+        Volume* volume = PickVolume(job.payloadSize);
+        if (volume == nullptr)
+        {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        volume->Push(job);
+        return true;
+    }
+
+    uint64_t GetRejectedCount() const
+    {
+        return m_rejected.load(std::memory_order_relaxed);
+    }
+
+    // Prints frames, bytes and throughput of every volume
+    void PrintSummary()
+    {
+        uint64_t totalFrames = 0;
+        for (size_t i = 0; i < m_volumes.size(); i++)
+        {
+            totalFrames += m_volumes[i]->frames.load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < m_volumes.size(); i++)
+        {
+            const Volume& volume = *m_volumes[i];
+            const uint64_t frames = volume.frames.load(std::memory_order_relaxed);
+            printf("Volume %zu (%s): %llu frames (%.0f%%), %.1f MB, %.1f MB/s while writing, %llu write errors\n", i,
+                   volume.directory.c_str(), (unsigned long long)frames,
+                   totalFrames > 0 ? 100.0 * frames / totalFrames : 0.0,
+                   volume.bytesWritten.load(std::memory_order_relaxed) / 1e6, volume.GetBytesPerSecond() / 1e6,
+                   (unsigned long long)volume.writeErrors.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Prometheus lines for MetricsRegistry::AddCollector
+    void Collect(std::string& out)
+    {
+        CollectVolumes(out, "recorder_volume_bytes_written_total", "counter", [](const Volume& volume) {
+            return (double)volume.bytesWritten.load(std::memory_order_relaxed);
+        });
+        CollectVolumes(out, "recorder_volume_write_bytes_per_second", "gauge",
+                       [](const Volume& volume) { return volume.GetBytesPerSecond(); });
+        CollectVolumes(out, "recorder_volume_queued_bytes", "gauge", [](const Volume& volume) {
+            return (double)volume.queuedBytes.load(std::memory_order_relaxed);
+        });
+        CollectVolumes(out, "recorder_volume_available", "gauge", [](const Volume& volume) {
+            return volume.available.load(std::memory_order_relaxed) ? 1.0 : 0.0;
+        });
+        char line[160];
+        snprintf(line, sizeof(line),
+                 "# TYPE recorder_stripe_rejected_total counter\nrecorder_stripe_rejected_total %llu\n",
+                 (unsigned long long)GetRejectedCount());
+        out += line;
+    }
+
+  private:
+    struct Volume
+    {
+        StripingWriter& owner;
+        const unsigned int index;
+        const std::string directory;
+        std::vector<std::unique_ptr<SegmentWriter> > writers; // per camera, fixed after Start()
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<StripeJob> jobs;
+        bool running;
+        bool segmentWork; // a writer rolled over, set and cleared on the I/O thread
+        std::thread thread;
+        std::atomic<uint64_t> queuedBytes;
+        std::atomic<uint64_t> bytesWritten;
+        std::atomic<uint64_t> frames;
+        std::atomic<uint64_t> writeErrors;
+        std::atomic<double> bytesPerSecond; // smoothed over recent writes, 0 until measured
+        std::atomic<bool> available;        // has space left and no failing writes
+        std::atomic<bool> backedUp;
+
+        Volume(StripingWriter& writer, unsigned int volumeIndex, const std::string& dir)
+            : owner(writer), index(volumeIndex), directory(dir), running(false), segmentWork(false),
+              queuedBytes(0), bytesWritten(0), frames(0), writeErrors(0), bytesPerSecond(0.0), available(true),
+              backedUp(false)
+        {
+        }
+
+        void AddCamera(const std::string& prefix, const std::string& serialNumber)
+        {
+            StorageConfig config = owner.m_config;
+            config.directory = directory;
+            writers.push_back(std::unique_ptr<SegmentWriter>(
+                new SegmentWriter(config, prefix, serialNumber, [this] { segmentWork = true; })));
+        }
+
+        void Start()
+        {
+            running = true;
+            thread = std::thread(&Volume::Run, this);
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!running)
+                {
+                    return;
+                }
+                running = false;
+            }
+            cond.notify_all();
+            thread.join();
+            for (size_t i = 0; i < writers.size(); i++)
+            {
+                writers[i]->Close();
+            }
+        }
+
+        void Push(StripeJob& job)
+        {
+            queuedBytes.fetch_add(job.payloadSize, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(StripeJob());
+                std::swap(jobs.back(), job);
+            }
+            cond.notify_one();
+        }
+
+        double GetBytesPerSecond() const
+        {
+            return bytesPerSecond.load(std::memory_order_relaxed);
+        }
+
+        void CheckFreeSpace()
+        {
+            struct statvfs info;
+            bool hasSpace = false;
+            if (statvfs(directory.c_str(), &info) == 0)
+            {
+                hasSpace = (uint64_t)info.f_bavail * (uint64_t)info.f_frsize >= owner.m_config.reserveFreeBytes;
+            }
+            if (available.exchange(hasSpace) != hasSpace)
+            {
+                if (hasSpace)
+                {
+                    ASYNC_LOG(SEVERITY_INFO, "Volume {} available again", directory);
+                }
+                else
+                {
+                    ASYNC_LOG(SEVERITY_WARNING, "Volume {} below the free-space reserve, no longer used", directory);
+                }
+            }
+        }
+
+        void Write(StripeJob& job)
+        {
+            const uint64_t start = GetMonotonicNs();
+            SegmentLocation location;
+            const bool written =
+                writers[job.camera]->Append(job.header, job.payload, job.payloadSize, &location);
+            const uint64_t writeNs = GetMonotonicNs() - start;
+            queuedBytes.fetch_sub(job.payloadSize, std::memory_order_relaxed);
+            if (written)
+            {
+                owner.m_manifest.Add(owner.m_serialNumbers[job.camera], index, job.header, location);
+                bytesWritten.fetch_add(job.payloadSize, std::memory_order_relaxed);
+                frames.fetch_add(1, std::memory_order_relaxed);
+                // Device throughput, so a volume that slows down loses share
+                if (writeNs > 0)
+                {
+                    const double rate = job.payloadSize * 1e9 / (double)writeNs;
+                    const double previous = GetBytesPerSecond();
+                    bytesPerSecond.store(previous == 0.0 ? rate : 0.9 * previous + 0.1 * rate,
+                                         std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                writeErrors.fetch_add(1, std::memory_order_relaxed);
+                available.store(false);
+                ASYNC_LOG_RATE_LIMITED(SEVERITY_ERROR, 1000, "Write to volume {} failed: {}", directory,
+                                       strerror(errno));
+            }
+            if (job.done)
+            {
+                job.done(written, writeNs);
+            }
+        }
+
+        void Run()
+        {
+            uint64_t nextSpaceCheck = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                cond.wait_for(lock, std::chrono::milliseconds(200), [this] { return !running || !jobs.empty(); });
+                while (!jobs.empty())
+                {
+                    StripeJob job;
+                    std::swap(job, jobs.front());
+                    jobs.pop_front();
+                    lock.unlock();
+                    Write(job);
+                    // Release the frame before taking the next one
+                    job = StripeJob();
+                    if (segmentWork)
+                    {
+                        segmentWork = false;
+                        PrepareSegments();
+                    }
+                    lock.lock();
+                }
+                if (!running)
+                {
+                    return;
+                }
+                lock.unlock();
+                PrepareSegments();
+                const uint64_t now = GetMonotonicNs();
+                if (now >= nextSpaceCheck)
+                {
+                    CheckFreeSpace();
+                    nextSpaceCheck = now + owner.m_config.pollIntervalMs * 1000000ULL;
+                }
+                lock.lock();
+            }
+        }
+
+        void PrepareSegments()
+        {
+            for (size_t i = 0; i < writers.size(); i++)
+            {
+                writers[i]->FinalizeRetired();
+                writers[i]->PrepareNext();
+            }
+        }
+    };
+
+    void CollectVolumes(std::string& out, const char* name, const char* type,
+                        std::function<double(const Volume&)> value)
+    {
+        char line[512];
+        snprintf(line, sizeof(line), "# TYPE %s %s\n", name, type);
+        out += line;
+        for (size_t i = 0; i < m_volumes.size(); i++)
+        {
+            snprintf(line, sizeof(line), "%s{volume=\"%s\"} %.0f\n", name, m_volumes[i]->directory.c_str(),
+                     value(*m_volumes[i]));
+            out += line;
+        }
+    }
+
+    bool Accepts(Volume& volume, uint32_t payloadSize)
+    {
+        if (!volume.available.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        const bool backedUp =
+            volume.queuedBytes.load(std::memory_order_relaxed) + payloadSize > m_maxQueuedBytes;
+        if (volume.backedUp.exchange(backedUp) != backedUp && backedUp)
+        {
+            ASYNC_LOG(SEVERITY_WARNING, "Volume {} is falling behind, shifting frames to other volumes",
+                      volume.directory);
+        }
+        return !backedUp;
+    }
+
+    Volume* PickVolume(uint32_t payloadSize)
+    {
+        const size_t count = m_volumes.size();
+        if (m_mode == STRIPE_ROUND_ROBIN)
+        {
+            const size_t start = m_nextVolume.fetch_add(1, std::memory_order_relaxed);
+            for (size_t i = 0; i < count; i++)
+            {
+                Volume& volume = *m_volumes[(start + i) % count];
+                if (Accepts(volume, payloadSize))
+                {
+                    return &volume;
+                }
+            }
+            return nullptr;
+        }
+        // Volumes not measured yet are assumed as fast as the fastest one, so
+        // every volume gets a share and a measurement
+        double fastest = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            fastest = std::max(fastest, m_volumes[i]->GetBytesPerSecond());
+        }
+        Volume* best = nullptr;
+        double bestFinish = 0.0;
+        const size_t start = m_nextVolume.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < count; i++)
+        {
+            Volume& volume = *m_volumes[(start + i) % count];
+            if (!Accepts(volume, payloadSize))
+            {
+                continue;
+            }
+            double rate = volume.GetBytesPerSecond();
+            if (rate == 0.0)
+            {
+                rate = fastest > 0.0 ? fastest : 1.0;
+            }
+            const double finish = (volume.queuedBytes.load(std::memory_order_relaxed) + payloadSize) / rate;
+            if (best == nullptr || finish < bestFinish)
+            {
+                best = &volume;
+                bestFinish = finish;
+            }
+        }
+        return best;
+    }
+
+    const stripeMode m_mode;
+    const StorageConfig m_config;
+    const uint64_t m_maxQueuedBytes;
+    std::string m_prefix;
+    std::vector<std::string> m_serialNumbers;
+    std::vector<std::unique_ptr<Volume> > m_volumes;
+    StripeManifest m_manifest;
+    std::atomic<size_t> m_nextVolume;
+    std::atomic<uint64_t> m_rejected;
+};
+
+#endif // DUAL_CAM_RECORDER_STRIPING_WRITER_H
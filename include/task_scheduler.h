@@ -0,0 +1,313 @@
+/*
+ * @Descripttion: Work-stealing task scheduler shared by all cameras
+ * @version:
+ * @Date: 2026-10-19 10:05:32
+ * @LastEditTime: 2026-10-19 10:05:32
+ */
+
+#ifndef DUAL_CAM_RECORDER_TASK_SCHEDULER_H
+#define DUAL_CAM_RECORDER_TASK_SCHEDULER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads, each with its own task deque. Tasks submitted
+// from outside the pool (new frames) are spread round-robin over the back of
+// the deques; tasks submitted by a worker (the follow-up stage of a frame it
+// just handled) go to the front of its own deque. A worker always pops from
+// the front, so it finishes a frame while its data is still in cache and
+// otherwise serves frames in arrival order. An idle worker steals from the
+// back of another worker's deque.
+class TaskScheduler
+{
+  public:
+    typedef std::function<void()> Task;
+
+    // numWorkers == 0 uses one worker per hardware thread
+    explicit TaskScheduler(unsigned int numWorkers = 0)
+        : m_pending(0), m_active(0), m_stop(false), m_nextQueue(0), m_steals(0)
+    {
+        if (numWorkers == 0)
+        {
+            numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned int i = 0; i < numWorkers; i++)
+        {
+            m_queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        }
+        for (unsigned int i = 0; i < numWorkers; i++)
+        {
+            m_threads.push_back(std::thread(&TaskScheduler::WorkerLoop, this, i));
+        }
+    }
+
+    // Runs every task already submitted, then stops the workers
+    ~TaskScheduler()
+    {
+        WaitIdle();
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stop = true;
+        }
+        m_sleepCond.notify_all();
+        for (size_t i = 0; i < m_threads.size(); i++)
+        {
+            m_threads[i].join();
+        }
+    }
+
+    void Submit(Task task)
+    {
+        const bool local = CurrentScheduler() == this;
+        unsigned int index;
+        if (local)
+        {
+            index = CurrentWorkerIndex();
+        }
+        else
+        {
+            index = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        }
+        m_active.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+            if (local)
+            {
+                m_queues[index]->tasks.push_front(std::move(task));
+            }
+            else
+            {
+                m_queues[index]->tasks.push_back(std::move(task));
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_pending++;
+        }
+        m_sleepCond.notify_one();
+    }
+
+    // Blocks until every submitted task, including tasks submitted by tasks,
+    // has finished. Must not be called from a worker.
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleCond.wait(lock, [this] { return m_active.load() == 0; });
+    }
+
+    unsigned int GetNumWorkers() const
+    {
+        return (unsigned int)m_threads.size();
+    }
+
+    // Number of tasks a worker took from another worker's deque
+    uint64_t GetStealCount() const
+    {
+        return m_steals.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static TaskScheduler*& CurrentScheduler()
+    {
+        static thread_local TaskScheduler* scheduler = nullptr;
+        return scheduler;
+    }
+
+    static unsigned int& CurrentWorkerIndex()
+    {
+        static thread_local unsigned int index = 0;
+        return index;
+    }
+
+    bool PopLocal(unsigned int index, Task& task)
+    {
+        WorkerQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool Steal(unsigned int index, Task& task)
+    {
+        for (size_t offset = 1; offset < m_queues.size(); offset++)
+        {
+            WorkerQueue& victim = *m_queues[(index + offset) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                m_steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerLoop(unsigned int index)
+    {
+        CurrentScheduler() = this;
+        CurrentWorkerIndex() = index;
+        while (true)
+        {
+            Task task;
+            if (PopLocal(index, task) || Steal(index, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_sleepMutex);
+                    m_pending--;
+                }
+                task();
+                if (m_active.fetch_sub(1) == 1)
+                {
+                    std::lock_guard<std::mutex> lock(m_idleMutex);
+                    m_idleCond.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleepCond.wait(lock, [this] { return m_stop || m_pending > 0; });
+            if (m_stop && m_pending == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue> > m_queues;
+    std::vector<std::thread> m_threads;
+    // Tasks queued but not yet started, guarded by m_sleepMutex
+    uint64_t m_pending;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCond;
+    // Tasks queued or running
+    std::atomic<uint64_t> m_active;
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCond;
+    bool m_stop;
+    std::atomic<unsigned int> m_nextQueue;
+    std::atomic<uint64_t> m_steals;
+};
+
+// Runs tasks on a TaskScheduler one at a time, in submission order. Used for
+// per-camera work that must not run concurrently, e.g. appending to a file.
+class Strand
+{
+  public:
+    explicit Strand(TaskScheduler& scheduler) : m_scheduler(scheduler), m_running(false)
+    {
+    }
+
+    void Post(TaskScheduler::Task task)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+        if (!m_running)
+        {
+            m_running = true;
+            m_scheduler.Submit([this] { Drain(); });
+        }
+    }
+
+  private:
+    // Bounded batch per scheduling so one busy camera cannot pin a worker
+    static const unsigned int k_maxBatch = 8;
+
+    void Drain()
+    {
+        for (unsigned int i = 0; i < k_maxBatch; i++)
+        {
+            TaskScheduler::Task task;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_tasks.empty())
+                {
+                    m_running = false;
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tasks.empty())
+        {
+            m_running = false;
+        }
+        else
+        {
+            m_scheduler.Submit([this] { Drain(); });
+        }
+    }
+
+    TaskScheduler& m_scheduler;
+    std::mutex m_mutex;
+    std::deque<TaskScheduler::Task> m_tasks;
+    bool m_running;
+};
+
+// Strand that runs tasks in sequence-number order regardless of the order in
+// which they are posted. Frames of one camera are converted in parallel and
+// finish out of order; posting each write with its frame index restores the
+// per-camera order. Every sequence number must be posted exactly once (an
+// empty task is fine for a frame that produced no output).
+class OrderedStrand
+{
+  public:
+    explicit OrderedStrand(TaskScheduler& scheduler, uint64_t firstSequence = 0)
+        : m_strand(scheduler), m_next(firstSequence)
+    {
+    }
+
+    void Post(uint64_t sequence, TaskScheduler::Task task)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waiting[sequence] = std::move(task);
+        std::map<uint64_t, TaskScheduler::Task>::iterator it = m_waiting.find(m_next);
+        while (it != m_waiting.end())
+        {
+            if (it->second)
+            {
+                m_strand.Post(std::move(it->second));
+            }
+            m_waiting.erase(it);
+            it = m_waiting.find(++m_next);
+        }
+    }
+
+    // Tasks held back waiting for an earlier sequence number
+    size_t GetWaitingCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_waiting.size();
+    }
+
+  private:
+    Strand m_strand;
+    std::mutex m_mutex;
+    std::map<uint64_t, TaskScheduler::Task> m_waiting;
+    uint64_t m_next;
+};
+
+#endif // DUAL_CAM_RECORDER_TASK_SCHEDULER_H
@@ -0,0 +1,44 @@
+/*
+ * @Descripttion: Host clock helpers shared by the acquisition pipeline
+ * @version: 
+ * @Date: 2026-10-19 09:12:40
+ * @LastEditTime: 2026-10-19 09:12:40
+ */
+
+#ifndef DUAL_CAM_RECORDER_TIME_UTILS_H
+#define DUAL_CAM_RECORDER_TIME_UTILS_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Host CLOCK_MONOTONIC in nanoseconds. All latency and rate measurements use
+// this clock because it never jumps with NTP or manual time changes.
+inline uint64_t GetMonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Host CLOCK_REALTIME in nanoseconds since the Unix epoch.
+inline uint64_t GetRealtimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// A camera timestamp mapped to the host clocks by the clock sync service
+struct SyncedTimestamp
+{
+    uint64_t monotonic; // ns, host CLOCK_MONOTONIC
+    uint64_t realtime;  // ns since the Unix epoch
+    uint64_t errorNs;   // bound on the error of both, 0 if not synchronized
+    bool valid;         // false until the camera's clock model is usable
+
+    SyncedTimestamp() : monotonic(0), realtime(0), errorNs(0), valid(false)
+    {
+    }
+};
+
+#endif // DUAL_CAM_RECORDER_TIME_UTILS_H
@@ -0,0 +1,580 @@
+/*
+ * @Descripttion: Random access playback and export of recorded sessions
+ * @version:
+ * @Date: 2026-10-19 20:02:44
+ * @LastEditTime: 2026-10-19 20:02:44
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "decode_pipeline.h"
+#include "session_index.h"
+#include "task_scheduler.h"
+#include "time_utils.h"
+
+using namespace std;
+
+// Command line of the player
+struct PlayerOptions
+{
+    string command;
+    vector<string> directories; // the session, one directory per volume
+    string outputDirectory;
+    string camera;            // export only this camera, empty for all
+    double fromSeconds;       // range, relative to the start of the session
+    double toSeconds;         // negative for the end of the session
+    double atSeconds;         // seek position
+    double toleranceMs;       // sets: largest offset from the reference frame, 0 for half a frame period
+    string match;             // sets: "time", "index", or empty to choose from the time base
+    unsigned int numThreads;  // decode workers, 0 for one per hardware thread
+    unsigned int readAhead;   // frames decoded ahead per worker
+
+    PlayerOptions()
+        : fromSeconds(0.0), toSeconds(-1.0), atSeconds(0.0), toleranceMs(0.0), numThreads(0), readAhead(4)
+    {
+    }
+};
+
+const char* const k_timeBaseNames[] = {"synced", "host receive", "wall seconds"};
+
+// This function prints the usage of the player.
+void PrintUsage()
+{
+    cout << "Usage: player <command> <session directory>... [options]" << endl
+         << "  index                      index the session and print a summary of every camera" << endl
+         << "  seek --at=<s>              frame of every camera closest to <s> seconds into the session" << endl
+         << "  export --out=<dir>         decode frames to <dir> as PGM/PPM" << endl
+         << "         [--camera=<serial>]" << endl
+         << "  sets --out=<dir>           decode synchronized sets, one frame per camera, to <dir>" << endl
+         << "         [--tolerance-ms=<ms>] [--match=time|index]" << endl
+         << "  decode                     decode without writing at 1..N workers and report throughput" << endl
+         << "Options of every command: [--from=<s>] [--to=<s>] [--threads=<n>] [--read-ahead=<frames per worker>]"
+         << endl
+         << "The index is kept in <first directory>/session.idx and refreshed on every run." << endl;
+}
+
+// This function parses the command line. Returns -1 on a usage error.
+int ParseOptions(int argc, char** argv, PlayerOptions& options)
+{
+    if (argc < 3)
+    {
+        return -1;
+    }
+    options.command = argv[1];
+    for (int i = 2; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            options.directories.push_back(arg);
+        }
+        else if (arg.compare(0, 6, "--out=") == 0)
+        {
+            options.outputDirectory = arg.substr(6);
+        }
+        else if (arg.compare(0, 9, "--camera=") == 0)
+        {
+            options.camera = arg.substr(9);
+        }
+        else if (arg.compare(0, 7, "--from=") == 0)
+        {
+            options.fromSeconds = atof(arg.c_str() + 7);
+        }
+        else if (arg.compare(0, 5, "--to=") == 0)
+        {
+            options.toSeconds = atof(arg.c_str() + 5);
+        }
+        else if (arg.compare(0, 5, "--at=") == 0)
+        {
+            options.atSeconds = atof(arg.c_str() + 5);
+        }
+        else if (arg.compare(0, 15, "--tolerance-ms=") == 0)
+        {
+            options.toleranceMs = atof(arg.c_str() + 15);
+        }
+        else if (arg.compare(0, 8, "--match=") == 0)
+        {
+            options.match = arg.substr(8);
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            options.numThreads = (unsigned int)atoi(arg.c_str() + 10);
+        }
+        else if (arg.compare(0, 13, "--read-ahead=") == 0)
+        {
+            options.readAhead = std::max(1, atoi(arg.c_str() + 13));
+        }
+        else
+        {
+            cout << "Unknown argument " << arg << endl;
+            return -1;
+        }
+    }
+    if (options.directories.empty() || (options.match != "" && options.match != "time" && options.match != "index"))
+    {
+        return -1;
+    }
+    if (options.numThreads == 0)
+    {
+        options.numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return 0;
+}
+
+// This function converts a position in seconds into the session to a timestamp.
+uint64_t ToTimestamp(const SessionIndex& index, double seconds)
+{
+    return index.GetStartTime() + (uint64_t)std::max(0.0, seconds * 1e9);
+}
+
+// This function returns the range [from, to] of timestamps selected by the options.
+void GetRange(const SessionIndex& index, const PlayerOptions& options, uint64_t& from, uint64_t& to)
+{
+    from = ToTimestamp(index, options.fromSeconds);
+    to = options.toSeconds < 0.0 ? index.GetEndTime() : ToTimestamp(index, options.toSeconds);
+}
+
+// This function collects the frames in the range, of the selected camera or
+// all, interleaved in time order so that read-ahead covers every camera.
+void CollectRange(const SessionIndex& index, const PlayerOptions& options, vector<SessionFrame>& frames)
+{
+    uint64_t from;
+    uint64_t to;
+    GetRange(index, options, from, to);
+    for (size_t c = 0; c < index.GetCameras().size(); c++)
+    {
+        if (options.camera != "" && index.GetCameras()[c] != options.camera)
+        {
+            continue;
+        }
+        const vector<SessionFrame>& cameraFrames = index.GetFrames((unsigned int)c);
+        for (size_t i = index.LowerBound((unsigned int)c, from); i < cameraFrames.size(); i++)
+        {
+            if (cameraFrames[i].timestamp > to)
+            {
+                break;
+            }
+            frames.push_back(cameraFrames[i]);
+        }
+    }
+    std::stable_sort(frames.begin(), frames.end(),
+                     [](const SessionFrame& a, const SessionFrame& b) { return a.timestamp < b.timestamp; });
+}
+
+// This function prints every camera of the session with its frame count,
+// time span, time base and gaps in the frame index sequence.
+void PrintSummary(const SessionIndex& index, uint64_t openNs)
+{
+    const vector<string>& cameras = index.GetCameras();
+    cout << "Session of " << cameras.size() << " cameras, " << index.GetSources().size() << " files, "
+         << (index.GetEndTime() - index.GetStartTime()) / 1e9 << " s" << endl;
+    cout << "Index " << index.GetIndexPath() << (index.IndexWritten() ? " written" : " up to date") << " in "
+         << openNs / 1e6 << " ms (" << index.GetReusedSourceCount() << " files from the index, "
+         << index.GetScannedSourceCount() << " read)" << endl;
+    for (size_t c = 0; c < cameras.size(); c++)
+    {
+        const vector<SessionFrame>& frames = index.GetFrames((unsigned int)c);
+        if (frames.empty())
+        {
+            cout << "[" << cameras[c] << "] no frames" << endl;
+            continue;
+        }
+        uint64_t minIndex = frames[0].frameIndex;
+        uint64_t maxIndex = frames[0].frameIndex;
+        unsigned int timeBases[3] = {0, 0, 0};
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            minIndex = std::min(minIndex, frames[i].frameIndex);
+            maxIndex = std::max(maxIndex, frames[i].frameIndex);
+            timeBases[std::min(2u, frames[i].timeBase)]++;
+        }
+        // Frame indices restart if the recorder did, so this can only be a lower bound
+        const uint64_t span = maxIndex - minIndex + 1;
+        const uint64_t missing = span > frames.size() ? span - frames.size() : 0;
+        cout << "[" << cameras[c] << "] " << frames.size() << " frames " << minIndex << ".." << maxIndex << ", "
+             << missing << " missing, " << (frames.front().timestamp - index.GetStartTime()) / 1e9 << " .. "
+             << (frames.back().timestamp - index.GetStartTime()) / 1e9 << " s, time base";
+        for (int t = 0; t < 3; t++)
+        {
+            if (timeBases[t] > 0)
+            {
+                cout << " " << k_timeBaseNames[t] << " (" << timeBases[t] << ")";
+            }
+        }
+        cout << endl;
+    }
+}
+
+// This function warns about the cameras timed only by their JPEG file names,
+// to the whole second, because the recording left no timestamp sidecar.
+void WarnWallSeconds(const SessionIndex& index)
+{
+    const vector<string>& cameras = index.GetCameras();
+    for (size_t c = 0; c < cameras.size(); c++)
+    {
+        const vector<SessionFrame>& frames = index.GetFrames((unsigned int)c);
+        bool wallSecondsOnly = !frames.empty();
+        for (size_t i = 0; wallSecondsOnly && i < frames.size(); i++)
+        {
+            wallSecondsOnly = frames[i].timeBase == TIME_WALL_SECONDS;
+        }
+        if (wallSecondsOnly)
+        {
+            cout << "Warning: [" << cameras[c] << "] has no timestamp sidecar, its frames are timed to the second"
+                 << (c == 0 ? " and sets are matched by frame index" : "") << endl;
+        }
+    }
+}
+
+// This function prints the frame of every camera closest to the seek position.
+void Seek(const SessionIndex& index, const PlayerOptions& options)
+{
+    const uint64_t timestamp = ToTimestamp(index, options.atSeconds);
+    for (size_t c = 0; c < index.GetCameras().size(); c++)
+    {
+        const long position = index.Nearest((unsigned int)c, timestamp);
+        if (position < 0)
+        {
+            continue;
+        }
+        const SessionFrame& frame = index.GetFrames((unsigned int)c)[position];
+        cout << "[" << index.GetCameras()[c] << "] frame " << frame.frameIndex << " at "
+             << (frame.timestamp - index.GetStartTime()) / 1e9 << " s ("
+             << ((double)frame.timestamp - (double)timestamp) / 1e6 << " ms from the seek position) in "
+             << index.GetSources()[frame.source].path << endl;
+    }
+}
+
+// This function writes a decoded frame as binary PGM (gray) or PPM (RGB), or
+// as the stored bytes if the layout is unknown. Returns -1 on error.
+int WriteDecodedFrame(const DecodedFrame& decoded, const string& pathWithoutExtension)
+{
+    string path = pathWithoutExtension;
+    path += decoded.channels == 1 ? ".pgm" : decoded.channels == 3 ? ".ppm" : ".raw";
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return -1;
+    }
+    if (decoded.channels != 0)
+    {
+        fprintf(file, "P%c\n%u %u\n%u\n", decoded.channels == 1 ? '5' : '6', decoded.width, decoded.height,
+                (1u << decoded.bitDepth) - 1);
+    }
+    const vector<uint8_t>* pixels = &decoded.pixels;
+    vector<uint8_t> bigEndian;
+    if (decoded.bitDepth > 8)
+    {
+        // PGM stores samples above 8 bits as big-endian pairs
+        bigEndian.resize(decoded.pixels.size());
+        for (size_t i = 0; i + 1 < bigEndian.size(); i += 2)
+        {
+            bigEndian[i] = decoded.pixels[i + 1];
+            bigEndian[i + 1] = decoded.pixels[i];
+        }
+        pixels = &bigEndian;
+    }
+    const bool ok = pixels->empty() || fwrite(&(*pixels)[0], 1, pixels->size(), file) == pixels->size();
+    return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+// This function decodes frames with numThreads workers, writing each frame
+// with write (if set) in list order. Prints the achieved throughput and
+// returns the number of frames that could not be decoded or written.
+template <class WriteFunction>
+size_t DecodeFrames(const SessionIndex& index, const vector<SessionFrame>& frames, unsigned int numThreads,
+                    unsigned int readAhead, WriteFunction write, bool quiet = false)
+{
+    TaskScheduler scheduler(numThreads);
+    DecodePipeline pipeline(index, scheduler, (size_t)numThreads * readAhead);
+    const uint64_t start = GetMonotonicNs();
+    pipeline.Start(frames);
+    DecodedFrame decoded;
+    size_t failed = 0;
+    uint64_t pixelBytes = 0;
+    while (pipeline.Next(decoded))
+    {
+        if (!decoded.ok)
+        {
+            cout << "[" << index.GetCameras()[decoded.frame.camera] << "] frame " << decoded.frame.frameIndex
+                 << ": " << decoded.error << endl;
+            failed++;
+            continue;
+        }
+        pixelBytes += decoded.pixels.size();
+        if (write(decoded) < 0)
+        {
+            failed++;
+        }
+    }
+    const double seconds = (GetMonotonicNs() - start) / 1e9;
+    if (!quiet)
+    {
+        cout << frames.size() << " frames with " << numThreads << " workers in " << seconds << " s: "
+             << frames.size() / seconds << " frames/s, " << pipeline.GetBytesRead() / seconds / 1e6
+             << " MB/s read, " << pixelBytes / seconds / 1e6 << " MB/s decoded" << endl;
+    }
+    return failed;
+}
+
+// This function exports every frame in the range, of one camera or all.
+int ExportRange(const SessionIndex& index, const PlayerOptions& options)
+{
+    vector<SessionFrame> frames;
+    CollectRange(index, options, frames);
+    cout << "Exporting " << frames.size() << " frames to " << options.outputDirectory << "..." << endl;
+    const string& directory = options.outputDirectory;
+    const size_t failed =
+        DecodeFrames(index, frames, options.numThreads, options.readAhead, [&](const DecodedFrame& decoded) {
+            const string& serialNumber = index.GetCameras()[decoded.frame.camera];
+            const string name = serialNumber + "-" + to_string(decoded.frame.frameIndex);
+            return WriteDecodedFrame(decoded, directory + "/" + name);
+        });
+    if (failed > 0)
+    {
+        cout << failed << " frames failed" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+// This function returns half the median frame period of a camera, the
+// default tolerance for matching frames of different cameras.
+uint64_t GetDefaultTolerance(const vector<SessionFrame>& frames)
+{
+    vector<uint64_t> periods;
+    for (size_t i = 1; i < frames.size(); i++)
+    {
+        periods.push_back(frames[i].timestamp - frames[i - 1].timestamp);
+    }
+    if (periods.empty())
+    {
+        return 0;
+    }
+    std::nth_element(periods.begin(), periods.begin() + periods.size() / 2, periods.end());
+    return periods[periods.size() / 2] / 2;
+}
+
+// This function finds synchronized sets in the range: for every frame of the
+// first camera, the frame of each other camera closest in time (within the
+// tolerance, and not used by an earlier set) or with the same frame index.
+// Sets that miss a camera are skipped. Frames are appended set by set.
+size_t FindSets(const SessionIndex& index, const PlayerOptions& options, vector<SessionFrame>& frames,
+                uint64_t& tolerance, bool& byIndex)
+{
+    const unsigned int numCameras = (unsigned int)index.GetCameras().size();
+    uint64_t from;
+    uint64_t to;
+    GetRange(index, options, from, to);
+    const vector<SessionFrame>& reference = index.GetFrames(0);
+    byIndex = options.match == "index" ||
+              (options.match == "" && !reference.empty() && reference[0].timeBase == TIME_WALL_SECONDS);
+    tolerance = options.toleranceMs > 0.0 ? (uint64_t)(options.toleranceMs * 1e6) : GetDefaultTolerance(reference);
+    vector<map<uint64_t, size_t> > positionsByIndex(numCameras);
+    if (byIndex)
+    {
+        for (unsigned int c = 1; c < numCameras; c++)
+        {
+            const vector<SessionFrame>& cameraFrames = index.GetFrames(c);
+            for (size_t i = 0; i < cameraFrames.size(); i++)
+            {
+                positionsByIndex[c][cameraFrames[i].frameIndex] = i;
+            }
+        }
+    }
+    vector<long> lastUsed(numCameras, -1);
+    vector<long> positions(numCameras, -1);
+    size_t numSets = 0;
+    for (size_t r = index.LowerBound(0, from); r < reference.size() && reference[r].timestamp <= to; r++)
+    {
+        vector<SessionFrame> set(1, reference[r]);
+        for (unsigned int c = 1; c < numCameras; c++)
+        {
+            long position = -1;
+            if (byIndex)
+            {
+                map<uint64_t, size_t>::const_iterator found = positionsByIndex[c].find(reference[r].frameIndex);
+                position = found == positionsByIndex[c].end() ? -1 : (long)found->second;
+            }
+            else
+            {
+                position = index.Nearest(c, reference[r].timestamp);
+                if (position >= 0)
+                {
+                    const SessionFrame& candidate = index.GetFrames(c)[position];
+                    const uint64_t offset = candidate.timestamp > reference[r].timestamp
+                                                ? candidate.timestamp - reference[r].timestamp
+                                                : reference[r].timestamp - candidate.timestamp;
+                    if (offset > tolerance || position <= lastUsed[c])
+                    {
+                        position = -1;
+                    }
+                }
+            }
+            if (position < 0)
+            {
+                break;
+            }
+            positions[c] = position;
+            set.push_back(index.GetFrames(c)[position]);
+        }
+        if (set.size() != numCameras)
+        {
+            continue;
+        }
+        lastUsed = positions;
+        frames.insert(frames.end(), set.begin(), set.end());
+        numSets++;
+    }
+    return numSets;
+}
+
+// This function exports synchronized sets and a sets.csv describing them.
+int ExportSets(const SessionIndex& index, const PlayerOptions& options)
+{
+    const vector<string>& cameras = index.GetCameras();
+    if (cameras.size() < 2)
+    {
+        cout << "Synchronized sets need at least two cameras" << endl;
+        return -1;
+    }
+    vector<SessionFrame> frames;
+    uint64_t tolerance = 0;
+    bool byIndex = false;
+    const size_t numSets = FindSets(index, options, frames, tolerance, byIndex);
+    const size_t numReference = index.GetFrames(0).size();
+    cout << numSets << " sets of " << cameras.size() << " cameras matched by "
+         << (byIndex ? "frame index" : "time, tolerance " + to_string(tolerance / 1e6) + " ms") << " ("
+         << numReference << " frames of reference camera " << cameras[0] << ")" << endl;
+
+    const string csvPath = options.outputDirectory + "/sets.csv";
+    FILE* csv = fopen(csvPath.c_str(), "w");
+    if (csv == nullptr)
+    {
+        cout << "Unable to create " << csvPath << endl;
+        return -1;
+    }
+    fprintf(csv, "set,camera,frame,timestamp_ns,offset_ns,time_base\n");
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const SessionFrame& frame = frames[i];
+        const SessionFrame& reference = frames[i - i % cameras.size()];
+        fprintf(csv, "%zu,%s,%llu,%llu,%lld,%s\n", i / cameras.size(), cameras[frame.camera].c_str(),
+                (unsigned long long)frame.frameIndex, (unsigned long long)frame.timestamp,
+                (long long)(frame.timestamp - reference.timestamp), k_timeBaseNames[std::min(2u, frame.timeBase)]);
+    }
+    fclose(csv);
+
+    // Frames are in set order, so the position in the list gives the set
+    size_t position = 0;
+    const string& directory = options.outputDirectory;
+    const size_t numCameras = cameras.size();
+    const size_t failed = DecodeFrames(index, frames, options.numThreads, options.readAhead,
+                                       [&](const DecodedFrame& decoded) {
+                                           char name[64];
+                                           snprintf(name, sizeof(name), "/set-%06zu-", position++ / numCameras);
+                                           return WriteDecodedFrame(decoded,
+                                                                    directory + name + cameras[decoded.frame.camera]);
+                                       });
+    if (failed > 0)
+    {
+        cout << failed << " frames failed" << endl;
+        return -1;
+    }
+    return 0;
+}
+
+// This function decodes the range without writing at 1, 2, 4, ... workers up
+// to the thread count, to show how decoding scales with cores.
+int MeasureDecode(const SessionIndex& index, const PlayerOptions& options)
+{
+    vector<SessionFrame> frames;
+    CollectRange(index, options, frames);
+    if (frames.empty())
+    {
+        cout << "No frames in the range" << endl;
+        return -1;
+    }
+    // The first pass warms the page cache so every pass reads the same way
+    DecodeFrames(index, frames, options.numThreads, options.readAhead,
+                 [](const DecodedFrame&) { return 0; }, true);
+    size_t failed = 0;
+    for (unsigned int threads = 1;; threads = std::min(threads * 2, options.numThreads))
+    {
+        failed += DecodeFrames(index, frames, threads, options.readAhead, [](const DecodedFrame&) { return 0; });
+        if (threads == options.numThreads)
+        {
+            break;
+        }
+    }
+    return failed > 0 ? -1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    PlayerOptions options;
+    if (ParseOptions(argc, argv, options) < 0)
+    {
+        PrintUsage();
+        return -1;
+    }
+    const bool exporting = options.command == "export" || options.command == "sets";
+    if (exporting && options.outputDirectory == "")
+    {
+        PrintUsage();
+        return -1;
+    }
+    if (exporting)
+    {
+        mkdir(options.outputDirectory.c_str(), 0755);
+    }
+
+    SessionIndex index;
+    const uint64_t openStart = GetMonotonicNs();
+    if (index.Open(options.directories) < 0)
+    {
+        cout << "Unable to list the session directories" << endl;
+        return -1;
+    }
+    const uint64_t openNs = GetMonotonicNs() - openStart;
+    if (index.GetCameras().empty())
+    {
+        cout << "No recorded frames found" << endl;
+        return -1;
+    }
+    WarnWallSeconds(index);
+
+    if (options.command == "index")
+    {
+        PrintSummary(index, openNs);
+        return 0;
+    }
+    if (options.command == "seek")
+    {
+        Seek(index, options);
+        return 0;
+    }
+    if (options.command == "export")
+    {
+        return ExportRange(index, options);
+    }
+    if (options.command == "sets")
+    {
+        return ExportSets(index, options);
+    }
+    if (options.command == "decode")
+    {
+        return MeasureDecode(index, options);
+    }
+    PrintUsage();
+    return -1;
+}
@@ -9,9 +9,36 @@
 
 #include <iostream>
 #include <sstream>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "Spinnaker.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
+#include "async_logger.h"
+#include "color_pipeline.h"
+#include "device_recovery.h"
+#include "frame_arena.h"
+#include "frame_lease.h"
+#include "frame_queue.h"
+#include "frame_timestamps.h"
+#include "jpeg_encoder.h"
+#include "load_shedder.h"
+#include "clock_sync.h"
+#include "mcap_writer.h"
+#include "metrics.h"
+#include "motion_gate.h"
+#include "packed_pixels.h"
+#include "pixel_pipeline.h"
+#include "storage_manager.h"
+#include "stream_diagnostics.h"
+#include "striping_writer.h"
+#include "task_scheduler.h"
+#include "time_utils.h"
 
 
 using namespace Spinnaker;
@@ -19,52 +46,1500 @@ using namespace Spinnaker::GenApi;
 using namespace Spinnaker::GenICam;
 using namespace std;
 
+// Use the following enum and global constant to select how images reach user
+// code. POLLING runs one grab thread per camera blocked in GetNextImage;
+// EVENT registers an image event handler per camera instead, so no thread is
+// tied to a camera. Either way, conversion and saving run as tasks on a
+// shared worker pool.
+enum acquisitionType
+{
+    POLLING,
+    EVENT
+};
+
+const acquisitionType chosenAcquisition = EVENT;
+
+// Use the following enum and global constant to select how converted frames
+// are stored. JPEG_FILES saves one .jpg file per frame; SEGMENTS appends the
+// Mono8 frames to preallocated per-camera segment files, which keeps the file
+// system out of the per-frame path; STRIPED spreads such segments over
+// several volumes to add up their bandwidth; MCAP streams the frames of all
+// cameras into one <time>-recording.mcap file as ROS 2 image messages.
+enum outputType
+{
+    JPEG_FILES,
+    SEGMENTS,
+    STRIPED,
+    MCAP
+};
+
+const outputType chosenOutput = JPEG_FILES;
+
+// Use the following enum and global constant to select the JPEG encoder of
+// JPEG_FILES output. SPINNAKER_SAVE encodes and writes with Image::Save on the
+// writer strand; LIBJPEG encodes on the conversion workers, each with its own
+// persistent compressor, and the writer strand only writes the bytes.
+enum jpegEncoderType
+{
+    SPINNAKER_SAVE,
+    LIBJPEG
+};
+
+const jpegEncoderType chosenJpegEncoder = LIBJPEG;
+// LIBJPEG settings; quality 75 matches the Image::Save default
+const int k_jpegQuality = 75;
+const jpegSubsampling k_jpegSubsampling = JPEG_SUBSAMPLING_420;
+const jpegDct k_jpegDct = JPEG_DCT_ACCURATE;
+
+// Use the following enum and global constant to select how LIBJPEG and
+// MCAP_IMAGE_JPEG encode BayerRG8 frames. MONO_RECORDING converts them to
+// Mono8 like every other format; COLOR_RECORDING demosaics them with k_demosaic,
+// applies the white balance gains and color correction matrix below and
+// encodes the result as YUV420 color JPEGs, whose Y plane also feeds the
+// motion gate. Crop, binning and the tone curve do not apply to color frames.
+enum colorType
+{
+    MONO_RECORDING,
+    COLOR_RECORDING
+};
+
+const colorType chosenColor = MONO_RECORDING;
+const demosaicMethod k_demosaic = DEMOSAIC_EDGE_AWARE;
+// Red, green and blue gains, then the row-major matrix from white-balanced
+// camera RGB to sRGB primaries; both leave the colors as the sensor saw them
+const double k_whiteBalance[3] = {1.0, 1.0, 1.0};
+const double k_colorMatrix[9] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+
+// Use the following enum and global constant to select frame gating. With
+// MOTION_GATING a frame is recorded only if the scene changed since the last
+// recorded frame, around such activity, or as a periodic keyframe (see
+// MotionGateConfig for the thresholds). Every frame's decision is written to
+// <time>-<serial>-gate.csv next to the recording.
+enum gatingType
+{
+    NO_GATING,
+    MOTION_GATING
+};
+
+const gatingType chosenGating = NO_GATING;
+
+// Use the following enum and global constant to select load shedding. With
+// ADAPTIVE_SHEDDING each camera's LoadShedder watches the frame queue and how
+// late frames reach storage. While output falls behind it lowers the JPEG
+// quality, then drops one frame in N, then records 2x2 binned frames and only
+// then drops every frame; it steps back down once the backlog has drained
+// (see LoadShedderConfig). Every change is logged.
+enum sheddingType
+{
+    NO_SHEDDING,
+    ADAPTIVE_SHEDDING
+};
+
+const sheddingType chosenShedding = ADAPTIVE_SHEDDING;
+
+// Use the following enum and global constant to select what happens when a
+// camera drops off the bus. With HOTPLUG_RECOVERY the camera is quarantined
+// while the others record on, searched for by serial number every
+// k_recoveryRescanMs, initialized again with the node values it was
+// configured with and resumed; after k_recoveryTimeoutMs it is given up.
+// POLLING detects the loss from failed grabs, EVENT from a camera that
+// delivers no image for k_grabTimeoutMs, and registers the camera's image
+// event handler again on the reacquired camera. Every outage and its recovery
+// time is written to <time>-<serial>-gaps.csv next to the recording.
+// NO_RECOVERY ends the camera's grab thread at its first grab failures, or
+// stops an EVENT camera at its first stall, as before.
+enum recoveryType
+{
+    NO_RECOVERY,
+    HOTPLUG_RECOVERY
+};
+
+const recoveryType chosenRecovery = HOTPLUG_RECOVERY;
+// Consecutive failed grabs after which a camera still listed counts as lost
+const unsigned int k_grabErrorsToQuarantine = 3;
+const unsigned int k_recoveryRescanMs = 100;
+const unsigned int k_recoveryTimeoutMs = 10000;
+// Nodes cached once a camera is configured and written back, in this order,
+// when it is initialized again after recovery
+const char* const k_cachedConfigNodes[] = {"AcquisitionMode", "PixelFormat", "Width", "Height", "OffsetX",
+                                           "OffsetY", "ExposureAuto", "ExposureTime", "GainAuto", "Gain",
+                                           "AcquisitionFrameRateEnable", "AcquisitionFrameRate"};
+
+// Pixel format the cameras transmit, as a GenICam PixelFormat entry name;
+// empty keeps each camera's current format. The packed formats Mono10p,
+// Mono12p, BayerRG12p, Mono12Packed and BayerRG12Packed keep the sensor's
+// bit depth at 1.25 or 1.5 bytes per pixel. SEGMENTS and STRIPED record them
+// as transmitted; the other outputs still record 8 bits.
+const char* const k_pixelFormat = "";
+// Crop, binning and tone curve of the frames the conversion workers encode
+// (LIBJPEG and MCAP_IMAGE_JPEG), fused with the conversion to Mono8 into one
+// pass picked per camera when acquisition starts; see PixelPipeline. A zero
+// crop size keeps the whole frame, k_binning is 1 or 2 and a gamma of 1.0
+// keeps the levels. Only Mono8, Mono16 and BayerRG8 frames are processed
+// this way; other formats are converted by Spinnaker as they are.
+const unsigned int k_cropX = 0;
+const unsigned int k_cropY = 0;
+const unsigned int k_cropWidth = 0;
+const unsigned int k_cropHeight = 0;
+const unsigned int k_binning = 1;
+const double k_toneGamma = 1.0;
+
+// Number of images saved from each camera
+const unsigned int k_numImages = 10;
+// Frames buffered per camera between the grab path and the workers
+const size_t k_frameQueueCapacity = 64;
+// Mono8 frames need no conversion and are written straight from the
+// acquisition buffer, which is held until the write is done. At most this
+// many buffers per camera are held that way, leaving the rest of the
+// driver's buffers for acquisition; past it frames are copied.
+const unsigned int k_maxLeasedBuffers = 4;
+// Frame buffers, conversion outputs, encoded bytes and the copy buffer of
+// the staging tier's flusher are carved from one arena of this much address
+// space. ARENA_PAGES_HUGE backs it with 2 MB pages, from the hugetlbfs pool
+// if vm.nr_hugepages reserves enough, else as transparent huge pages, else
+// regular pages; which it got is printed at startup. Frames past the arena
+// come from the heap and are counted.
+const size_t k_frameArenaBytes = 512ULL << 20;
+const arenaPages k_frameArenaPages = ARENA_PAGES_HUGE;
+// Worker threads shared by all cameras; 0 uses one per hardware thread
+const unsigned int k_numWorkers = 0;
+// Give up on a camera that delivers nothing for this long (ms)
+const unsigned int k_grabTimeoutMs = 1000;
+// Metrics are served as Prometheus text on 127.0.0.1:<port>/metrics (0 disables)
+const int k_metricsPort = 9105;
+// and written to this file every interval (empty disables)
+const char* const k_metricsSnapshotPath = "recorder_metrics.prom";
+const unsigned int k_metricsIntervalMs = 1000;
+// Each camera's timestamp counter is latched this often to map frame
+// timestamps onto the host clocks
+const unsigned int k_clockSyncIntervalMs = 1000;
+// Each camera's transport-layer stream statistics and link throughput are
+// read this often, off the grab path, and set against its incomplete frames
+// on the timeline <time>-stream.csv in the output directory
+const unsigned int k_streamDiagnosticsIntervalMs = 1000;
+// Output volume, segment bounds and what to do when free space runs low
+const char* const k_outputDirectory = ".";
+const uint64_t k_segmentMaxBytes = 1ULL << 30;
+const unsigned int k_segmentMaxSeconds = 60;
+const storagePolicy k_storagePolicy = STORAGE_DECIMATE;
+const uint64_t k_storageWarnFreeBytes = 20ULL << 30;
+const uint64_t k_storageReserveFreeBytes = 4ULL << 30;
+// SEGMENTS output can stage segments in RAM: they are written to this tmpfs
+// directory at memory speed and copied to k_outputDirectory in batches of
+// k_stagingFlushBatchBytes by a background flusher, which rides out the
+// latency spikes of the recording disks. Above the high-water mark writers
+// wait for the flusher and the load shedder takes over; a record that would
+// exceed the capacity is dropped. Every segment is flushed, synced and
+// checked when the session ends. Occupancy and flush throughput go to
+// <time>-staging.csv every second. Empty writes segments directly.
+const char* const k_stagingDirectory = "";
+const uint64_t k_stagingCapacityBytes = 2ULL << 30;
+const uint64_t k_stagingHighWaterBytes = 1536ULL << 20;
+const uint64_t k_stagingFlushBatchBytes = 64ULL << 20;
+// Volumes used by STRIPED output (the manifest goes to the first) and how
+// frames are spread over them
+const char* const k_stripeDirectories[] = {"/mnt/record0", "/mnt/record1"};
+const stripeMode k_stripeMode = STRIPE_WEIGHTED;
+// Bytes queued on a volume before it counts as backed up and is skipped
+const uint64_t k_stripeMaxQueuedBytes = 256ULL << 20;
+// MCAP output: message type of the camera channels and chunk compression.
+// MCAP_IMAGE_JPEG is encoded on the conversion workers like LIBJPEG; JPEG
+// payloads barely compress further, while MCAP_IMAGE_RAW suits zstd.
+const mcapImageType k_mcapImageType = MCAP_IMAGE_JPEG;
+const mcapCompression k_mcapCompression = MCAP_COMPRESSION_NONE;
+// Bytes queued for the MCAP file before frames are dropped
+const uint64_t k_mcapMaxQueuedBytes = 512ULL << 20;
+
+// This function builds the recovery configuration from the constants above.
+DeviceRecoveryConfig GetRecoveryConfig()
+{
+    DeviceRecoveryConfig config;
+    config.errorsToQuarantine = k_grabErrorsToQuarantine;
+    config.rescanIntervalMs = k_recoveryRescanMs;
+    config.reacquireTimeoutMs = k_recoveryTimeoutMs;
+    return config;
+}
+
+// This function returns the gap file of a camera, or an empty path if its
+// outages are not recovered.
+std::string GetGapFilePath(const std::string& serialNumber)
+{
+    if (chosenRecovery != HOTPLUG_RECOVERY)
+    {
+        return "";
+    }
+    ostringstream path;
+    path << k_outputDirectory << "/" << time(nullptr) << "-" << serialNumber << "-gaps.csv";
+    return path.str();
+}
+
+// This function builds the stream diagnostics configuration from the constants above.
+StreamDiagnosticsConfig GetStreamDiagnosticsConfig()
+{
+    StreamDiagnosticsConfig config;
+    config.intervalMs = k_streamDiagnosticsIntervalMs;
+    ostringstream path;
+    path << k_outputDirectory << "/" << time(nullptr) << "-stream.csv";
+    config.timelinePath = path.str();
+    return config;
+}
+
+// Rate-limited messages about one camera. Each camera limits each of them on
+// its own, so one camera's burst does not hide another camera's messages.
+enum cameraLog
+{
+    CAMERA_LOG_INCOMPLETE,
+    CAMERA_LOG_QUEUE_FULL,
+    CAMERA_LOG_ENCODE_FAILED,
+    CAMERA_LOG_WRITE_FAILED,
+    CAMERA_LOG_SEGMENT_FAILED,
+    CAMERA_LOG_VOLUMES_BACKED_UP,
+    CAMERA_LOG_MCAP_BACKED_UP,
+    CAMERA_LOG_REINIT_FAILED,
+    NUM_CAMERA_LOGS
+};
+
+// Per-camera state shared by the grab path and the workers
+struct CameraContext
+{
+    CameraPtr pCam;
+    std::string serialNumber;
+    FrameQueue queue;
+    LatencyStats latency;
+    // Writes run here in frame order; conversions run anywhere
+    OrderedStrand writer;
+    // Frames handed to the pool whose source image has not been released yet
+    std::atomic<unsigned int> framesInFlight;
+    // Acquisition buffers written in place, released when their write is done
+    FrameLeaseTracker leases;
+    // Counters read by the metrics reporter
+    std::shared_ptr<CameraMetrics> metrics;
+    // Admits frames under the storage policy
+    StorageManager& storage;
+    // Segment files of this camera, null unless output is SEGMENTS
+    SegmentWriter* segments;
+    // Shared striping writer and this camera's index in it, null unless output is STRIPED
+    StripingWriter* striping;
+    unsigned int stripeCamera;
+    // Shared MCAP writer and this camera's channel in it, null unless output is MCAP
+    McapWriter* mcap;
+    unsigned int mcapChannel;
+    // Fused crop, bin, convert and LUT kernel of this camera's pixel format
+    PixelPipeline pipeline;
+    // The same with 2x2 binning, used while the load shedder asks for binned frames
+    PixelPipeline binnedPipeline;
+    // Degrades the output of this camera while it falls behind
+    LoadShedder shedder;
+    // Decides which frames are recorded, null without MOTION_GATING
+    std::unique_ptr<MotionGate> gate;
+    // Maps device timestamps onto the host clocks; this camera's index in it
+    ClockSyncService& clockSync;
+    unsigned int clockIndex;
+    // Samples the transport-layer stream statistics; this camera's index in it
+    StreamDiagnostics& streamDiagnostics;
+    unsigned int streamIndex;
+    // Reacquires the camera after it dropped off the bus, with the node
+    // values to configure it with (k_cachedConfigNodes)
+    DeviceRecovery recovery;
+    std::vector<std::pair<std::string, std::string> > cachedConfig;
+    // Timestamps of the frames written as JPEG files, null for other outputs
+    std::unique_ptr<FrameTimestampLog> timestamps;
+    // Rate limits of this camera's messages, by cameraLog
+    LogRateLimiter logLimiters[NUM_CAMERA_LOGS];
+
+    CameraContext(CameraPtr cam, const std::string& serial, TaskScheduler& scheduler, MetricsRegistry& registry,
+                  StorageManager& storageManager, ClockSyncService& clockSyncService,
+                  StreamDiagnostics& diagnostics)
+        : pCam(cam), serialNumber(serial), queue(k_frameQueueCapacity), writer(scheduler), framesInFlight(0),
+          leases(k_maxLeasedBuffers, serial), metrics(registry.AddCamera(serial)), storage(storageManager),
+          segments(chosenOutput == SEGMENTS ? storageManager.OpenWriter(serial) : nullptr), striping(nullptr),
+          stripeCamera(0), mcap(nullptr), mcapChannel(0), shedder(LoadShedderConfig(), serial),
+          clockSync(clockSyncService), clockIndex(0), streamDiagnostics(diagnostics), streamIndex(0),
+          recovery(GetRecoveryConfig(), serial, GetGapFilePath(serial))
+    {
+        metrics->Set(metrics->queueCapacity, k_frameQueueCapacity);
+        if (chosenGating == MOTION_GATING)
+        {
+            ostringstream metadataPath;
+            metadataPath << k_outputDirectory << "/" << time(nullptr) << "-" << serial << "-gate.csv";
+            gate.reset(new MotionGate(MotionGateConfig(), metadataPath.str()));
+        }
+        if (chosenOutput == JPEG_FILES)
+        {
+            ostringstream timestampsPath;
+            timestampsPath << k_outputDirectory << "/" << time(nullptr) << "-" << serial << k_frameTimestampsSuffix;
+            timestamps.reset(new FrameTimestampLog(timestampsPath.str()));
+            if (!timestamps->IsOpen())
+            {
+                ASYNC_LOG(SEVERITY_WARNING, "[{}] Unable to create {}, frames keep only whole-second timestamps",
+                          serial, timestampsPath.str());
+            }
+        }
+    }
+};
+
 // This function prints the device information of the camera from the transport
 // layer; please see NodeMapInfo example for more in-depth comments on printing
 // device information from the nodemap.
 int PrintDeviceInfo(INodeMap& nodeMap, std::string camSerial)
 {
-    int result = 0;
-    cout << "[" << camSerial << "] Printing device information ..." << endl << endl;
-    FeatureList_t features;
-    CCategoryPtr category = nodeMap.GetNode("DeviceInformation");
-    if (IsAvailable(category) && IsReadable(category))
+    int result = 0;
+    cout << "[" << camSerial << "] Printing device information ..." << endl << endl;
+    FeatureList_t features;
+    CCategoryPtr category = nodeMap.GetNode("DeviceInformation");
+    if (IsAvailable(category) && IsReadable(category))
+    {
+        category->GetFeatures(features);
+        FeatureList_t::const_iterator it;
+        for (it = features.begin(); it != features.end(); ++it)
+        {
+            CNodePtr pfeatureNode = *it;
+            CValuePtr pValue = (CValuePtr)pfeatureNode;
+            cout << "[" << camSerial << "] " << pfeatureNode->GetName() << " : "
+                 << (IsReadable(pValue) ? pValue->ToString() : "Node not readable") << endl;
+        }
+    }
+    else
+    {
+        cout << "[" << camSerial << "] "
+             << "Device control information not available." << endl;
+    }
+    cout << endl;
+    return result;
+}
+
+// This function returns the device serial number, or an empty string if it
+// cannot be read.
+std::string GetSerialNumber(CameraPtr pCam)
+{
+    CStringPtr ptrStringSerial = pCam->GetTLDeviceNodeMap().GetNode("DeviceSerialNumber");
+    std::string serialNumber = "";
+    if (IsAvailable(ptrStringSerial) && IsReadable(ptrStringSerial))
+    {
+        serialNumber = ptrStringSerial->GetValue();
+    }
+    return serialNumber;
+}
+
+// This function sets the acquisition mode of an initialized camera to
+// continuous.
+int ConfigureAcquisitionMode(CameraPtr pCam, const std::string& serialNumber)
+{
+    CEnumerationPtr ptrAcquisitionMode = pCam->GetNodeMap().GetNode("AcquisitionMode");
+    if (!IsAvailable(ptrAcquisitionMode) || !IsWritable(ptrAcquisitionMode))
+    {
+        cout << "Unable to set acquisition mode to continuous (node retrieval; camera " << serialNumber
+             << "). Aborting..." << endl
+             << endl;
+
+        return -1;
+    }
+    CEnumEntryPtr ptrAcquisitionModeContinuous = ptrAcquisitionMode->GetEntryByName("Continuous");
+    if (!IsAvailable(ptrAcquisitionModeContinuous) || !IsReadable(ptrAcquisitionModeContinuous))
+    {
+        cout << "Unable to set acquisition mode to continuous (entry 'continuous' retrieval " << serialNumber
+             << "). Aborting..." << endl
+             << endl;
+
+        return -1;
+    }
+    int64_t acquisitionModeContinuous = ptrAcquisitionModeContinuous->GetValue();
+    ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
+    cout << "[" << serialNumber << "] "
+         << "Acquisition mode set to continuous..." << endl;
+    return 0;
+}
+
+// This function selects k_pixelFormat on the camera before acquisition starts.
+int ConfigurePixelFormat(CameraPtr pCam, const std::string& serialNumber)
+{
+    if (k_pixelFormat[0] == '\0')
+    {
+        return 0;
+    }
+    CEnumerationPtr ptrPixelFormat = pCam->GetNodeMap().GetNode("PixelFormat");
+    if (!IsAvailable(ptrPixelFormat) || !IsWritable(ptrPixelFormat))
+    {
+        cout << "Unable to set pixel format (node retrieval; camera " << serialNumber << "). Aborting..." << endl
+             << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrPixelFormatEntry = ptrPixelFormat->GetEntryByName(k_pixelFormat);
+    if (!IsAvailable(ptrPixelFormatEntry) || !IsReadable(ptrPixelFormatEntry))
+    {
+        cout << "Pixel format " << k_pixelFormat << " not supported by camera " << serialNumber << ". Aborting..."
+             << endl
+             << endl;
+        return -1;
+    }
+    ptrPixelFormat->SetIntValue(ptrPixelFormatEntry->GetValue());
+    cout << "[" << serialNumber << "] "
+         << "Pixel format set to " << k_pixelFormat << "..." << endl;
+    return 0;
+}
+
+// This function picks the camera's pixel pipeline for its current pixel
+// format, once per session. Formats the pipeline does not read keep the
+// Spinnaker conversion.
+void SelectPixelPipeline(CameraContext& context)
+{
+    CEnumerationPtr ptrPixelFormat = context.pCam->GetNodeMap().GetNode("PixelFormat");
+    if (!IsAvailable(ptrPixelFormat) || !IsReadable(ptrPixelFormat))
+    {
+        return;
+    }
+    const std::string format = ptrPixelFormat->GetCurrentEntry()->GetSymbolic().c_str();
+    int input = 0;
+    while (input < NUM_PIPELINE_FORMATS && format != GetPipelineFormatName((pipelineFormat)input))
+    {
+        input++;
+    }
+    PipelineConfig config;
+    config.cropX = k_cropX;
+    config.cropY = k_cropY;
+    config.cropWidth = k_cropWidth;
+    config.cropHeight = k_cropHeight;
+    config.bin = k_binning;
+    config.SetGamma(k_toneGamma);
+    if (input == NUM_PIPELINE_FORMATS || context.pipeline.Select((pipelineFormat)input, config) < 0)
+    {
+        cout << "[" << context.serialNumber << "] "
+             << "No pixel pipeline for " << format << " frames, converting with Spinnaker..." << endl;
+        return;
+    }
+    cout << "[" << context.serialNumber << "] "
+         << "Pixel pipeline " << context.pipeline.Describe() << "..." << endl;
+    if (chosenShedding == ADAPTIVE_SHEDDING && config.bin == 1)
+    {
+        config.bin = 2;
+        context.binnedPipeline.Select((pipelineFormat)input, config);
+    }
+}
+
+// This function returns the pixel pipeline for the camera's next frame: the
+// binned one while the load shedder asks for binned frames.
+const PixelPipeline& GetActivePipeline(const CameraContext& context)
+{
+    if (context.shedder.UseBinning() && context.binnedPipeline.IsSelected())
+    {
+        return context.binnedPipeline;
+    }
+    return context.pipeline;
+}
+
+// This function runs one of the camera's pixel pipelines on a frame into the
+// calling worker's buffer, which stays valid until the worker's next call.
+// Returns null if the frame is not in the format the pipeline was picked for.
+const PipelineOutput* RunPixelPipeline(const PixelPipeline& pipeline, ImagePtr image)
+{
+    static thread_local PipelineOutput output;
+    if (!pipeline.IsSelected() || image->GetPixelFormatName() != GetPipelineFormatName(pipeline.GetInput()))
+    {
+        return nullptr;
+    }
+    if (pipeline.Process((const uint8_t*)image->GetData(), (unsigned int)image->GetWidth(),
+                         (unsigned int)image->GetHeight(), image->GetStride(), output) < 0)
+    {
+        return nullptr;
+    }
+    return &output;
+}
+
+// This function returns the color pipeline of COLOR_RECORDING, configured
+// once in main.
+ColorPipeline& GetColorPipeline()
+{
+    static ColorPipeline pipeline;
+    return pipeline;
+}
+
+// This function demosaics a BayerRG8 frame into the calling worker's buffer,
+// which stays valid until the worker's next call. The frame is converted by
+// this worker alone: the other workers are busy with the other frames.
+// Returns null if the frame is not BayerRG8.
+const ColorFrame* RunColorPipeline(ImagePtr image)
+{
+    static thread_local ColorFrame output;
+    if (image->GetPixelFormat() != PixelFormat_BayerRG8 ||
+        GetColorPipeline().Process((const uint8_t*)image->GetData(), image->GetStride(),
+                                   (unsigned int)image->GetWidth(), (unsigned int)image->GetHeight(), output) < 0)
+    {
+        return nullptr;
+    }
+    return &output;
+}
+
+// This function returns how a pixel format is packed, or PACKING_NONE if
+// its samples are whole bytes.
+pixelPacking GetPixelPacking(PixelFormatEnums format)
+{
+    switch (format)
+    {
+    case PixelFormat_Mono10p:
+        return PACKING_10P;
+    case PixelFormat_Mono12p:
+    case PixelFormat_BayerRG12p:
+        return PACKING_12P;
+    case PixelFormat_Mono12Packed:
+    case PixelFormat_BayerRG12Packed:
+        return PACKING_12PACKED;
+    default:
+        return PACKING_NONE;
+    }
+}
+
+// This function unpacks the 8 most significant bits of every sample of a
+// packed image into the calling worker's buffer, which stays valid until
+// the worker's next call. Returns null if the payload is shorter than the
+// image.
+const uint8_t* UnpackMono8View(ImagePtr image, pixelPacking packing)
+{
+    static thread_local ArenaBytes view;
+    const size_t count = image->GetWidth() * image->GetHeight();
+    if (count == 0 || GetPackedSize(packing, count) > image->GetImageSize())
+    {
+        return nullptr;
+    }
+    view.resize(count);
+    UnpackPixels8(packing, (const uint8_t*)image->GetData(), count, &view[0]);
+    return &view[0];
+}
+
+// This function latches the camera's timestamp counter between two readings of
+// the host clock, for the clock sync service. Returns -1 if the camera has no
+// timestamp latch.
+int LatchCameraClock(CameraPtr pCam, ClockSample& sample)
+{
+    try
+    {
+        INodeMap& nodeMap = pCam->GetNodeMap();
+        CCommandPtr ptrTimestampLatch = nodeMap.GetNode("TimestampLatch");
+        CIntegerPtr ptrTimestampLatchValue = nodeMap.GetNode("TimestampLatchValue");
+        if (!IsAvailable(ptrTimestampLatch) || !IsWritable(ptrTimestampLatch) ||
+            !IsAvailable(ptrTimestampLatchValue) || !IsReadable(ptrTimestampLatchValue))
+        {
+            return -1;
+        }
+        const uint64_t realtime = GetRealtimeNs();
+        sample.hostBefore = GetMonotonicNs();
+        ptrTimestampLatch->Execute();
+        sample.hostAfter = GetMonotonicNs();
+        sample.realtimeOffset = (int64_t)(realtime - sample.hostBefore);
+        sample.deviceTimestamp = (uint64_t)ptrTimestampLatchValue->GetValue();
+        return 0;
+    }
+    catch (Spinnaker::Exception&)
+    {
+        return -1;
+    }
+}
+
+// This function registers a camera with the clock sync service. Its clock is
+// latched from when it is activated after Init() until it is suspended.
+void AddCameraClock(ClockSyncService& clockSync, CameraContext& context)
+{
+    // The camera is read at each latch: recovery replaces it while the
+    // clock is suspended
+    CameraContext* pContext = &context;
+    context.clockIndex = clockSync.AddClock(context.serialNumber, [pContext](ClockSample& sample) {
+        return LatchCameraClock(pContext->pCam, sample);
+    });
+}
+
+// Transport-layer stream nodes of each counter. GigE Vision and USB3 Vision
+// transport layers name some of them differently; the first one found is read.
+const char* const k_streamCounterNodes[NUM_STREAM_COUNTERS][2] = {
+    {"StreamLostPacketCount", "StreamMissedPacketCount"},
+    {"StreamPacketResendRequestCount", "StreamPacketResendRequestedPacketCount"},
+    {"StreamPacketResendReceivedPacketCount", "StreamPacketsResendReceivedCount"},
+    {"StreamBufferUnderrunCount", "StreamInputBufferUnderrunCount"},
+    {"StreamDroppedFrameCount", "StreamLostFrameCount"},
+};
+
+// This function reads a throughput node of the device nodemap, which is an
+// integer on some cameras and a float on others. Returns -1 if it is missing.
+double ReadLinkThroughput(INodeMap& nodeMap, const char* name)
+{
+    CIntegerPtr ptrInteger = nodeMap.GetNode(name);
+    if (IsAvailable(ptrInteger) && IsReadable(ptrInteger))
+    {
+        return (double)ptrInteger->GetValue();
+    }
+    CFloatPtr ptrFloat = nodeMap.GetNode(name);
+    if (IsAvailable(ptrFloat) && IsReadable(ptrFloat))
+    {
+        return ptrFloat->GetValue();
+    }
+    return -1.0;
+}
+
+// This function reads the stream statistics of the camera's transport layer
+// and the throughput of its link, for the stream diagnostics. Counters the
+// transport layer does not provide are left missing. Returns -1 if the
+// camera cannot be read.
+int ReadStreamCounters(CameraPtr pCam, StreamSample& sample)
+{
+    try
+    {
+        INodeMap& streamNodeMap = pCam->GetTLStreamNodeMap();
+        for (int i = 0; i < NUM_STREAM_COUNTERS; i++)
+        {
+            for (int n = 0; n < 2; n++)
+            {
+                CIntegerPtr ptrCounter = streamNodeMap.GetNode(k_streamCounterNodes[i][n]);
+                if (IsAvailable(ptrCounter) && IsReadable(ptrCounter))
+                {
+                    sample.counters[i] = ptrCounter->GetValue();
+                    break;
+                }
+            }
+        }
+        INodeMap& nodeMap = pCam->GetNodeMap();
+        sample.linkThroughput = ReadLinkThroughput(nodeMap, "DeviceLinkCurrentThroughput");
+        sample.linkThroughputLimit = ReadLinkThroughput(nodeMap, "DeviceLinkThroughputLimit");
+        return 0;
+    }
+    catch (Spinnaker::Exception&)
+    {
+        return -1;
+    }
+}
+
+// This function registers a camera with the stream diagnostics. Its stream
+// is read from when it is activated after Init() until it is suspended.
+void AddCameraStream(StreamDiagnostics& streamDiagnostics, CameraContext& context)
+{
+    // The camera is read at each sample: recovery replaces it while the
+    // stream is suspended
+    CameraContext* pContext = &context;
+    context.streamIndex = streamDiagnostics.AddCamera(context.serialNumber, [pContext](StreamSample& sample) {
+        return ReadStreamCounters(pContext->pCam, sample);
+    });
+}
+
+// This function builds the storage configuration from the constants above.
+StorageConfig GetStorageConfig()
+{
+    StorageConfig config;
+    config.directory = k_outputDirectory;
+    config.segmentMaxBytes = k_segmentMaxBytes;
+    config.segmentMaxSeconds = k_segmentMaxSeconds;
+    config.policy = k_storagePolicy;
+    config.warnFreeBytes = k_storageWarnFreeBytes;
+    config.reserveFreeBytes = k_storageReserveFreeBytes;
+    if (chosenOutput == SEGMENTS)
+    {
+        config.staging.directory = k_stagingDirectory;
+        config.staging.capacityBytes = k_stagingCapacityBytes;
+        config.staging.highWaterBytes = k_stagingHighWaterBytes;
+        config.staging.flushBatchBytes = k_stagingFlushBatchBytes;
+    }
+    return config;
+}
+
+// This function creates the striping writer for STRIPED output and registers
+// every camera with it. Returns -1 if the manifest cannot be created.
+int StartStripingWriter(std::unique_ptr<StripingWriter>& striping,
+                        std::vector<std::unique_ptr<CameraContext> >& contexts, MetricsRegistry& metricsRegistry)
+{
+    std::vector<std::string> directories(
+        k_stripeDirectories, k_stripeDirectories + sizeof(k_stripeDirectories) / sizeof(k_stripeDirectories[0]));
+    striping.reset(new StripingWriter(directories, k_stripeMode, GetStorageConfig(), k_stripeMaxQueuedBytes));
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        contexts[i]->striping = striping.get();
+        contexts[i]->stripeCamera = striping->AddCamera(contexts[i]->serialNumber);
+    }
+    if (striping->Start() < 0)
+    {
+        cout << "Unable to create the stripe manifest in " << directories[0] << ". Aborting..." << endl;
+        return -1;
+    }
+    StripingWriter* writer = striping.get();
+    metricsRegistry.AddCollector([writer](std::string& out) { writer->Collect(out); });
+    return 0;
+}
+
+// This function creates the MCAP writer for MCAP output with one channel per
+// camera. Returns -1 if the file cannot be created.
+int StartMcapWriter(std::unique_ptr<McapWriter>& mcap, std::vector<std::unique_ptr<CameraContext> >& contexts,
+                    MetricsRegistry& metricsRegistry)
+{
+    McapConfig config;
+    config.compression = k_mcapCompression;
+    config.maxQueuedBytes = k_mcapMaxQueuedBytes;
+    ostringstream path;
+    path << k_outputDirectory << "/" << time(nullptr) << "-recording.mcap";
+    mcap.reset(new McapWriter(path.str(), config));
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        contexts[i]->mcap = mcap.get();
+        contexts[i]->mcapChannel = mcap->AddChannel(contexts[i]->serialNumber, k_mcapImageType);
+    }
+    if (mcap->Start() < 0)
+    {
+        cout << "Unable to create " << path.str() << ". Aborting..." << endl;
+        return -1;
+    }
+    McapWriter* writer = mcap.get();
+    metricsRegistry.AddCollector([writer](std::string& out) { writer->Collect(out); });
+    return 0;
+}
+
+// This function queues one frame on the MCAP writer: Mono8 pixels or JPEG
+// bytes, as k_mcapImageType says. The message is built and written on the
+// writer's I/O thread; keepAlive holds the payload until then.
+void WriteMcapMessage(CameraContext& context, uint64_t frameIndex, uint64_t hostTimestamp,
+                      const SyncedTimestamp& synced, unsigned int width, unsigned int height, const void* payload,
+                      uint32_t payloadSize, std::shared_ptr<const void> keepAlive)
+{
+    McapFrame frame;
+    frame.channel = context.mcapChannel;
+    frame.sequence = (uint32_t)frameIndex;
+    // Log time is when the host received the frame, stamps are the device's
+    frame.logTime = hostTimestamp + (GetRealtimeNs() - GetMonotonicNs());
+    frame.publishTime = synced.valid ? synced.realtime : frame.logTime;
+    frame.width = width;
+    frame.height = height;
+    frame.payload = payload;
+    frame.payloadSize = payloadSize;
+    frame.keepAlive = keepAlive;
+    CameraContext* pContext = &context;
+    frame.done = [pContext, payloadSize](bool written, uint64_t serializeNs) {
+        if (written)
+        {
+            pContext->metrics->stageDurations[STAGE_WRITE].Observe(serializeNs);
+            pContext->metrics->Increment(pContext->metrics->bytesWritten, payloadSize);
+            pContext->metrics->Increment(pContext->metrics->framesWritten);
+            pContext->storage.AddBytesWritten(payloadSize);
+        }
+    };
+    if (!context.mcap->Submit(frame))
+    {
+        context.metrics->Increment(context.metrics->framesDropped);
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_MCAP_BACKED_UP], SEVERITY_WARNING, 1000,
+                                  "[{}] MCAP writer backed up, image {} dropped", context.serialNumber, frameIndex);
+    }
+}
+
+// This function fills in the record header of a converted frame.
+void FillRecordHeader(SegmentRecordHeader& header, uint64_t frameIndex, time_t wallTime, uint64_t deviceTimestamp,
+                      uint64_t hostTimestamp, const SyncedTimestamp& synced, ImagePtr convertedImage)
+{
+    memset(&header, 0, sizeof(header));
+    header.frameIndex = frameIndex;
+    header.deviceTimestamp = deviceTimestamp;
+    header.hostTimestamp = hostTimestamp;
+    header.wallTime = (int64_t)wallTime;
+    header.width = (uint32_t)convertedImage->GetWidth();
+    header.height = (uint32_t)convertedImage->GetHeight();
+    header.pixelFormat = (uint32_t)convertedImage->GetPixelFormat();
+    const pixelPacking packing = GetPixelPacking(convertedImage->GetPixelFormat());
+    header.packing = (uint32_t)packing;
+    header.bitDepth = GetPackingBitDepth(packing);
+    if (synced.valid)
+    {
+        header.syncedTimestamp = synced.monotonic;
+        header.syncedRealtime = synced.realtime;
+        header.syncErrorNs = synced.errorNs;
+    }
+}
+
+// This function queues one converted frame on the striping writer. The write
+// itself happens on the chosen volume's I/O thread.
+void WriteStripedRecord(CameraContext& context, uint64_t frameIndex, time_t wallTime, uint64_t deviceTimestamp,
+                        uint64_t hostTimestamp, const SyncedTimestamp& synced, ImagePtr convertedImage,
+                        const FrameLeasePtr& lease)
+{
+    StripeJob job;
+    job.camera = context.stripeCamera;
+    FillRecordHeader(job.header, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, convertedImage);
+    job.payload = convertedImage->GetData();
+    job.payloadSize = (uint32_t)convertedImage->GetImageSize();
+    // The converted image, or the leased buffer, lives until the volume has written it
+    job.keepAlive = std::shared_ptr<const void>(job.payload, [convertedImage, lease](const void*) {});
+    CameraContext* pContext = &context;
+    const uint64_t recordSize = sizeof(SegmentRecordHeader) + job.payloadSize;
+    job.done = [pContext, recordSize](bool written, uint64_t writeNs) {
+        if (written)
+        {
+            pContext->metrics->stageDurations[STAGE_WRITE].Observe(writeNs);
+            pContext->metrics->Increment(pContext->metrics->bytesWritten, recordSize);
+            pContext->metrics->Increment(pContext->metrics->framesWritten);
+        }
+    };
+    if (!context.striping->Submit(job))
+    {
+        context.metrics->Increment(context.metrics->framesDropped);
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_VOLUMES_BACKED_UP], SEVERITY_WARNING, 1000,
+                                  "[{}] All volumes backed up, image {} dropped", context.serialNumber, frameIndex);
+    }
+}
+
+// This function appends one converted frame to the camera's current segment.
+void WriteSegmentRecord(CameraContext& context, uint64_t frameIndex, time_t wallTime, uint64_t deviceTimestamp,
+                        uint64_t hostTimestamp, const SyncedTimestamp& synced, ImagePtr convertedImage)
+{
+    SegmentRecordHeader header;
+    FillRecordHeader(header, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, convertedImage);
+    const uint32_t payloadSize = (uint32_t)convertedImage->GetImageSize();
+    const uint64_t writeStart = GetMonotonicNs();
+    if (!context.segments->Append(header, convertedImage->GetData(), payloadSize))
+    {
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_SEGMENT_FAILED], SEVERITY_ERROR, 1000,
+                                  "[{}] Unable to write image {} to segment: {}", context.serialNumber, frameIndex,
+                                  strerror(errno));
+        return;
+    }
+    context.metrics->stageDurations[STAGE_WRITE].Observe(GetMonotonicNs() - writeStart);
+    context.metrics->Increment(context.metrics->bytesWritten, sizeof(header) + payloadSize);
+    context.metrics->Increment(context.metrics->framesWritten);
+}
+
+// This function returns the filename of a JPEG_FILES frame.
+std::string GetFrameFilename(const std::string& serialNumber, time_t wallTime, uint64_t frameIndex)
+{
+    // Create a unique filename
+    ostringstream filename;
+    filename << k_outputDirectory << "/" << wallTime;
+    filename << "-";
+    if (serialNumber != "")
+    {
+        filename << serialNumber.c_str();
+    }
+    filename << "-" << frameIndex << ".jpg";
+    return filename.str();
+}
+
+// This function returns the pool of encoded JPEG buffers shared by all cameras.
+JpegBufferPool& GetJpegBufferPool()
+{
+    static JpegBufferPool pool;
+    return pool;
+}
+
+// This function encodes Mono8 pixels, or the given input, with the calling
+// worker's compressor. Returns null on error.
+std::shared_ptr<JpegBuffer> EncodeJpeg(CameraContext& context, const uint8_t* pixels, unsigned int width,
+                                       unsigned int height, size_t stride, jpegInput input = JPEG_INPUT_GRAY)
+{
+    JpegOptions options;
+    options.quality = context.shedder.GetJpegQuality(k_jpegQuality);
+    options.subsampling = k_jpegSubsampling;
+    options.dct = k_jpegDct;
+    std::shared_ptr<JpegBuffer> buffer = GetJpegBufferPool().Acquire();
+    JpegEncoder& encoder = JpegEncoder::ForCurrentThread();
+    const uint64_t encodeStart = GetMonotonicNs();
+    if (encoder.Encode(pixels, width, height, stride, input, options, *buffer) < 0)
+    {
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_ENCODE_FAILED], SEVERITY_ERROR, 1000,
+                                  "[{}] JPEG encoding failed: {}", context.serialNumber, encoder.GetLastError());
+        return std::shared_ptr<JpegBuffer>();
+    }
+    context.metrics->stageDurations[STAGE_ENCODE].Observe(GetMonotonicNs() - encodeStart);
+    return buffer;
+}
+
+// This function writes one frame encoded by EncodeJpeg. It runs on the
+// camera's writer strand, so files of one camera are written in frame order.
+void WriteEncodedFrame(CameraContext& context, uint64_t frameIndex, time_t wallTime, uint64_t deviceTimestamp,
+                       uint64_t hostTimestamp, const SyncedTimestamp& synced, unsigned int width, unsigned int height,
+                       std::shared_ptr<JpegBuffer> encoded)
+{
+    const std::string filename = GetFrameFilename(context.serialNumber, wallTime, frameIndex);
+    const uint64_t writeStart = GetMonotonicNs();
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr || fwrite(encoded->Data(), 1, encoded->Size(), file) != encoded->Size())
+    {
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_WRITE_FAILED], SEVERITY_ERROR, 1000,
+                                  "[{}] Unable to write {}: {}", context.serialNumber, filename, strerror(errno));
+        if (file != nullptr)
+        {
+            fclose(file);
+        }
+        return;
+    }
+    fclose(file);
+    context.timestamps->Append(frameIndex, deviceTimestamp, hostTimestamp, synced);
+    context.metrics->stageDurations[STAGE_WRITE].Observe(GetMonotonicNs() - writeStart);
+    context.metrics->Increment(context.metrics->bytesWritten, encoded->Size());
+    context.metrics->Increment(context.metrics->framesWritten);
+    context.storage.AddBytesWritten(encoded->Size());
+    // Print image information
+    ASYNC_LOG(SEVERITY_INFO, "[{}] Grabbed image {}, width = {}, height = {}. Image saved at {}",
+              context.serialNumber, frameIndex, width, height, filename);
+}
+
+// This function saves one converted frame. It runs on the camera's writer
+// strand, so frames of one camera are written in frame order.
+void WriteFrame(CameraContext& context, uint64_t frameIndex, time_t wallTime, uint64_t deviceTimestamp,
+                uint64_t hostTimestamp, const SyncedTimestamp& synced, ImagePtr convertedImage,
+                const FrameLeasePtr& lease)
+{
+    const std::string& serialNumber = context.serialNumber;
+    if (lease && !lease->Check("Writer"))
+    {
+        return;
+    }
+    try
+    {
+        if (context.segments != nullptr)
+        {
+            WriteSegmentRecord(context, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, convertedImage);
+            ASYNC_LOG(SEVERITY_INFO, "[{}] Grabbed image {}, width = {}, height = {}. Image appended to segment",
+                      serialNumber, frameIndex, convertedImage->GetWidth(), convertedImage->GetHeight());
+            return;
+        }
+        if (context.striping != nullptr)
+        {
+            WriteStripedRecord(context, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, convertedImage,
+                               lease);
+            return;
+        }
+        if (context.mcap != nullptr)
+        {
+            // The converted image, or the leased buffer, lives until the writer has copied it
+            const void* pixels = convertedImage->GetData();
+            WriteMcapMessage(context, frameIndex, hostTimestamp, synced, (unsigned int)convertedImage->GetWidth(),
+                             (unsigned int)convertedImage->GetHeight(), pixels,
+                             (uint32_t)convertedImage->GetImageSize(),
+                             std::shared_ptr<const void>(pixels, [convertedImage, lease](const void*) {}));
+            return;
+        }
+        const std::string filename = GetFrameFilename(serialNumber, wallTime, frameIndex);
+        // Save image. Image::Save encodes and writes in one call, so its
+        // time is counted as the write stage.
+        const uint64_t saveStart = GetMonotonicNs();
+        convertedImage->Save(filename.c_str());
+        context.timestamps->Append(frameIndex, deviceTimestamp, hostTimestamp, synced);
+        context.metrics->stageDurations[STAGE_WRITE].Observe(GetMonotonicNs() - saveStart);
+        struct stat fileStat;
+        if (stat(filename.c_str(), &fileStat) == 0)
+        {
+            context.metrics->Increment(context.metrics->bytesWritten, (uint64_t)fileStat.st_size);
+            context.storage.AddBytesWritten((uint64_t)fileStat.st_size);
+        }
+        context.metrics->Increment(context.metrics->framesWritten);
+        // Print image information
+        ASYNC_LOG(SEVERITY_INFO, "[{}] Grabbed image {}, width = {}, height = {}. Image saved at {}", serialNumber,
+                  frameIndex, convertedImage->GetWidth(), convertedImage->GetHeight(), filename);
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        ASYNC_LOG(SEVERITY_ERROR, "[{}] Error: {}", serialNumber, e.what());
+    }
+}
+
+// This function computes the motion gate's grid of Mono8 pixels, or returns
+// null if the camera is not gated.
+std::shared_ptr<MotionGrid> ComputeMotionGrid(CameraContext& context, const uint8_t* pixels, unsigned int width,
+                                              unsigned int height, size_t stride)
+{
+    std::shared_ptr<MotionGrid> grid;
+    if (context.gate)
+    {
+        grid.reset(new MotionGrid());
+        grid->Compute(pixels, width, height, stride, MotionGateConfig());
+    }
+    return grid;
+}
+
+// This function ends motion gating of every camera once all frames are
+// through the writer strands, and prints how many frames were recorded.
+void FinishMotionGates(std::vector<std::unique_ptr<CameraContext> >& contexts)
+{
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        CameraContext& context = *contexts[i];
+        if (context.gate)
+        {
+            context.gate->Finish();
+            context.metrics->Set(context.metrics->framesSkipped, context.gate->GetSkippedCount());
+            cout << "[" << context.serialNumber << "] Motion gate recorded " << context.gate->GetRecordedCount()
+                 << " frames, skipped " << context.gate->GetSkippedCount() << endl;
+        }
+    }
+}
+
+// This function prints the load shedding level changes of every camera with
+// the time of each change.
+void PrintSheddingSummary(std::vector<std::unique_ptr<CameraContext> >& contexts)
+{
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        CameraContext& context = *contexts[i];
+        const std::vector<SheddingTransition> transitions = context.shedder.GetTransitions();
+        if (transitions.empty())
+        {
+            continue;
+        }
+        cout << "[" << context.serialNumber << "] Load shedding dropped " << context.shedder.GetShedCount()
+             << " frames over " << transitions.size() << " level changes:" << endl;
+        for (size_t t = 0; t < transitions.size(); t++)
+        {
+            const SheddingTransition& transition = transitions[t];
+            const time_t seconds = (time_t)(transition.realtimeNs / 1000000000ULL);
+            struct tm local;
+            localtime_r(&seconds, &local);
+            char line[160];
+            snprintf(line, sizeof(line), "    %02d:%02d:%02d.%03u %s -> %s (queue %d%%, latency %llu ms)",
+                     local.tm_hour, local.tm_min, local.tm_sec,
+                     (unsigned int)((transition.realtimeNs % 1000000000ULL) / 1000000),
+                     GetSheddingLevelName(transition.from), GetSheddingLevelName(transition.to),
+                     (int)(transition.occupancy * 100.0), (unsigned long long)(transition.latencyNs / 1000000));
+            cout << line << endl;
+        }
+    }
+}
+
+// This function is the conversion task. Each queued frame gets one such task
+// on the shared scheduler; it converts the oldest frame of the camera and
+// posts the write to the camera's writer strand.
+void ProcessNextFrame(CameraContext* context)
+{
+    GrabbedFrame frame;
+    if (!context->queue.TryPop(frame))
+    {
+        return;
+    }
+    context->latency.AddDispatch(GetMonotonicNs() - frame.hostTimestamp);
+    context->metrics->Set(context->metrics->queueDepth, context->queue.Size());
+
+    const std::string& serialNumber = context->serialNumber;
+    ImagePtr convertedImage;
+    // Holds the grabbed buffer while a Mono8 frame is written in place
+    FrameLeasePtr lease;
+    bool converted = false;
+    std::shared_ptr<JpegBuffer> encoded;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    // Change metric input of the motion gate, computed here in parallel
+    std::shared_ptr<MotionGrid> grid;
+    try
+    {
+        // An incomplete EVENT frame has no image, only the state recorded at handoff
+        const PixelFormatEnums pixelFormat = frame.incomplete ? UNKNOWN_PIXELFORMAT : frame.image->GetPixelFormat();
+        const pixelPacking packing = GetPixelPacking(pixelFormat);
+        if (frame.incomplete)
+        {
+            context->metrics->Increment(context->metrics->framesIncomplete);
+            context->streamDiagnostics.OnIncompleteFrame(context->streamIndex, frame.hostTimestamp);
+            ASYNC_LOG_RATE_LIMITED_BY(context->logLimiters[CAMERA_LOG_INCOMPLETE], SEVERITY_WARNING, 1000,
+                                      "[{}] Image {} incomplete with image status {}...", serialNumber, frame.frameId,
+                                      frame.imageStatus);
+        }
+        else if (packing != PACKING_NONE && (chosenOutput == SEGMENTS || chosenOutput == STRIPED))
+        {
+            // Packed frames are recorded as transmitted, keeping the sensor's
+            // bit depth; copying them costs less than a conversion
+            const uint64_t convertStart = GetMonotonicNs();
+            convertedImage = Image::Create(frame.image);
+            context->metrics->stageDurations[STAGE_CONVERT].Observe(GetMonotonicNs() - convertStart);
+            if (context->gate)
+            {
+                const uint8_t* view = UnpackMono8View(frame.image, packing);
+                if (view != nullptr)
+                {
+                    grid = ComputeMotionGrid(*context, view, (unsigned int)frame.image->GetWidth(),
+                                             (unsigned int)frame.image->GetHeight(), frame.image->GetWidth());
+                }
+            }
+            converted = true;
+        }
+        else if ((chosenOutput == JPEG_FILES && chosenJpegEncoder == LIBJPEG) ||
+                 (chosenOutput == MCAP && k_mcapImageType == MCAP_IMAGE_JPEG))
+        {
+            // Mono8 frames without pipeline operations are encoded straight
+            // from the grabbed buffer, packed mono frames from the 8 most
+            // significant bits of each sample
+            ImagePtr source = frame.image;
+            width = (unsigned int)source->GetWidth();
+            height = (unsigned int)source->GetHeight();
+            const uint8_t* pixels = nullptr;
+            size_t stride = width;
+            jpegInput input = JPEG_INPUT_GRAY;
+            const uint64_t convertStart = GetMonotonicNs();
+            const ColorFrame* color = chosenColor == COLOR_RECORDING ? RunColorPipeline(source) : nullptr;
+            if (color != nullptr)
+            {
+                // The Y plane comes first, so the motion gate reads it as Mono8
+                pixels = &color->data[0];
+                stride = color->stride;
+                input = JPEG_INPUT_YUV420;
+            }
+            else if (packing != PACKING_NONE && pixelFormat != PixelFormat_BayerRG12p &&
+                pixelFormat != PixelFormat_BayerRG12Packed)
+            {
+                pixels = UnpackMono8View(source, packing);
+            }
+            else if (!GetActivePipeline(*context).IsIdentity())
+            {
+                const PipelineOutput* output = RunPixelPipeline(GetActivePipeline(*context), source);
+                if (output != nullptr)
+                {
+                    pixels = &output->data[0];
+                    width = output->width;
+                    height = output->height;
+                    stride = output->stride;
+                }
+            }
+            if (pixels == nullptr)
+            {
+                if (pixelFormat != PixelFormat_Mono8)
+                {
+                    source = frame.image->Convert(PixelFormat_Mono8, HQ_LINEAR);
+                }
+                pixels = (const uint8_t*)source->GetData();
+                stride = source->GetStride();
+            }
+            if (pixels != (const uint8_t*)frame.image->GetData())
+            {
+                context->metrics->stageDurations[STAGE_CONVERT].Observe(GetMonotonicNs() - convertStart);
+            }
+            grid = ComputeMotionGrid(*context, pixels, width, height, stride);
+            encoded = EncodeJpeg(*context, pixels, width, height, stride, input);
+        }
+        else
+        {
+            // Convert image to mono 8, binned in the same pass while shedding load
+            const uint64_t convertStart = GetMonotonicNs();
+            const PipelineOutput* binned = nullptr;
+            if (context->shedder.UseBinning())
+            {
+                binned = RunPixelPipeline(context->binnedPipeline, frame.image);
+            }
+            if (binned != nullptr)
+            {
+                // The outer copy owns its pixels; the worker's buffer is reused
+                convertedImage = Image::Create(Image::Create(binned->width, binned->height, 0, 0, PixelFormat_Mono8,
+                                                             (void*)&binned->data[0]));
+            }
+            else if (pixelFormat == PixelFormat_Mono8)
+            {
+                // Nothing to convert. An EVENT frame is already the handler's
+                // own copy, whose arena block the writer holds through an
+                // untracked lease; a grabbed buffer is leased to the writer,
+                // or copied if this camera holds too many buffers already.
+                convertedImage = frame.image;
+                if (frame.storage)
+                {
+                    std::shared_ptr<uint8_t> storage = frame.storage;
+                    lease.reset(new FrameLease(nullptr, [storage]() {}));
+                }
+                else if (frame.fromCamera)
+                {
+                    ImagePtr image = frame.image;
+                    lease = context->leases.Acquire([context, image]() {
+                        image->Release();
+                        context->metrics->Set(context->metrics->leasedBuffers, context->leases.GetOutstanding() - 1);
+                        context->framesInFlight--;
+                    });
+                    if (lease)
+                    {
+                        context->metrics->Set(context->metrics->leasedBuffers, context->leases.GetOutstanding());
+                    }
+                    else
+                    {
+                        convertedImage = Image::Create(frame.image);
+                    }
+                }
+                // Only a leased POLLING buffer is written without a copy; the
+                // EVENT handler has already copied its frame
+                if (frame.fromCamera && lease)
+                {
+                    context->metrics->Increment(context->metrics->framesZeroCopy);
+                }
+            }
+            else
+            {
+                convertedImage = frame.image->Convert(PixelFormat_Mono8, HQ_LINEAR);
+            }
+            context->metrics->stageDurations[STAGE_CONVERT].Observe(GetMonotonicNs() - convertStart);
+            grid = ComputeMotionGrid(*context, (const uint8_t*)convertedImage->GetData(),
+                                     (unsigned int)convertedImage->GetWidth(),
+                                     (unsigned int)convertedImage->GetHeight(), convertedImage->GetStride());
+            converted = true;
+        }
+        // Release image; the converted copy or encoded bytes no longer need
+        // the acquisition buffer. A leased buffer is released with its lease.
+        if (frame.fromCamera && !lease)
+        {
+            frame.image->Release();
+        }
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        ASYNC_LOG(SEVERITY_ERROR, "[{}] Error: {}", serialNumber, e.what());
+    }
+    if (!lease || !frame.fromCamera)
+    {
+        context->framesInFlight--;
+    }
+
+    // Every frame index is posted, even without output, so later frames are not held back
+    TaskScheduler::Task writeTask;
+    if (converted)
+    {
+        const uint64_t frameIndex = frame.frameIndex;
+        const time_t wallTime = frame.wallTime;
+        const uint64_t deviceTimestamp = frame.deviceTimestamp;
+        const uint64_t hostTimestamp = frame.hostTimestamp;
+        const SyncedTimestamp synced = frame.synced;
+        writeTask = [context, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, convertedImage,
+                     lease]() {
+            WriteFrame(*context, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, convertedImage,
+                       lease);
+        };
+    }
+    else if (encoded && context->mcap != nullptr)
+    {
+        const uint64_t frameIndex = frame.frameIndex;
+        const uint64_t hostTimestamp = frame.hostTimestamp;
+        const SyncedTimestamp synced = frame.synced;
+        writeTask = [context, frameIndex, hostTimestamp, synced, width, height, encoded]() {
+            WriteMcapMessage(*context, frameIndex, hostTimestamp, synced, width, height, encoded->Data(),
+                             (uint32_t)encoded->Size(), encoded);
+        };
+    }
+    else if (encoded)
+    {
+        const uint64_t frameIndex = frame.frameIndex;
+        const time_t wallTime = frame.wallTime;
+        const uint64_t deviceTimestamp = frame.deviceTimestamp;
+        const uint64_t hostTimestamp = frame.hostTimestamp;
+        const SyncedTimestamp synced = frame.synced;
+        writeTask = [context, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, width, height,
+                     encoded]() {
+            WriteEncodedFrame(*context, frameIndex, wallTime, deviceTimestamp, hostTimestamp, synced, width, height,
+                              encoded);
+        };
+    }
+    if (writeTask && chosenShedding == ADAPTIVE_SHEDDING)
+    {
+        // How late the frame reaches storage is the load shedder's latency signal
+        const uint64_t hostTimestamp = frame.hostTimestamp;
+        TaskScheduler::Task timedTask = [context, hostTimestamp, writeTask]() {
+            writeTask();
+            const uint64_t now = GetMonotonicNs();
+            context->shedder.ReportLatency(now - hostTimestamp, now);
+        };
+        writeTask = timedTask;
+    }
+    if (writeTask && grid)
+    {
+        // The gate decides in frame order on the writer strand
+        const uint64_t frameIndex = frame.frameIndex;
+        const uint64_t deviceTimestamp = frame.deviceTimestamp;
+        const uint64_t hostTimestamp = frame.hostTimestamp;
+        TaskScheduler::Task gatedTask = [context, frameIndex, deviceTimestamp, hostTimestamp, grid, writeTask]() {
+            context->gate->Process(frameIndex, deviceTimestamp, hostTimestamp, *grid, writeTask);
+            context->metrics->Set(context->metrics->framesSkipped, context->gate->GetSkippedCount());
+        };
+        writeTask = gatedTask;
+    }
+    context->writer.Post(frame.frameIndex, writeTask);
+}
+
+// This function hands a received frame to the worker pool. If the storage
+// policy or the load shedder sheds the frame or the camera's queue is full,
+// the frame is dropped here and its index is skipped.
+void DispatchFrame(CameraContext& context, TaskScheduler& scheduler, GrabbedFrame& frame)
+{
+    const uint64_t frameIndex = frame.frameIndex;
+    frame.synced = context.clockSync.ToHost(context.clockIndex, frame.deviceTimestamp);
+    context.latency.AddDelivery(frame.hostTimestamp, frame.deviceTimestamp);
+    context.metrics->Increment(context.metrics->framesReceived);
+    if (chosenShedding == ADAPTIVE_SHEDDING)
     {
-        category->GetFeatures(features);
-        FeatureList_t::const_iterator it;
-        for (it = features.begin(); it != features.end(); ++it)
+        context.shedder.Observe((double)context.queue.Size() / k_frameQueueCapacity, GetMonotonicNs());
+        context.metrics->Set(context.metrics->sheddingLevel, context.shedder.GetLevel());
+    }
+    bool admit = context.storage.Admit(frameIndex);
+    if (admit && !context.shedder.Admit(frameIndex))
+    {
+        context.metrics->Increment(context.metrics->framesShed);
+        admit = false;
+    }
+    if (admit)
+    {
+        context.framesInFlight++;
+        if (context.queue.Push(frame))
         {
-            CNodePtr pfeatureNode = *it;
-            CValuePtr pValue = (CValuePtr)pfeatureNode;
-            cout << "[" << camSerial << "] " << pfeatureNode->GetName() << " : "
-                 << (IsReadable(pValue) ? pValue->ToString() : "Node not readable") << endl;
+            context.metrics->Set(context.metrics->queueDepth, context.queue.Size());
+            CameraContext* pContext = &context;
+            scheduler.Submit([pContext]() { ProcessNextFrame(pContext); });
+            return;
         }
+        context.framesInFlight--;
+        context.metrics->Increment(context.metrics->framesDropped);
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_QUEUE_FULL], SEVERITY_WARNING, 1000,
+                                  "[{}] Frame queue full, image {} dropped", context.serialNumber, frameIndex);
     }
-    else
+    if (frame.fromCamera)
     {
-        cout << "[" << camSerial << "] "
-             << "Device control information not available." << endl;
+        frame.image->Release();
+    }
+    context.writer.Post(frameIndex, TaskScheduler::Task());
+}
+
+// This function caches the values of k_cachedConfigNodes of a configured
+// camera, for configuring it again after recovery.
+void CacheCameraConfig(CameraContext& context)
+{
+    context.cachedConfig.clear();
+    INodeMap& nodeMap = context.pCam->GetNodeMap();
+    for (size_t i = 0; i < sizeof(k_cachedConfigNodes) / sizeof(k_cachedConfigNodes[0]); i++)
+    {
+        CValuePtr ptrValue = nodeMap.GetNode(k_cachedConfigNodes[i]);
+        if (IsAvailable(ptrValue) && IsReadable(ptrValue))
+        {
+            context.cachedConfig.push_back(std::make_pair(std::string(k_cachedConfigNodes[i]),
+                                                          std::string(ptrValue->ToString().c_str())));
+        }
+    }
+}
+
+// This function writes the cached node values back to an initialized camera.
+// Nodes the camera does not let us write are skipped, e.g. ExposureTime while
+// ExposureAuto is on.
+void RestoreCameraConfig(CameraContext& context)
+{
+    INodeMap& nodeMap = context.pCam->GetNodeMap();
+    for (size_t i = 0; i < context.cachedConfig.size(); i++)
+    {
+        CValuePtr ptrValue = nodeMap.GetNode(context.cachedConfig[i].first.c_str());
+        if (IsAvailable(ptrValue) && IsWritable(ptrValue))
+        {
+            ptrValue->FromString(context.cachedConfig[i].second.c_str());
+        }
+    }
+}
+
+// This function looks for a quarantined camera on the bus by its serial
+// number and, if it is there, initializes it with its cached configuration
+// and starts acquisition. Returns -1 if the camera is not back yet.
+int ReacquireCamera(CameraContext& context)
+{
+    // Grab threads of several lost cameras enumerate one at a time
+    static std::mutex enumerationMutex;
+    CameraPtr pCam;
+    {
+        std::lock_guard<std::mutex> lock(enumerationMutex);
+        SystemPtr system = System::GetInstance();
+        system->UpdateCameras();
+        CameraList camList = system->GetCameras();
+        pCam = camList.GetBySerial(context.serialNumber);
+        camList.Clear();
+    }
+    if (!pCam.IsValid())
+    {
+        return -1;
+    }
+    try
+    {
+        pCam->Init();
+        context.pCam = pCam;
+        RestoreCameraConfig(context);
+        pCam->BeginAcquisition();
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        ASYNC_LOG_RATE_LIMITED_BY(context.logLimiters[CAMERA_LOG_REINIT_FAILED], SEVERITY_WARNING, 1000,
+                                  "[{}] Camera found but not reinitialized: {}", context.serialNumber, e.what());
+        try
+        {
+            if (pCam->IsInitialized())
+            {
+                pCam->DeInit();
+            }
+        }
+        catch (Spinnaker::Exception&)
+        {
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// This function takes a camera that dropped off the bus out of acquisition
+// and reacquires it, leaving the other cameras alone. Returns -1 if it was
+// given up.
+int RecoverCamera(CameraContext& context)
+{
+    context.metrics->Increment(context.metrics->deviceRemovals);
+    context.clockSync.Suspend(context.clockIndex);
+    context.streamDiagnostics.Suspend(context.streamIndex);
+    // Frames grabbed before the loss still hold their buffers
+    while (context.framesInFlight > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    try
+    {
+        if (context.pCam->IsStreaming())
+        {
+            context.pCam->EndAcquisition();
+        }
+        context.pCam->DeInit();
+    }
+    catch (Spinnaker::Exception&)
+    {
+        // The handle of a removed device fails; it is replaced below
+    }
+    CameraContext* pContext = &context;
+    if (context.recovery.Recover([pContext]() { return ReacquireCamera(*pContext); }) < 0)
+    {
+        return -1;
+    }
+    context.clockSync.Activate(context.clockIndex);
+    context.streamDiagnostics.Activate(context.streamIndex);
+    context.metrics->Increment(context.metrics->deviceRecoveries);
+    context.metrics->Set(context.metrics->recoveryMs, context.recovery.GetLastRecoveryNs() / 1000000);
+    return 0;
+}
+
+// This function closes the gap files and prints the outages of every camera
+// that had any.
+void PrintRecoverySummary(std::vector<std::unique_ptr<CameraContext> >& contexts)
+{
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        CameraContext& context = *contexts[i];
+        context.recovery.Finish();
+        if (context.recovery.GetRemovalCount() == 0)
+        {
+            continue;
+        }
+        cout << "[" << context.serialNumber << "] Dropped off the bus " << context.recovery.GetRemovalCount()
+             << " times, recovered " << context.recovery.GetRecoveryCount() << " (last "
+             << context.recovery.GetLastRecoveryNs() / 1000000 << " ms, longest "
+             << context.recovery.GetMaxRecoveryNs() / 1000000 << " ms), "
+             << context.recovery.GetTotalGapNs() / 1000000 << " ms without frames, "
+             << GetDeviceStateName(context.recovery.GetState()) << endl;
     }
-    cout << endl;
-    return result;
 }
 
-// This function acquires and saves 10 images from a camera.
+// Arguments of a POLLING grab thread
+struct GrabThreadArgs
+{
+    CameraContext* context;
+    TaskScheduler* scheduler;
+};
+
+// This function acquires 10 images from a camera and hands them to the
+// worker pool.
 void* AcquireImages(void* arg)
 {
-    CameraPtr pCam = *((CameraPtr*)arg);
+    GrabThreadArgs& args = *((GrabThreadArgs*)arg);
+    CameraContext& context = *args.context;
+    CameraPtr pCam = context.pCam;
 
     try
     {
         // Retrieve TL device nodemap
         INodeMap& nodeMapTLDevice = pCam->GetTLDeviceNodeMap();
-        // Retrieve device serial number for filename
-        CStringPtr ptrStringSerial = pCam->GetTLDeviceNodeMap().GetNode("DeviceSerialNumber");
-        std::string serialNumber = "";
-        if (IsAvailable(ptrStringSerial) && IsReadable(ptrStringSerial))
-        {
-            serialNumber = ptrStringSerial->GetValue();
-        }
+        // Device serial number for filename, read when the context was created
+        const std::string& serialNumber = context.serialNumber;
         cout << endl
              << "[" << serialNumber << "] "
              << "*** IMAGE ACQUISITION THREAD STARTING"
@@ -74,87 +1549,67 @@ void* AcquireImages(void* arg)
         PrintDeviceInfo(nodeMapTLDevice, serialNumber);
         // Initialize camera
         pCam->Init();
+        context.clockSync.Activate(context.clockIndex);
+        context.streamDiagnostics.Activate(context.streamIndex);
 
         // Set acquisition mode to continuous
-        CEnumerationPtr ptrAcquisitionMode = pCam->GetNodeMap().GetNode("AcquisitionMode");
-        if (!IsAvailable(ptrAcquisitionMode) || !IsWritable(ptrAcquisitionMode))
-        {
-            cout << "Unable to set acquisition mode to continuous (node retrieval; camera " << serialNumber
-                 << "). Aborting..." << endl
-                 << endl;
-
-            return (void*)0;
-        }
-        CEnumEntryPtr ptrAcquisitionModeContinuous = ptrAcquisitionMode->GetEntryByName("Continuous");
-        if (!IsAvailable(ptrAcquisitionModeContinuous) || !IsReadable(ptrAcquisitionModeContinuous))
+        if (ConfigureAcquisitionMode(pCam, serialNumber) < 0 || ConfigurePixelFormat(pCam, serialNumber) < 0)
         {
-            cout << "Unable to set acquisition mode to continuous (entry 'continuous' retrieval " << serialNumber
-                 << "). Aborting..." << endl
-                 << endl;
-
+            context.clockSync.Suspend(context.clockIndex);
+            context.streamDiagnostics.Suspend(context.streamIndex);
             return (void*)0;
         }
-        int64_t acquisitionModeContinuous = ptrAcquisitionModeContinuous->GetValue();
-        ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
-        cout << "[" << serialNumber << "] "
-             << "Acquisition mode set to continuous..." << endl;
+        SelectPixelPipeline(context);
+        CacheCameraConfig(context);
         // Begin acquiring images
         pCam->BeginAcquisition();
         cout << "[" << serialNumber << "] "
              << "Started acquiring images..." << endl;
         //
-        // Retrieve, convert, and save images for each camera
+        // Retrieve images for each camera; conversion and saving run on the pool
         //
-        const unsigned int k_numImages = 10;
         cout << endl;
-        for (unsigned int imageCnt = 0; imageCnt < k_numImages; imageCnt++)
+        for (unsigned int imageCnt = 0; imageCnt < k_numImages && !context.storage.StopRequested(); imageCnt++)
         {
             try
             {
-                // Retrieve next received image and ensure image completion
-                ImagePtr pResultImage = pCam->GetNextImage(1000);
-                // Timestamp
-                auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                std::stringstream ss;
-                ss << t;
-                if (pResultImage->IsIncomplete())
-                {
-                    cout << "[" << serialNumber << "] "
-                         << "Image incomplete with image status " << pResultImage->GetImageStatus() << "..." << endl
-                         << endl;
-                }
-                else
+                // Retrieve next received image
+                GrabbedFrame frame;
+                frame.image = pCam->GetNextImage(k_grabTimeoutMs);
+                frame.fromCamera = true;
+                frame.hostTimestamp = GetMonotonicNs();
+                frame.wallTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                RecordImageState(frame.image, frame);
+                frame.frameIndex = imageCnt;
+                context.recovery.OnFrame(frame.frameIndex, frame.deviceTimestamp);
+                DispatchFrame(context, *args.scheduler, frame);
+            }
+            catch (Spinnaker::Exception& e)
+            {
+                ASYNC_LOG(SEVERITY_ERROR, "[{}] Error: {}", serialNumber, e.what());
+                context.metrics->Increment(context.metrics->grabTimeouts);
+                // Nothing was grabbed for this index
+                context.writer.Post(imageCnt, TaskScheduler::Task());
+                // A camera gone from the bus is recovered without the others noticing
+                if (chosenRecovery == HOTPLUG_RECOVERY && context.recovery.OnGrabError(!pCam->IsValid()))
                 {
-                    // Convert image to mono 8
-                    ImagePtr convertedImage = pResultImage->Convert(PixelFormat_Mono8, HQ_LINEAR);
-                    // Create a unique filename
-                    ostringstream filename;
-                    filename << ss.str();
-                    filename << "-";
-                    if (serialNumber != "")
+                    if (RecoverCamera(context) < 0)
                     {
-                        filename << serialNumber.c_str();
+                        return (void*)0;
                     }
-                    filename << "-" << imageCnt << ".jpg";
-                    // Save image
-                    convertedImage->Save(filename.str().c_str());
-                    // Print image information
-                    cout << "[" << serialNumber << "] "
-                         << "Grabbed image " << imageCnt << ", width = " << pResultImage->GetWidth()
-                         << ", height = " << pResultImage->GetHeight() << ". Image saved at " << filename.str() << endl;
+                    pCam = context.pCam;
                 }
-                // Release image
-                pResultImage->Release();
-                cout << endl;
-            }
-            catch (Spinnaker::Exception& e)
-            {
-                cout << "[" << serialNumber << "] "
-                     << "Error: " << e.what() << endl;
             }
         }
+        // Wait for the pool to release this camera's buffers
+        while (context.framesInFlight > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
         // End acquisition
         pCam->EndAcquisition();
+        context.clockSync.Suspend(context.clockIndex);
+        context.streamDiagnostics.Suspend(context.streamIndex);
         // Deinitialize camera
         pCam->DeInit();
 
@@ -167,7 +1622,80 @@ void* AcquireImages(void* arg)
         return (void*)0;
     }
 }
-// This function acts as the body of the example
+
+// Image event handler used by EVENT acquisition. OnImageEvent runs on a
+// Spinnaker thread, so it only stamps the frame and queues it; conversion and
+// saving happen on the worker pool.
+class FrameEventHandler : public ImageEventHandler
+{
+  public:
+    FrameEventHandler(CameraContext& context, TaskScheduler& scheduler)
+        : m_context(context), m_scheduler(scheduler), m_imageCnt(0)
+    {
+    }
+
+    void OnImageEvent(ImagePtr image)
+    {
+        const uint64_t hostTimestamp = GetMonotonicNs();
+        if (m_imageCnt >= k_numImages)
+        {
+            return;
+        }
+        if (m_context.storage.StopRequested())
+        {
+            // Out of disk space: end this camera's recording
+            m_imageCnt = k_numImages;
+            m_context.queue.Close();
+            return;
+        }
+        GrabbedFrame frame;
+        // Spinnaker releases the image buffer back to the driver as soon as
+        // this callback returns, so the frame cannot outlive it in place: the
+        // queued frame holds its own copy, in the frame arena, and the state
+        // of the image, which the copy does not carry. This copy is why only
+        // POLLING frames are written without one.
+        CopyEventImage(image, [](size_t size) { return FrameArena::Default().AllocateShared(size); }, frame);
+        frame.hostTimestamp = hostTimestamp;
+        frame.wallTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        frame.frameIndex = m_imageCnt++;
+        m_context.recovery.OnFrame(frame.frameIndex, frame.deviceTimestamp);
+        DispatchFrame(m_context, m_scheduler, frame);
+        if (m_imageCnt >= k_numImages)
+        {
+            m_context.queue.Close();
+        }
+    }
+
+  private:
+    CameraContext& m_context;
+    TaskScheduler& m_scheduler;
+    unsigned int m_imageCnt;
+};
+
+// This function recovers a camera of EVENT acquisition that counts as lost:
+// its image event handler is taken off the lost camera and registered on the
+// one found again by serial number. Returns -1 if the camera was given up;
+// the handler is then released.
+int RecoverEventCamera(CameraContext& context, std::unique_ptr<FrameEventHandler>& handler)
+{
+    try
+    {
+        context.pCam->UnregisterEventHandler(*handler);
+    }
+    catch (Spinnaker::Exception&)
+    {
+        // The handle of a removed device fails; its events went with it
+    }
+    if (RecoverCamera(context) < 0)
+    {
+        handler.reset();
+        return -1;
+    }
+    context.pCam->RegisterEventHandler(*handler);
+    return 0;
+}
+
+// This function acts as the body of the example for POLLING acquisition
 int RunMultipleCameras(CameraList camList)
 {
     int result = 0;
@@ -180,6 +1708,22 @@ int RunMultipleCameras(CameraList camList)
         // count when CameraPtr is passed into grab thread as void pointer
         // Create an array of handles
         CameraPtr* pCamList = new CameraPtr[camListSize];
+        // Declared before the scheduler so that queued tasks never outlive them
+        MetricsRegistry metricsRegistry;
+        StorageManager storage(GetStorageConfig());
+        if (storage.Start() < 0)
+        {
+            cout << "Unable to query free space of " << k_outputDirectory << ". Aborting..." << endl;
+            delete[] pCamList;
+            return -1;
+        }
+        ClockSyncService clockSync((ClockSyncConfig()), k_clockSyncIntervalMs);
+        StreamDiagnostics streamDiagnostics(GetStreamDiagnosticsConfig());
+        metricsRegistry.AddCollector([&storage](std::string& out) { storage.Collect(out); });
+        metricsRegistry.AddCollector([](std::string& out) { FrameArena::Default().Collect(out); });
+        std::vector<std::unique_ptr<CameraContext> > contexts;
+        std::vector<GrabThreadArgs> threadArgs(camListSize);
+        TaskScheduler scheduler(k_numWorkers);
 
         pthread_t* grabThreads = new pthread_t[camListSize];
 
@@ -187,8 +1731,36 @@ int RunMultipleCameras(CameraList camList)
         {
             // Select camera
             pCamList[i] = camList.GetByIndex(i);
+            contexts.push_back(std::unique_ptr<CameraContext>(
+                new CameraContext(pCamList[i], GetSerialNumber(pCamList[i]), scheduler, metricsRegistry, storage,
+                                  clockSync, streamDiagnostics)));
+            AddCameraClock(clockSync, *contexts[i]);
+            AddCameraStream(streamDiagnostics, *contexts[i]);
+            threadArgs[i].context = contexts[i].get();
+            threadArgs[i].scheduler = &scheduler;
+        }
+        std::unique_ptr<StripingWriter> striping;
+        std::unique_ptr<McapWriter> mcap;
+        if ((chosenOutput == STRIPED && StartStripingWriter(striping, contexts, metricsRegistry) < 0) ||
+            (chosenOutput == MCAP && StartMcapWriter(mcap, contexts, metricsRegistry) < 0))
+        {
+            delete[] pCamList;
+            delete[] grabThreads;
+            return -1;
+        }
+        clockSync.Start();
+        metricsRegistry.AddCollector([&clockSync](std::string& out) { clockSync.Collect(out); });
+        streamDiagnostics.Start();
+        metricsRegistry.AddCollector([&streamDiagnostics](std::string& out) { streamDiagnostics.Collect(out); });
+        MetricsReporter metricsReporter(metricsRegistry, k_metricsPort, k_metricsSnapshotPath, k_metricsIntervalMs);
+        if (metricsReporter.Start() < 0)
+        {
+            cout << "Unable to serve metrics on port " << k_metricsPort << ", writing snapshots only" << endl;
+        }
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
             // Start grab thread
-            int err = pthread_create(&(grabThreads[i]), nullptr, &AcquireImages, &pCamList[i]);
+            int err = pthread_create(&(grabThreads[i]), nullptr, &AcquireImages, &threadArgs[i]);
             assert(err == 0);
         }
 
@@ -211,6 +1783,42 @@ int RunMultipleCameras(CameraList camList)
                 result = -1;
             }
         }
+        clockSync.Stop();
+        streamDiagnostics.Stop();
+        scheduler.WaitIdle();
+        FinishMotionGates(contexts);
+        PrintSheddingSummary(contexts);
+        PrintRecoverySummary(contexts);
+        // Finish queued writes and close the last segments
+        if (striping)
+        {
+            striping->Stop();
+            striping->PrintSummary();
+        }
+        if (mcap)
+        {
+            mcap->Stop();
+            mcap->PrintSummary();
+        }
+        storage.Stop();
+        AsyncLogger::Instance().Flush();
+        if (storage.GetStaging() != nullptr)
+        {
+            storage.GetStaging()->PrintSummary();
+        }
+        clockSync.PrintSummary();
+        streamDiagnostics.PrintSummary();
+
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            contexts[i]->latency.Print(contexts[i]->serialNumber, "POLLING");
+        }
+        if (storage.GetShedCount() > 0)
+        {
+            cout << storage.GetShedCount() << " frames not recorded because of low disk space" << endl;
+        }
+        cout << scheduler.GetNumWorkers() << " workers, " << scheduler.GetStealCount() << " tasks stolen" << endl;
+        cout << "Frame memory: " << FrameArena::Default().Describe() << endl;
 
         // Clear CameraPtr array and close all handles
         for (unsigned int i = 0; i < camListSize; i++)
@@ -230,6 +1838,198 @@ int RunMultipleCameras(CameraList camList)
     return result;
 }
 
+// This function acts as the body of the example for EVENT acquisition. All
+// cameras are initialized from this thread and frames arrive through image
+// events; no thread is created per camera.
+int RunMultipleCamerasEvents(CameraList camList)
+{
+    int result = 0;
+    try
+    {
+        const unsigned int camListSize = camList.GetSize();
+        // Declared before the scheduler so that queued tasks never outlive them
+        MetricsRegistry metricsRegistry;
+        StorageManager storage(GetStorageConfig());
+        if (storage.Start() < 0)
+        {
+            cout << "Unable to query free space of " << k_outputDirectory << ". Aborting..." << endl;
+            return -1;
+        }
+        ClockSyncService clockSync((ClockSyncConfig()), k_clockSyncIntervalMs);
+        StreamDiagnostics streamDiagnostics(GetStreamDiagnosticsConfig());
+        metricsRegistry.AddCollector([&storage](std::string& out) { storage.Collect(out); });
+        metricsRegistry.AddCollector([](std::string& out) { FrameArena::Default().Collect(out); });
+        std::vector<std::unique_ptr<CameraContext> > contexts;
+        std::vector<std::unique_ptr<FrameEventHandler> > handlers;
+        TaskScheduler scheduler(k_numWorkers);
+
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            CameraPtr pCam = camList.GetByIndex(i);
+            contexts.push_back(std::unique_ptr<CameraContext>(
+                new CameraContext(pCam, GetSerialNumber(pCam), scheduler, metricsRegistry, storage, clockSync,
+                                  streamDiagnostics)));
+            CameraContext& context = *contexts.back();
+            AddCameraClock(clockSync, context);
+            AddCameraStream(streamDiagnostics, context);
+            // Print device information
+            PrintDeviceInfo(pCam->GetTLDeviceNodeMap(), context.serialNumber);
+            // Initialize camera
+            pCam->Init();
+            handlers.push_back(std::unique_ptr<FrameEventHandler>());
+            if (ConfigureAcquisitionMode(pCam, context.serialNumber) < 0 ||
+                ConfigurePixelFormat(pCam, context.serialNumber) < 0)
+            {
+                // Nothing will arrive for this camera
+                context.queue.Close();
+                result = -1;
+                continue;
+            }
+            SelectPixelPipeline(context);
+            CacheCameraConfig(context);
+            clockSync.Activate(context.clockIndex);
+            streamDiagnostics.Activate(context.streamIndex);
+            // Register image event handler
+            handlers.back().reset(new FrameEventHandler(context, scheduler));
+            pCam->RegisterEventHandler(*handlers.back());
+        }
+        std::unique_ptr<StripingWriter> striping;
+        std::unique_ptr<McapWriter> mcap;
+        if ((chosenOutput == STRIPED && StartStripingWriter(striping, contexts, metricsRegistry) < 0) ||
+            (chosenOutput == MCAP && StartMcapWriter(mcap, contexts, metricsRegistry) < 0))
+        {
+            for (unsigned int i = 0; i < camListSize; i++)
+            {
+                if (handlers[i])
+                {
+                    contexts[i]->pCam->UnregisterEventHandler(*handlers[i]);
+                }
+                contexts[i]->pCam->DeInit();
+            }
+            return -1;
+        }
+        clockSync.Start();
+        metricsRegistry.AddCollector([&clockSync](std::string& out) { clockSync.Collect(out); });
+        streamDiagnostics.Start();
+        metricsRegistry.AddCollector([&streamDiagnostics](std::string& out) { streamDiagnostics.Collect(out); });
+        cout << "Started " << scheduler.GetNumWorkers() << " workers for " << camListSize << " cameras..." << endl;
+        MetricsReporter metricsReporter(metricsRegistry, k_metricsPort, k_metricsSnapshotPath, k_metricsIntervalMs);
+        if (metricsReporter.Start() < 0)
+        {
+            cout << "Unable to serve metrics on port " << k_metricsPort << ", writing snapshots only" << endl;
+        }
+
+        // Begin acquiring images
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            if (!contexts[i]->queue.IsClosed())
+            {
+                contexts[i]->pCam->BeginAcquisition();
+                cout << "[" << contexts[i]->serialNumber << "] "
+                     << "Started acquiring images..." << endl;
+            }
+        }
+
+        // The handlers close each queue after k_numImages frames. A stall
+        // counts as a failed grab; a camera that counts as lost is recovered
+        // while the others record on.
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            CameraContext& context = *contexts[i];
+            while (!context.queue.WaitClosed(k_grabTimeoutMs))
+            {
+                context.metrics->Increment(context.metrics->grabTimeouts);
+                if (chosenRecovery == HOTPLUG_RECOVERY && handlers[i])
+                {
+                    if (!context.recovery.OnGrabError(!context.pCam->IsValid()) ||
+                        RecoverEventCamera(context, handlers[i]) == 0)
+                    {
+                        continue;
+                    }
+                }
+                cout << "[" << context.serialNumber << "] "
+                     << "No image received for " << k_grabTimeoutMs << " ms, stopping camera" << endl;
+                context.queue.Close();
+                result = -1;
+            }
+        }
+
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            CameraContext& context = *contexts[i];
+            if (context.recovery.GetState() == DEVICE_LOST)
+            {
+                // Already taken out of acquisition and deinitialized
+                continue;
+            }
+            if (context.pCam->IsStreaming())
+            {
+                // End acquisition
+                context.pCam->EndAcquisition();
+            }
+            if (handlers[i])
+            {
+                // Unregister image event handler
+                context.pCam->UnregisterEventHandler(*handlers[i]);
+            }
+        }
+        clockSync.Stop();
+        streamDiagnostics.Stop();
+        scheduler.WaitIdle();
+        FinishMotionGates(contexts);
+        PrintSheddingSummary(contexts);
+        PrintRecoverySummary(contexts);
+        // Finish queued writes and close the last segments
+        if (striping)
+        {
+            striping->Stop();
+            striping->PrintSummary();
+        }
+        if (mcap)
+        {
+            mcap->Stop();
+            mcap->PrintSummary();
+        }
+        storage.Stop();
+        AsyncLogger::Instance().Flush();
+        if (storage.GetStaging() != nullptr)
+        {
+            storage.GetStaging()->PrintSummary();
+        }
+        clockSync.PrintSummary();
+        streamDiagnostics.PrintSummary();
+
+        if (storage.GetShedCount() > 0)
+        {
+            cout << storage.GetShedCount() << " frames not recorded because of low disk space" << endl;
+        }
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            CameraContext& context = *contexts[i];
+            context.latency.Print(context.serialNumber, "EVENT");
+            if (context.queue.DroppedCount() > 0)
+            {
+                cout << "[" << context.serialNumber << "] " << context.queue.DroppedCount()
+                     << " frames dropped on a full queue" << endl;
+                result = -1;
+            }
+            // Deinitialize camera
+            if (context.recovery.GetState() != DEVICE_LOST)
+            {
+                context.pCam->DeInit();
+            }
+        }
+        cout << scheduler.GetNumWorkers() << " workers, " << scheduler.GetStealCount() << " tasks stolen" << endl;
+        cout << "Frame memory: " << FrameArena::Default().Describe() << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error: " << e.what() << endl;
+        result = -1;
+    }
+    return result;
+}
+
 // 多个相机同步采集10张图片
 int main(int /*argc*/, char** /*argv*/)
 {
@@ -247,6 +2047,22 @@ int main(int /*argc*/, char** /*argv*/)
     fclose(tempFile);
     remove("test.txt");
     int result = 0;
+    // Reserve frame memory before anything allocates from it
+    cout << "Frame memory: " << FrameArena::Default(k_frameArenaBytes, k_frameArenaPages).Describe() << endl;
+    if (chosenColor == COLOR_RECORDING)
+    {
+        ColorConfig colorConfig;
+        colorConfig.demosaic = k_demosaic;
+        colorConfig.output = COLOR_OUTPUT_YUV420;
+        memcpy(colorConfig.whiteBalance, k_whiteBalance, sizeof(k_whiteBalance));
+        memcpy(colorConfig.ccm, k_colorMatrix, sizeof(k_colorMatrix));
+        if (GetColorPipeline().Configure(colorConfig) < 0)
+        {
+            cout << "White balance and color matrix out of range!" << endl;
+            return -1;
+        }
+        cout << "Color pipeline " << GetColorPipeline().Describe() << endl;
+    }
     // Print application build information
     cout << "Application build date: " << __DATE__ << " " << __TIME__ << endl << endl;
     // Retrieve singleton reference to system object
@@ -274,7 +2090,16 @@ int main(int /*argc*/, char** /*argv*/)
     }
     // Run example on all cameras
     cout << endl << "Running example for all cameras..." << endl;
-    result = RunMultipleCameras(camList);
+    if (chosenAcquisition == EVENT)
+    {
+        result = RunMultipleCamerasEvents(camList);
+    }
+    else
+    {
+        result = RunMultipleCameras(camList);
+    }
+    // Write out everything the grab path logged
+    AsyncLogger::Instance().Shutdown();
     cout << "Example complete..." << endl << endl;
     // Clear camera list before releasing system
     camList.Clear();
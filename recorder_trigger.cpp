@@ -7,11 +7,24 @@
  * @LastEditTime: 2022-11-10 13:52:56
  */
 
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "Spinnaker.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
+#include "async_logger.h"
+#include "hdr_fusion.h"
+#include "time_utils.h"
 
 
 using namespace Spinnaker;
@@ -61,12 +74,63 @@ int PrintDeviceInfo(INodeMap& nodeMap, std::string camSerial)
 const triggerType chosenTrigger = HARDWARE;
 const double exposureTime = 3000.0; // us
 
+// Use the following enum and global constant to select trigger overlap. With
+// OVERLAP_READOUT the camera accepts the next trigger while the previous
+// frame is still being read out, so triggers may come as fast as the longer
+// of exposure and readout allows instead of their sum; with OVERLAP_OFF a
+// trigger during readout is dropped.
+enum triggerOverlapType
+{
+    OVERLAP_OFF,
+    OVERLAP_READOUT
+};
+
+const triggerOverlapType chosenOverlap = OVERLAP_READOUT;
+// Frames per trigger. Above 1, each trigger starts a burst of this many
+// frames at the sensor's frame rate (TriggerSelector FrameBurstStart).
+const unsigned int k_burstFrameCount = 1;
+// Triggers each camera waits for
+const unsigned int k_numTriggers = 200;
+// Rate of the triggers in Hz: of the hardware trigger generator, or of the
+// software triggers this program executes. Achieved rates are reported
+// against it. 0 waits for the Enter key before each software trigger.
+const double k_triggerRate = 100.0;
+// Every complete frame is copied out of its acquisition buffer on the grab
+// thread and converted and saved on the worker pool, as Image::Save takes
+// longer than a frame period at full rate. The grab thread waits once this
+// many frames (brackets in HDR mode) of a camera wait for the workers,
+// which bounds their memory.
+const unsigned int k_maxPendingSaves = 64;
+// Stop waiting for frames after this long without one (ms)
+const unsigned int k_grabTimeoutMs = 1000;
+
+// Use the following enum and global constant to select HDR capture. With
+// HDR_BRACKETED the camera sequencer steps through k_hdrExposures, one
+// exposure per frame, and each trigger starts a burst of one bracket. The
+// grab thread collects the frames of a bracket and hands it to the worker
+// pool, which merges it into one radiance frame and saves that tone-mapped;
+// exposureTime is unused.
+enum hdrType
+{
+    NO_HDR,
+    HDR_BRACKETED
+};
+
+const hdrType chosenHdr = NO_HDR;
+// Exposure times of a bracket (us), 2 to k_hdrMaxExposures of them
+const double k_hdrExposures[] = {8000.0, 2000.0, 500.0};
+const unsigned int k_hdrExposureCount = sizeof(k_hdrExposures) / sizeof(k_hdrExposures[0]);
+// Frames each trigger starts
+const unsigned int k_framesPerTrigger = chosenHdr == HDR_BRACKETED ? k_hdrExposureCount : k_burstFrameCount;
+
 // This function configures the camera to use a trigger. First, trigger mode is
 // set to off in order to select the trigger source. Once the trigger source
 // has been selected, trigger mode is then enabled, which has the camera
-// capture only a single image upon the execution of the chosen trigger.
-// 为每个相机配置相机触发模式，每次触发捕获一张图像
-int ConfigureTrigger(INodeMap& nodeMap)
+// capture k_framesPerTrigger images upon the execution of the chosen trigger.
+// Trigger overlap is set last, as it can only be changed with trigger mode on;
+// its previous value is kept in previousOverlap for ResetTrigger.
+// 为每个相机配置相机触发模式，每次触发捕获k_framesPerTrigger张图像，并配置触发重叠
+int ConfigureTrigger(INodeMap& nodeMap, std::string& previousOverlap)
 {
     int result = 0;
 
@@ -75,8 +139,7 @@ int ConfigureTrigger(INodeMap& nodeMap)
     cout << "Note that if the application / user software triggers faster than frame time, the trigger may be dropped "
             "/ skipped by the camera."
          << endl
-         << "If several frames are needed per trigger, a more reliable alternative for such case, is to use the "
-            "multi-frame mode."
+         << "Trigger overlap and bursts of k_framesPerTrigger frames per trigger raise the highest trigger rate."
          << endl
          << endl;
 
@@ -117,11 +180,11 @@ int ConfigureTrigger(INodeMap& nodeMap)
         cout << "Trigger mode disabled..." << endl;
 
         //
-        // Set TriggerSelector to FrameStart
+        // Set TriggerSelector to FrameStart, or FrameBurstStart for bursts
         //
         // *** NOTES ***
-        // For this example, the trigger selector should be set to frame start.
-        // This is the default for most cameras.
+        // Frame start is the default for most cameras. With frame burst
+        // start, one trigger starts AcquisitionBurstFrameCount frames.
         //
         CEnumerationPtr ptrTriggerSelector = nodeMap.GetNode("TriggerSelector");
         if (!IsAvailable(ptrTriggerSelector) || !IsWritable(ptrTriggerSelector))
@@ -130,16 +193,32 @@ int ConfigureTrigger(INodeMap& nodeMap)
             return -1;
         }
 
-        CEnumEntryPtr ptrTriggerSelectorFrameStart = ptrTriggerSelector->GetEntryByName("FrameStart");
-        if (!IsAvailable(ptrTriggerSelectorFrameStart) || !IsReadable(ptrTriggerSelectorFrameStart))
+        const char* selector = k_framesPerTrigger > 1 ? "FrameBurstStart" : "FrameStart";
+        CEnumEntryPtr ptrTriggerSelectorEntry = ptrTriggerSelector->GetEntryByName(selector);
+        if (!IsAvailable(ptrTriggerSelectorEntry) || !IsReadable(ptrTriggerSelectorEntry))
         {
-            cout << "Unable to set trigger selector (enum entry retrieval). Aborting..." << endl;
+            cout << "Unable to set trigger selector to " << selector << " (enum entry retrieval). Aborting..." << endl;
             return -1;
         }
 
-        ptrTriggerSelector->SetIntValue(ptrTriggerSelectorFrameStart->GetValue());
+        ptrTriggerSelector->SetIntValue(ptrTriggerSelectorEntry->GetValue());
+
+        cout << "Trigger selector set to " << selector << "..." << endl;
+
+        if (k_framesPerTrigger > 1)
+        {
+            CIntegerPtr ptrBurstFrameCount = nodeMap.GetNode("AcquisitionBurstFrameCount");
+            if (!IsAvailable(ptrBurstFrameCount) || !IsWritable(ptrBurstFrameCount) ||
+                ptrBurstFrameCount->GetMax() < (int64_t)k_framesPerTrigger)
+            {
+                cout << "Unable to set burst frame count to " << k_framesPerTrigger << ". Aborting..." << endl;
+                return -1;
+            }
+
+            ptrBurstFrameCount->SetValue(k_framesPerTrigger);
 
-        cout << "Trigger selector set to frame start..." << endl;
+            cout << "Burst frame count set to " << k_framesPerTrigger << "..." << endl;
+        }
 
         //
         // Select trigger source
@@ -203,7 +282,33 @@ int ConfigureTrigger(INodeMap& nodeMap)
 
         // NOTE: Blackfly and Flea3 GEV cameras need 1 second delay after trigger mode is turned on
 
-        cout << "Trigger mode turned back on..." << endl << endl;
+        cout << "Trigger mode turned back on..." << endl;
+
+        //
+        // Set trigger overlap
+        //
+        // *** NOTES ***
+        // Not every camera has this node; without it triggers during readout
+        // are dropped, which the rate report at the end shows.
+        //
+        CEnumerationPtr ptrTriggerOverlap = nodeMap.GetNode("TriggerOverlap");
+        const char* overlap = chosenOverlap == OVERLAP_READOUT ? "ReadOut" : "Off";
+        CEnumEntryPtr ptrTriggerOverlapEntry;
+        if (IsAvailable(ptrTriggerOverlap) && IsWritable(ptrTriggerOverlap))
+        {
+            ptrTriggerOverlapEntry = ptrTriggerOverlap->GetEntryByName(overlap);
+        }
+        if (IsAvailable(ptrTriggerOverlapEntry) && IsReadable(ptrTriggerOverlapEntry))
+        {
+            previousOverlap = ptrTriggerOverlap->GetCurrentEntry()->GetSymbolic().c_str();
+            ptrTriggerOverlap->SetIntValue(ptrTriggerOverlapEntry->GetValue());
+
+            cout << "Trigger overlap set to " << overlap << "..." << endl << endl;
+        }
+        else
+        {
+            cout << "Unable to set trigger overlap to " << overlap << ". Non-fatal error..." << endl << endl;
+        }
     }
     catch (Spinnaker::Exception& e)
     {
@@ -270,14 +375,42 @@ int GrabNextImageByTrigger(INodeMap& nodeMap, CameraPtr pCam)
     return result;
 }
 
-// This function returns the camera to a normal state by turning off trigger
-// mode.
-int ResetTrigger(INodeMap& nodeMap)
+// This function returns the camera to a normal state by undoing
+// ConfigureTrigger: trigger overlap back to previousOverlap (unless empty),
+// trigger mode off, one frame per trigger and TriggerSelector FrameStart.
+int ResetTrigger(INodeMap& nodeMap, const std::string& previousOverlap)
 {
     int result = 0;
 
     try
     {
+        //
+        // Restore trigger overlap
+        //
+        // *** NOTES ***
+        // Like setting it, this needs trigger mode still on.
+        //
+        if (!previousOverlap.empty())
+        {
+            CEnumerationPtr ptrTriggerOverlap = nodeMap.GetNode("TriggerOverlap");
+            CEnumEntryPtr ptrTriggerOverlapEntry;
+            if (IsAvailable(ptrTriggerOverlap) && IsWritable(ptrTriggerOverlap))
+            {
+                ptrTriggerOverlapEntry = ptrTriggerOverlap->GetEntryByName(previousOverlap.c_str());
+            }
+            if (IsAvailable(ptrTriggerOverlapEntry) && IsReadable(ptrTriggerOverlapEntry))
+            {
+                ptrTriggerOverlap->SetIntValue(ptrTriggerOverlapEntry->GetValue());
+
+                cout << "Trigger overlap restored to " << previousOverlap << "..." << endl;
+            }
+            else
+            {
+                cout << "Unable to restore trigger overlap to " << previousOverlap << ". Non-fatal error..." << endl;
+                result = -1;
+            }
+        }
+
         //
         // Turn trigger mode back off
         //
@@ -301,7 +434,34 @@ int ResetTrigger(INodeMap& nodeMap)
 
         ptrTriggerMode->SetIntValue(ptrTriggerModeOff->GetValue());
 
-        cout << "Trigger mode disabled..." << endl << endl;
+        cout << "Trigger mode disabled..." << endl;
+
+        //
+        // Restore one frame per trigger and TriggerSelector FrameStart
+        //
+        CIntegerPtr ptrBurstFrameCount = nodeMap.GetNode("AcquisitionBurstFrameCount");
+        if (IsAvailable(ptrBurstFrameCount) && IsWritable(ptrBurstFrameCount))
+        {
+            ptrBurstFrameCount->SetValue(1);
+        }
+
+        CEnumerationPtr ptrTriggerSelector = nodeMap.GetNode("TriggerSelector");
+        CEnumEntryPtr ptrTriggerSelectorFrameStart;
+        if (IsAvailable(ptrTriggerSelector) && IsWritable(ptrTriggerSelector))
+        {
+            ptrTriggerSelectorFrameStart = ptrTriggerSelector->GetEntryByName("FrameStart");
+        }
+        if (IsAvailable(ptrTriggerSelectorFrameStart) && IsReadable(ptrTriggerSelectorFrameStart))
+        {
+            ptrTriggerSelector->SetIntValue(ptrTriggerSelectorFrameStart->GetValue());
+
+            cout << "Trigger selector restored to FrameStart..." << endl << endl;
+        }
+        else
+        {
+            cout << "Unable to restore trigger selector to FrameStart. Non-fatal error..." << endl << endl;
+            result = -1;
+        }
     }
     catch (Spinnaker::Exception& e)
     {
@@ -434,22 +594,456 @@ int ResetExposure(INodeMap& nodeMap)
     return result;
 }
 
-// This function acquires and saves single image from a camera.
-void* AcquireImage(void* arg)
+// This function sets an enumeration node to the entry of the given name.
+// Returns -1 if either is unavailable.
+int SetEnumeration(INodeMap& nodeMap, const char* node, const char* entry)
 {
-    CameraPtr pCam = *((CameraPtr*)arg);
+    CEnumerationPtr ptrEnumeration = nodeMap.GetNode(node);
+    if (!IsAvailable(ptrEnumeration) || !IsWritable(ptrEnumeration))
+    {
+        cout << "Unable to set " << node << " (node retrieval). Aborting..." << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrEntry = ptrEnumeration->GetEntryByName(entry);
+    if (!IsAvailable(ptrEntry) || !IsReadable(ptrEntry))
+    {
+        cout << "Unable to set " << node << " to " << entry << " (enum entry retrieval). Aborting..." << endl;
+        return -1;
+    }
+    ptrEnumeration->SetIntValue(ptrEntry->GetValue());
+    return 0;
+}
 
+// This function programs the sequencer with one set per exposure of the
+// bracket, each set moving on to the next on every frame start, the last
+// back to the first. Automatic exposure must already be off. The exposure
+// times set, limited to the camera's maximum, are returned in exposures.
+int ConfigureSequencer(INodeMap& nodeMap, double* exposures)
+{
     int result = 0;
-    
+
+    cout << endl << endl << "*** CONFIGURING SEQUENCER ***" << endl << endl;
+
+    try
+    {
+        //
+        // Turn the sequencer off, then configuration mode on
+        //
+        // *** NOTES ***
+        // Sets can only be changed in configuration mode, which in turn can
+        // only be entered with the sequencer off.
+        //
+        if (SetEnumeration(nodeMap, "SequencerMode", "Off") < 0 ||
+            SetEnumeration(nodeMap, "SequencerConfigurationMode", "On") < 0)
+        {
+            return -1;
+        }
+
+        CIntegerPtr ptrSetSelector = nodeMap.GetNode("SequencerSetSelector");
+        CIntegerPtr ptrSetNext = nodeMap.GetNode("SequencerSetNext");
+        CFloatPtr ptrExposureTime = nodeMap.GetNode("ExposureTime");
+        CCommandPtr ptrSetSave = nodeMap.GetNode("SequencerSetSave");
+        if (!IsAvailable(ptrSetSelector) || !IsWritable(ptrSetSelector) || !IsAvailable(ptrSetNext) ||
+            !IsAvailable(ptrExposureTime) || !IsAvailable(ptrSetSave) ||
+            ptrSetSelector->GetMax() < (int64_t)k_hdrExposureCount - 1)
+        {
+            cout << "Unable to program " << k_hdrExposureCount << " sequencer sets. Aborting..." << endl;
+            return -1;
+        }
+
+        //
+        // Program one set per exposure
+        //
+        // *** NOTES ***
+        // Each set is selected, changed and saved in turn. Its trigger source
+        // FrameStart moves the sequencer to the next set after every frame.
+        //
+        for (unsigned int i = 0; i < k_hdrExposureCount; i++)
+        {
+            ptrSetSelector->SetValue(i);
+            exposures[i] = std::min(k_hdrExposures[i], ptrExposureTime->GetMax());
+            ptrExposureTime->SetValue(exposures[i]);
+            ptrSetNext->SetValue((i + 1) % k_hdrExposureCount);
+            if (SetEnumeration(nodeMap, "SequencerTriggerSource", "FrameStart") < 0)
+            {
+                return -1;
+            }
+            ptrSetSave->Execute();
+
+            cout << "Sequencer set " << i << ": exposure time " << exposures[i] << " us..." << endl;
+        }
+
+        //
+        // Start at the first set, leave configuration mode and turn the
+        // sequencer on
+        //
+        CIntegerPtr ptrSetStart = nodeMap.GetNode("SequencerSetStart");
+        if (IsAvailable(ptrSetStart) && IsWritable(ptrSetStart))
+        {
+            ptrSetStart->SetValue(0);
+        }
+        if (SetEnumeration(nodeMap, "SequencerConfigurationMode", "Off") < 0 ||
+            SetEnumeration(nodeMap, "SequencerMode", "On") < 0)
+        {
+            return -1;
+        }
+
+        cout << "Sequencer on with " << k_hdrExposureCount << " exposures per bracket..." << endl << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error: " << e.what() << endl;
+        result = -1;
+    }
+
+    return result;
+}
+
+// This function turns the sequencer back off, so the camera keeps a single
+// exposure time again.
+int ResetSequencer(INodeMap& nodeMap)
+{
+    int result = 0;
+
+    try
+    {
+        if (SetEnumeration(nodeMap, "SequencerMode", "Off") < 0)
+        {
+            return -1;
+        }
+
+        cout << "Sequencer disabled..." << endl << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error: " << e.what() << endl;
+        result = -1;
+    }
+
+    return result;
+}
+
+// Rate-limited messages about one camera. Each camera limits each of them on
+// its own, so one camera's burst does not hide another camera's messages.
+enum cameraLog
+{
+    CAMERA_LOG_INCOMPLETE,
+    CAMERA_LOG_SAVE_FAILED,
+    CAMERA_LOG_FUSE_FAILED,
+    CAMERA_LOG_TRIGGER_FAILED,
+    NUM_CAMERA_LOGS
+};
+
+// One camera of the run and the statistics of its triggered acquisition
+struct TriggeredCamera
+{
+    CameraPtr pCam;
+    std::string serialNumber;
+    // Executed by the trigger pacing thread when software triggers are paced
+    CCommandPtr triggerSoftware;
+    // 1 while acquiring, 2 once all frames are in, -1 if acquisition failed
+    std::atomic<int> state;
+    std::atomic<uint64_t> triggersIssued; // software triggers executed
+    bool counterAvailable;                // Counter0 counts edges on Line0
+    int64_t triggersCounted;              // hardware triggers seen by Counter0, -1 if unknown
+    double resultingFrameRate;            // AcquisitionResultingFrameRate, 0 if unknown
+    uint64_t framesReceived;
+    uint64_t framesIncomplete;
+    uint64_t framesLost;                  // gaps in the frame IDs
+    uint64_t firstTimestamp;              // device timestamps, ns
+    uint64_t lastTimestamp;
+    // TriggerOverlap before ConfigureTrigger set it, empty if it did not
+    std::string previousOverlap;
+    // Saving on the workers (scheduler). The grab thread takes a slot per
+    // frame handed over, the worker gives it back once the frame is saved.
+    TaskScheduler* scheduler; // shared by the cameras
+    std::atomic<unsigned int> savesPending;
+    unsigned int savesPendingPeak;
+    uint64_t saveWaits;  // frames the grab thread waited for a free slot
+    uint64_t saveWaitNs; // ... and how long it waited in total
+    std::atomic<uint64_t> framesSaved;
+    std::atomic<uint64_t> saveFailures;
+    std::mutex saveStatsMutex;
+    uint64_t saveNsTotal; // convert and save time on the workers
+    uint64_t saveNsMax;
+    // HDR mode: frames of the bracket being collected, copied out of their
+    // acquisition buffers, one per sequencer set. A frame's set follows from
+    // its frame ID, counted from the first frame, which the sequencer took
+    // with set 0. Complete brackets are fused and saved on the workers.
+    std::vector<ImagePtr> bracketImages;
+    uint64_t firstFrameId;
+    uint64_t bracketIndex;      // bracket the collected frames belong to
+    unsigned int bracketFrames; // frames of it collected so far
+    unsigned int bracketWidth;
+    unsigned int bracketHeight;
+    HdrFusion fusion;
+    std::atomic<uint64_t> bracketsFused; // fused and saved
+    uint64_t bracketsDropped;            // a frame of them was incomplete or lost
+    uint64_t fuseNsTotal;                // fusion alone, under saveStatsMutex
+    uint64_t fuseNsMax;
+    // Rate limits of this camera's messages, by cameraLog
+    LogRateLimiter logLimiters[NUM_CAMERA_LOGS];
+
+    TriggeredCamera()
+        : state(0), triggersIssued(0), counterAvailable(false), triggersCounted(-1), resultingFrameRate(0.0),
+          framesReceived(0), framesIncomplete(0), framesLost(0), firstTimestamp(0), lastTimestamp(0),
+          scheduler(nullptr), savesPending(0), savesPendingPeak(0), saveWaits(0), saveWaitNs(0), framesSaved(0),
+          saveFailures(0), saveNsTotal(0), saveNsMax(0), firstFrameId(0), bracketIndex(0), bracketFrames(0),
+          bracketWidth(0), bracketHeight(0), bracketsFused(0), bracketsDropped(0), fuseNsTotal(0), fuseNsMax(0)
+    {
+    }
+};
+
+// This function sets Counter0 to count the rising edges on Line0, the
+// hardware trigger input, so dropped triggers can be told from triggers that
+// never came. Returns -1 if the camera has no such counter.
+int ConfigureTriggerCounter(INodeMap& nodeMap)
+{
+    try
+    {
+        CEnumerationPtr ptrCounterSelector = nodeMap.GetNode("CounterSelector");
+        CEnumerationPtr ptrCounterEventSource = nodeMap.GetNode("CounterEventSource");
+        CEnumerationPtr ptrCounterEventActivation = nodeMap.GetNode("CounterEventActivation");
+        if (!IsAvailable(ptrCounterSelector) || !IsWritable(ptrCounterSelector) ||
+            !IsAvailable(ptrCounterEventSource) || !IsWritable(ptrCounterEventSource))
+        {
+            cout << "Unable to configure the trigger counter (node retrieval). Non-fatal error..." << endl;
+            return -1;
+        }
+        CEnumEntryPtr ptrCounter0 = ptrCounterSelector->GetEntryByName("Counter0");
+        CEnumEntryPtr ptrLine0 = ptrCounterEventSource->GetEntryByName("Line0");
+        if (!IsAvailable(ptrCounter0) || !IsAvailable(ptrLine0))
+        {
+            cout << "Unable to count Line0 on Counter0 (enum entry retrieval). Non-fatal error..." << endl;
+            return -1;
+        }
+        ptrCounterSelector->SetIntValue(ptrCounter0->GetValue());
+        ptrCounterEventSource->SetIntValue(ptrLine0->GetValue());
+        if (IsAvailable(ptrCounterEventActivation) && IsWritable(ptrCounterEventActivation))
+        {
+            CEnumEntryPtr ptrRisingEdge = ptrCounterEventActivation->GetEntryByName("RisingEdge");
+            if (IsAvailable(ptrRisingEdge))
+            {
+                ptrCounterEventActivation->SetIntValue(ptrRisingEdge->GetValue());
+            }
+        }
+        cout << "Counter0 counts trigger edges on Line0..." << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Unable to configure the trigger counter: " << e.what() << ". Non-fatal error..." << endl;
+        return -1;
+    }
+    return 0;
+}
+
+// This function resets (before acquisition) or reads (after it) Counter0.
+// Returns the count, or -1 if it cannot be read.
+int64_t AccessTriggerCounter(INodeMap& nodeMap, bool reset)
+{
+    try
+    {
+        if (reset)
+        {
+            CCommandPtr ptrCounterReset = nodeMap.GetNode("CounterReset");
+            if (!IsAvailable(ptrCounterReset) || !IsWritable(ptrCounterReset))
+            {
+                cout << "Unable to reset the trigger counter (node retrieval). Non-fatal error..." << endl;
+                return -1;
+            }
+            ptrCounterReset->Execute();
+            return 0;
+        }
+        CIntegerPtr ptrCounterValue = nodeMap.GetNode("CounterValue");
+        if (!IsAvailable(ptrCounterValue) || !IsReadable(ptrCounterValue))
+        {
+            cout << "Unable to read the trigger counter (node retrieval). Non-fatal error..." << endl;
+            return -1;
+        }
+        return ptrCounterValue->GetValue();
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Unable to " << (reset ? "reset" : "read") << " the trigger counter: " << e.what()
+             << ". Non-fatal error..." << endl;
+        return -1;
+    }
+}
+
+// This function takes a slot of the camera's save queue for a frame about to
+// be handed to the workers, waiting while the queue is full.
+void ReserveSaveSlot(TriggeredCamera& camera)
+{
+    if (camera.savesPending >= k_maxPendingSaves)
+    {
+        const uint64_t start = GetMonotonicNs();
+        while (camera.savesPending >= k_maxPendingSaves)
+        {
+            usleep(100);
+        }
+        camera.saveWaits++;
+        camera.saveWaitNs += GetMonotonicNs() - start;
+    }
+    camera.savesPendingPeak = std::max(camera.savesPendingPeak, ++camera.savesPending);
+}
+
+// This function gives back a save slot once its frame is saved, or failed
+// to be, and adds the time the worker spent on it to the statistics.
+void ReleaseSaveSlot(TriggeredCamera& camera, uint64_t elapsedNs)
+{
+    {
+        std::lock_guard<std::mutex> lock(camera.saveStatsMutex);
+        camera.saveNsTotal += elapsedNs;
+        camera.saveNsMax = std::max(camera.saveNsMax, elapsedNs);
+    }
+    camera.savesPending--;
+}
+
+// This function runs on a worker: it converts a frame copied out of its
+// acquisition buffer to Mono8 and saves it.
+void SaveFrame(TriggeredCamera& camera, ImagePtr image, unsigned int frameCnt, time_t t)
+{
+    const uint64_t start = GetMonotonicNs();
+    try
+    {
+        // Convert image to mono 8
+        ImagePtr convertedImage = image->Convert(PixelFormat_Mono8, HQ_LINEAR);
+        // Create a unique filename
+        ostringstream filename;
+        filename << t;
+        filename << "-";
+        if (camera.serialNumber != "")
+        {
+            filename << camera.serialNumber.c_str();
+        }
+        filename << "-" << frameCnt << ".jpg";
+        // Save image
+        convertedImage->Save(filename.str().c_str());
+        camera.framesSaved++;
+        // Print image information
+        ASYNC_LOG(SEVERITY_DEBUG, "[{}] Grabbed image {}, width = {}, height = {}. Image saved at {}",
+                  camera.serialNumber, frameCnt, image->GetWidth(), image->GetHeight(), filename.str());
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        camera.saveFailures++;
+        ASYNC_LOG_RATE_LIMITED_BY(camera.logLimiters[CAMERA_LOG_SAVE_FAILED], SEVERITY_ERROR, 1000,
+                                  "[{}] Unable to save image {}: {}", camera.serialNumber, frameCnt, e.what());
+    }
+    ReleaseSaveSlot(camera, GetMonotonicNs() - start);
+}
+
+// This function runs on a worker: it converts the frames of a complete
+// bracket to Mono8, fuses them and saves the tone-mapped result. Brackets of
+// a camera are fused in parallel on different workers, each in a single
+// band, so that no worker blocks waiting for the bands of another.
+void FuseBracket(TriggeredCamera& camera, const std::vector<ImagePtr>& images, uint64_t bracketIndex, time_t t)
+{
+    // Fused frame of this worker, reused across brackets
+    static thread_local HdrFrame fused;
+    const uint64_t start = GetMonotonicNs();
     try
     {
-        // Retrieve device serial number for filename
-        CStringPtr ptrStringSerial = pCam->GetTLDeviceNodeMap().GetNode("DeviceSerialNumber");
-        std::string serialNumber = "";
-        if (IsAvailable(ptrStringSerial) && IsReadable(ptrStringSerial))
+        ImagePtr mono8[k_hdrMaxExposures];
+        const uint8_t* pixels[k_hdrMaxExposures];
+        size_t strides[k_hdrMaxExposures];
+        for (unsigned int i = 0; i < k_hdrExposureCount; i++)
         {
-            serialNumber = ptrStringSerial->GetValue();
+            mono8[i] = images[i];
+            if (images[i]->GetPixelFormat() != PixelFormat_Mono8)
+            {
+                mono8[i] = images[i]->Convert(PixelFormat_Mono8, HQ_LINEAR);
+            }
+            pixels[i] = (const uint8_t*)mono8[i]->GetData();
+            strides[i] = mono8[i]->GetStride() > 0 ? mono8[i]->GetStride() : mono8[i]->GetWidth();
+        }
+        const unsigned int width = (unsigned int)mono8[0]->GetWidth();
+        const unsigned int height = (unsigned int)mono8[0]->GetHeight();
+        const uint64_t fuseStart = GetMonotonicNs();
+        camera.fusion.Fuse(pixels, strides, width, height, fused);
+        const uint64_t fuseNs = GetMonotonicNs() - fuseStart;
+        {
+            std::lock_guard<std::mutex> lock(camera.saveStatsMutex);
+            camera.fuseNsTotal += fuseNs;
+            camera.fuseNsMax = std::max(camera.fuseNsMax, fuseNs);
         }
+
+        ostringstream filename;
+        filename << t << "-" << camera.serialNumber << "-hdr-" << bracketIndex << ".jpg";
+        ImagePtr toneMapped = Image::Create(width, height, 0, 0, PixelFormat_Mono8, &fused.toneMapped[0]);
+        toneMapped->Save(filename.str().c_str());
+        camera.bracketsFused++;
+        ASYNC_LOG(SEVERITY_DEBUG, "[{}] Fused bracket {} in {} us. Image saved at {}", camera.serialNumber,
+                  bracketIndex, fuseNs / 1000, filename.str());
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        camera.saveFailures++;
+        ASYNC_LOG_RATE_LIMITED_BY(camera.logLimiters[CAMERA_LOG_FUSE_FAILED], SEVERITY_ERROR, 1000,
+                                  "[{}] Unable to fuse bracket {}: {}", camera.serialNumber, bracketIndex, e.what());
+    }
+    ReleaseSaveSlot(camera, GetMonotonicNs() - start);
+}
+
+// This function copies a complete frame out of its acquisition buffer into
+// the bracket being collected and hands the bracket to the workers once all
+// its frames are in. A bracket missing a frame is dropped when the next one
+// starts.
+void AddBracketFrame(TriggeredCamera& camera, ImagePtr pImage, uint64_t frameId)
+{
+    const uint64_t sequence = frameId - camera.firstFrameId;
+    const uint64_t bracketIndex = sequence / k_hdrExposureCount;
+    if (bracketIndex != camera.bracketIndex)
+    {
+        if (camera.bracketFrames > 0)
+        {
+            camera.bracketsDropped++;
+        }
+        camera.bracketIndex = bracketIndex;
+        camera.bracketFrames = 0;
+    }
+
+    const unsigned int width = (unsigned int)pImage->GetWidth();
+    const unsigned int height = (unsigned int)pImage->GetHeight();
+    if (camera.bracketFrames > 0 && (width != camera.bracketWidth || height != camera.bracketHeight))
+    {
+        camera.bracketsDropped++;
+        camera.bracketFrames = 0;
+    }
+    camera.bracketWidth = width;
+    camera.bracketHeight = height;
+    camera.bracketImages[sequence % k_hdrExposureCount] = Image::Create(pImage);
+
+    if (++camera.bracketFrames == k_hdrExposureCount)
+    {
+        ReserveSaveSlot(camera);
+        auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::shared_ptr<std::vector<ImagePtr> > images(new std::vector<ImagePtr>(k_hdrExposureCount));
+        images->swap(camera.bracketImages);
+        TriggeredCamera* pCamera = &camera;
+        camera.scheduler->Submit([pCamera, images, bracketIndex, t]() {
+            FuseBracket(*pCamera, *images, bracketIndex, t);
+        });
+        camera.bracketFrames = 0;
+        camera.bracketIndex++;
+    }
+}
+
+// This function acquires the frames of k_numTriggers triggers from a camera,
+// k_framesPerTrigger per trigger, and hands every complete one to the
+// workers to be saved. In HDR mode it hands them over per bracket instead,
+// to be fused and saved.
+void* AcquireImage(void* arg)
+{
+    TriggeredCamera& camera = *((TriggeredCamera*)arg);
+    CameraPtr pCam = camera.pCam;
+
+    int result = 0;
+    
+    try
+    {
+        // Device serial number for filename, read when the camera was configured
+        const std::string& serialNumber = camera.serialNumber;
         // Set acquisition mode to continuous
         CEnumerationPtr ptrAcquisitionMode = pCam->GetNodeMap().GetNode("AcquisitionMode");
         if (!IsAvailable(ptrAcquisitionMode) || !IsWritable(ptrAcquisitionMode))
@@ -458,6 +1052,7 @@ void* AcquireImage(void* arg)
                  << "). Aborting..." << endl
                  << endl;
 
+            camera.state = -1;
             return (void*)0;
         }
         CEnumEntryPtr ptrAcquisitionModeContinuous = ptrAcquisitionMode->GetEntryByName("Continuous");
@@ -467,70 +1062,106 @@ void* AcquireImage(void* arg)
                  << "). Aborting..." << endl
                  << endl;
 
+            camera.state = -1;
             return (void*)0;
         }
         int64_t acquisitionModeContinuous = ptrAcquisitionModeContinuous->GetValue();
         ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
         cout << "[" << serialNumber << "] "
-             << "Started acquiring images..." << endl;
+             << "Acquisition mode set to continuous..." << endl;
+
+        // Retrieve GenICam nodemap
+        INodeMap& nodeMap = pCam->GetNodeMap();
+
+        // Count hardware triggers from here on
+        if (camera.counterAvailable)
+        {
+            camera.counterAvailable = AccessTriggerCounter(nodeMap, true) == 0;
+        }
 
         // Begin acquiring images
         pCam->BeginAcquisition();
+        camera.state = 1;
         cout << "[" << serialNumber << "] "
              << "Started acquiring images..." << endl;
 
-        // Retrieve GenICam nodemap
-        INodeMap& nodeMap = pCam->GetNodeMap();
-
         //
-        // Retrieve, convert, and save single image for each camera
+        // Retrieve, convert, and save the frames of every trigger
         //
-
-        try
+        const unsigned int numFrames = k_numTriggers * k_framesPerTrigger;
+        uint64_t lastFrameId = 0;
+        for (unsigned int frameCnt = 0; frameCnt < numFrames; frameCnt++)
         {
-            // Retrieve the next image from the trigger
-            result = result | GrabNextImageByTrigger(nodeMap, pCam);
-            // Retrieve next received image and ensure image completion
-            ImagePtr pResultImage = pCam->GetNextImage(1000);
-            // Timestamp
-            auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-            std::stringstream ss;
-            ss << t;
-            if (pResultImage->IsIncomplete())
+            try
             {
-                cout << "[" << serialNumber << "] "
-                        << "Image incomplete with image status " << pResultImage->GetImageStatus() << "..." << endl
-                        << endl;
+                // Wait for the Enter key before each unpaced software trigger
+                if (chosenTrigger == SOFTWARE && k_triggerRate <= 0.0 && frameCnt % k_framesPerTrigger == 0)
+                {
+                    result = result | GrabNextImageByTrigger(nodeMap, pCam);
+                    camera.triggersIssued++;
+                }
+                // Retrieve next received image and ensure image completion
+                ImagePtr pResultImage = pCam->GetNextImage(k_grabTimeoutMs);
+
+                // Frame IDs count up by one per frame the camera sent
+                const uint64_t frameId = pResultImage->GetFrameID();
+                if (camera.framesReceived > 0 && frameId > lastFrameId + 1)
+                {
+                    camera.framesLost += frameId - lastFrameId - 1;
+                }
+                lastFrameId = frameId;
+                if (camera.framesReceived == 0)
+                {
+                    camera.firstTimestamp = pResultImage->GetTimeStamp();
+                    camera.firstFrameId = frameId;
+                }
+                camera.lastTimestamp = pResultImage->GetTimeStamp();
+                camera.framesReceived++;
+
+                if (pResultImage->IsIncomplete())
+                {
+                    camera.framesIncomplete++;
+                    ASYNC_LOG_RATE_LIMITED_BY(camera.logLimiters[CAMERA_LOG_INCOMPLETE], SEVERITY_WARNING, 1000,
+                                              "[{}] Image incomplete with image status {}...", serialNumber,
+                                              pResultImage->GetImageStatus());
+                }
+                else if (chosenHdr == HDR_BRACKETED)
+                {
+                    AddBracketFrame(camera, pResultImage, frameId);
+                }
+                else
+                {
+                    // Timestamp
+                    auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                    // Copy the frame out of its acquisition buffer, released
+                    // below, and leave converting and saving it to the workers
+                    ReserveSaveSlot(camera);
+                    ImagePtr copy = Image::Create(pResultImage);
+                    TriggeredCamera* pCamera = &camera;
+                    camera.scheduler->Submit(
+                        [pCamera, copy, frameCnt, t]() { SaveFrame(*pCamera, copy, frameCnt, t); });
+                }
+                // Release image
+                pResultImage->Release();
             }
-            else
+            catch (Spinnaker::Exception& e)
             {
-                // Convert image to mono 8
-                ImagePtr convertedImage = pResultImage->Convert(PixelFormat_Mono8, HQ_LINEAR);
-                // Create a unique filename
-                ostringstream filename;
-                filename << ss.str();
-                filename << "-";
-                if (serialNumber != "")
+                if (e.GetError() == SPINNAKER_ERR_TIMEOUT)
                 {
-                    filename << serialNumber.c_str();
+                    // The trigger source stopped, or its triggers were dropped
+                    ASYNC_LOG(SEVERITY_WARNING, "[{}] No frame for {} ms after {} frames, stopping",
+                              serialNumber, k_grabTimeoutMs, camera.framesReceived);
+                    break;
                 }
-                filename << ".jpg";
-                // Save image
-                convertedImage->Save(filename.str().c_str());
-                // Print image information
-                cout << "[" << serialNumber << "] "
-                        << "Grabbed image width = " << pResultImage->GetWidth()
-                        << ", height = " << pResultImage->GetHeight() << ". Image saved at " << filename.str() << endl;
+                ASYNC_LOG(SEVERITY_ERROR, "[{}] Error: {}", serialNumber, e.what());
             }
-            // Release image
-            pResultImage->Release();
-            
-            cout << endl;
         }
-        catch (Spinnaker::Exception& e)
+
+        // No more software triggers for this camera
+        camera.state = 2;
+        if (camera.counterAvailable)
         {
-            cout << "[" << serialNumber << "] "
-                    << "Error: " << e.what() << endl;
+            camera.triggersCounted = AccessTriggerCounter(nodeMap, false);
         }
 
         // End acquisition
@@ -538,8 +1169,14 @@ void* AcquireImage(void* arg)
         // // Deinitialize camera
         // pCam->DeInit();
 
+        // Reset sequencer
+        if (chosenHdr == HDR_BRACKETED)
+        {
+            result = result | ResetSequencer(nodeMap);
+        }
+
         // Reset trigger
-        result = result | ResetTrigger(nodeMap);
+        result = result | ResetTrigger(nodeMap, camera.previousOverlap);
 
         // Reset exposure
         result = result | ResetExposure(nodeMap);
@@ -549,12 +1186,22 @@ void* AcquireImage(void* arg)
     catch (Spinnaker::Exception& e)
     {
         cout << "Error: " << e.what() << endl;
+        if (camera.state == 0)
+        {
+            camera.state = -1;
+        }
 
         // Retrieve GenICam nodemap
         INodeMap& nodeMap = pCam->GetNodeMap();
         
+        // Reset sequencer
+        if (chosenHdr == HDR_BRACKETED)
+        {
+            result = result | ResetSequencer(nodeMap);
+        }
+
         // Reset trigger
-        result = result | ResetTrigger(nodeMap);
+        result = result | ResetTrigger(nodeMap, camera.previousOverlap);
 
         // Reset exposure
         result = result | ResetExposure(nodeMap);
@@ -562,6 +1209,177 @@ void* AcquireImage(void* arg)
         return (void*)0;
     }
 }
+// Arguments of the software trigger pacing thread
+struct TriggerPacerArgs
+{
+    TriggeredCamera* cameras;
+    unsigned int numCameras;
+};
+
+// This function executes the software trigger of every camera k_numTriggers
+// times at k_triggerRate, once all cameras are acquiring. Triggers are timed
+// against absolute deadlines so a late one does not delay the rest.
+void* PaceSoftwareTriggers(void* arg)
+{
+    TriggerPacerArgs& args = *((TriggerPacerArgs*)arg);
+    for (unsigned int i = 0; i < args.numCameras; i++)
+    {
+        while (args.cameras[i].state == 0)
+        {
+            usleep(1000);
+        }
+    }
+    const uint64_t periodNs = (uint64_t)(1e9 / k_triggerRate);
+    const uint64_t start = GetMonotonicNs();
+    for (unsigned int t = 0; t < k_numTriggers; t++)
+    {
+        const uint64_t deadline = start + t * periodNs;
+        struct timespec ts;
+        ts.tv_sec = (time_t)(deadline / 1000000000ULL);
+        ts.tv_nsec = (long)(deadline % 1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        {
+        }
+        for (unsigned int i = 0; i < args.numCameras; i++)
+        {
+            TriggeredCamera& camera = args.cameras[i];
+            if (camera.state != 1)
+            {
+                continue;
+            }
+            try
+            {
+                camera.triggerSoftware->Execute();
+                camera.triggersIssued++;
+            }
+            catch (Spinnaker::Exception& e)
+            {
+                ASYNC_LOG_RATE_LIMITED_BY(camera.logLimiters[CAMERA_LOG_TRIGGER_FAILED], SEVERITY_ERROR, 1000,
+                                          "[{}] Unable to execute trigger: {}", camera.serialNumber, e.what());
+            }
+        }
+    }
+    return (void*)1;
+}
+
+// This function prints the frame rate a camera achieved against the
+// requested one and how many of its triggers were dropped.
+void PrintTriggerReport(const TriggeredCamera& camera)
+{
+    const std::string prefix = "[" + camera.serialNumber + "] ";
+    const double seconds = (camera.lastTimestamp - camera.firstTimestamp) / 1e9;
+    const double requestedRate = k_triggerRate * k_framesPerTrigger;
+    cout << prefix << camera.framesReceived << " frames of " << k_numTriggers * k_framesPerTrigger << " expected";
+    if (camera.framesReceived > 1 && seconds > 0.0)
+    {
+        const double achievedRate = (camera.framesReceived - 1 + camera.framesLost) / seconds;
+        cout << " in " << seconds << " s: " << achievedRate << " fps";
+        if (requestedRate > 0.0)
+        {
+            cout << " of " << requestedRate << " fps requested (" << (int)(achievedRate * 100.0 / requestedRate)
+                 << "%)";
+        }
+    }
+    cout << endl;
+    if (camera.resultingFrameRate > 0.0)
+    {
+        cout << prefix << "Camera limit with this exposure and overlap: " << camera.resultingFrameRate << " fps"
+             << endl;
+    }
+
+    // A trigger produced its frames if any of them left the camera
+    const uint64_t framesSent = camera.framesReceived + camera.framesLost;
+    const int64_t triggersServed = (int64_t)((framesSent + k_framesPerTrigger - 1) / k_framesPerTrigger);
+    const int64_t triggers = chosenTrigger == SOFTWARE ? (int64_t)camera.triggersIssued.load() : camera.triggersCounted;
+    if (triggers >= 0)
+    {
+        cout << prefix << triggers << " triggers, " << std::max<int64_t>(0, triggers - triggersServed) << " dropped";
+    }
+    else
+    {
+        cout << prefix << "Trigger count unavailable";
+    }
+    cout << "; " << camera.framesLost << " frames lost in transport, " << camera.framesIncomplete << " incomplete"
+         << endl;
+}
+
+// This function prints how many of the grabbed frames (fused brackets in HDR
+// mode) were saved and whether saving on the workers kept up: the grab
+// thread only waits for them once k_maxPendingSaves are queued.
+void PrintSaveReport(const TriggeredCamera& camera)
+{
+    const std::string prefix = "[" + camera.serialNumber + "] ";
+    const bool hdr = chosenHdr == HDR_BRACKETED;
+    const uint64_t saved = hdr ? camera.bracketsFused.load() : camera.framesSaved.load();
+    if (hdr)
+    {
+        cout << prefix << saved << " brackets of " << k_hdrExposureCount << " exposures fused and saved, "
+             << camera.bracketsDropped << " dropped";
+    }
+    else
+    {
+        cout << prefix << saved << " frames saved of " << camera.framesReceived - camera.framesIncomplete
+             << " complete frames grabbed";
+    }
+    if (camera.saveFailures > 0)
+    {
+        cout << ", " << camera.saveFailures << " failed";
+    }
+    cout << endl;
+    if (saved + camera.saveFailures == 0)
+    {
+        return;
+    }
+    const char* unit = hdr ? "bracket" : "frame";
+    const double meanMs = camera.saveNsTotal / 1e6 / (saved + camera.saveFailures);
+    cout << prefix << "Save: " << meanMs << " ms mean, " << camera.saveNsMax / 1e6 << " ms max per " << unit
+         << " on " << camera.scheduler->GetNumWorkers() << " workers, queue peak " << camera.savesPendingPeak
+         << " of " << k_maxPendingSaves;
+    if (camera.saveWaits > 0)
+    {
+        cout << "; the grab thread waited " << camera.saveWaitNs / 1e6 << " ms for " << camera.saveWaits << " "
+             << unit << "s (falls behind)" << endl;
+    }
+    else
+    {
+        cout << " (keeps up)" << endl;
+    }
+}
+
+// This function prints the time fusion alone takes per bracket. Whether the
+// workers keep up with the bracket rate is in the save report.
+void PrintHdrReport(const TriggeredCamera& camera)
+{
+    const uint64_t fused = camera.bracketsFused + camera.saveFailures;
+    if (fused == 0)
+    {
+        return;
+    }
+    cout << "[" << camera.serialNumber << "] Fusion (" << GetHdrKernelName(camera.fusion.GetKernel())
+         << ", one band per bracket): " << camera.fuseNsTotal / 1e6 / fused << " ms mean, "
+         << camera.fuseNsMax / 1e6 << " ms max" << endl;
+}
+
+// This function reads the frame rate the camera can sustain with its
+// current exposure, trigger overlap and readout settings. Returns 0 if the
+// camera does not report it.
+double GetResultingFrameRate(INodeMap& nodeMap)
+{
+    try
+    {
+        CFloatPtr ptrResultingFrameRate = nodeMap.GetNode("AcquisitionResultingFrameRate");
+        if (IsAvailable(ptrResultingFrameRate) && IsReadable(ptrResultingFrameRate))
+        {
+            return ptrResultingFrameRate->GetValue();
+        }
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Unable to read the resulting frame rate: " << e.what() << ". Non-fatal error..." << endl;
+    }
+    return 0.0;
+}
+
 // This function acts as the body of the example
 int RunMultipleCameras(CameraList camList)
 {
@@ -572,10 +1390,12 @@ int RunMultipleCameras(CameraList camList)
     {
         // Retrieve camera list size
         camListSize = camList.GetSize();
-        // Create an array of CameraPtrs. This array maintenances smart pointer's reference
+        // Create an array of cameras. This array maintenances smart pointer's reference
         // count when CameraPtr is passed into grab thread as void pointer
         // Create an array of handles
-        CameraPtr* pCamList = new CameraPtr[camListSize];
+        TriggeredCamera* cameras = new TriggeredCamera[camListSize];
+        // Saving and fusion of every camera run on one pool
+        TaskScheduler scheduler;
 
         pthread_t* grabThreads = new pthread_t[camListSize];
 
@@ -609,7 +1429,7 @@ int RunMultipleCameras(CameraList camList)
             INodeMap& nodeMap = pCam->GetNodeMap();
 
             // 配置触发模式
-            err = ConfigureTrigger(nodeMap);
+            err = ConfigureTrigger(nodeMap, cameras[i].previousOverlap);
             if (err < 0)
             {
                 cout << "Configure trigger failed" << endl;
@@ -623,18 +1443,63 @@ int RunMultipleCameras(CameraList camList)
                 cout << "Configure exposure failed" << endl;
                 return err;
             }
+
+            // HDR模式下由序列器循环切换曝光时间，每次触发得到一组包围曝光
+            if (chosenHdr == HDR_BRACKETED)
+            {
+                double exposures[k_hdrMaxExposures];
+                err = ConfigureSequencer(nodeMap, exposures);
+                if (err < 0 || cameras[i].fusion.Configure(exposures, k_hdrExposureCount) < 0)
+                {
+                    cout << "Configure sequencer failed" << endl;
+                    return -1;
+                }
+                cameras[i].bracketImages.resize(k_hdrExposureCount);
+            }
+            cameras[i].scheduler = &scheduler;
+
+            // 软件触发按固定频率执行；硬件触发用计数器统计触发次数
+            cameras[i].serialNumber = serialNumber;
+            if (chosenTrigger == SOFTWARE)
+            {
+                cameras[i].triggerSoftware = nodeMap.GetNode("TriggerSoftware");
+                if (!IsAvailable(cameras[i].triggerSoftware) || !IsWritable(cameras[i].triggerSoftware))
+                {
+                    cout << "Unable to execute trigger. Aborting..." << endl;
+                    return -1;
+                }
+            }
+            else
+            {
+                cameras[i].counterAvailable = ConfigureTriggerCounter(nodeMap) == 0;
+            }
+            cameras[i].resultingFrameRate = GetResultingFrameRate(nodeMap);
         }
 
         // 为每个相机创建一个线程获取图像
         for (unsigned int i = 0; i < camListSize; i++)
         {
             // Select camera
-            pCamList[i] = camList.GetByIndex(i);
+            cameras[i].pCam = camList.GetByIndex(i);
             // Start grab thread
-            int err = pthread_create(&(grabThreads[i]), nullptr, &AcquireImage, &pCamList[i]);
+            int err = pthread_create(&(grabThreads[i]), nullptr, &AcquireImage, &cameras[i]);
             assert(err == 0);
         }
 
+        // 软件触发时由一个线程同时触发所有相机
+        pthread_t pacerThread;
+        TriggerPacerArgs pacerArgs = {cameras, camListSize};
+        const bool paced = chosenTrigger == SOFTWARE && k_triggerRate > 0.0;
+        if (paced)
+        {
+            int err = pthread_create(&pacerThread, nullptr, &PaceSoftwareTriggers, &pacerArgs);
+            assert(err == 0);
+        }
+        else if (chosenTrigger == HARDWARE)
+        {
+            cout << "Use the hardware to trigger image acquisition at " << k_triggerRate << " Hz." << endl;
+        }
+
         for (unsigned int i = 0; i < camListSize; i++)
         {
             // Wait for all threads to finish
@@ -654,16 +1519,36 @@ int RunMultipleCameras(CameraList camList)
                 result = -1;
             }
         }
+        if (paced)
+        {
+            pthread_join(pacerThread, nullptr);
+        }
+
+        // Let the workers save the last frames, then write out the log
+        // before the report
+        scheduler.WaitIdle();
+        AsyncLogger::Instance().Flush();
+        cout << endl << "*** TRIGGER RATE ***" << endl << endl;
+        for (unsigned int i = 0; i < camListSize; i++)
+        {
+            PrintTriggerReport(cameras[i]);
+            PrintSaveReport(cameras[i]);
+            if (chosenHdr == HDR_BRACKETED)
+            {
+                PrintHdrReport(cameras[i]);
+            }
+        }
+        cout << endl;
 
         // Clear CameraPtr array and close all handles
         for (unsigned int i = 0; i < camListSize; i++)
         {
             // Deinitialize camera
-            pCamList[i]->DeInit();
-            pCamList[i] = 0;
+            cameras[i].pCam->DeInit();
+            cameras[i].pCam = 0;
         }
         // Delete array pointer
-        delete[] pCamList;
+        delete[] cameras;
         // Delete array pointer
         delete[] grabThreads;
     }
@@ -675,7 +1560,9 @@ int RunMultipleCameras(CameraList camList)
     return result;
 }
 
-// 多个相机配置成硬件触发模式，同步硬件触发采集图像，每个相机每次触发只获取一张图像
+// 多个相机配置成硬件触发模式，同步硬件触发采集图像，每个相机每次触发获取k_framesPerTrigger张图像
+// HDR模式下每次触发采集一组不同曝光的图像，在主机上融合成一张高动态范围图像
+// 开启触发重叠以接近传感器最高帧率，结束时统计实际帧率和丢失的触发
 int main(int /*argc*/, char** /*argv*/)
 {
     // Since this application saves images in the current folder
@@ -720,6 +1607,8 @@ int main(int /*argc*/, char** /*argv*/)
     // Run example on all cameras
     cout << endl << "Running example for all cameras..." << endl;
     result = RunMultipleCameras(camList);
+    // Write out everything the grab threads logged
+    AsyncLogger::Instance().Shutdown();
     cout << "Example complete..." << endl << endl;
     // Clear camera list before releasing system
     camList.Clear();
@@ -0,0 +1,254 @@
+/*
+ * @Descripttion: Bench output test: every line the bench target prints on stdout is one JSON object
+ * @version:
+ * @Date: 2026-10-20 05:44:15
+ * @LastEditTime: 2026-10-20 05:44:15
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "test_common.h"
+
+using namespace std;
+
+// Just enough of a JSON parser to tell whether a line is valid JSON
+class JsonValidator
+{
+  public:
+    explicit JsonValidator(const string& text) : m_text(text), m_pos(0)
+    {
+    }
+
+    // Whether the whole text is a single JSON object
+    bool IsObject()
+    {
+        SkipSpace();
+        if (Peek() != '{' || !ParseValue())
+        {
+            return false;
+        }
+        SkipSpace();
+        return m_pos == m_text.size();
+    }
+
+  private:
+    char Peek() const
+    {
+        return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+    }
+
+    void SkipSpace()
+    {
+        while (m_pos < m_text.size() && isspace((unsigned char)m_text[m_pos]))
+        {
+            m_pos++;
+        }
+    }
+
+    bool Expect(const char* literal)
+    {
+        const size_t length = strlen(literal);
+        if (m_text.compare(m_pos, length, literal) != 0)
+        {
+            return false;
+        }
+        m_pos += length;
+        return true;
+    }
+
+    bool ParseValue()
+    {
+        SkipSpace();
+        switch (Peek())
+        {
+        case '{':
+            return ParseContainer('}', true);
+        case '[':
+            return ParseContainer(']', false);
+        case '"':
+            return ParseString();
+        case 't':
+            return Expect("true");
+        case 'f':
+            return Expect("false");
+        case 'n':
+            return Expect("null");
+        default:
+            return ParseNumber();
+        }
+    }
+
+    // An object (members are "key": value) or an array
+    bool ParseContainer(char close, bool members)
+    {
+        m_pos++;
+        SkipSpace();
+        if (Peek() == close)
+        {
+            m_pos++;
+            return true;
+        }
+        while (true)
+        {
+            if (members)
+            {
+                SkipSpace();
+                if (Peek() != '"' || !ParseString())
+                {
+                    return false;
+                }
+                SkipSpace();
+                if (Peek() != ':')
+                {
+                    return false;
+                }
+                m_pos++;
+            }
+            if (!ParseValue())
+            {
+                return false;
+            }
+            SkipSpace();
+            if (Peek() == ',')
+            {
+                m_pos++;
+                continue;
+            }
+            if (Peek() != close)
+            {
+                return false;
+            }
+            m_pos++;
+            return true;
+        }
+    }
+
+    bool ParseString()
+    {
+        m_pos++;
+        while (m_pos < m_text.size())
+        {
+            const char c = m_text[m_pos++];
+            if (c == '"')
+            {
+                return true;
+            }
+            if ((unsigned char)c < 0x20)
+            {
+                return false;
+            }
+            if (c == '\\')
+            {
+                if (m_pos >= m_text.size() || strchr("\"\\/bfnrtu", m_text[m_pos]) == nullptr)
+                {
+                    return false;
+                }
+                if (m_text[m_pos++] == 'u')
+                {
+                    for (int i = 0; i < 4; i++, m_pos++)
+                    {
+                        if (m_pos >= m_text.size() || !isxdigit((unsigned char)m_text[m_pos]))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, which rules out nan and inf
+    bool ParseNumber()
+    {
+        if (Peek() == '-')
+        {
+            m_pos++;
+        }
+        if (Peek() == '0')
+        {
+            m_pos++;
+        }
+        else if (!SkipDigits())
+        {
+            return false;
+        }
+        if (Peek() == '.')
+        {
+            m_pos++;
+            if (!SkipDigits())
+            {
+                return false;
+            }
+        }
+        if (Peek() == 'e' || Peek() == 'E')
+        {
+            m_pos++;
+            if (Peek() == '+' || Peek() == '-')
+            {
+                m_pos++;
+            }
+            if (!SkipDigits())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SkipDigits()
+    {
+        const size_t start = m_pos;
+        while (isdigit((unsigned char)Peek()))
+        {
+            m_pos++;
+        }
+        return m_pos > start;
+    }
+
+    const string& m_text;
+    size_t m_pos;
+};
+
+// Runs every bench case once, with the shortest measurement, and checks that
+// each line on stdout is a JSON object, so "bench > results.jsonl" loads as
+// is. Log lines and progress belong on stderr, which is left alone.
+static void TestBenchOutput(const TestOptions& options)
+{
+    if (options.benchPath.empty())
+    {
+        fprintf(stderr, "No --bench=<path> given, bench output not checked\n");
+        return;
+    }
+    const string command = options.benchPath + " --min-time=0 --min-iters=1 --output-dir=" + options.outputDir;
+    FILE* output = popen(command.c_str(), "r");
+    if (!TEST_CHECK(output != nullptr))
+    {
+        return;
+    }
+    unsigned int lines = 0;
+    string line;
+    char buffer[4096];
+    while (fgets(buffer, sizeof(buffer), output) != nullptr)
+    {
+        line += buffer;
+        if (line.empty() || line[line.size() - 1] != '\n')
+        {
+            continue;
+        }
+        line.erase(line.size() - 1);
+        lines++;
+        if (!TEST_CHECK(JsonValidator(line).IsObject()))
+        {
+            fprintf(stderr, "Not a JSON object: %s\n", line.c_str());
+        }
+        line.clear();
+    }
+    TEST_CHECK(line.empty());
+    TEST_CHECK(pclose(output) == 0);
+    TEST_CHECK(lines > 0);
+}
+
+TEST_REGISTER("bench_output", TestBenchOutput);
@@ -0,0 +1,132 @@
+/*
+ * @Descripttion: Clock sync tests: drift, offset, outlier rejection and error bound on simulated camera clocks
+ * @version:
+ * @Date: 2026-10-20 07:44:05
+ * @LastEditTime: 2026-10-20 07:44:05
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "clock_simulation.h"
+#include "test_common.h"
+
+using namespace std;
+
+// Clocks with a constant drift, so the rate the fit must find is known, and
+// how far the fit may be off after a minute of latches
+struct DriftCase
+{
+    SimulatedCameraClock clock;
+    double driftTolerancePpm;
+    double offsetToleranceNs;
+};
+
+const DriftCase k_driftCases[] = {
+    {{"steady", 5e9, 30.0, 0.0, 0.0, 40e3, 20e3, 0.0, 0.0, 0.0}, 1.0, 20e3},
+    {{"jittery", 120e9, -80.0, 0.0, 0.0, 100e3, 150e3, 0.0, 0.0, 0.0}, 3.0, 50e3},
+};
+
+// Latches per simulated session, one per second
+const unsigned int k_clockTestLatches = 64;
+
+// This function checks the fit against the simulated clock: its drift against
+// the rate error of the camera clock, and the host time it maps the device
+// time of the last latch to against the true host time.
+static bool CheckFit(const ClockModel& model, const DriftCase& driftCase, const ClockSyncConfig& config)
+{
+    const SimulatedCameraClock& clock = driftCase.clock;
+    // host - device falls by driftPpm per device ns the camera clock gains
+    const double drift = -clock.driftPpm * 1e-6 / (1.0 + clock.driftPpm * 1e-6);
+    const double t = (k_clockTestLatches - 1) * 1e9;
+    const SyncedTimestamp synced = model.GetFit().Map((uint64_t)clock.DeviceAt(t), config);
+    const double offsetError = (double)synced.monotonic - (k_simulationHostStartNs + t);
+    const bool driftOk = TEST_CHECK(fabs(model.GetFit().drift - drift) * 1e6 <= driftCase.driftTolerancePpm);
+    const bool offsetOk = TEST_CHECK(synced.valid && fabs(offsetError) <= driftCase.offsetToleranceNs);
+    if (!driftOk || !offsetOk)
+    {
+        fprintf(stderr, "%s: drift off by %.3f ppm, offset off by %.1f us\n", clock.name,
+                (model.GetFit().drift - drift) * 1e6, offsetError / 1e3);
+    }
+    return driftOk && offsetOk;
+}
+
+// The fit recovers the drift and offset of each clock from its latches
+static void CheckDriftAndOffset()
+{
+    for (size_t c = 0; c < sizeof(k_driftCases) / sizeof(k_driftCases[0]); c++)
+    {
+        ClockSyncConfig config;
+        ClockModel model(config);
+        SimulationRandom random(c + 1);
+        for (unsigned int i = 0; i < k_clockTestLatches; i++)
+        {
+            model.AddSample(SimulateLatch(k_driftCases[c].clock, random, i * 1e9));
+        }
+        CheckFit(model, k_driftCases[c], config);
+    }
+}
+
+// Once the fit is established, every 7th latch reads a value 1 ms off and
+// every 11th takes 3 ms longer than usual. Each of them is rejected for what
+// it is, the fit never restarts, and it still recovers drift and offset.
+static void CheckOutliers()
+{
+    const DriftCase& driftCase = k_driftCases[0];
+    ClockSyncConfig config;
+    ClockModel model(config);
+    SimulationRandom random(3);
+    unsigned int injected = 0;
+    unsigned int rejected = 0;
+    for (unsigned int i = 0; i < k_clockTestLatches; i++)
+    {
+        ClockSample sample = SimulateLatch(driftCase.clock, random, i * 1e9);
+        clockSampleResult expected = CLOCK_SAMPLE_ACCEPTED;
+        if (i >= 10 && i % 7 == 0)
+        {
+            sample.deviceTimestamp += (i % 2 == 0 ? 1000000 : -1000000);
+            expected = CLOCK_SAMPLE_OUTLIER;
+        }
+        else if (i >= 10 && i % 11 == 0)
+        {
+            sample.hostAfter += 3000000;
+            expected = CLOCK_SAMPLE_SLOW_LATCH;
+        }
+        const clockSampleResult result = model.AddSample(sample);
+        TEST_CHECK(result != CLOCK_SAMPLE_RESET);
+        if (expected != CLOCK_SAMPLE_ACCEPTED)
+        {
+            injected++;
+            rejected += TEST_CHECK(result == expected) ? 1 : 0;
+        }
+    }
+    TEST_CHECK(injected > 0 && rejected == injected);
+    CheckFit(model, driftCase, config);
+}
+
+// An hour at 30 fps of every simulated clock of the bench: the error bound
+// reported with every mapped frame timestamp covers its true error, and
+// frames are only left unmapped while the fit starts or restarts.
+static void CheckErrorBound()
+{
+    for (size_t c = 0; c < k_numSimulatedClocks; c++)
+    {
+        const SimulationReport report = Simulate(k_simulatedClocks[c], 3600.0, 30.0);
+        const uint64_t mapped = report.frames - report.unmapped;
+        const bool covered = TEST_CHECK(mapped > 0 && report.withinBound >= mapped - mapped / 1000);
+        TEST_CHECK(report.unmapped * 100 < report.frames);
+        if (!covered)
+        {
+            fprintf(stderr, "%s: %llu of %llu frames within the bound\n", k_simulatedClocks[c].name,
+                    (unsigned long long)report.withinBound, (unsigned long long)mapped);
+        }
+    }
+}
+
+static void TestClockSync(const TestOptions&)
+{
+    CheckDriftAndOffset();
+    CheckOutliers();
+    CheckErrorBound();
+}
+
+TEST_REGISTER("clock_sync", TestClockSync);
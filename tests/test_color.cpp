@@ -0,0 +1,73 @@
+/*
+ * @Descripttion: Color pipeline tests: SIMD and banded kernels against the scalar one on synthetic Bayer charts
+ * @version:
+ * @Date: 2026-10-20 06:34:07
+ * @LastEditTime: 2026-10-20 06:34:07
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "color_chart.h"
+#include "test_common.h"
+
+using namespace std;
+
+// Every demosaic method into both outputs gives the scalar kernel's bytes
+// with SSE2, on the calling thread and over TaskScheduler bands, also at a
+// size that leaves partial vectors and bands. Bilinear BGR8 stays within
+// one level of the floating point reference, and every output is close to
+// the chart it was captured from.
+static void TestColorPipeline(const TestOptions&)
+{
+    const unsigned int sizes[][2] = {{1440, 1080}, {646, 486}};
+    TaskScheduler scheduler;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        const unsigned int width = sizes[s][0];
+        const unsigned int height = sizes[s][1];
+        const vector<uint8_t> chart = MakeColorChart(width, height);
+        const vector<uint8_t> bayer = MakeBayerChart(chart, width, height);
+        for (int method = 0; method < NUM_DEMOSAIC_METHODS; method++)
+        {
+            for (int output = 0; output < NUM_COLOR_OUTPUTS; output++)
+            {
+                ColorConfig config;
+                config.demosaic = (demosaicMethod)method;
+                config.output = (colorOutput)output;
+                for (int c = 0; c < 3; c++)
+                {
+                    config.whiteBalance[c] = k_chartWhiteBalance[c];
+                }
+                ColorPipeline pipeline;
+                pipeline.Configure(config);
+                ColorFrame scalarFrame;
+                ColorFrame simdFrame;
+                ColorFrame bandedFrame;
+                pipeline.SetKernel(COLOR_KERNEL_SCALAR);
+                pipeline.Process(&bayer[0], width, width, height, scalarFrame);
+                pipeline.SetKernel(COLOR_KERNEL_SSE2);
+                pipeline.Process(&bayer[0], width, width, height, simdFrame);
+                pipeline.Process(&bayer[0], width, width, height, bandedFrame, &scheduler);
+
+                const bool simdMatches = TEST_CHECK(simdFrame.data == scalarFrame.data);
+                const bool bandedMatches = TEST_CHECK(bandedFrame.data == scalarFrame.data);
+                const double psnr = GetPsnr(chart, scalarFrame);
+                const bool close = TEST_CHECK(psnr > 30.0);
+                bool nearReference = true;
+                if (method == DEMOSAIC_BILINEAR && output == COLOR_OUTPUT_BGR8)
+                {
+                    const vector<uint8_t> reference = DemosaicReference(bayer, width, height);
+                    nearReference =
+                        TEST_CHECK(GetMaxDifference(&scalarFrame.data[0], &reference[0], width, height) <= 1);
+                }
+                if (!simdMatches || !bandedMatches || !close || !nearReference)
+                {
+                    fprintf(stderr, "%s to %s at %ux%u, PSNR %.1f dB\n", GetDemosaicMethodName((demosaicMethod)method),
+                            output == COLOR_OUTPUT_BGR8 ? "bgr8" : "yuv420", width, height, psnr);
+                }
+            }
+        }
+    }
+}
+
+TEST_REGISTER("color", TestColorPipeline);
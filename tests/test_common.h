@@ -0,0 +1,74 @@
+/*
+ * @Descripttion: Registry and checks shared by the tests target
+ * @version:
+ * @Date: 2026-10-20 05:12:36
+ * @LastEditTime: 2026-10-20 05:12:36
+ */
+
+#ifndef DUAL_CAM_RECORDER_TEST_COMMON_H
+#define DUAL_CAM_RECORDER_TEST_COMMON_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Options shared by every test group, set from the command line
+struct TestOptions
+{
+    std::string filter;    // run only groups whose name contains this
+    std::string outputDir; // scratch directory for groups that write files
+    std::string benchPath; // bench executable, for the group checking its output
+
+    TestOptions() : outputDir("/tmp")
+    {
+    }
+};
+
+// Checks that failed in the running group
+inline unsigned int& GetTestFailures()
+{
+    static unsigned int failures = 0;
+    return failures;
+}
+
+// Counts a failed check and says which on stderr; the run goes on so that one
+// run shows every failure
+inline bool TestCheck(bool passed, const char* expression, const char* file, int line)
+{
+    if (!passed)
+    {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+        GetTestFailures()++;
+    }
+    return passed;
+}
+
+#define TEST_CHECK(condition) TestCheck((condition), #condition, __FILE__, __LINE__)
+
+typedef void (*TestFunction)(const TestOptions& options);
+
+struct TestEntry
+{
+    const char* name;
+    TestFunction function;
+};
+
+inline std::vector<TestEntry>& GetTestRegistry()
+{
+    static std::vector<TestEntry> registry;
+    return registry;
+}
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, TestFunction function)
+    {
+        TestEntry entry = {name, function};
+        GetTestRegistry().push_back(entry);
+    }
+};
+
+// Registers a test group; each source file in tests/ registers its own
+#define TEST_REGISTER(name, function) static TestRegistrar s_testRegistrar_##function(name, function)
+
+#endif // DUAL_CAM_RECORDER_TEST_COMMON_H
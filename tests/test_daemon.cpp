@@ -0,0 +1,162 @@
+/*
+ * @Descripttion: Capture daemon tests: the command protocol and a recording on synthetic cameras
+ * @version:
+ * @Date: 2026-10-20 05:31:48
+ * @LastEditTime: 2026-10-20 05:31:48
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "capture_daemon.h"
+#include "capture_protocol.h"
+#include "test_common.h"
+
+using namespace std;
+
+const unsigned int k_daemonCameras = 2;
+const double k_daemonFrameRate = 200.0;
+
+// Removes a session directory written by the daemon
+static void RemoveSession(const string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        const string name = entry->d_name;
+        if (name != "." && name != "..")
+        {
+            remove((directory + "/" + name).c_str());
+        }
+    }
+    closedir(dir);
+    rmdir(directory.c_str());
+}
+
+// Sends a raw request and returns the response status, or -1
+static int RawCall(int fd, uint8_t command, const vector<uint8_t>& payload, uint8_t version = k_captureVersion)
+{
+    vector<uint8_t> message;
+    CapturePayloadWriter writer(message);
+    writer.U32(k_captureMagic);
+    writer.U8(version);
+    writer.U8(command);
+    writer.U16(0);
+    writer.U32(7);
+    writer.U32((uint32_t)payload.size());
+    writer.Raw(payload.empty() ? nullptr : &payload[0], payload.size());
+    CaptureMessage response;
+    if (!WriteCaptureBytes(fd, &message[0], message.size()) || ReceiveCaptureMessage(fd, response) < 0 ||
+        response.sequence != 7)
+    {
+        return -1;
+    }
+    return response.status;
+}
+
+// The client commands against synthetic 1.6 MP cameras
+static void CheckCommands(const string& socketPath, CaptureDaemon& daemon)
+{
+    CaptureClient client;
+    if (!TEST_CHECK(client.Connect(socketPath) >= 0))
+    {
+        return;
+    }
+    vector<CaptureCameraStatus> statuses;
+    if (!TEST_CHECK(client.Status(statuses) == CAPTURE_OK && statuses.size() == k_daemonCameras))
+    {
+        return;
+    }
+
+    vector<pair<captureParameter, double> > parameters;
+    parameters.push_back(make_pair(CAPTURE_PARAM_EXPOSURE_US, 2000.0));
+    parameters.push_back(make_pair(CAPTURE_PARAM_GAIN_DB, 6.0));
+    if (TEST_CHECK(client.Reconfigure(1, parameters, statuses) == CAPTURE_OK))
+    {
+        TEST_CHECK(statuses[0].exposureUs == 2000.0 && statuses[0].gainDb == 6.0 && statuses[1].gainDb == 0.0);
+    }
+    parameters.assign(1, make_pair(CAPTURE_PARAM_EXPOSURE_US, -1.0));
+    TEST_CHECK(client.Reconfigure(k_captureAllCameras, parameters, statuses) == CAPTURE_CAMERA_ERROR);
+    TEST_CHECK(client.Start(1U << k_daemonCameras, 0, statuses) == CAPTURE_BAD_CAMERA);
+
+    CaptureSnapshot snapshot;
+    TEST_CHECK(client.Snapshot(k_daemonCameras, 100, snapshot) == CAPTURE_BAD_CAMERA);
+    TEST_CHECK(client.Snapshot(1, 1000, snapshot) == CAPTURE_OK && snapshot.pixels.size() == 1440 * 1080 &&
+               snapshot.width == 1440);
+
+    // Five frames per camera, then the session is closed by STOP
+    if (!TEST_CHECK(client.Start(k_captureAllCameras, 5, statuses) == CAPTURE_OK))
+    {
+        return;
+    }
+    const uint64_t deadline = GetMonotonicNs() + 2000000000ULL;
+    while (GetMonotonicNs() < deadline && client.Status(statuses) == CAPTURE_OK &&
+           (statuses[0].recording || statuses[1].recording))
+    {
+        usleep(1000);
+    }
+    if (TEST_CHECK(client.Stop(k_captureAllCameras, statuses) == CAPTURE_OK))
+    {
+        TEST_CHECK(statuses[0].framesRecorded == 5 && statuses[1].framesRecorded == 5);
+        TEST_CHECK(statuses[0].firstFrameLatencyNs > 0);
+    }
+    const string session = daemon.GetSessionDirectory();
+    TEST_CHECK(!session.empty());
+    RemoveSession(session);
+}
+
+// Malformed requests are answered and keep the connection usable
+static void CheckMalformedRequests(const string& socketPath)
+{
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    if (!TEST_CHECK(fd >= 0 && connect(fd, (const struct sockaddr*)&address, sizeof(address)) == 0))
+    {
+        close(fd);
+        return;
+    }
+    const vector<uint8_t> shortPayload(3, 0);
+    TEST_CHECK(RawCall(fd, CAPTURE_START, shortPayload) == CAPTURE_BAD_REQUEST);
+    TEST_CHECK(RawCall(fd, NUM_CAPTURE_COMMANDS, vector<uint8_t>()) == CAPTURE_UNKNOWN_COMMAND);
+    TEST_CHECK(RawCall(fd, CAPTURE_STATUS, vector<uint8_t>(), k_captureVersion + 1) == CAPTURE_UNKNOWN_COMMAND);
+    TEST_CHECK(RawCall(fd, CAPTURE_STATUS, vector<uint8_t>()) == CAPTURE_OK);
+    close(fd);
+}
+
+// The daemon answers every command, malformed ones included, as the protocol
+// says, and a recording lands in the session directory
+static void TestCaptureDaemon(const TestOptions& options)
+{
+    vector<unique_ptr<CaptureCamera> > cameras;
+    for (unsigned int i = 0; i < k_daemonCameras; i++)
+    {
+        cameras.push_back(unique_ptr<CaptureCamera>(
+            new SyntheticCamera("synthetic" + to_string(i), 1440, 1080, k_daemonFrameRate, 0)));
+    }
+    CaptureDaemonConfig config;
+    config.socketPath = options.outputDir + "/test_daemon.sock";
+    config.storage.directory = options.outputDir;
+    config.storage.segmentMaxBytes = 64ULL << 20;
+    CaptureDaemon daemon(config, cameras);
+    if (!TEST_CHECK(daemon.Start() >= 0))
+    {
+        return;
+    }
+    CheckCommands(config.socketPath, daemon);
+    CheckMalformedRequests(config.socketPath);
+    daemon.Stop();
+}
+
+TEST_REGISTER("daemon", TestCaptureDaemon);
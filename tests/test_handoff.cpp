@@ -0,0 +1,203 @@
+/*
+ * @Descripttion: Frame handoff tests: image events copied into frames with their state, incomplete ones diagnosed
+ * @version:
+ * @Date: 2026-10-20 07:24:10
+ * @LastEditTime: 2026-10-20 07:24:10
+ */
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "frame_queue.h"
+#include "stream_diagnostics.h"
+#include "test_common.h"
+
+using namespace std;
+using namespace Spinnaker;
+
+// Status of an image with missing packets, as the driver reports it
+const ImageStatus k_handoffMissingPackets = (ImageStatus)3;
+
+// An image as an image event handler receives it, without a camera. Its
+// buffer is the driver's: the handler has to be done with it on return.
+struct SyntheticImage
+{
+    vector<uint8_t> buffer;
+    unsigned int width;
+    unsigned int height;
+    bool incomplete;
+    ImageStatus status;
+    uint64_t frameId;
+    uint64_t timestamp;
+
+    SyntheticImage(unsigned int w, unsigned int h)
+        : buffer(w * h), width(w), height(h), incomplete(false), status(), frameId(0), timestamp(0)
+    {
+        for (size_t i = 0; i < buffer.size(); i++)
+        {
+            buffer[i] = (uint8_t)(i * 7);
+        }
+    }
+
+    bool IsIncomplete() const
+    {
+        return incomplete;
+    }
+
+    ImageStatus GetImageStatus() const
+    {
+        return status;
+    }
+
+    uint64_t GetFrameID() const
+    {
+        return frameId;
+    }
+
+    uint64_t GetTimeStamp() const
+    {
+        return timestamp;
+    }
+
+    size_t GetImageSize() const
+    {
+        return buffer.size();
+    }
+
+    void* GetData() const
+    {
+        return (void*)&buffer[0];
+    }
+
+    size_t GetWidth() const
+    {
+        return width;
+    }
+
+    size_t GetHeight() const
+    {
+        return height;
+    }
+
+    PixelFormatEnums GetPixelFormat() const
+    {
+        return PixelFormat_Mono8;
+    }
+};
+
+// This function allocates the copy of a frame, counting the allocations.
+static std::shared_ptr<uint8_t> AllocateCounted(size_t size, unsigned int& allocations)
+{
+    allocations++;
+    return std::shared_ptr<uint8_t>(new uint8_t[size], std::default_delete<uint8_t[]>());
+}
+
+// A complete image is copied and keeps its state once the driver reuses its
+// buffer. An incomplete one is not copied, and still reaches the worker
+// side of the queue marked incomplete, with its status and frame ID.
+static void CheckHandoff()
+{
+    unsigned int allocations = 0;
+    FrameQueue queue(4);
+
+    SyntheticImage complete(64, 48);
+    complete.frameId = 41;
+    complete.timestamp = 123456789;
+    GrabbedFrame frame;
+    const SyntheticImage* image = &complete;
+    CopyEventImage(image, [&allocations](size_t size) { return AllocateCounted(size, allocations); }, frame);
+    const vector<uint8_t> expected = complete.buffer;
+    memset(&complete.buffer[0], 0, complete.buffer.size());
+    TEST_CHECK(allocations == 1 && frame.storage);
+    TEST_CHECK(frame.storage && memcmp(frame.storage.get(), &expected[0], expected.size()) == 0);
+    TEST_CHECK(!frame.incomplete && frame.frameId == 41 && frame.deviceTimestamp == 123456789);
+    TEST_CHECK(queue.Push(frame));
+
+    SyntheticImage partial(64, 48);
+    partial.incomplete = true;
+    partial.status = k_handoffMissingPackets;
+    partial.frameId = 42;
+    GrabbedFrame partialFrame;
+    image = &partial;
+    CopyEventImage(image, [&allocations](size_t size) { return AllocateCounted(size, allocations); }, partialFrame);
+    TEST_CHECK(allocations == 1 && !partialFrame.storage);
+    TEST_CHECK(queue.Push(partialFrame));
+
+    GrabbedFrame popped;
+    TEST_CHECK(queue.TryPop(popped) && !popped.incomplete && popped.frameId == 41);
+    TEST_CHECK(queue.TryPop(popped) && popped.incomplete);
+    TEST_CHECK(popped.imageStatus == k_handoffMissingPackets && popped.frameId == 42);
+}
+
+// An incomplete EVENT frame and a complete one go through the handoff and the
+// queue. The worker side reports the frames marked incomplete to the stream
+// diagnostics, as ProcessNextFrame does, and the next reading of the camera,
+// which lost packets, ends exactly one interval with incomplete frames.
+static void CheckIncompleteReported()
+{
+    StreamDiagnosticsConfig config;
+    config.intervalMs = 1;
+    StreamDiagnostics diagnostics(config);
+    std::atomic<uint64_t> readings(0);
+    const unsigned int camera = diagnostics.AddCamera("event", [&readings](StreamSample& sample) {
+        sample.counters[STREAM_LOST_PACKETS] = (int64_t)readings++;
+        return 0;
+    });
+    diagnostics.Activate(camera);
+    diagnostics.Start();
+    // Past the baseline reading
+    while (readings < 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    FrameQueue queue(4);
+    SyntheticImage partial(64, 48);
+    partial.incomplete = true;
+    SyntheticImage complete(64, 48);
+    const SyntheticImage* images[] = {&partial, &complete};
+    for (size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++)
+    {
+        GrabbedFrame frame;
+        CopyEventImage(images[i], [](size_t size) { return std::shared_ptr<uint8_t>(new uint8_t[size],
+                                                                                   std::default_delete<uint8_t[]>()); },
+                       frame);
+        frame.hostTimestamp = GetMonotonicNs();
+        queue.Push(frame);
+    }
+    GrabbedFrame frame;
+    while (queue.TryPop(frame))
+    {
+        if (frame.incomplete)
+        {
+            diagnostics.OnIncompleteFrame(camera, frame.hostTimestamp);
+        }
+    }
+
+    const uint64_t readingsReported = readings;
+    while (readings < readingsReported + 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    diagnostics.Stop();
+    AsyncLogger::Instance().Flush();
+    uint64_t intervals = 0;
+    for (int cause = 0; cause < NUM_STREAM_CAUSES; cause++)
+    {
+        intervals += diagnostics.GetIntervalCount(camera, (streamCause)cause);
+    }
+    TEST_CHECK(intervals == 1);
+    TEST_CHECK(diagnostics.GetIntervalCount(camera, STREAM_CAUSE_PACKET_LOSS) == 1);
+}
+
+static void TestEventHandoff(const TestOptions&)
+{
+    CheckHandoff();
+    CheckIncompleteReported();
+}
+
+TEST_REGISTER("handoff", TestEventHandoff);
@@ -0,0 +1,67 @@
+/*
+ * @Descripttion: Frame lease tests: release once, refusal past the limit and the use-after-release guard
+ * @version:
+ * @Date: 2026-10-20 06:09:52
+ * @LastEditTime: 2026-10-20 06:09:52
+ */
+
+#include <thread>
+#include <vector>
+#include "frame_lease.h"
+#include "test_common.h"
+
+using namespace std;
+
+const unsigned int k_leaseMaxLeases = 4;
+
+// The guarantees the recorder relies on when it writes Mono8 frames from the
+// acquisition buffer. The use-after-release check logs its error line on
+// purpose.
+static void TestFrameLease(const TestOptions&)
+{
+    FrameLeaseTracker tracker(k_leaseMaxLeases, "synthetic");
+
+    // Released once, when the last holder lets go, wherever that is
+    int releases = 0;
+    {
+        FrameLeasePtr lease = tracker.Acquire([&releases]() { releases++; });
+        FrameLeasePtr writer = lease;
+        std::thread consumer([writer]() { (void)writer->IsReleased(); });
+        lease.reset();
+        TEST_CHECK(releases == 0 && tracker.GetOutstanding() == 1);
+        consumer.join();
+        writer.reset();
+        TEST_CHECK(releases == 1 && tracker.GetOutstanding() == 0);
+    }
+
+    // An early release returns the buffer once; a stage reading afterwards is
+    // refused and counted
+    {
+        FrameLeasePtr lease = tracker.Acquire([&releases]() { releases++; });
+        TEST_CHECK(lease->Check("Test"));
+        lease->Release();
+        lease->Release();
+        TEST_CHECK(!lease->Check("Test"));
+        TEST_CHECK(releases == 2 && tracker.GetOutstanding() == 0);
+        TEST_CHECK(tracker.GetViolationCount() == 1);
+    }
+
+    // At the limit the caller gets no lease and copies instead
+    {
+        vector<FrameLeasePtr> leases;
+        for (unsigned int i = 0; i < k_leaseMaxLeases + 2; i++)
+        {
+            FrameLeasePtr lease = tracker.Acquire(FrameLease::ReleaseFunction());
+            if (lease)
+            {
+                leases.push_back(lease);
+            }
+        }
+        TEST_CHECK(leases.size() == k_leaseMaxLeases && tracker.GetRefusedCount() == 2);
+        TEST_CHECK(tracker.GetMaxOutstanding() == k_leaseMaxLeases);
+    }
+    TEST_CHECK(tracker.GetOutstanding() == 0);
+    AsyncLogger::Instance().Flush();
+}
+
+TEST_REGISTER("lease", TestFrameLease);
@@ -0,0 +1,87 @@
+/*
+ * @Descripttion: Entry point of the tests target
+ * @version:
+ * @Date: 2026-10-20 05:12:36
+ * @LastEditTime: 2026-10-20 05:12:36
+ */
+
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include "test_common.h"
+
+using namespace std;
+
+// Usage: tests [--filter=<substring>] [--output-dir=<dir>] [--bench=<path>] [--list]
+//
+// Runs every selected group and prints one line per group. Exits with 1 if a
+// check failed or no group matched the filter, so CTest sees the failure;
+// timings belong to the bench target.
+int main(int argc, char** argv)
+{
+    TestOptions options;
+    bool listOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 9, "--filter=") == 0)
+        {
+            options.filter = arg.substr(9);
+        }
+        else if (arg.compare(0, 13, "--output-dir=") == 0)
+        {
+            options.outputDir = arg.substr(13);
+        }
+        else if (arg.compare(0, 8, "--bench=") == 0)
+        {
+            options.benchPath = arg.substr(8);
+        }
+        else if (arg == "--list")
+        {
+            listOnly = true;
+        }
+        else
+        {
+            cerr << "Unknown argument " << arg << endl;
+            return -1;
+        }
+    }
+
+    const vector<TestEntry>& registry = GetTestRegistry();
+    unsigned int groups = 0;
+    unsigned int failedGroups = 0;
+    for (size_t i = 0; i < registry.size(); i++)
+    {
+        if (listOnly)
+        {
+            cout << registry[i].name << endl;
+            continue;
+        }
+        if (!options.filter.empty() && string(registry[i].name).find(options.filter) == string::npos)
+        {
+            continue;
+        }
+        groups++;
+        GetTestFailures() = 0;
+        registry[i].function(options);
+        if (GetTestFailures() > 0)
+        {
+            failedGroups++;
+            cout << "FAILED " << registry[i].name << " (" << GetTestFailures() << " checks)" << endl;
+        }
+        else
+        {
+            cout << "passed " << registry[i].name << endl;
+        }
+    }
+    if (listOnly)
+    {
+        return 0;
+    }
+    if (groups == 0)
+    {
+        cerr << "No test group matches " << options.filter << endl;
+        return 1;
+    }
+    return failedGroups > 0 ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * @Descripttion: Packed 10/12-bit tests: every unpacker gives back what was packed
+ * @version:
+ * @Date: 2026-10-20 05:12:36
+ * @LastEditTime: 2026-10-20 05:12:36
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "bench_common.h"
+#include "packed_pixels.h"
+#include "test_common.h"
+
+using namespace std;
+
+// Round trip of a synthetic frame of each packing through PackPixels16 and
+// every unpacker, SSSE3 and scalar, to 16 and to 8 bits. Also for lengths
+// that end inside a block or a group; each is unpacked from an exact-size
+// copy, so a kernel reading past the frame is caught by a sanitizer.
+static void TestPackedRoundTrip(const TestOptions&)
+{
+    const pixelPacking packings[] = {PACKING_10P, PACKING_12P, PACKING_12PACKED};
+    const SensorResolution& resolution = k_sensorResolutions[0];
+    for (size_t p = 0; p < sizeof(packings) / sizeof(packings[0]); p++)
+    {
+        const pixelPacking packing = packings[p];
+        vector<uint16_t> samples = MakeSyntheticFrame16(resolution.width, resolution.height);
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            samples[i] = (uint16_t)(samples[i] >> (12 - GetPackingBitDepth(packing)));
+        }
+        vector<uint8_t> packed(GetPackedSize(packing, samples.size()));
+        PackPixels16(packing, &samples[0], samples.size(), &packed[0]);
+
+        const unsigned int shift = GetPackingBitDepth(packing) - 8;
+        const size_t counts[] = {samples.size(), samples.size() - 1, samples.size() - 7, 33, 17, 16, 15, 3, 1};
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+        {
+            const size_t count = counts[c];
+            vector<uint8_t> source(packed.begin(), packed.begin() + GetPackedSize(packing, count));
+            vector<uint16_t> simd16(count);
+            vector<uint16_t> scalar16(count);
+            vector<uint8_t> simd8(count);
+            vector<uint8_t> scalar8(count);
+            UnpackPixels16(packing, &source[0], count, &simd16[0]);
+            UnpackPixels16Scalar(packing, &source[0], count, &scalar16[0]);
+            UnpackPixels8(packing, &source[0], count, &simd8[0]);
+            UnpackPixels8Scalar(packing, &source[0], count, &scalar8[0]);
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!TEST_CHECK(simd16[i] == samples[i] && scalar16[i] == samples[i] &&
+                                simd8[i] == samples[i] >> shift && scalar8[i] == simd8[i]))
+                {
+                    fprintf(stderr, "Packing %d, %zu samples, at %zu: %u, unpacked %u/%u, 8-bit %u/%u\n", (int)packing,
+                            count, i, samples[i], simd16[i], scalar16[i], simd8[i], scalar8[i]);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+TEST_REGISTER("packed", TestPackedRoundTrip);
@@ -0,0 +1,90 @@
+/*
+ * @Descripttion: Pixel pipeline tests: fused single-pass kernels against one pass per stage
+ * @version:
+ * @Date: 2026-10-20 07:15:43
+ * @LastEditTime: 2026-10-20 07:15:43
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "bench_common.h"
+#include "pixel_pipeline.h"
+#include "test_common.h"
+
+using namespace std;
+
+// Every combination the recorder runs ahead of JPEG encoding gives the same
+// output from the fused kernel as from one pass per stage, at a sensor
+// resolution and at an odd size whose crop and bins do not divide evenly.
+static void TestPixelPipeline(const TestOptions&)
+{
+    struct PipelineCase
+    {
+        const char* name;
+        pipelineFormat input;
+        pipelineFormat output;
+        bool crop;
+        unsigned int bin;
+        bool lut;
+    };
+    const PipelineCase cases[] = {
+        {"mono8_lut", PIPELINE_MONO8, PIPELINE_MONO8, false, 1, true},
+        {"mono8_crop_bin2_lut", PIPELINE_MONO8, PIPELINE_MONO8, true, 2, true},
+        {"mono16_to_mono8", PIPELINE_MONO16, PIPELINE_MONO8, false, 1, false},
+        {"mono16_to_mono8_crop_bin2_lut", PIPELINE_MONO16, PIPELINE_MONO8, true, 2, true},
+        {"mono16_bin2", PIPELINE_MONO16, PIPELINE_MONO16, false, 2, false},
+        {"bayerrg8_to_mono8", PIPELINE_BAYERRG8, PIPELINE_MONO8, false, 1, false},
+        {"bayerrg8_to_mono8_bin2_lut", PIPELINE_BAYERRG8, PIPELINE_MONO8, false, 2, true},
+    };
+    const unsigned int sizes[][2] = {{1440, 1080}, {1002, 751}};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        const unsigned int width = sizes[s][0];
+        const unsigned int height = sizes[s][1];
+        const vector<uint8_t> frame8 = MakeSyntheticFrame8(width, height);
+        vector<uint16_t> frame16 = MakeSyntheticFrame16(width, height);
+        for (size_t i = 0; i < frame16.size(); i++)
+        {
+            frame16[i] = (uint16_t)(frame16[i] & 0x0FFF);
+        }
+
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        {
+            const PipelineCase& pipelineCase = cases[c];
+            PipelineConfig config;
+            if (pipelineCase.crop)
+            {
+                config.cropX = width / 8;
+                config.cropY = height / 8;
+                config.cropWidth = width * 3 / 4;
+                config.cropHeight = height * 3 / 4;
+            }
+            config.bin = pipelineCase.bin;
+            config.inputBits = 12;
+            config.output = pipelineCase.output;
+            config.SetGamma(pipelineCase.lut ? 2.2 : 1.0);
+
+            const unsigned int bytesPerPixel = GetPipelineBytesPerPixel(pipelineCase.input);
+            const uint8_t* src = bytesPerPixel == 2 ? (const uint8_t*)&frame16[0] : &frame8[0];
+            const size_t stride = (size_t)width * bytesPerPixel;
+            PixelPipeline pipeline;
+            if (!TEST_CHECK(pipeline.Select(pipelineCase.input, config) == 0))
+            {
+                fprintf(stderr, "Pipeline %s is not instantiated\n", pipelineCase.name);
+                continue;
+            }
+            PipelineOutput fused;
+            PipelineOutput chained;
+            PipelineStages stages;
+            pipeline.Process(src, width, height, stride, fused);
+            RunChainedPipeline(pipelineCase.input, config, src, width, height, stride, stages, chained);
+            if (!TEST_CHECK(fused.width == chained.width && fused.height == chained.height &&
+                            fused.data == chained.data))
+            {
+                fprintf(stderr, "%s at %ux%u\n", pipelineCase.name, width, height);
+            }
+        }
+    }
+}
+
+TEST_REGISTER("pipeline", TestPixelPipeline);
@@ -0,0 +1,43 @@
+/*
+ * @Descripttion: Hot-plug recovery tests: a simulated camera unplugged and replugged while another records on
+ * @version:
+ * @Date: 2026-10-20 06:21:18
+ * @LastEditTime: 2026-10-20 06:21:18
+ */
+
+#include <string>
+#include "async_logger.h"
+#include "recovery_simulation.h"
+#include "test_common.h"
+
+using namespace std;
+
+// A camera unplugged for 100 ms comes back with its cached configuration and
+// one line in the gap file, well within the reacquire timeout. One that never
+// comes back is given up after the timeout, also with a gap line. Either way
+// the other camera records on without a grab error. Resume times are only
+// checked against a generous multiple of the bound, as they depend on the
+// machine; the bench reports them.
+static void TestDeviceRecovery(const TestOptions& options)
+{
+    const string gapPath = options.outputDir + "/test-recovery-gaps.csv";
+    DeviceRecoveryConfig config;
+    config.rescanIntervalMs = k_simulatedRescanMs;
+    config.reacquireTimeoutMs = k_simulatedRecoveryTimeoutMs;
+    const RecoveryRun replugged = SimulateOutage(config, 100, gapPath);
+    TEST_CHECK(!replugged.givenUp);
+    TEST_CHECK(replugged.configRestored);
+    TEST_CHECK(replugged.resumeMs > 0.0 && replugged.resumeMs < 10.0 * GetSimulatedResumeBoundMs());
+    TEST_CHECK(replugged.gapLines == 1);
+    TEST_CHECK(replugged.otherErrors == 0);
+
+    config.reacquireTimeoutMs = k_simulatedGoneTimeoutMs;
+    const RecoveryRun gone = SimulateOutage(config, 0, gapPath);
+    TEST_CHECK(gone.givenUp);
+    TEST_CHECK(gone.recoveryMs >= k_simulatedGoneTimeoutMs);
+    TEST_CHECK(gone.gapLines == 1);
+    TEST_CHECK(gone.otherErrors == 0);
+    AsyncLogger::Instance().Flush();
+}
+
+TEST_REGISTER("recovery", TestDeviceRecovery);
@@ -0,0 +1,99 @@
+/*
+ * @Descripttion: Session index tests: JPEG frames timed from the timestamp sidecar of their recording
+ * @version:
+ * @Date: 2026-10-20 07:52:31
+ * @LastEditTime: 2026-10-20 07:52:31
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "frame_timestamps.h"
+#include "session_index.h"
+#include "test_common.h"
+
+using namespace std;
+
+// This function writes a JPEG file as the recorder names it. The index never
+// decodes it, so any content does.
+static void WriteJpeg(const string& directory, const char* name, vector<string>& paths)
+{
+    const string path = directory + "/" + name;
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file != nullptr)
+    {
+        fputs("jpeg", file);
+        fclose(file);
+    }
+    paths.push_back(path);
+}
+
+// Camera 111 recorded frames 0 and 1 with a sidecar, frame 1 once its clock
+// was synchronized, and frame 2 before its line reached the sidecar. Camera
+// 222 left no sidecar. Once the sidecar lists frame 2, only reopening finds it.
+static void TestSessionIndex(const TestOptions& options)
+{
+    const string directory = options.outputDir + "/test-session";
+    mkdir(directory.c_str(), 0755);
+    const string sidecarPath = directory + "/1000-111" + k_frameTimestampsSuffix;
+    vector<string> paths(1, sidecarPath);
+    paths.push_back(directory + "/session.idx");
+    WriteJpeg(directory, "1000-111-0.jpg", paths);
+    WriteJpeg(directory, "1000-111-1.jpg", paths);
+    WriteJpeg(directory, "1001-111-2.jpg", paths);
+    WriteJpeg(directory, "1000-222-0.jpg", paths);
+    unlink((directory + "/session.idx").c_str());
+    {
+        FrameTimestampLog sidecar(sidecarPath);
+        TEST_CHECK(sidecar.IsOpen());
+        SyncedTimestamp synced;
+        sidecar.Append(0, 100, 5000000000ULL, synced);
+        synced.valid = true;
+        synced.monotonic = 6000000000ULL;
+        synced.errorNs = 20000;
+        sidecar.Append(1, 200, 6000100000ULL, synced);
+    }
+
+    SessionIndex index;
+    vector<string> directories(1, directory);
+    TEST_CHECK(index.Open(directories) == 0);
+    const int timed = index.FindCamera("111");
+    const int untimed = index.FindCamera("222");
+    TEST_CHECK(timed >= 0 && untimed >= 0);
+    if (timed < 0 || untimed < 0)
+    {
+        return;
+    }
+    const vector<SessionFrame>& frames = index.GetFrames(timed);
+    TEST_CHECK(frames.size() == 2);
+    TEST_CHECK(frames.size() == 2 && frames[0].timeBase == TIME_HOST_RECEIVE && frames[0].timestamp == 5000000000ULL);
+    TEST_CHECK(frames.size() == 2 && frames[1].timeBase == TIME_SYNCED && frames[1].timestamp == 6000000000ULL);
+    const vector<SessionFrame>& wallFrames = index.GetFrames(untimed);
+    TEST_CHECK(wallFrames.size() == 1 && wallFrames[0].timeBase == TIME_WALL_SECONDS);
+    TEST_CHECK(wallFrames.size() == 1 && wallFrames[0].timestamp == 1000000000000ULL);
+
+    SessionIndex reopened;
+    TEST_CHECK(reopened.Open(directories) == 0 && reopened.GetScannedSourceCount() == 0);
+
+    FILE* file = fopen(sidecarPath.c_str(), "a");
+    if (file != nullptr)
+    {
+        fputs("2,300,7000100000,7000000000,20000\n", file);
+        fclose(file);
+    }
+    SessionIndex appended;
+    TEST_CHECK(appended.Open(directories) == 0 && appended.GetScannedSourceCount() > 0);
+    const int camera = appended.FindCamera("111");
+    TEST_CHECK(camera >= 0 && appended.GetFrames(camera).size() == 3);
+    TEST_CHECK(camera >= 0 && appended.GetFrames(camera).back().timestamp == 7000000000ULL);
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        unlink(paths[i].c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+TEST_REGISTER("session", TestSessionIndex);
@@ -0,0 +1,43 @@
+/*
+ * @Descripttion: Load shedder tests: a simulated slow writer is shed only while it falls behind
+ * @version:
+ * @Date: 2026-10-20 05:58:40
+ * @LastEditTime: 2026-10-20 05:58:40
+ */
+
+#include "async_logger.h"
+#include "shedding_simulation.h"
+#include "test_common.h"
+
+using namespace std;
+
+// The writer falls behind for 4 s of a 12 s session. With the default
+// config the shedder reacts within a second, loses far fewer frames to the
+// full queue than no shedding does, and is back at none once the writer
+// has caught up. With every level disabled nothing is shed.
+static void TestLoadShedding(const TestOptions&)
+{
+    AsyncLogger::SetMinSeverity(SEVERITY_ERROR);
+    LoadShedderConfig adaptiveConfig;
+    const ShedSimulation adaptive = SimulateSlowWriter(adaptiveConfig);
+    LoadShedderConfig noneConfig;
+    for (unsigned int level = 0; level < NUM_SHEDDING_LEVELS; level++)
+    {
+        noneConfig.enabled[level] = false;
+    }
+    const ShedSimulation none = SimulateSlowWriter(noneConfig);
+    AsyncLogger::Instance().Flush();
+    AsyncLogger::SetMinSeverity(SEVERITY_INFO);
+
+    TEST_CHECK(adaptive.frames == none.frames);
+    TEST_CHECK(adaptive.maxLevel != SHEDDING_NONE && adaptive.shedBeforeSlow == 0);
+    TEST_CHECK(adaptive.firstShedNs > 0 && adaptive.firstShedNs < 1000000000ULL);
+    TEST_CHECK(adaptive.recoveredNs > 0 && adaptive.recoveredNs < k_shedSessionNs - k_shedSlowEndNs);
+    TEST_CHECK(adaptive.queueFull * 4 < none.queueFull);
+    TEST_CHECK(adaptive.written > none.written);
+
+    TEST_CHECK(none.shed == 0 && none.maxLevel == SHEDDING_NONE && none.levels.empty());
+    TEST_CHECK(none.queueFull > 0);
+}
+
+TEST_REGISTER("shedding", TestLoadShedding);
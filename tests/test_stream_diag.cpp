@@ -0,0 +1,129 @@
+/*
+ * @Descripttion: Stream diagnostics tests: cause attribution on simulated links and readings off the frame path
+ * @version:
+ * @Date: 2026-10-20 06:47:25
+ * @LastEditTime: 2026-10-20 06:47:25
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "stream_simulation.h"
+#include "test_common.h"
+
+using namespace std;
+
+// A simulated hour per transport layer. With resend counters (GigE) every
+// episode is attributed to its cause. Without them (USB3) late resends
+// can only show as unknown, and every other episode still gets its cause.
+static void CheckAttribution()
+{
+    const AttributionRun gige = SimulateAttribution(true);
+    TEST_CHECK(gige.episodes > 0 && gige.correct == gige.episodes);
+
+    const AttributionRun usb3 = SimulateAttribution(false);
+    uint64_t lateResends = 0;
+    for (int cause = 0; cause < NUM_STREAM_CAUSES; cause++)
+    {
+        lateResends += usb3.causes[EPISODE_LATE_RESENDS][cause];
+    }
+    TEST_CHECK(lateResends > 0 && usb3.causes[EPISODE_LATE_RESENDS][STREAM_CAUSE_UNKNOWN] == lateResends);
+    TEST_CHECK(usb3.episodes > 0 && usb3.correct == usb3.episodes - lateResends);
+}
+
+// Two threads report incomplete frames while the service reads both
+// cameras every millisecond. Every reading runs on the one sampler thread,
+// never on a frame thread, and the frames reported show up in the intervals.
+// The cameras only have the lost packets counter, so the warnings must leave
+// the others out rather than print them as -1.
+static void CheckFramePath()
+{
+    FILE* log = tmpfile();
+    if (!TEST_CHECK(log != nullptr))
+    {
+        return;
+    }
+    AsyncLogger::Instance().Flush();
+    AsyncLogger::Instance().SetOutput(log);
+    StreamDiagnosticsConfig config;
+    config.intervalMs = 1;
+    StreamDiagnostics diagnostics(config);
+    std::mutex readMutex;
+    std::vector<std::thread::id> readers;
+    std::atomic<uint64_t> readings(0);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        diagnostics.AddCamera("cam" + to_string(i), [&](StreamSample& sample) {
+            sample.counters[STREAM_LOST_PACKETS] = (int64_t)readings++;
+            std::lock_guard<std::mutex> lock(readMutex);
+            if (std::find(readers.begin(), readers.end(), std::this_thread::get_id()) == readers.end())
+            {
+                readers.push_back(std::this_thread::get_id());
+            }
+            return 0;
+        });
+        diagnostics.Activate(i);
+    }
+    diagnostics.Start();
+    std::atomic<bool> stop(false);
+    std::thread otherCamera([&]() {
+        while (!stop)
+        {
+            diagnostics.OnIncompleteFrame(1, GetMonotonicNs());
+            std::this_thread::yield();
+        }
+    });
+    const uint64_t deadline = GetMonotonicNs() + 50000000ULL;
+    while (GetMonotonicNs() < deadline)
+    {
+        diagnostics.OnIncompleteFrame(0, GetMonotonicNs());
+        std::this_thread::yield();
+    }
+    stop = true;
+    const std::thread::id otherCameraThread = otherCamera.get_id();
+    otherCamera.join();
+    // Let a last reading of both cameras take in the final frames
+    const uint64_t readingsAtEnd = readings;
+    while (readings < readingsAtEnd + 4)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    diagnostics.Stop();
+    AsyncLogger::Instance().Flush();
+    AsyncLogger::Instance().SetOutput(stderr);
+
+    TEST_CHECK(readers.size() == 1);
+    TEST_CHECK(std::find(readers.begin(), readers.end(), std::this_thread::get_id()) == readers.end());
+    TEST_CHECK(std::find(readers.begin(), readers.end(), otherCameraThread) == readers.end());
+    TEST_CHECK(diagnostics.GetIntervalCount(0, STREAM_CAUSE_PACKET_LOSS) > 0);
+    TEST_CHECK(diagnostics.GetIntervalCount(1, STREAM_CAUSE_PACKET_LOSS) > 0);
+
+    unsigned int warnings = 0;
+    char line[512];
+    rewind(log);
+    while (fgets(line, sizeof(line), log) != nullptr)
+    {
+        if (strstr(line, "incomplete frames") != nullptr)
+        {
+            warnings++;
+            TEST_CHECK(strstr(line, "lost_packets") != nullptr && strstr(line, "-1") == nullptr);
+        }
+    }
+    fclose(log);
+    TEST_CHECK(warnings > 0);
+}
+
+static void TestStreamDiagnostics(const TestOptions&)
+{
+    CheckAttribution();
+    CheckFramePath();
+}
+
+TEST_REGISTER("stream_diag", TestStreamDiagnostics);
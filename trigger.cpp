@@ -7,11 +7,17 @@
  * @LastEditTime: 2022-11-10 11:34:01
  */
 
+#include <pthread.h>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 #include "Spinnaker.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
+#include "time_utils.h"
 
 
 using namespace Spinnaker;
@@ -59,6 +65,25 @@ int PrintDeviceInfo(INodeMap& nodeMap, std::string camSerial)
 
 const triggerType chosenTrigger = SOFTWARE;
 
+// Use the following enum and global constant to select how several cameras
+// are run. SEQUENTIAL runs the example on one camera after the other;
+// CONCURRENT configures every camera for triggering first, acquires on all of
+// them in parallel with one grab thread per camera and fans each software
+// trigger out to all cameras at once. It reports the trigger to frame latency
+// of each camera and the skew between cameras.
+enum runType
+{
+    SEQUENTIAL,
+    CONCURRENT
+};
+
+const runType chosenRun = CONCURRENT;
+// Number of triggers (and images per camera)
+const unsigned int k_numTriggers = 10;
+// A fanned-out trigger is released this long after it is armed, so every
+// grab thread has woken up and is spinning when the release time comes
+const uint64_t k_triggerLeadNs = 2000000ULL;
+
 // This function configures the camera to use a trigger. First, trigger mode is
 // set to off in order to select the trigger source. Once the trigger source
 // has been selected, trigger mode is then enabled, which has the camera
@@ -400,7 +425,7 @@ int AcquireImages(CameraPtr pCam, INodeMap& nodeMap, INodeMap& nodeMapTLDevice)
         cout << endl;
 
         // Retrieve, convert, and save images
-        const int unsigned k_numImages = 10;
+        const int unsigned k_numImages = k_numTriggers;
 
         //
         // Create ImageProcessor instance for post processing images
@@ -525,8 +550,354 @@ int RunSingleCamera(CameraPtr pCam)
     return result;
 }
 
-// 每个相机通过Enter按键触发一次图像采集（共可以触发10次），支持多个相机轮流触发
-// 例如camera 0先通过Enter按键触发10次图像采集，然后camera 1再通过Enter按键触发10次图像采集
+// Trigger shared by the grab threads of CONCURRENT mode. The main thread arms
+// each trigger with a release time slightly in the future; every grab thread
+// wakes up, spins until that time and executes its own camera's software
+// trigger, so the cameras are triggered within microseconds of each other
+// instead of one command round trip apart.
+struct TriggerFanOut
+{
+    std::mutex mutex;
+    std::condition_variable armed;
+    std::condition_variable done;
+    unsigned int generation; // triggers armed so far
+    uint64_t releaseNs;      // GetMonotonicNs() time of the current trigger
+    unsigned int pending;    // grab threads not yet done with the current trigger
+
+    TriggerFanOut() : generation(0), releaseNs(0), pending(0)
+    {
+    }
+};
+
+// One camera of CONCURRENT mode and the timing of each of its triggers
+struct ConcurrentCamera
+{
+    CameraPtr pCam;
+    std::string serialNumber;
+    CCommandPtr triggerSoftware;
+    TriggerFanOut* fanOut;
+    std::vector<uint64_t> executeNs;  // when the trigger was executed, 0 if it was not
+    std::vector<uint64_t> receivedNs; // when the image arrived, 0 if none did
+    bool ok;
+
+    ConcurrentCamera() : fanOut(nullptr), executeNs(k_numTriggers, 0), receivedNs(k_numTriggers, 0), ok(true)
+    {
+    }
+};
+
+// This function configures a camera for CONCURRENT mode and begins
+// acquisition; the camera then waits for triggers.
+int PrepareConcurrentCamera(ConcurrentCamera& camera)
+{
+    try
+    {
+        CameraPtr pCam = camera.pCam;
+        INodeMap& nodeMapTLDevice = pCam->GetTLDeviceNodeMap();
+        CStringPtr ptrStringSerial = nodeMapTLDevice.GetNode("DeviceSerialNumber");
+        if (IsAvailable(ptrStringSerial) && IsReadable(ptrStringSerial))
+        {
+            camera.serialNumber = ptrStringSerial->GetValue().c_str();
+        }
+        PrintDeviceInfo(nodeMapTLDevice, camera.serialNumber);
+
+        // Initialize camera
+        pCam->Init();
+        INodeMap& nodeMap = pCam->GetNodeMap();
+
+        // Configure trigger
+        if (ConfigureTrigger(nodeMap) < 0)
+        {
+            return -1;
+        }
+        if (chosenTrigger == SOFTWARE)
+        {
+            camera.triggerSoftware = nodeMap.GetNode("TriggerSoftware");
+            if (!IsAvailable(camera.triggerSoftware) || !IsWritable(camera.triggerSoftware))
+            {
+                cout << "[" << camera.serialNumber << "] Unable to execute trigger. Aborting..." << endl;
+                return -1;
+            }
+        }
+
+        // Set acquisition mode to continuous
+        CEnumerationPtr ptrAcquisitionMode = nodeMap.GetNode("AcquisitionMode");
+        if (!IsAvailable(ptrAcquisitionMode) || !IsWritable(ptrAcquisitionMode))
+        {
+            cout << "[" << camera.serialNumber
+                 << "] Unable to set acquisition mode to continuous (node retrieval). Aborting..." << endl;
+            return -1;
+        }
+        CEnumEntryPtr ptrAcquisitionModeContinuous = ptrAcquisitionMode->GetEntryByName("Continuous");
+        if (!IsAvailable(ptrAcquisitionModeContinuous) || !IsReadable(ptrAcquisitionModeContinuous))
+        {
+            cout << "[" << camera.serialNumber
+                 << "] Unable to set acquisition mode to continuous (entry 'continuous' retrieval). Aborting..."
+                 << endl;
+            return -1;
+        }
+        ptrAcquisitionMode->SetIntValue(ptrAcquisitionModeContinuous->GetValue());
+
+        // Begin acquiring images; frames come only with triggers
+        pCam->BeginAcquisition();
+        cout << "[" << camera.serialNumber << "] Acquiring images..." << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "[" << camera.serialNumber << "] Error: " << e.what() << endl;
+        return -1;
+    }
+    return 0;
+}
+
+// This function is the grab thread of one camera in CONCURRENT mode. For
+// each trigger it waits until the trigger is armed, executes it at the
+// release time (software trigger only), then retrieves and saves the image.
+void* AcquireImagesConcurrently(void* arg)
+{
+    ConcurrentCamera& camera = *((ConcurrentCamera*)arg);
+    TriggerFanOut& fanOut = *camera.fanOut;
+
+    // One ImageProcessor per grab thread, set up as in AcquireImages()
+    ImageProcessor processor;
+    processor.SetColorProcessing(HQ_LINEAR);
+
+    for (unsigned int imageCnt = 0; imageCnt < k_numTriggers; imageCnt++)
+    {
+        try
+        {
+            if (chosenTrigger == SOFTWARE)
+            {
+                uint64_t releaseNs;
+                {
+                    std::unique_lock<std::mutex> lock(fanOut.mutex);
+                    fanOut.armed.wait(lock, [&]() { return fanOut.generation > imageCnt; });
+                    releaseNs = fanOut.releaseNs;
+                }
+                while (GetMonotonicNs() < releaseNs)
+                {
+                }
+                camera.executeNs[imageCnt] = GetMonotonicNs();
+                camera.triggerSoftware->Execute();
+            }
+
+            // Retrieve the next received image
+            ImagePtr pResultImage = camera.pCam->GetNextImage(1000);
+            camera.receivedNs[imageCnt] = GetMonotonicNs();
+
+            if (pResultImage->IsIncomplete())
+            {
+                cout << "[" << camera.serialNumber << "] Image incomplete with image status "
+                     << pResultImage->GetImageStatus() << "..." << endl;
+            }
+            else
+            {
+                // Convert image to mono 8
+                ImagePtr convertedImage = processor.Convert(pResultImage, PixelFormat_Mono8);
+
+                // Create a unique filename
+                ostringstream filename;
+                filename << "Trigger-";
+                if (camera.serialNumber != "")
+                {
+                    filename << camera.serialNumber << "-";
+                }
+                filename << imageCnt << ".jpg";
+
+                // Save image
+                convertedImage->Save(filename.str().c_str());
+                cout << "[" << camera.serialNumber << "] Grabbed image " << imageCnt << ", saved at "
+                     << filename.str() << endl;
+            }
+
+            // Release image
+            pResultImage->Release();
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            cout << "[" << camera.serialNumber << "] Error: " << e.what() << endl;
+            camera.ok = false;
+        }
+
+        if (chosenTrigger == SOFTWARE)
+        {
+            std::lock_guard<std::mutex> lock(fanOut.mutex);
+            if (--fanOut.pending == 0)
+            {
+                fanOut.done.notify_one();
+            }
+        }
+    }
+    return (void*)(intptr_t)(camera.ok ? 1 : 0);
+}
+
+// This function prints the minimum, median and maximum of a list of
+// durations in microseconds.
+void PrintDurationStats(const std::string& label, std::vector<uint64_t> durations)
+{
+    if (durations.empty())
+    {
+        cout << label << ": no samples" << endl;
+        return;
+    }
+    std::sort(durations.begin(), durations.end());
+    cout << label << ": min " << durations.front() / 1000 << " us, median " << durations[durations.size() / 2] / 1000
+         << " us, max " << durations.back() / 1000 << " us (" << durations.size() << " triggers)" << endl;
+}
+
+// This function prints the trigger to frame latency of each camera and the
+// spread of trigger execution and frame arrival between cameras.
+void PrintTriggerTiming(const std::vector<ConcurrentCamera>& cameras)
+{
+    cout << endl << "*** TRIGGER TIMING ***" << endl << endl;
+    if (chosenTrigger == SOFTWARE)
+    {
+        for (size_t i = 0; i < cameras.size(); i++)
+        {
+            std::vector<uint64_t> latencies;
+            for (unsigned int t = 0; t < k_numTriggers; t++)
+            {
+                if (cameras[i].executeNs[t] != 0 && cameras[i].receivedNs[t] != 0)
+                {
+                    latencies.push_back(cameras[i].receivedNs[t] - cameras[i].executeNs[t]);
+                }
+            }
+            PrintDurationStats("[" + cameras[i].serialNumber + "] Trigger to frame latency", latencies);
+        }
+    }
+
+    // Spread between the first and the last camera of each trigger
+    std::vector<uint64_t> executeSkews;
+    std::vector<uint64_t> arrivalSkews;
+    for (unsigned int t = 0; t < k_numTriggers && cameras.size() > 1; t++)
+    {
+        uint64_t executeFirst = UINT64_MAX, executeLast = 0, arrivalFirst = UINT64_MAX, arrivalLast = 0;
+        unsigned int executed = 0, arrived = 0;
+        for (size_t i = 0; i < cameras.size(); i++)
+        {
+            if (cameras[i].executeNs[t] != 0)
+            {
+                executeFirst = std::min(executeFirst, cameras[i].executeNs[t]);
+                executeLast = std::max(executeLast, cameras[i].executeNs[t]);
+                executed++;
+            }
+            if (cameras[i].receivedNs[t] != 0)
+            {
+                arrivalFirst = std::min(arrivalFirst, cameras[i].receivedNs[t]);
+                arrivalLast = std::max(arrivalLast, cameras[i].receivedNs[t]);
+                arrived++;
+            }
+        }
+        if (executed == cameras.size())
+        {
+            executeSkews.push_back(executeLast - executeFirst);
+        }
+        if (arrived == cameras.size())
+        {
+            arrivalSkews.push_back(arrivalLast - arrivalFirst);
+        }
+    }
+    if (cameras.size() > 1)
+    {
+        if (chosenTrigger == SOFTWARE)
+        {
+            PrintDurationStats("Inter-camera trigger skew", executeSkews);
+        }
+        PrintDurationStats("Inter-camera frame arrival skew", arrivalSkews);
+    }
+    cout << endl;
+}
+
+// This function runs the example on all cameras at once: every camera is
+// configured for triggering before the first trigger, and each trigger
+// reaches all of them together.
+int RunConcurrentCameras(CameraList& camList)
+{
+    int result = 0;
+    const unsigned int numCameras = camList.GetSize();
+    std::vector<ConcurrentCamera> cameras(numCameras);
+    TriggerFanOut fanOut;
+
+    // Configure every camera before the first trigger
+    unsigned int prepared = 0;
+    for (; prepared < numCameras; prepared++)
+    {
+        cameras[prepared].pCam = camList.GetByIndex(prepared);
+        cameras[prepared].fanOut = &fanOut;
+        if (PrepareConcurrentCamera(cameras[prepared]) < 0)
+        {
+            result = -1;
+            break;
+        }
+    }
+
+    if (result == 0)
+    {
+        std::vector<pthread_t> grabThreads(numCameras);
+        for (unsigned int i = 0; i < numCameras; i++)
+        {
+            pthread_create(&grabThreads[i], nullptr, &AcquireImagesConcurrently, &cameras[i]);
+        }
+
+        if (chosenTrigger == SOFTWARE)
+        {
+            for (unsigned int t = 0; t < k_numTriggers; t++)
+            {
+                cout << "Press the Enter key to trigger all " << numCameras << " cameras." << endl;
+                getchar();
+                std::unique_lock<std::mutex> lock(fanOut.mutex);
+                fanOut.pending = numCameras;
+                fanOut.releaseNs = GetMonotonicNs() + k_triggerLeadNs;
+                fanOut.generation++;
+                fanOut.armed.notify_all();
+                // Wait until every camera has its image before the next prompt
+                fanOut.done.wait(lock, [&]() { return fanOut.pending == 0; });
+            }
+        }
+        else
+        {
+            cout << "Use the hardware to trigger image acquisition on all cameras." << endl;
+        }
+
+        for (unsigned int i = 0; i < numCameras; i++)
+        {
+            void* exitcode;
+            if (pthread_join(grabThreads[i], &exitcode) != 0 || (int)(intptr_t)exitcode == 0)
+            {
+                cout << "Grab thread for camera at index " << i << " exited with errors." << endl;
+                result = -1;
+            }
+        }
+        PrintTriggerTiming(cameras);
+    }
+
+    // End acquisition, reset trigger and deinitialize every camera that was initialized
+    for (unsigned int i = 0; i < numCameras; i++)
+    {
+        try
+        {
+            if (!cameras[i].pCam.IsValid() || !cameras[i].pCam->IsInitialized())
+            {
+                continue;
+            }
+            if (cameras[i].pCam->IsStreaming())
+            {
+                cameras[i].pCam->EndAcquisition();
+            }
+            result = result | ResetTrigger(cameras[i].pCam->GetNodeMap());
+            cameras[i].pCam->DeInit();
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            cout << "[" << cameras[i].serialNumber << "] Error: " << e.what() << endl;
+            result = -1;
+        }
+    }
+    return result;
+}
+
+// 每个相机通过Enter按键触发一次图像采集（共可以触发10次）
+// SEQUENTIAL：多个相机轮流触发，例如camera 0先通过Enter按键触发10次图像采集，然后camera 1再通过Enter按键触发10次图像采集
+// CONCURRENT：所有相机同时配置、并行采集，每次Enter按键同时触发所有相机，并统计触发延迟和相机间偏差
 int main(int /*argc*/, char** /*argv*/)
 {
     // Since this application saves images in the current folder
@@ -582,15 +953,30 @@ int main(int /*argc*/, char** /*argv*/)
         return -1;
     }
 
-    // Run example on each camera
-    for (unsigned int i = 0; i < numCameras; i++)
+    const uint64_t sessionStart = GetMonotonicNs();
+    if (chosenRun == CONCURRENT)
     {
-        cout << endl << "Running example for camera " << i << "..." << endl;
+        // Run example on all cameras at once
+        cout << endl << "Running example for all cameras..." << endl;
 
-        result = result | RunSingleCamera(camList.GetByIndex(i));
+        result = RunConcurrentCameras(camList);
 
-        cout << "Camera " << i << " example complete..." << endl << endl;
+        cout << "Example complete..." << endl << endl;
+    }
+    else
+    {
+        // Run example on each camera
+        for (unsigned int i = 0; i < numCameras; i++)
+        {
+            cout << endl << "Running example for camera " << i << "..." << endl;
+
+            result = result | RunSingleCamera(camList.GetByIndex(i));
+
+            cout << "Camera " << i << " example complete..." << endl << endl;
+        }
     }
+    cout << "Session took " << (GetMonotonicNs() - sessionStart) / 1000000 << " ms for " << numCameras
+         << " cameras" << endl;
 
     // Clear camera list before releasing system
     camList.Clear();